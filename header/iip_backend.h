@@ -0,0 +1,113 @@
+/*
+ * ===========================================================
+ *           Copyright (c) 2018, __IIPLAB__
+ *                All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of
+ * the Mozilla Public License, v. 2.0.
+ * If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/.
+ * ===========================================================
+ */
+#ifndef IIP_BACKEND_H
+#define IIP_BACKEND_H
+#include "iip_type.h"
+
+/**** BLAS BACKEND ****/
+/* gemm, gemv and syrk go either to built-in kernels(omp_gemm(),
+ * omp_gemv(), ...) or to a BLAS backend, call by call, by size of the
+ * problem.
+ *
+ * backend : BLAS linked by USE_CBLAS("linked"), or with USE_DLBLAS a
+ *           library loaded at run time by blas_open(). "none" without.
+ * size    : m * n * k for gemm, m * n for gemv, n * n * k for syrk. A
+ *           call of size from the threshold of its op on goes to BLAS,
+ *           see BLAS_GEMM_MIN.
+ *
+ * init() calls blas_init(), which takes environment variables
+ *  IIP_BLAS_LIB  : library for blas_open(), USE_DLBLAS only
+ *  IIP_BLAS_TUNE : file of thresholds for blas_load_tune()
+ *  ex) IIP_BLAS_LIB=libopenblas.so.0 IIP_BLAS_TUNE=blas.tune ./a.out
+ * */
+#define BLAS_GEMM 0
+#define BLAS_CGEMM 1
+#define BLAS_GEMV 2
+#define BLAS_CGEMV 3
+#define BLAS_SYRK 4
+#define BLAS_HERK 5
+#define BLAS_OPS 6
+
+#define ROUTE_BUILTIN 0
+#define ROUTE_BLAS 1
+
+/* threshold which no call reaches */
+#define BLAS_NEVER (~0ULL)
+
+void blas_init();
+/* Loads cblas_?gemm, cblas_?gemv, cblas_?syrk and cblas_?herk of the
+ * library at path. NULL tries OpenBLAS, MKL and system BLAS in turn.
+ * Returns 1 when loaded, 0 keeps the backend before. Not to be called
+ * inside a parallel region. */
+int blas_open(const char* path);
+/* Unloads the library of blas_open(), back to "linked" or "none". */
+void blas_close();
+const char* blas_name();
+/* Sets threads of the backend to n and returns the number before, for
+ * restoring it. Returns 0 if the backend has no such control. Not to be
+ * called inside a parallel region. */
+int blas_set_threads(int n);
+
+void blas_set_threshold(int op, unsigned long long int size);
+unsigned long long int blas_get_threshold(int op);
+/* Returns 1 if a call of op and size goes to BLAS. */
+int blas_use(int op, unsigned long long int size);
+/* Counts cnt calls of op on route, for callers running BLAS by
+ * themselves, such as cblas_?gemm_batch(). */
+void blas_count(int op, int route, unsigned long long int cnt);
+
+/* omp_gemm(), omp_cgemm(), omp_gemv() and omp_cgemv() routed by size.
+ * Same arguments, column-major gemm and row-major gemv. */
+void route_gemm(char transA, char transB, UINT m, UINT n, UINT k, DTYPE alpha,
+                DTYPE* A, UINT lda, DTYPE* B, UINT ldb, DTYPE beta, DTYPE* C,
+                UINT ldc);
+void route_cgemm(char transA, char transB, UINT m, UINT n, UINT k,
+                 CTYPE alpha, CTYPE* A, UINT lda, CTYPE* B, UINT ldb,
+                 CTYPE beta, CTYPE* C, UINT ldc);
+void route_gemv(char transA, UINT m, UINT n, DTYPE alpha, DTYPE* A, UINT lda,
+                DTYPE* X, SINT incx, DTYPE beta, DTYPE* Y, SINT incy);
+void route_cgemv(char transA, UINT m, UINT n, CTYPE alpha, CTYPE* A, UINT lda,
+                 CTYPE* X, SINT incx, CTYPE beta, CTYPE* Y, SINT incy);
+/* omp_syrk() and omp_herk() routed by size. */
+void route_syrk(char uplo, char trans, UINT n, UINT k, DTYPE alpha, DTYPE* A,
+                UINT lda, DTYPE beta, DTYPE* C, UINT ldc);
+void route_herk(char uplo, char trans, UINT n, UINT k, DTYPE alpha, CTYPE* A,
+                UINT lda, DTYPE beta, CTYPE* C, UINT ldc);
+
+/* Times built-in kernels against the backend on square problems of
+ * growing size, and sets each threshold to the size from which BLAS wins
+ * to the end, BLAS_NEVER if it doesn't. Thresholds are written to path
+ * unless NULL, as lines of "<op> <size>" for blas_load_tune().
+ *  ex) blas_autotune("blas.tune");  // once per machine and library */
+void blas_autotune(const char* path);
+/* Returns the number of thresholds read, -1 if path can't be opened. */
+int blas_load_tune(const char* path);
+
+/**** BLAS STATISTICS ****/
+/* name      : backend
+ * threshold : size from which op goes to BLAS
+ * builtin   : calls of op run on built-in kernels
+ * blas      : calls of op run on BLAS
+ * Indexed by BLAS_GEMM, BLAS_CGEMM, ..., BLAS_HERK.
+ * */
+typedef struct BLAS_STAT {
+  char name[MAX_CHAR];
+  unsigned long long int threshold[BLAS_OPS];
+  unsigned long long int builtin[BLAS_OPS];
+  unsigned long long int blas[BLAS_OPS];
+} BLAS_STAT;
+
+void blas_stat(BLAS_STAT* stat);
+void blas_stat_reset();
+/* Writes BLAS_STAT as one line of JSON object. */
+void blas_stat_json(FILE* fp);
+#endif
@@ -0,0 +1,54 @@
+/*
+ * ===========================================================
+ *           Copyright (c) 2018, __IIPLAB__
+ *                All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of
+ * the Mozilla Public License, v. 2.0.
+ * If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/.
+ * ===========================================================
+ */
+#ifndef IIP_BATCH_H
+#define IIP_BATCH_H
+
+#include "iip_type.h"
+
+/**** batched small matrix ****/
+/* Operations on d2 slices of small matrices, up to SMALL_MAX x SMALL_MAX,
+ * such as channel x channel per frequency bin.
+ * Slices are taken SMALL_LANE at a time and interleaved, so that element
+ * (i,j) of every slice in the chunk is contiguous, and each step runs
+ * across slices instead of inside one.
+ *
+ * ex) R : 4 x 4 x 257 spatial covariance, one per bin
+ *     invert_small(R, Ri);
+ *     gemv_small(NoTran, 1, Ri, steer, 0, w);   // steer : 4 x 1 x 257
+ * */
+
+/* C = alpha * op(A) * op(B) + beta * C on each slice, column-major same as
+ * gemm_mat(). A or B of d2 == 1 is shared by every slice. */
+void gemm_small(char transA, char transB, DTYPE alpha, MAT* A, MAT* B,
+                DTYPE beta, MAT* C);
+void cgemm_small(char transA, char transB, CTYPE alpha, CMAT* A, CMAT* B,
+                 CTYPE beta, CMAT* C);
+
+/* Y = alpha * op(A) * X + beta * Y on each slice, A is column-major as in
+ * gemm_small(), unlike gemv_mat(). X and Y hold one vector per slice, of
+ * d0 * d1 elements. A of d2 == 1 is shared by every slice. */
+void gemv_small(char transA, DTYPE alpha, MAT* A, MAT* X, DTYPE beta, MAT* Y);
+void cgemv_small(char transA, CTYPE alpha, CMAT* A, CMAT* X, CTYPE beta,
+                 CMAT* Y);
+
+/* Inverse of each slice. Real slices up to 6 x 6 go through the closed
+ * forms of invert(), complex ones through the adjugate up to 4 x 4, others
+ * through Gauss-Jordan elimination with partial pivoting.
+ * mat and inv may be the same. */
+void invert_small(MAT* mat, MAT* inv);
+void cinvert_small(CMAT* mat, CMAT* inv);
+
+/* Determinant of each slice into d, which holds d2 elements. */
+void det_small(MAT* mat, MAT* d);
+void cdet_small(CMAT* mat, CMAT* d);
+
+#endif
@@ -58,6 +58,12 @@ void caxpy_inc(UINT size, CTYPE alpha, CTYPE *X, ITER incx, CTYPE *Y,
                ITER incy);
 void omp_caxpy(UINT, CTYPE, CTYPE *, UINT, CTYPE *, UINT);
 
+/* axpy and scal on TMAT, s/d/c/z by dtype. x of d2 = 1 is broadcast.
+ * scal_tmat() takes real alpha for every dtype. */
+void axpy_tmat(double alpha, TMAT *x, TMAT *y);
+void caxpy_tmat(CTYPE_D alpha, TMAT *x, TMAT *y);
+void scal_tmat(double alpha, TMAT *mat);
+
 #if USE_CUDA
 __global__ void cu_axpy(DTYPE alpha, DTYPE *X, UINT INCX, DTYPE *Y, UINT INCY,
                         UINT len, UINT block_size);
@@ -76,6 +82,24 @@ void ccopy_mat(CMAT *src, CMAT *des);
 void ccopy_mat_inc(UINT size, CTYPE  *X, ITER incx, CTYPE *Y,ITER incxy);
 void omp_ccopy_mat(UINT N, CTYPE *src, SINT src_inc, CTYPE *des, SINT des_inc);
 
+/* axpy and copy on views, see subview().
+ * x(src) of d2 = 1 is broadcast over d2 of y(des). */
+void axpy_view(DTYPE alpha, MAT_VIEW *x, MAT_VIEW *y);
+void axpy_cview(CTYPE alpha, CMAT_VIEW *x, CMAT_VIEW *y);
+void copy_view(MAT_VIEW *src, MAT_VIEW *des);
+void ccopy_view(CMAT_VIEW *src, CMAT_VIEW *des);
+
+/* axpy and copy on d0 x d1 blocks at data + off, columns ld apart, see
+ * ld_view(). A vector of increment inc is 1 x n with ld = inc. */
+void axpy_mat_ld(UINT d0, UINT d1, DTYPE alpha, MAT *x, UINT offx, UINT ldx,
+                 MAT *y, UINT offy, UINT ldy);
+void axpy_cmat_ld(UINT d0, UINT d1, CTYPE alpha, CMAT *x, UINT offx,
+                  UINT ldx, CMAT *y, UINT offy, UINT ldy);
+void copy_mat_ld(UINT d0, UINT d1, MAT *src, UINT offs, UINT lds, MAT *des,
+                 UINT offd, UINT ldd);
+void ccopy_mat_ld(UINT d0, UINT d1, CMAT *src, UINT offs, UINT lds,
+                  CMAT *des, UINT offd, UINT ldd);
+
 #if USE_CUDA
 __global__ void cu_copy(DTYPE *SRC, UINT INC_SRC, DTYPE *DES, UINT INC_DES,
                         UINT len, UINT block_size);
@@ -203,6 +227,7 @@ void omp_cscal(UINT size, DTYPE alpha, CTYPE *X, UINT incx);
 
 /* (complex MAT) * (complex number) */
 void cscal_cmat(CTYPE alpha, CMAT *mat);
+void pscal_pcmat(CTYPE alpha, PCMAT *mat);
 void uscal_inc(UINT size, CTYPE alpha, CTYPE *X, UINT incx);
 void omp_uscal(UINT size, CTYPE alpha, CTYPE *X, UINT incx);
 
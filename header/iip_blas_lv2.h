@@ -21,6 +21,11 @@
  *  */
 
 #ifndef USE_CUDA
+/* MAT of d0 x d1 is taken as row-major d1 x d0, so that
+ * NoTran : Y(d1) = alpha * A^T * X(d0) + beta * Y
+ * Tran   : Y(d0) = alpha * A * X(d1) + beta * Y
+ * omp_gemv() is row-major gemv, lda is the stride between rows.
+ * Calls go to BLAS or omp_gemv() by size, see iip_backend.h. */
 void gemv_mat(char transA, DTYPE alpha, MAT* A, MAT* X, DTYPE beta, MAT* Y);
 void omp_gemv(char transA, UINT m, UINT n, DTYPE alpha, DTYPE* A, UINT lda,
               DTYPE* X, SINT incx, DTYPE beta, DTYPE* Y, SINT incy);
@@ -29,6 +34,42 @@ void gemv_cmat(char transA, CTYPE alpha, CMAT* A, CMAT* X, CTYPE beta, CMAT* Y);
 void omp_cgemv(char transA, UINT m, UINT n, CTYPE alpha, CTYPE* A, UINT lda,
                CTYPE* X, SINT incx, CTYPE beta, CTYPE* Y, SINT incy);
 
+/* gemv_mat() on k vectors at once, X and Y hold one vector per column.
+ * NoTran : Y(d1 x k) = alpha * A^T * X(d0 x k) + beta * Y
+ * Tran   : Y(d0 x k) = alpha * A * X(d1 x k) + beta * Y
+ * ex) frames of one block as columns of X, projected by one gemm. */
+void gemv_rhs_mat(char transA, DTYPE alpha, MAT* A, MAT* X, DTYPE beta,
+                  MAT* Y);
+void gemv_rhs_cmat(char transA, CTYPE alpha, CMAT* A, CMAT* X, CTYPE beta,
+                   CMAT* Y);
+/* omp_gemv() on k vectors, columns of X and Y of ldx and ldy. */
+void omp_gemv_rhs(char transA, UINT m, UINT n, UINT k, DTYPE alpha, DTYPE* A,
+                  UINT lda, DTYPE* X, UINT ldx, DTYPE beta, DTYPE* Y,
+                  UINT ldy);
+
+/* gemv on views, see subview(). A is 2D, X and Y are a column or a row. */
+void gemv_view(char transA, DTYPE alpha, MAT_VIEW* A, MAT_VIEW* X, DTYPE beta,
+               MAT_VIEW* Y);
+void gemv_cview(char transA, CTYPE alpha, CMAT_VIEW* A, CMAT_VIEW* X,
+                CTYPE beta, CMAT_VIEW* Y);
+
+/* gemv_mat() on d0 x d1 block of A at data + offa, columns lda apart, see
+ * ld_view(). X and Y are vectors at data + off of increment inc.
+ * ex) gemv_mat_ld(NoTran, 20, 8, 1, S, t * 257 + 10, 257, w, 0, 1, 0, y, 0, 1)
+ *     // y(8) = S(10:29, t:t+7)^T * w(20), S untouched */
+void gemv_mat_ld(char transA, UINT d0, UINT d1, DTYPE alpha, MAT* A,
+                 UINT offa, UINT lda, MAT* X, UINT offx, UINT incx,
+                 DTYPE beta, MAT* Y, UINT offy, UINT incy);
+void gemv_cmat_ld(char transA, UINT d0, UINT d1, CTYPE alpha, CMAT* A,
+                  UINT offa, UINT lda, CMAT* X, UINT offx, UINT incx,
+                  CTYPE beta, CMAT* Y, UINT offy, UINT incy);
+
+/* gemv on TMAT, same as gemv_mat(). s/d/c/z by dtype of A, X and Y. */
+void gemv_tmat(char transA, double alpha, TMAT* A, TMAT* X, double beta,
+               TMAT* Y);
+void cgemv_tmat(char transA, CTYPE_D alpha, TMAT* A, TMAT* X, CTYPE_D beta,
+                TMAT* Y);
+
 #else
 void gemv_mat(cublasOperation_t transA, DTYPE alpha, MAT* A, MAT* X, DTYPE beta,
           MAT* Y);
@@ -63,12 +63,84 @@ void gemm_mat(char transA, char transB, DTYPE alpha, MAT* A, MAT* B, DTYPE beta,
 void omp_gemm(char transA, char transB, UINT m, UINT n, UINT k, DTYPE alpha,
               DTYPE* A, UINT lda, DTYPE* B, UINT ldb, DTYPE beta, DTYPE* C,
               UINT ldc);
+/* gemm on batch of slices, slice i of A at A + i * sa and so B and C.
+ * Stride 0 shares one slice over the batch. gemm_mat() runs on it.
+ * Each slice goes to BLAS or omp_gemm() by size, see iip_backend.h. */
+void gemm_batch(char transA, char transB, UINT m, UINT n, UINT k, DTYPE alpha,
+                DTYPE* A, UINT lda, UINT sa, DTYPE* B, UINT ldb, UINT sb,
+                DTYPE beta, DTYPE* C, UINT ldc, UINT sc, UINT batch);
 
 void gemm_cmat(char transA, char transB, CTYPE alpha, CMAT* A, CMAT* B, CTYPE beta,
            CMAT* C);
 void omp_cgemm(char transA, char transB, UINT m, UINT n, UINT k, CTYPE alpha,
                CTYPE* A, UINT lda, CTYPE* B, UINT ldb, CTYPE beta, CTYPE* C,
                UINT ldc);
+void cgemm_batch(char transA, char transB, UINT m, UINT n, UINT k, CTYPE alpha,
+                 CTYPE* A, UINT lda, UINT sa, CTYPE* B, UINT ldb, UINT sb,
+                 CTYPE beta, CTYPE* C, UINT ldc, UINT sc, UINT batch);
+
+/* gemm on views, see subview(). Broadcasting over d2 is same as gemm_mat().
+ * ex) gemm_view(NoTran,NoTran,1,&band,&W,0,&out)
+ *     where band = subview(S,10,20,-1,-1), without copy of S
+ * trans/conj flags of A and B, see trans_view(), are applied on the fly.
+ * */
+void gemm_view(char transA, char transB, DTYPE alpha, MAT_VIEW* A, MAT_VIEW* B,
+               DTYPE beta, MAT_VIEW* C);
+void gemm_cview(char transA, char transB, CTYPE alpha, CMAT_VIEW* A,
+                CMAT_VIEW* B, CTYPE beta, CMAT_VIEW* C);
+
+/* gemm on blocks inside data of A, B and C, at data + off with columns ld
+ * apart, as cblas_?gemm() takes them. op(A) : m x k, op(B) : k x n,
+ * C : m x n. See ld_view().
+ * ex) gemm_mat_ld(NoTran,NoTran,257,1,8,1,S,t*257,257,w,0,8,0,y,0,257)
+ *     // y = frames t ~ t + 7 of S weighted by w(8), S untouched
+ * */
+void gemm_mat_ld(char transA, char transB, UINT m, UINT n, UINT k,
+                 DTYPE alpha, MAT* A, UINT offa, UINT lda, MAT* B, UINT offb,
+                 UINT ldb, DTYPE beta, MAT* C, UINT offc, UINT ldc);
+void gemm_cmat_ld(char transA, char transB, UINT m, UINT n, UINT k,
+                  CTYPE alpha, CMAT* A, UINT offa, UINT lda, CMAT* B,
+                  UINT offb, UINT ldb, CTYPE beta, CMAT* C, UINT offc,
+                  UINT ldc);
+
+/* Rank-k update of one triangle of each slice of C over d2, with half of
+ * the flops of gemm.
+ * syrk_mat  : C = alpha * A * A^T + beta * C (NoTran)
+ *             C = alpha * A^T * A + beta * C (Tran)
+ * herk_cmat : C = alpha * A * A^H + beta * C (NoTran)
+ *             C = alpha * A^H * A + beta * C (CTran), diagonal is real
+ * uplo : Upper or Lower triangle of C is written, the other one is left
+ *        as it is. See mirror_mat() to fill it.
+ * ex) spatial covariance per bin, X : channel x frame x bin, R : channel
+ *     x channel x bin
+ *     herk_cmat(Lower, NoTran, 1.0 / X->d1, X, 0, R);
+ *     mirror_cmat(Lower, R);  // when the full matrix is needed
+ * */
+void syrk_mat(char uplo, char trans, DTYPE alpha, MAT* A, DTYPE beta,
+              MAT* C);
+void herk_cmat(char uplo, char trans, DTYPE alpha, CMAT* A, DTYPE beta,
+               CMAT* C);
+/* Column-major n x n triangle of C, op(A) n x k. See SYRK_NB. */
+void omp_syrk(char uplo, char trans, UINT n, UINT k, DTYPE alpha, DTYPE* A,
+              UINT lda, DTYPE beta, DTYPE* C, UINT ldc);
+void omp_herk(char uplo, char trans, UINT n, UINT k, DTYPE alpha, CTYPE* A,
+              UINT lda, DTYPE beta, CTYPE* C, UINT ldc);
+/* syrk on batch of slices, same as gemm_batch(). */
+void syrk_batch(char uplo, char trans, UINT n, UINT k, DTYPE alpha, DTYPE* A,
+                UINT lda, UINT sa, DTYPE beta, DTYPE* C, UINT ldc, UINT sc,
+                UINT batch);
+void herk_batch(char uplo, char trans, UINT n, UINT k, DTYPE alpha, CTYPE* A,
+                UINT lda, UINT sa, DTYPE beta, CTYPE* C, UINT ldc, UINT sc,
+                UINT batch);
+
+/* gemm on TMAT, sgemm/dgemm by dtype of A, B and C which must be equal.
+ * cgemm_tmat() is cgemm/zgemm. alpha and beta are rounded for float.
+ * Broadcasting over d2 is same as gemm_mat().
+ * */
+void gemm_tmat(char transA, char transB, double alpha, TMAT* A, TMAT* B,
+               double beta, TMAT* C);
+void cgemm_tmat(char transA, char transB, CTYPE_D alpha, TMAT* A, TMAT* B,
+                CTYPE_D beta, TMAT* C);
 #else
 
 void gemm_mat(cublasOperation_t transA, cublasOperation_t transB, DTYPE alpha,
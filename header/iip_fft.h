@@ -82,7 +82,7 @@ void free_handle(mkl_handle*handle);
 /* Fast Fourier Transform
  * perform fft on first dimension(d0).
  * d0 must be power of 2
- * Every fft function uses memory pool.
+ * Every fft function takes its work area from scratch stack of memory pool.
  * Be sure to initialize memory pool by init(<size>);
  * */
 void fft(MAT*in,CMAT*out);
@@ -118,6 +118,11 @@ void ooura_hfft_col(UINT N,DTYPE*in, CTYPE*out);
 void hifft(CMAT*in, MAT*out);
 void ooura_hifft_col(UINT N,CTYPE*in,DTYPE*out);
 
+/* hfft() and hifft() on TMAT, in and out are DT_S and DT_C or
+ * DT_D and DT_Z. */
+void hfft_tmat(TMAT*in, TMAT*out);
+void hifft_tmat(TMAT*in, TMAT*out);
+
 /*
 -------- Complex DFT (Discrete Fourier Transform) --------
     [definition]
@@ -129,6 +129,13 @@ void abs_mat_inc(UINT size, DTYPE* X, ITER incx);
 void abs_cmat(CMAT* mat);
 void abs_cmat_inc(UINT size, CTYPE* X, ITER incx);
 
+/**** magnitude and phase of PCMAT ****/
+/* des = |mat|, des = arg(mat), des can be mat->re or mat->im.
+ * polar_pcmat() is the inverse, des = mag * exp(i*phase). */
+void abs_pcmat(PCMAT* mat, MAT* des);
+void angle_pcmat(PCMAT* mat, MAT* des);
+void polar_pcmat(MAT* mag, MAT* phase, PCMAT* des);
+
 /**** max ****/
 DTYPE max_mat(MAT* mat, DIM* dim);
 CTYPE max_cmat(CMAT* mat, DIM* dim);
@@ -167,4 +174,66 @@ void sum_cmat(CMAT* src, CMAT* des, UINT axis);  // des : d0 1 d2
 
 /**** return complex type : r + ii ****/
 CTYPE CX(DTYPE r, DTYPE i);
+
+/**** fused element-wise operation ****/
+/* A chain of element-wise operations run in one pass over memory.
+ * Every block of EW_BLOCK elements goes through the whole chain while it
+ * stays in L1, all blocks in one parallel region.
+ * Each op is same as its function : EW_LOG is log_mat(), EW_SCAL is
+ * scal_mat(), EW_ADD is add_mat(), EW_ADD_MAT is add_elements() of
+ * same shape, ...
+ *
+ * ex) log power spectrum, log10(scale * |X|^2 + eps) of STFT X
+ * EW_CHAIN c = ew_chain();
+ * ew_push(&c, EW_ABS, 0);
+ * ew_push(&c, EW_POW, 2);
+ * ew_push(&c, EW_SCAL, scale);
+ * ew_push(&c, EW_ADD, eps);
+ * ew_push(&c, EW_LOG10, 0);
+ * ew_run_cmat(&c, X, P);   // P is MAT of X's shape
+ * */
+#define EW_MAX_OP 16
+#define EW_BLOCK 1024
+
+// unary, arg is used by EW_POW, EW_SCAL, EW_ADD
+#define EW_ABS 1
+#define EW_SQRT 2
+#define EW_POW 3
+#define EW_SCAL 4
+#define EW_ADD 5
+#define EW_LOG 6
+#define EW_LOG10 7
+#define EW_LOG2 8
+#define EW_EXP 9
+#define EW_ROUND 10
+#define EW_FLOOR 11
+#define EW_CEIL 12
+// binary with a MAT of same shape, ew_push_mat()
+#define EW_ADD_MAT 13
+#define EW_MUL_MAT 14
+#define EW_DIV_MAT 15
+
+typedef struct EW_OP {
+  UINT code;
+  DTYPE arg;
+  MAT* mat;
+} EW_OP;
+
+typedef struct EW_CHAIN {
+  UINT n;
+  EW_OP op[EW_MAX_OP];
+} EW_CHAIN;
+
+EW_CHAIN ew_chain();
+void ew_push(EW_CHAIN* chain, UINT code, DTYPE arg);
+void ew_push_mat(EW_CHAIN* chain, UINT code, MAT* mat);
+
+/* des = chain(src), des can be src. */
+void ew_run(EW_CHAIN* chain, MAT* src, MAT* des);
+/* Chain of complex src must begin with EW_ABS, |X|^2 is taken without
+ * square root when EW_POW 2 follows. */
+void ew_run_cmat(EW_CHAIN* chain, CMAT* src, MAT* des);
+/* On TMAT, des is DT_S or DT_D and src is real or complex of the same
+ * precision. Operands of EW_*_MAT stay MAT and are rounded on the fly. */
+void ew_run_tmat(EW_CHAIN* chain, TMAT* src, TMAT* des);
 #endif
@@ -47,6 +47,8 @@ __global__ void cu_cfill(CTYPE*, UINT, DTYPE, DTYPE, UINT);
 #endif
 
 /*** allocate MAT ***/
+/* MAT and its data are one block, from slab cache of calling thread when
+ * small. Release it by free_mat(). */
 #define alloc_mat_load(_x, _3, _2, _1, ...) _1
 #define alloc_mat_load_(args_list) alloc_mat_load args_list
 #define alloc_mat(...) \
@@ -85,6 +87,16 @@ CMAT* mpalloc_cmat_1d(UINT d0);
 CMAT* mpalloc_cmat_2d(UINT d0, UINT d1);
 CMAT* mpalloc_cmat_3d(UINT d0, UINT d1, UINT d2);
 
+/**** allocate MAT in scratch stack : mp_scratch_mat ***/
+/* For temporaries inside a function.
+ *  MP_MARK mark = mp_mark();
+ *  t = mp_scratch_mat(d0, d1, d2);
+ *  ...
+ *  mp_release(mark);
+ * */
+MAT* mp_scratch_mat(UINT d0, UINT d1, UINT d2);
+CMAT* mp_scratch_cmat(UINT d0, UINT d1, UINT d2);
+
 /**** allocate matrix and set all elements as 0  ****/
 #define zeros_load(_x, _3, _2, _1, ...) _1
 #define zeros_load_(args_list) zeros_load args_list
@@ -212,6 +224,71 @@ CMAT* mpcsubmat_2d(CMAT* src, ITER s0, ITER e0, ITER s1, ITER e1);
 CMAT* mpcsubmat_3d(CMAT* src, ITER s0, ITER e0, ITER s1, ITER e1, ITER s2,
                      ITER e2);
 
+/**** view ****/
+/* View of whole mat, or of the range of mat without copy.
+ * Range is given as in submat(). A view is valid while mat is alive.
+ * ex)
+ * MAT* S : spectrogram, 257 x T
+ *
+ * MAT_VIEW frame = subview(S, -1, -1, t, t + 1);     // t-th frame
+ * MAT_VIEW band = subview(S, 10, 20, -1, -1);        // 10th ~ 19th bins
+ *
+ * gemv_view(), gemm_view(), axpy_view() and copy_view() take views.
+ * */
+MAT_VIEW view_mat(MAT* mat);
+CMAT_VIEW view_cmat(CMAT* mat);
+
+#define subview_load(_x2, _x3, _x4, _3, _x5, _2, _x6, _1, ...) _1
+#define subview_load_(args_list) subview_load args_list
+#define subview(...) \
+  subview_load_(     \
+      (__VA_ARGS__, subview_3d, _, subview_2d, _, subview_1d)(__VA_ARGS__))
+MAT_VIEW subview_1d(MAT* mat, ITER s0, ITER e0);
+MAT_VIEW subview_2d(MAT* mat, ITER s0, ITER e0, ITER s1, ITER e1);
+MAT_VIEW subview_3d(MAT* mat, ITER s0, ITER e0, ITER s1, ITER e1, ITER s2,
+                    ITER e2);
+
+#define csubview_load(_x2, _x3, _x4, _3, _x5, _2, _x6, _1, ...) _1
+#define csubview_load_(args_list) csubview_load args_list
+#define csubview(...)                                               \
+  csubview_load_((__VA_ARGS__, csubview_3d, _, csubview_2d, _, \
+                  csubview_1d)(__VA_ARGS__))
+CMAT_VIEW csubview_1d(CMAT* mat, ITER s0, ITER e0);
+CMAT_VIEW csubview_2d(CMAT* mat, ITER s0, ITER e0, ITER s1, ITER e1);
+CMAT_VIEW csubview_3d(CMAT* mat, ITER s0, ITER e0, ITER s1, ITER e1, ITER s2,
+                      ITER e2);
+
+/* View of d0 x d1 block at data + off of mat, whose columns are ld apart,
+ * as BLAS takes a pointer and a leading dimension. A vector of increment
+ * inc is a block of 1 x n with ld = inc. Used by *_ld functions.
+ * ex) MAT_VIEW win = ld_view(S, t * 257 + 10, 20, 8, 257);
+ *     // bins 10 ~ 29 of frames t ~ t + 7 of S : 257 x T
+ * */
+MAT_VIEW ld_view(MAT* mat, UINT off, UINT d0, UINT d1, UINT ld);
+CMAT_VIEW ld_cview(CMAT* mat, UINT off, UINT d0, UINT d1, UINT ld);
+
+/**** lazy transpose ****/
+/* Flip trans and conj flags of view, no data is moved.
+ * gemm_view(), gemv_view() and complex versions fold the flags into
+ * Tran/CTran of BLAS call. copy_view() and axpy_view() read a transposed
+ * view along its rows, so copy_view() into a plain view materializes it.
+ * Output of these can't be flagged.
+ * ex)
+ * MAT_VIEW At = trans_view(view_mat(A));
+ * gemm_view(NoTran, NoTran, 1, &At, &b, 0, &c);  // A^T * B, A untouched
+ * */
+MAT_VIEW trans_view(MAT_VIEW view);
+CMAT_VIEW trans_cview(CMAT_VIEW view);
+CMAT_VIEW conj_cview(CMAT_VIEW view);
+CMAT_VIEW hermit_cview(CMAT_VIEW view);
+
+/* trans(NoTran, Tran, CTran) of BLAS call composed with flags of view.
+ * cview_op() returns 0 for conjugate without transpose, which BLAS lacks. */
+char view_op(char trans, MAT_VIEW* view);
+char cview_op(char trans, CMAT_VIEW* view);
+/* Conjugated copy on scratch stack, released by mp_release(). */
+CMAT_VIEW mp_scratch_conj(CMAT_VIEW* view);
+
 /**** allocate DIM
  * currently DIM is only used for repmat, reshape
  * ******************/
@@ -224,6 +301,8 @@ DIM* alloc_dim_0d();
 DIM* alloc_dim_1d(UINT d0);
 DIM* alloc_dim_2d(UINT d0, UINT d1);
 DIM* alloc_dim_3d(UINT d0, UINT d1, UINT d2);
+/* DIM comes from slab cache, release it by free_dim(). */
+void free_dim(DIM* dim);
 
 /**** element operation by DIM ***/
 DTYPE get_by_dim(MAT* mat, DIM* dim);
@@ -232,6 +311,11 @@ CTYPE cget_by_dim(CMAT* mat, DIM* dim);
 void set_by_dim(MAT* mat, DIM* dim, DTYPE val);
 void cset_by_dim(CMAT* mat, DIM* dim, CTYPE val);
 
+/**** element operations - broadcasting ****
+ * Each dim of A and B is either 1 or that of C, dim of 1 is repeated.
+ * ex) A(257,1,8) + B(1,500,1) = C(257,500,8)
+ * */
+
 /**** add elements - broadcasting operation ****/
 void add_elements(MAT* A, MAT* B, MAT* C);
 void cadd_elements(CMAT* A, CMAT* B, CMAT* C);
@@ -244,6 +328,11 @@ void cmul_elements(CMAT* A, CMAT* B, CMAT* C);
 void div_elements(MAT* A, MAT* B, MAT* C);
 void cdiv_elements(CMAT* A, CMAT* B, CMAT* C);
 
+/* planar versions, C = A op B of PCMAT, same broadcasting */
+void padd_elements(PCMAT* A, PCMAT* B, PCMAT* C);
+void pmul_elements(PCMAT* A, PCMAT* B, PCMAT* C);
+void pdiv_elements(PCMAT* A, PCMAT* B, PCMAT* C);
+
 /**** inverse elements ***/
 void inv_elements(MAT* mat);
 void inv_elements_inc(UINT size, DTYPE* X, ITER incx);
@@ -298,17 +387,31 @@ void cshiftdim(CMAT* mat, SINT n);
  * ==> A(3,2,4)
  *
  * !!) this operation is not eqaul to reshape
+ *
+ * Every seq is written tile by tile into scratch stack and copied back,
+ * see perm_plan() in iip_matrix.c.
  * ***************/
 void permute(MAT* mat, UINT seq);
 void cpermute(CMAT* mat, UINT seq);
 
 /**** transpose  ****/
+/* Tiled transpose of each d0 x d1 slice, over d2.
+ * create_trans() returns a new matrix, transpose() works in place :
+ * square by swapping tiles, rectangular through scratch stack
+ * (or following cycles when larger than TRANS_SCRATCH_MAX).
+ * ctranspose() is transpose without conjugation. */
 MAT* create_trans(MAT* mat);
 CMAT* create_ctrans(CMAT* mat);
 
 void transpose(MAT* mat);  // with memory pool
 void ctranspose(CMAT* mat);
 
+/* Fills the other triangle of each square slice from triangle uplo(Upper
+ * or Lower), as left by syrk_mat(). mirror_cmat() conjugates, for
+ * herk_cmat(). */
+void mirror_mat(char uplo, MAT* mat);
+void mirror_cmat(char uplo, CMAT* mat);
+
 /**** get Diagonal of Matrix ****/
 /* ex
  * mat = | 1 3 |
@@ -362,6 +465,55 @@ void print_cmat(CMAT* mat);
 void mpfree_mat(MAT* mat_in_memory_pool);
 void mpfree_cmat(CMAT* mat_in_memory_pool);
 
+/**** PCMAT, planar complex ****/
+#define alloc_pcmat_load(_x, _3, _2, _1, ...) _1
+#define alloc_pcmat_load_(args_list) alloc_pcmat_load args_list
+#define alloc_pcmat(...)                                              \
+  alloc_pcmat_load_((__VA_ARGS__, alloc_pcmat_3d, alloc_pcmat_2d, \
+                     alloc_pcmat_1d)(__VA_ARGS__))
+PCMAT* alloc_pcmat_1d(UINT d0);
+PCMAT* alloc_pcmat_2d(UINT d0, UINT d1);
+PCMAT* alloc_pcmat_3d(UINT d0, UINT d1, UINT d2);
+void free_pcmat(PCMAT* mat);
+
+/* interleaved <-> planar, shapes must be equal */
+void cmat2pcmat(CMAT* src, PCMAT* des);
+void pcmat2cmat(PCMAT* src, CMAT* des);
+
+/**** TMAT, runtime precision ****/
+/* ex) F = alloc_tmat(DT_S, 257, 500);     float32 spectrogram
+ *     W = mat2tmat(weight, DT_S);          MAT -> float32 copy
+ *     gemm_tmat(NoTran, NoTran, 1, W, F, 0, G);
+ *     convert_tmat(G, G64);                float32 -> float64
+ *     M = as_mat(G64);                     shares data, no copy
+ * */
+#define alloc_tmat_load(_x, _xx, _3, _2, _1, ...) _1
+#define alloc_tmat_load_(args_list) alloc_tmat_load args_list
+#define alloc_tmat(...)                                            \
+  alloc_tmat_load_((__VA_ARGS__, alloc_tmat_3d, alloc_tmat_2d, \
+                    alloc_tmat_1d)(__VA_ARGS__))
+TMAT* alloc_tmat_1d(UINT dtype, UINT d0);
+TMAT* alloc_tmat_2d(UINT dtype, UINT d0, UINT d1);
+TMAT* alloc_tmat_3d(UINT dtype, UINT d0, UINT d1, UINT d2);
+void free_tmat(TMAT* mat);
+
+/* bytes of an element of dtype */
+UINT dtype_size(UINT dtype);
+
+/* src -> des of same shape and realness, DT_S <-> DT_D, DT_C <-> DT_Z */
+void convert_tmat(TMAT* src, TMAT* des);
+
+/* copies between MAT(CMAT) and TMAT of any precision */
+TMAT* mat2tmat(MAT* mat, UINT dtype);
+TMAT* cmat2tmat(CMAT* mat, UINT dtype);
+void tmat2mat(TMAT* src, MAT* des);
+void tmat2cmat(TMAT* src, CMAT* des);
+
+/* MAT(CMAT) on data of TMAT, dtype must be DT_NATIVE(DT_CNATIVE).
+ * Every function of MAT works on it, nothing to free. */
+MAT as_mat(TMAT* mat);
+CMAT as_cmat(TMAT* mat);
+
 #if USE_CUDA
 __global__ void cu_print_mat(DTYPE*, UINT, UINT, UINT);
 __global__ void cu_print_cmat(CTYPE*, UINT, UINT, UINT);
@@ -48,6 +48,124 @@
  * */
 #define CHUNK_SIZE 128
 
+/* transpose() and create_trans() move a tile of TRANS_BLOCK x TRANS_BLOCK
+ * (TRANS_CBLOCK for CTYPE) at once, a tile of source and destination
+ * together should fit in L1 cache.
+ * In-place transpose of rectangular matrix larger than TRANS_SCRATCH_MAX
+ * bytes follows cycles instead of taking a copy on scratch stack.
+ * */
+#define TRANS_BLOCK 32
+#define TRANS_CBLOCK 16
+#ifndef TRANS_SCRATCH_MAX
+#define TRANS_SCRATCH_MAX (256ULL << 20)
+#endif
+
+/* Broadcasting element operations(add_elements(), ...) hand rows of C to
+ * threads in blocks of BCAST_BLOCK elements.
+ * */
+#define BCAST_BLOCK 2048
+
+/* Batched small matrix operations(gemm_small(), ...) take up to
+ * SMALL_MAX x SMALL_MAX, and interleave SMALL_LANE slices at once.
+ * Slices which run one by one are handed to threads SMALL_CHUNK at a time.
+ * */
+#define SMALL_MAX 8
+#define SMALL_LANE 16
+#define SMALL_CHUNK 256
+
+/* Non-BLAS reductions(omp_dot(), omp_asum(), ...) run REDUCE_ACC
+ * accumulators over leaves of REDUCE_BLOCK elements, and add leaves
+ * pairwise. Under REDUCE_OMP_MIN elements they stay on one thread.
+ * */
+#ifndef REDUCE_ACC
+#define REDUCE_ACC 16
+#define REDUCE_BLOCK 1024
+#endif
+#ifndef REDUCE_OMP_MIN
+#define REDUCE_OMP_MIN (1 << 16)
+#endif
+
+/* Non-BLAS omp_gemv() takes GEMV_MR rows of row-major A at once
+ * (GEMV_CMR for complex), each with GEMV_ACC accumulators. Transposed, it
+ * sums rows of A into a block of Y of GEMV_NB elements (GEMV_NB / 2 for
+ * complex) held on stack, and threads take those blocks.
+ * omp_gemv_rhs() runs GEMV_KR vectors at once on GEMV_KL accumulators.
+ * */
+#ifndef GEMV_MR
+#define GEMV_MR 4
+#define GEMV_CMR 2
+#endif
+#ifndef GEMV_ACC
+#define GEMV_ACC 8
+#define GEMV_NB 1024
+#endif
+#ifndef GEMV_KR
+#define GEMV_KR 4
+#define GEMV_KL 4
+#endif
+
+/* Non-BLAS omp_gemm() packs op(B) by GEMM_KC x GEMM_NC and op(A) by
+ * GEMM_MC x GEMM_KC (L2 cache), and computes C in tiles of
+ * GEMM_MR x GEMM_NR held in registers. GEMM_MC is a multiple of GEMM_MR.
+ * Under GEMM_SMALL_MNK of m * n * k it skips packing and loops on A and B.
+ * */
+#ifndef GEMM_MR
+#define GEMM_MR 8
+#define GEMM_NR 6
+#endif
+#ifndef GEMM_MC
+#define GEMM_MC 96
+#define GEMM_KC 256
+#define GEMM_NC 1536
+#endif
+#ifndef GEMM_SMALL_MNK
+#define GEMM_SMALL_MNK (8 * 8 * 8)
+#endif
+
+/* omp_cgemm() takes the same blocks. Under CGEMM_3M_MIN on any of m, n
+ * and k, it runs tiles of GEMM_CMR x GEMM_CNR with four real products
+ * (4M). From there it runs 3M, three real gemms on the micro-kernel of
+ * omp_gemm(), for 3/4 of flops at slightly lower accuracy of imaginary
+ * part.
+ * */
+#ifndef GEMM_CMR
+#define GEMM_CMR 4
+#define GEMM_CNR 4
+#endif
+#ifndef CGEMM_3M_MIN
+#define CGEMM_3M_MIN 256
+#endif
+
+/* gemm_batch() hands slices of m * n * k under GEMM_BATCH_MNK to threads,
+ * one slice each. Larger slices are threaded inside.
+ * */
+#ifndef GEMM_BATCH_MNK
+#define GEMM_BATCH_MNK (128 * 128 * 128)
+#endif
+
+/* Non-BLAS omp_syrk() and omp_herk() compute diagonal blocks of
+ * SYRK_NB x SYRK_NB, one triangle only, and the rest of the triangle
+ * below(or above) each of them by one omp_gemm().
+ * */
+#ifndef SYRK_NB
+#define SYRK_NB 64
+#endif
+
+/* With a BLAS backend(see iip_backend.h), gemm of m * n * k, gemv of
+ * m * n and syrk of n * n * k from BLAS_*_MIN on go to BLAS, smaller
+ * ones to built-in kernels. All go to BLAS by default, as without
+ * routing. blas_autotune() measures thresholds on the machine, and
+ * IIP_BLAS_TUNE loads them.
+ * */
+#ifndef BLAS_GEMM_MIN
+#define BLAS_GEMM_MIN 0
+#define BLAS_CGEMM_MIN 0
+#define BLAS_GEMV_MIN 0
+#define BLAS_CGEMV_MIN 0
+#define BLAS_SYRK_MIN 0
+#define BLAS_HERK_MIN 0
+#endif
+
 /************************************
 *********************************** */
 
@@ -68,10 +186,15 @@
 #define NoTran CUBLAS_OP_N
 #define Tran CUBLAS_OP_T
 #define CTran CUBLAS_OP_C
+#define Upper CUBLAS_FILL_MODE_UPPER
+#define Lower CUBLAS_FILL_MODE_LOWER
 #else
 #define NoTran 111
 #define Tran 112
 #define CTran 113
+/* triangle of syrk_mat(), herk_cmat() and mirror_mat() */
+#define Upper 121
+#define Lower 122
 #endif
 
 
@@ -114,7 +237,23 @@ extern UINT max_block;
 #define str(x) #x
 #define xstr(x) str(x)
 
+/**** ALIGNMENT ****/
+/* Alignment of data in every MAT and CMAT, one cache line.
+ * IS_ALIGNED(ptr) tests it and ASSUME_ALIGNED(ptr) lets compiler
+ * vectorize a loop over ptr without peeling. */
+#define MEM_ALIGN_SIZE 64
+#define IS_ALIGNED(ptr) ((((uintptr_t)(ptr)) & (MEM_ALIGN_SIZE - 1)) == 0)
+#if defined(__GNUC__)
+#define ASSUME_ALIGNED(ptr) __builtin_assume_aligned((ptr), MEM_ALIGN_SIZE)
+#else
+#define ASSUME_ALIGNED(ptr) (ptr)
+#endif
+
 /**** STRUCT ****/
+/* data of MAT and CMAT is aligned to MEM_ALIGN_SIZE bytes
+ * when allocated by alloc_mat(), zeros(), mpalloc_mat(), mp_scratch_mat(),
+ * wav2mat() and their complex versions. A pointer into the middle
+ * of data(a column, a slice) is not. */
 typedef struct MAT {
   DTYPE* data;
   UINT ndim;
@@ -136,6 +275,85 @@ typedef struct CMAT {
   UINT d2;
 } CMAT;
 
+/* View into data of MAT or CMAT, owns nothing and is never freed.
+ * Columns are contiguous as in MAT, and element (i,j,k) is
+ * data[i + j*ld1 + k*ld2]. MAT itself is a view with ld1 = d0 and
+ * ld2 = d0*d1. See subview().
+ *
+ * trans and conj(1 or 0) mark the view as transposed or conjugated
+ * without moving data, see trans_view(). d0, d1, ld1 and ld2 always
+ * describe the data as stored. */
+typedef struct MAT_VIEW {
+  DTYPE* data;
+  UINT ndim;
+  UINT d0;
+  UINT d1;
+  UINT d2;
+  UINT ld1;  // stride of d1, leading dimension
+  UINT ld2;  // stride of d2
+  UINT trans;
+} MAT_VIEW;
+
+typedef struct CMAT_VIEW {
+  CTYPE* data;
+  UINT ndim;
+  UINT d0;
+  UINT d1;
+  UINT d2;
+  UINT ld1;
+  UINT ld2;
+  UINT trans;
+  UINT conj;
+} CMAT_VIEW;
+
+/* Planar(split) complex : real parts in re and imaginary parts in im,
+ * each laid out as data of MAT. Complex kernels on it need no shuffle of
+ * interleaved re/im, see cmat2pcmat(). */
+typedef struct PCMAT {
+  DTYPE* re;
+  DTYPE* im;
+  UINT ndim;
+  UINT d0;
+  UINT d1;
+  UINT d2;
+} PCMAT;
+
+/* MAT with precision chosen at run time, so float and double live in one
+ * build regardless of DTYPE. dtype is one of DT_S(float), DT_D(double),
+ * DT_C(complex float) and DT_Z(complex double), as the letters of BLAS.
+ * TMAT of DT_NATIVE(DT_CNATIVE) shares data with MAT(CMAT) by as_mat()
+ * (as_cmat()), others go through the *_tmat functions. */
+#define DT_S 0
+#define DT_D 1
+#define DT_C 2
+#define DT_Z 3
+#if NTYPE == 0
+#define DT_NATIVE DT_S
+#define DT_CNATIVE DT_C
+#else
+#define DT_NATIVE DT_D
+#define DT_CNATIVE DT_Z
+#endif
+
+typedef struct CTYPE_S {
+  float re;
+  float im;
+} CTYPE_S;
+
+typedef struct CTYPE_D {
+  double re;
+  double im;
+} CTYPE_D;
+
+typedef struct TMAT {
+  void* data;
+  UINT dtype;
+  UINT ndim;
+  UINT d0;
+  UINT d1;
+  UINT d2;
+} TMAT;
+
 typedef struct RANGE {
   UINT s0, e0;  // d0 range
   UINT s1, e1;  // d1 range
@@ -341,22 +559,111 @@ __func__, A->d, B->d);
  *****************************/
 #define MAX_MEM_PAGE 20
 #define MEM_PAGE_BASIC_SIZE 256
-#define LOG_ALLOC_UNIT 8  // 4 for float, 8 for double
 
-typedef struct USED_MEM {
-  unsigned long long int frag_idx;
-  unsigned long long int size;
-} USED_MEM;
-
-static void* memory_pool[MAX_MEM_PAGE];
-static USED_MEM* memory_log[MAX_MEM_PAGE];
+/* Every thread that calls mpalloc() gets its own arena(chain of pages),
+ * so allocations inside '#pragma omp parallel' never race each other.
+ * Threads beyond MAX_MEM_ARENA share the arena of the thread which
+ * called init(). A block may be mpfree()'d by any thread.
+ *
+ * Each block carries a small header in front of it, so mpalloc() and
+ * mpfree() take constant time regardless of the number of live blocks. */
+#define MAX_MEM_ARENA 64
 
-static unsigned long long int log_cnt[MAX_MEM_PAGE];
-static unsigned int pool_cnt;
-signed long long int page_alloc_isable(int page_idx,
-                                       unsigned long long int require_size);
+/* Blocks of mpalloc() and mp_scratch() are aligned to MEM_ALIGN_SIZE. */
 void* mpalloc(unsigned long long int size);
 void mpfree(void* ptr);
+
+/* malloc() aligned to MEM_ALIGN_SIZE, released by free_aligned() only. */
+void* malloc_aligned(unsigned long long int size);
+void free_aligned(void* ptr);
+
+/* Slab cache for small blocks such as MAT, CMAT and DIM headers.
+ * Blocks up to 8 KB come from free lists of calling thread, without a call
+ * to malloc(), larger ones from malloc_aligned(). Usable without init().
+ * mp_slab_free() must be given the size passed to mp_slab_alloc(). */
+void* mp_slab_alloc(unsigned long long int size);
+void mp_slab_free(void* ptr, unsigned long long int size);
+
+/* Scratch stack of calling thread, for temporaries released in LIFO order.
+ * mp_scratch() only bumps a pointer and mp_release() rewinds it.
+ *
+ *  MP_MARK mark = mp_mark();
+ *  a = mp_scratch(size_a);
+ *  b = mp_scratch(size_b);
+ *  ...
+ *  mp_release(mark);  // releases a and b at once
+ * */
+typedef unsigned long long int MP_MARK;
+MP_MARK mp_mark();
+void* mp_scratch(unsigned long long int size);
+void mp_release(MP_MARK mark);
 void init(UINT mem_pool_size);
 void finit();
+
+/**** MEMORY POOL PROFILE ****/
+/* mode : how pages of the pool are obtained
+ *  MEM_MODE_MALLOC   : malloc(), pages are faulted on first use.
+ *  MEM_MODE_PREFAULT : mmap() with MAP_POPULATE, faulted in init.
+ *  MEM_MODE_HUGE     : mmap() advised as transparent huge pages,
+ *                      faulted in init.
+ * On other than OS_UNIX every mode acts as MEM_MODE_MALLOC.
+ * */
+#define MEM_MODE_MALLOC 0
+#define MEM_MODE_PREFAULT 1
+#define MEM_MODE_HUGE 2
+
+/* Prepares memory pool ahead of first use.
+ * main_size   : bytes for the thread calling init_profile()
+ * thread_size : bytes for each of other threads
+ * num_thread  : number of other threads to prepare for
+ *
+ * init(mem_pool_size) is equal to
+ * init_profile(MEM_MODE_MALLOC, mem_pool_size, 0, 0) unless
+ * environment variable IIP_MEM_PROFILE gives a profile.
+ *  ex) IIP_MEM_PROFILE="mode=huge,main=64M,thread=8M,threads=8"
+ *  mode : malloc, prefault, huge
+ *  main, thread : size with optional K, M or G
+ *  threads : num_thread
+ * */
+void init_profile(UINT mode, unsigned long long int main_size,
+                  unsigned long long int thread_size, UINT num_thread);
+
+/**** MEMORY POOL STATISTICS ****/
+/* Taken over every arena by mpstat(), in bytes unless noted.
+ * Block sizes include the block header.
+ *
+ * reserved         : pages held by the pool
+ * live             : blocks currently handed out by mpalloc()
+ * high_water       : sum of peak 'live' of each arena
+ * main_high_water  : peak 'live' of the arena of init(), a size for
+ *                    init() of next run
+ * scratch_reserved : chunks held by scratch stacks (mp_scratch())
+ * slab_reserved    : chunks held by slab cache (mp_slab_alloc())
+ * page_cnt         : number of pages
+ * arena_cnt        : number of arenas(threads)
+ * alloc_cnt        : number of mpalloc() calls
+ * free_cnt         : number of mpfree() calls
+ * fragmentation    : 1 - largest hole / bytes of holes, over freed blocks
+ *                    below top of their page. 0 when there is no hole or
+ *                    one, whatever is left free above the tops
+ * largest_free     : largest request served without a new page
+ * */
+typedef struct MEM_STAT {
+  unsigned long long int reserved;
+  unsigned long long int live;
+  unsigned long long int high_water;
+  unsigned long long int main_high_water;
+  unsigned long long int scratch_reserved;
+  unsigned long long int slab_reserved;
+  unsigned int page_cnt;
+  unsigned int arena_cnt;
+  unsigned long long int alloc_cnt;
+  unsigned long long int free_cnt;
+  double fragmentation;
+  unsigned long long int largest_free;
+} MEM_STAT;
+
+void mpstat(MEM_STAT* stat);
+/* Writes MEM_STAT as one line of JSON object. */
+void mpstat_json(FILE* fp);
 #endif
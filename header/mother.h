@@ -12,9 +12,11 @@
 #ifndef MOTHER_H
 #define MOTHER_H
 
+#include "iip_backend.h"
 #include "iip_blas_lv1.h"
 #include "iip_blas_lv2.h"
 #include "iip_blas_lv3.h"
+#include "iip_batch.h"
 #include "iip_invert.h"
 #include "iip_invert.h"
 #include "iip_io.h"
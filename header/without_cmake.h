@@ -25,3 +25,7 @@
 #define USE_OPEN  0
 #define USE_MKL   0
 
+/* set 1 to load BLAS at run time(dlopen), see iip_backend.h
+ * link libdl on UNIX.
+ * */
+#define USE_DLBLAS 0
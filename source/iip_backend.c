@@ -0,0 +1,631 @@
+/*
+ * ===========================================================
+ *           Copyright (c) 2018, __IIPLAB__
+ *                All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of
+ * the Mozilla Public License, v. 2.0.
+ * If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/.
+ * ===========================================================
+ */
+#include "iip_backend.h"
+#include "iip_blas_lv2.h"
+#include "iip_blas_lv3.h"
+
+#if USE_DLBLAS && OS_UNIX
+#include <dlfcn.h>
+#endif
+
+/**** BACKEND ****/
+/* CblasRowMajor and CblasColMajor */
+#define BLAS_ROW 101
+#define BLAS_COL 102
+
+/* cblas_?gemm, cblas_?gemv, cblas_?syrk and cblas_?herk with enums and
+ * BLAS integers as int */
+typedef void (*GEMM_FN)(int, int, int, int, int, int, DTYPE, const DTYPE*,
+                        int, const DTYPE*, int, DTYPE, DTYPE*, int);
+typedef void (*CGEMM_FN)(int, int, int, int, int, int, const void*,
+                         const void*, int, const void*, int, const void*,
+                         void*, int);
+typedef void (*GEMV_FN)(int, int, int, int, DTYPE, const DTYPE*, int,
+                        const DTYPE*, int, DTYPE, DTYPE*, int);
+typedef void (*CGEMV_FN)(int, int, int, int, const void*, const void*, int,
+                         const void*, int, const void*, void*, int);
+typedef void (*SYRK_FN)(int, int, int, int, int, DTYPE, const DTYPE*, int,
+                        DTYPE, DTYPE*, int);
+typedef void (*HERK_FN)(int, int, int, int, int, DTYPE, const void*, int,
+                        DTYPE, void*, int);
+/* openblas_set_num_threads() and openblas_get_num_threads(), or their
+ * MKL counterparts */
+typedef void (*SET_THREADS_FN)(int);
+typedef int (*GET_THREADS_FN)(void);
+
+#if USE_CBLAS
+static void linked_gemm(int layout, int ta, int tb, int m, int n, int k,
+                        DTYPE alpha, const DTYPE* A, int lda, const DTYPE* B,
+                        int ldb, DTYPE beta, DTYPE* C, int ldc) {
+#if NTYPE == 0
+  cblas_sgemm(layout, ta, tb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+#else
+  cblas_dgemm(layout, ta, tb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+#endif
+}
+
+static void linked_cgemm(int layout, int ta, int tb, int m, int n, int k,
+                         const void* alpha, const void* A, int lda,
+                         const void* B, int ldb, const void* beta, void* C,
+                         int ldc) {
+#if NTYPE == 0
+  cblas_cgemm(layout, ta, tb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+#else
+  cblas_zgemm(layout, ta, tb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+#endif
+}
+
+static void linked_gemv(int layout, int ta, int m, int n, DTYPE alpha,
+                        const DTYPE* A, int lda, const DTYPE* X, int incx,
+                        DTYPE beta, DTYPE* Y, int incy) {
+#if NTYPE == 0
+  cblas_sgemv(layout, ta, m, n, alpha, A, lda, X, incx, beta, Y, incy);
+#else
+  cblas_dgemv(layout, ta, m, n, alpha, A, lda, X, incx, beta, Y, incy);
+#endif
+}
+
+static void linked_cgemv(int layout, int ta, int m, int n, const void* alpha,
+                         const void* A, int lda, const void* X, int incx,
+                         const void* beta, void* Y, int incy) {
+#if NTYPE == 0
+  cblas_cgemv(layout, ta, m, n, alpha, A, lda, X, incx, beta, Y, incy);
+#else
+  cblas_zgemv(layout, ta, m, n, alpha, A, lda, X, incx, beta, Y, incy);
+#endif
+}
+
+static void linked_syrk(int layout, int uplo, int trans, int n, int k,
+                        DTYPE alpha, const DTYPE* A, int lda, DTYPE beta,
+                        DTYPE* C, int ldc) {
+#if NTYPE == 0
+  cblas_ssyrk(layout, uplo, trans, n, k, alpha, A, lda, beta, C, ldc);
+#else
+  cblas_dsyrk(layout, uplo, trans, n, k, alpha, A, lda, beta, C, ldc);
+#endif
+}
+
+static void linked_herk(int layout, int uplo, int trans, int n, int k,
+                        DTYPE alpha, const void* A, int lda, DTYPE beta,
+                        void* C, int ldc) {
+#if NTYPE == 0
+  cblas_cherk(layout, uplo, trans, n, k, alpha, A, lda, beta, C, ldc);
+#else
+  cblas_zherk(layout, uplo, trans, n, k, alpha, A, lda, beta, C, ldc);
+#endif
+}
+
+#if USE_OPEN
+#define LINKED_SET_THREADS openblas_set_num_threads
+#define LINKED_GET_THREADS openblas_get_num_threads
+#elif USE_MKL
+static void linked_set_threads(int n) { mkl_set_num_threads(n); }
+static int linked_get_threads(void) { return mkl_get_max_threads(); }
+#define LINKED_SET_THREADS linked_set_threads
+#define LINKED_GET_THREADS linked_get_threads
+#else
+#define LINKED_SET_THREADS NULL
+#define LINKED_GET_THREADS NULL
+#endif
+
+#define LINKED_NAME "linked"
+#define LINKED_GEMM linked_gemm
+#define LINKED_CGEMM linked_cgemm
+#define LINKED_GEMV linked_gemv
+#define LINKED_CGEMV linked_cgemv
+#define LINKED_SYRK linked_syrk
+#define LINKED_HERK linked_herk
+#else
+#define LINKED_NAME "none"
+#define LINKED_GEMM NULL
+#define LINKED_CGEMM NULL
+#define LINKED_GEMV NULL
+#define LINKED_CGEMV NULL
+#define LINKED_SYRK NULL
+#define LINKED_HERK NULL
+#define LINKED_SET_THREADS NULL
+#define LINKED_GET_THREADS NULL
+#endif
+
+static char backend_name[MAX_CHAR] = LINKED_NAME;
+static void* backend_lib = NULL;
+static GEMM_FN backend_gemm = LINKED_GEMM;
+static CGEMM_FN backend_cgemm = LINKED_CGEMM;
+static GEMV_FN backend_gemv = LINKED_GEMV;
+static CGEMV_FN backend_cgemv = LINKED_CGEMV;
+static SYRK_FN backend_syrk = LINKED_SYRK;
+static HERK_FN backend_herk = LINKED_HERK;
+static SET_THREADS_FN backend_set_threads = LINKED_SET_THREADS;
+static GET_THREADS_FN backend_get_threads = LINKED_GET_THREADS;
+
+static unsigned long long int threshold[BLAS_OPS] = {
+    BLAS_GEMM_MIN, BLAS_CGEMM_MIN, BLAS_GEMV_MIN,
+    BLAS_CGEMV_MIN, BLAS_SYRK_MIN, BLAS_HERK_MIN};
+static unsigned long long int route_cnt[BLAS_OPS][2];
+
+static const char* op_name[BLAS_OPS] = {"gemm",  "cgemm", "gemv",
+                                        "cgemv", "syrk",  "herk"};
+
+/**** LOADER ****/
+#if USE_DLBLAS
+#if OS_UNIX
+#define DL_OPEN(path) dlopen(path, RTLD_NOW | RTLD_LOCAL)
+#define DL_SYM(lib, sym) dlsym(lib, sym)
+#define DL_CLOSE(lib) dlclose(lib)
+#elif OS_WIN
+#define DL_OPEN(path) ((void*)LoadLibraryA(path))
+#define DL_SYM(lib, sym) ((void*)GetProcAddress((HMODULE)(lib), sym))
+#define DL_CLOSE(lib) FreeLibrary((HMODULE)(lib))
+#else
+#define DL_OPEN(path) NULL
+#define DL_SYM(lib, sym) NULL
+#define DL_CLOSE(lib)
+#endif
+
+#if NTYPE == 0
+#define SYM_GEMM "cblas_sgemm"
+#define SYM_CGEMM "cblas_cgemm"
+#define SYM_GEMV "cblas_sgemv"
+#define SYM_CGEMV "cblas_cgemv"
+#define SYM_SYRK "cblas_ssyrk"
+#define SYM_HERK "cblas_cherk"
+#else
+#define SYM_GEMM "cblas_dgemm"
+#define SYM_CGEMM "cblas_zgemm"
+#define SYM_GEMV "cblas_dgemv"
+#define SYM_CGEMV "cblas_zgemv"
+#define SYM_SYRK "cblas_dsyrk"
+#define SYM_HERK "cblas_zherk"
+#endif
+
+/* thread control, optional */
+#define SYM_OPENBLAS_SET "openblas_set_num_threads"
+#define SYM_OPENBLAS_GET "openblas_get_num_threads"
+#define SYM_MKL_SET "MKL_Set_Num_Threads"
+#define SYM_MKL_GET "MKL_Get_Max_Threads"
+
+/* tried in order by blas_open(NULL) */
+static const char* blas_lib_list[] = {
+#if OS_WIN
+    "libopenblas.dll", "mkl_rt.2.dll", "mkl_rt.dll",
+#else
+    "libopenblas.so.0", "libopenblas.so", "libmkl_rt.so.2", "libmkl_rt.so",
+    "libcblas.so.3",    "libblas.so.3",
+#endif
+    NULL};
+#endif
+
+void blas_init() {
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+#if USE_DLBLAS
+  if (backend_lib == NULL && !blas_open(getenv("IIP_BLAS_LIB")) &&
+      getenv("IIP_BLAS_LIB") != NULL)
+    printf(" *** [iip_sph_pp] Can't load BLAS of IIP_BLAS_LIB '%s'\n",
+           getenv("IIP_BLAS_LIB"));
+  printf(" *** BLAS backend : %s\n", backend_name);
+#endif
+  if (getenv("IIP_BLAS_TUNE") != NULL &&
+      blas_load_tune(getenv("IIP_BLAS_TUNE")) < 0)
+    printf(" *** [iip_sph_pp] Can't read IIP_BLAS_TUNE '%s'\n",
+           getenv("IIP_BLAS_TUNE"));
+}
+
+int blas_open(const char* path) {
+#if USE_DLBLAS
+  void* lib;
+  GEMM_FN gemm;
+  CGEMM_FN cgemm;
+  GEMV_FN gemv;
+  CGEMV_FN cgemv;
+  SYRK_FN syrk;
+  HERK_FN herk;
+  SET_THREADS_FN set_threads;
+  GET_THREADS_FN get_threads;
+  int i;
+#endif
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+#if USE_DLBLAS
+  if (path == NULL) {
+    for (i = 0; blas_lib_list[i] != NULL; i++)
+      if (blas_open(blas_lib_list[i])) return 1;
+    return 0;
+  }
+  lib = DL_OPEN(path);
+  if (lib == NULL) return 0;
+  gemm = (GEMM_FN)DL_SYM(lib, SYM_GEMM);
+  cgemm = (CGEMM_FN)DL_SYM(lib, SYM_CGEMM);
+  gemv = (GEMV_FN)DL_SYM(lib, SYM_GEMV);
+  cgemv = (CGEMV_FN)DL_SYM(lib, SYM_CGEMV);
+  syrk = (SYRK_FN)DL_SYM(lib, SYM_SYRK);
+  herk = (HERK_FN)DL_SYM(lib, SYM_HERK);
+  if (gemm == NULL || cgemm == NULL || gemv == NULL || cgemv == NULL ||
+      syrk == NULL || herk == NULL) {
+    DL_CLOSE(lib);
+    return 0;
+  }
+  set_threads = (SET_THREADS_FN)DL_SYM(lib, SYM_OPENBLAS_SET);
+  get_threads = (GET_THREADS_FN)DL_SYM(lib, SYM_OPENBLAS_GET);
+  if (set_threads == NULL || get_threads == NULL) {
+    set_threads = (SET_THREADS_FN)DL_SYM(lib, SYM_MKL_SET);
+    get_threads = (GET_THREADS_FN)DL_SYM(lib, SYM_MKL_GET);
+  }
+  if (set_threads == NULL || get_threads == NULL) {
+    set_threads = NULL;
+    get_threads = NULL;
+  }
+
+  blas_close();
+  backend_lib = lib;
+  backend_gemm = gemm;
+  backend_cgemm = cgemm;
+  backend_gemv = gemv;
+  backend_cgemv = cgemv;
+  backend_syrk = syrk;
+  backend_herk = herk;
+  backend_set_threads = set_threads;
+  backend_get_threads = get_threads;
+  strncpy(backend_name, path, MAX_CHAR - 1);
+  backend_name[MAX_CHAR - 1] = '\0';
+  return 1;
+#else
+  (void)path;
+  return 0;
+#endif
+}
+
+void blas_close() {
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+#if USE_DLBLAS
+  if (backend_lib != NULL) DL_CLOSE(backend_lib);
+#endif
+  backend_lib = NULL;
+  backend_gemm = LINKED_GEMM;
+  backend_cgemm = LINKED_CGEMM;
+  backend_gemv = LINKED_GEMV;
+  backend_cgemv = LINKED_CGEMV;
+  backend_syrk = LINKED_SYRK;
+  backend_herk = LINKED_HERK;
+  backend_set_threads = LINKED_SET_THREADS;
+  backend_get_threads = LINKED_GET_THREADS;
+  strcpy(backend_name, LINKED_NAME);
+}
+
+const char* blas_name() { return backend_name; }
+
+int blas_set_threads(int n) {
+  int prev;
+  if (backend_set_threads == NULL) return 0;
+  prev = backend_get_threads();
+  backend_set_threads(n);
+  return prev;
+}
+
+void blas_set_threshold(int op, unsigned long long int size) {
+  ASSERT(op >= 0 && op < BLAS_OPS, "Wrong BLAS op.\n")
+  threshold[op] = size;
+}
+
+unsigned long long int blas_get_threshold(int op) {
+  ASSERT(op >= 0 && op < BLAS_OPS, "Wrong BLAS op.\n")
+  return threshold[op];
+}
+
+int blas_use(int op, unsigned long long int size) {
+  // all ops are loaded together
+  return backend_gemm != NULL && size >= threshold[op];
+}
+
+void blas_count(int op, int route, unsigned long long int cnt) {
+#pragma omp atomic
+  route_cnt[op][route] += cnt;
+}
+
+/**** ROUTE ****/
+
+void route_gemm(char transA, char transB, UINT m, UINT n, UINT k, DTYPE alpha,
+                DTYPE* A, UINT lda, DTYPE* B, UINT ldb, DTYPE beta, DTYPE* C,
+                UINT ldc) {
+  if (blas_use(BLAS_GEMM, (unsigned long long int)m * n * k)) {
+    blas_count(BLAS_GEMM, ROUTE_BLAS, 1);
+    backend_gemm(BLAS_COL, transA, transB, m, n, k, alpha, A, lda, B, ldb,
+                 beta, C, ldc);
+  } else {
+    blas_count(BLAS_GEMM, ROUTE_BUILTIN, 1);
+    omp_gemm(transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+  }
+}
+
+void route_cgemm(char transA, char transB, UINT m, UINT n, UINT k,
+                 CTYPE alpha, CTYPE* A, UINT lda, CTYPE* B, UINT ldb,
+                 CTYPE beta, CTYPE* C, UINT ldc) {
+  if (blas_use(BLAS_CGEMM, (unsigned long long int)m * n * k)) {
+    blas_count(BLAS_CGEMM, ROUTE_BLAS, 1);
+    backend_cgemm(BLAS_COL, transA, transB, m, n, k, &alpha, A, lda, B, ldb,
+                  &beta, C, ldc);
+  } else {
+    blas_count(BLAS_CGEMM, ROUTE_BUILTIN, 1);
+    omp_cgemm(transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+  }
+}
+
+void route_gemv(char transA, UINT m, UINT n, DTYPE alpha, DTYPE* A, UINT lda,
+                DTYPE* X, SINT incx, DTYPE beta, DTYPE* Y, SINT incy) {
+  if (blas_use(BLAS_GEMV, (unsigned long long int)m * n)) {
+    blas_count(BLAS_GEMV, ROUTE_BLAS, 1);
+    backend_gemv(BLAS_ROW, transA, m, n, alpha, A, lda, X, incx, beta, Y,
+                 incy);
+  } else {
+    blas_count(BLAS_GEMV, ROUTE_BUILTIN, 1);
+    omp_gemv(transA, m, n, alpha, A, lda, X, incx, beta, Y, incy);
+  }
+}
+
+void route_cgemv(char transA, UINT m, UINT n, CTYPE alpha, CTYPE* A, UINT lda,
+                 CTYPE* X, SINT incx, CTYPE beta, CTYPE* Y, SINT incy) {
+  if (blas_use(BLAS_CGEMV, (unsigned long long int)m * n)) {
+    blas_count(BLAS_CGEMV, ROUTE_BLAS, 1);
+    backend_cgemv(BLAS_ROW, transA, m, n, &alpha, A, lda, X, incx, &beta, Y,
+                  incy);
+  } else {
+    blas_count(BLAS_CGEMV, ROUTE_BUILTIN, 1);
+    omp_cgemv(transA, m, n, alpha, A, lda, X, incx, beta, Y, incy);
+  }
+}
+
+void route_syrk(char uplo, char trans, UINT n, UINT k, DTYPE alpha, DTYPE* A,
+                UINT lda, DTYPE beta, DTYPE* C, UINT ldc) {
+  if (blas_use(BLAS_SYRK, (unsigned long long int)n * n * k)) {
+    blas_count(BLAS_SYRK, ROUTE_BLAS, 1);
+    backend_syrk(BLAS_COL, uplo, trans, n, k, alpha, A, lda, beta, C, ldc);
+  } else {
+    blas_count(BLAS_SYRK, ROUTE_BUILTIN, 1);
+    omp_syrk(uplo, trans, n, k, alpha, A, lda, beta, C, ldc);
+  }
+}
+
+void route_herk(char uplo, char trans, UINT n, UINT k, DTYPE alpha, CTYPE* A,
+                UINT lda, DTYPE beta, CTYPE* C, UINT ldc) {
+  if (blas_use(BLAS_HERK, (unsigned long long int)n * n * k)) {
+    blas_count(BLAS_HERK, ROUTE_BLAS, 1);
+    backend_herk(BLAS_COL, uplo, trans, n, k, alpha, A, lda, beta, C, ldc);
+  } else {
+    blas_count(BLAS_HERK, ROUTE_BUILTIN, 1);
+    omp_herk(uplo, trans, n, k, alpha, A, lda, beta, C, ldc);
+  }
+}
+
+/**** AUTOTUNE ****/
+/* square sizes timed by blas_autotune() */
+#define TUNE_GEMM_CNT 11
+#define TUNE_GEMV_CNT 8
+static const UINT tune_gemm[TUNE_GEMM_CNT] = {4,  8,  16,  24,  32, 48,
+                                              64, 96, 128, 192, 256};
+static const UINT tune_gemv[TUNE_GEMV_CNT] = {8,   16,  32,  64,
+                                              128, 256, 512, 1024};
+/* each size runs for TUNE_US micro sec, best of TUNE_ROUND rounds */
+#define TUNE_US 2000
+#define TUNE_ROUND 3
+
+/* stopwatch() is left to the caller */
+static double tune_clock() {
+#if OS_UNIX
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+#elif OS_WIN
+  LARGE_INTEGER cnt, freq;
+  QueryPerformanceCounter(&cnt);
+  QueryPerformanceFrequency(&freq);
+  return (double)cnt.QuadPart * 1e6 / freq.QuadPart;
+#else
+  return (double)clock() * 1e6 / CLOCKS_PER_SEC;
+#endif
+}
+
+static void tune_call(int op, int route, UINT s, DTYPE* a, DTYPE* b,
+                      DTYPE* c) {
+  CTYPE one = {1, 0}, zero = {0, 0};
+
+  switch (op) {
+    case BLAS_GEMM:
+      if (route == ROUTE_BLAS)
+        backend_gemm(BLAS_COL, NoTran, NoTran, s, s, s, 1, a, s, b, s, 0, c,
+                     s);
+      else
+        omp_gemm(NoTran, NoTran, s, s, s, 1, a, s, b, s, 0, c, s);
+      break;
+    case BLAS_CGEMM:
+      if (route == ROUTE_BLAS)
+        backend_cgemm(BLAS_COL, NoTran, NoTran, s, s, s, &one, a, s, b, s,
+                      &zero, c, s);
+      else
+        omp_cgemm(NoTran, NoTran, s, s, s, one, (CTYPE*)a, s, (CTYPE*)b, s,
+                  zero, (CTYPE*)c, s);
+      break;
+    case BLAS_GEMV:
+      if (route == ROUTE_BLAS)
+        backend_gemv(BLAS_ROW, NoTran, s, s, 1, a, s, b, 1, 0, c, 1);
+      else
+        omp_gemv(NoTran, s, s, 1, a, s, b, 1, 0, c, 1);
+      break;
+    case BLAS_CGEMV:
+      if (route == ROUTE_BLAS)
+        backend_cgemv(BLAS_ROW, NoTran, s, s, &one, a, s, b, 1, &zero, c, 1);
+      else
+        omp_cgemv(NoTran, s, s, one, (CTYPE*)a, s, (CTYPE*)b, 1, zero,
+                  (CTYPE*)c, 1);
+      break;
+    case BLAS_SYRK:
+      if (route == ROUTE_BLAS)
+        backend_syrk(BLAS_COL, Lower, NoTran, s, s, 1, a, s, 0, c, s);
+      else
+        omp_syrk(Lower, NoTran, s, s, 1, a, s, 0, c, s);
+      break;
+    case BLAS_HERK:
+      if (route == ROUTE_BLAS)
+        backend_herk(BLAS_COL, Lower, NoTran, s, s, 1, a, s, 0, c, s);
+      else
+        omp_herk(Lower, NoTran, s, s, 1, (CTYPE*)a, s, 0, (CTYPE*)c, s);
+      break;
+  }
+}
+
+/* micro sec per call */
+static double tune_time(int op, int route, UINT s, DTYPE* a, DTYPE* b,
+                        DTYPE* c) {
+  ITER r, cnt;
+  double t0, t, best = -1;
+
+  tune_call(op, route, s, a, b, c);
+  for (r = 0; r < TUNE_ROUND; r++) {
+    cnt = 0;
+    t0 = tune_clock();
+    do {
+      tune_call(op, route, s, a, b, c);
+      cnt++;
+    } while ((t = tune_clock() - t0) < TUNE_US);
+    if (best < 0 || t / cnt < best) best = t / cnt;
+  }
+  return best;
+}
+
+void blas_autotune(const char* path) {
+  const UINT* sizes;
+  UINT s, cnt, max_gemm, max_gemv;
+  ITER i, op;
+  int win;
+  unsigned long long int size;
+  double t_builtin, t_blas;
+  DTYPE *a, *b, *c;
+  FILE* fp;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  if (backend_gemm == NULL) {
+    printf(" *** [iip_sph_pp] No BLAS backend to tune.\n");
+    return;
+  }
+  // complex of the largest sizes
+  max_gemm = tune_gemm[TUNE_GEMM_CNT - 1];
+  max_gemv = tune_gemv[TUNE_GEMV_CNT - 1];
+  a = (DTYPE*)malloc_aligned(sizeof(CTYPE) * max_gemv * max_gemv);
+  b = (DTYPE*)malloc_aligned(sizeof(CTYPE) * max_gemm * max_gemm);
+  c = (DTYPE*)malloc_aligned(sizeof(CTYPE) * max_gemm * max_gemm);
+  for (i = 0; i < 2 * max_gemv * max_gemv; i++) a[i] = 1. / (i % 7 + 1);
+  for (i = 0; i < 2 * max_gemm * max_gemm; i++) b[i] = 1. / (i % 5 + 1);
+
+  printf(" *** BLAS autotune, %s\n", backend_name);
+  printf("%8s %6s %12s %12s   (us)\n", "op", "size", "builtin", "blas");
+  for (op = 0; op < BLAS_OPS; op++) {
+    sizes = op != BLAS_GEMV && op != BLAS_CGEMV ? tune_gemm : tune_gemv;
+    cnt = op != BLAS_GEMV && op != BLAS_CGEMV ? TUNE_GEMM_CNT : TUNE_GEMV_CNT;
+    // smallest size of the run of BLAS wins up to the largest
+    threshold[op] = BLAS_NEVER;
+    win = 1;
+    for (i = cnt - 1; i >= 0; i--) {
+      s = sizes[i];
+      t_builtin = tune_time(op, ROUTE_BUILTIN, s, a, b, c);
+      t_blas = tune_time(op, ROUTE_BLAS, s, a, b, c);
+      printf("%8s %6u %12.2lf %12.2lf\n", op_name[op], s, t_builtin, t_blas);
+      if (win && t_blas < t_builtin) {
+        size = (unsigned long long int)s * s;
+        if (op != BLAS_GEMV && op != BLAS_CGEMV) size *= s;
+        threshold[op] = i == 0 ? 0 : size;
+      } else
+        win = 0;
+    }
+  }
+  free_aligned(a);
+  free_aligned(b);
+  free_aligned(c);
+
+  if (path == NULL) return;
+  fp = fopen(path, "w");
+  if (fp == NULL) {
+    printf(" *** [iip_sph_pp] Can't write BLAS tune to '%s'\n", path);
+    return;
+  }
+  fprintf(fp, "# %s\n", backend_name);
+  for (op = 0; op < BLAS_OPS; op++)
+    if (threshold[op] == BLAS_NEVER)
+      fprintf(fp, "%s never\n", op_name[op]);
+    else
+      fprintf(fp, "%s %llu\n", op_name[op], threshold[op]);
+  fclose(fp);
+}
+
+int blas_load_tune(const char* path) {
+  FILE* fp;
+  char line[MAX_CHAR], name[MAX_CHAR], value[MAX_CHAR];
+  int op, cnt = 0;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  fp = fopen(path, "r");
+  if (fp == NULL) return -1;
+  while (fgets(line, MAX_CHAR, fp) != NULL) {
+    if (line[0] == '#' || sscanf(line, "%255s %255s", name, value) != 2)
+      continue;
+    for (op = 0; op < BLAS_OPS; op++)
+      if (!strcmp(name, op_name[op])) {
+        threshold[op] =
+            strcmp(value, "never") ? strtoull(value, NULL, 10) : BLAS_NEVER;
+        cnt++;
+      }
+  }
+  fclose(fp);
+  return cnt;
+}
+
+/**** STATISTICS ****/
+
+void blas_stat(BLAS_STAT* stat) {
+  int op;
+
+  strcpy(stat->name, backend_name);
+  for (op = 0; op < BLAS_OPS; op++) {
+    stat->threshold[op] = threshold[op];
+    stat->builtin[op] = route_cnt[op][ROUTE_BUILTIN];
+    stat->blas[op] = route_cnt[op][ROUTE_BLAS];
+  }
+}
+
+void blas_stat_reset() { memset(route_cnt, 0, sizeof(route_cnt)); }
+
+void blas_stat_json(FILE* fp) {
+  BLAS_STAT stat;
+  int op;
+
+  blas_stat(&stat);
+  fprintf(fp, "{\"backend\": \"%s\"", stat.name);
+  for (op = 0; op < BLAS_OPS; op++) {
+    fprintf(fp, ", \"%s\": {\"threshold\": ", op_name[op]);
+    if (stat.threshold[op] == BLAS_NEVER)
+      fprintf(fp, "null");
+    else
+      fprintf(fp, "%llu", stat.threshold[op]);
+    fprintf(fp, ", \"builtin\": %llu, \"blas\": %llu}", stat.builtin[op],
+            stat.blas[op]);
+  }
+  fprintf(fp, "}\n");
+}
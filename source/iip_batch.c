@@ -0,0 +1,839 @@
+#include "iip_batch.h"
+#include "iip_invert.h"
+
+/* A chunk holds SMALL_LANE slices interleaved, element e of slice l is
+ * x[e][l]. Complex chunk is split into planes of re and im.
+ * Every step below runs over l with rows of x indexed apart, so that the
+ * compiler sees no dependence across lanes. */
+#define ELEM (SMALL_MAX * SMALL_MAX)
+
+/**** interleave ****/
+/* Element e of slice l is X[l * stride + e], stride 0 repeats one slice.
+ * Lanes from nb on are zero. */
+static void small_load(DTYPE* X, UINT size, UINT stride, UINT nb,
+                       DTYPE (*x)[SMALL_LANE]) {
+  ITER e, l;
+  for (e = 0; e < size; e++) {
+    for (l = 0; l < nb; l++) x[e][l] = X[l * stride + e];
+    for (; l < SMALL_LANE; l++) x[e][l] = 0;
+  }
+}
+
+static void small_store(DTYPE (*x)[SMALL_LANE], UINT size, UINT stride,
+                        UINT nb, DTYPE* X) {
+  ITER e, l;
+  for (e = 0; e < size; e++)
+    for (l = 0; l < nb; l++) X[l * stride + e] = x[e][l];
+}
+
+/* conj != 0 negates im. */
+static void small_cload(CTYPE* X, UINT size, UINT stride, UINT nb, int conj,
+                        DTYPE (*xr)[SMALL_LANE], DTYPE (*xi)[SMALL_LANE]) {
+  ITER e, l;
+  for (e = 0; e < size; e++) {
+    for (l = 0; l < nb; l++) {
+      xr[e][l] = X[l * stride + e].re;
+      xi[e][l] = conj ? -X[l * stride + e].im : X[l * stride + e].im;
+    }
+    for (; l < SMALL_LANE; l++) xr[e][l] = xi[e][l] = 0;
+  }
+}
+
+static void small_cstore(DTYPE (*xr)[SMALL_LANE], DTYPE (*xi)[SMALL_LANE],
+                         UINT size, UINT stride, UINT nb, CTYPE* X) {
+  ITER e, l;
+  for (e = 0; e < size; e++)
+    for (l = 0; l < nb; l++) {
+      X[l * stride + e].re = xr[e][l];
+      X[l * stride + e].im = xi[e][l];
+    }
+}
+
+/* d2 of A and B against C, same broadcasting as gemm_mat(). */
+#define SMALL_CHECK_D2(A, B, C)                       \
+  {                                                   \
+    if (A->d2 == B->d2 || A->d2 == 1 || B->d2 == 1) { \
+      if (C->d2 != (A->d2 > B->d2 ? A->d2 : B->d2))   \
+        ASSERT_DIM_INVALID()                          \
+    } else                                            \
+      ASSERT_DIM_INVALID()                            \
+  }
+
+/**** gemm ****/
+
+void gemm_small(char transA, char transB, DTYPE alpha, MAT* A, MAT* B,
+                DTYPE beta, MAT* C) {
+  UINT m, n, k, kb, nb, sa, sb, sc;
+  ITER b, i, j, p, l;
+  UINT ia, ib, ic;
+  DTYPE a[ELEM][SMALL_LANE], bb[ELEM][SMALL_LANE], c[ELEM][SMALL_LANE],
+      acc[SMALL_LANE];
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  if ((transA == CTran) || (transB == CTran)) {
+    printf("ERROR : can't conjugate transpose real number matrix\n");
+    return;
+  }
+  m = transA == NoTran ? A->d0 : A->d1;
+  k = transA == NoTran ? A->d1 : A->d0;
+  n = transB == NoTran ? B->d1 : B->d0;
+  kb = transB == NoTran ? B->d0 : B->d1;
+  if (k != kb || C->d0 != m || C->d1 != n) {
+    sprintf(str_assert, "(%d * %d) X (%d * %d) = (%d * %d)\n", A->d0, A->d1,
+            B->d0, B->d1, C->d0, C->d1);
+    ASSERT(0, str_assert)
+  }
+  ASSERT(m <= SMALL_MAX && n <= SMALL_MAX && k <= SMALL_MAX,
+         "Too large for gemm_small().\n")
+  SMALL_CHECK_D2(A, B, C)
+  sa = A->d2 == 1 ? 0 : A->d0 * A->d1;
+  sb = B->d2 == 1 ? 0 : B->d0 * B->d1;
+  sc = m * n;
+
+#pragma omp parallel for schedule(static) shared(A, B, C) private( \
+    b, i, j, p, l, nb, a, bb, c, acc, ia, ib, ic)
+  for (b = 0; b < C->d2; b += SMALL_LANE) {
+    nb = C->d2 - b < SMALL_LANE ? C->d2 - b : SMALL_LANE;
+    small_load(A->data + b * sa, A->d0 * A->d1, sa, nb, a);
+    small_load(B->data + b * sb, B->d0 * B->d1, sb, nb, bb);
+    if (beta != 0) small_load(C->data + b * sc, sc, sc, nb, c);
+
+    for (j = 0; j < n; j++)
+      for (i = 0; i < m; i++) {
+        for (l = 0; l < SMALL_LANE; l++) acc[l] = 0;
+        for (p = 0; p < k; p++) {
+          ia = transA == NoTran ? i + p * A->d0 : p + i * A->d0;
+          ib = transB == NoTran ? p + j * B->d0 : j + p * B->d0;
+          for (l = 0; l < SMALL_LANE; l++) acc[l] += a[ia][l] * bb[ib][l];
+        }
+        ic = i + j * m;
+        if (beta == 0)
+          for (l = 0; l < SMALL_LANE; l++) c[ic][l] = alpha * acc[l];
+        else
+          for (l = 0; l < SMALL_LANE; l++)
+            c[ic][l] = alpha * acc[l] + beta * c[ic][l];
+      }
+    small_store(c, sc, sc, nb, C->data + b * sc);
+  }
+}
+
+void cgemm_small(char transA, char transB, CTYPE alpha, CMAT* A, CMAT* B,
+                 CTYPE beta, CMAT* C) {
+  UINT m, n, k, kb, nb, sa, sb, sc;
+  ITER b, i, j, p, l;
+  DTYPE ar[ELEM][SMALL_LANE], ai[ELEM][SMALL_LANE], br[ELEM][SMALL_LANE],
+      bi[ELEM][SMALL_LANE], cr[ELEM][SMALL_LANE], ci[ELEM][SMALL_LANE];
+  DTYPE acr[SMALL_LANE], aci[SMALL_LANE], t;
+  UINT ia, ib, ic;
+  int zero;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  m = transA == NoTran ? A->d0 : A->d1;
+  k = transA == NoTran ? A->d1 : A->d0;
+  n = transB == NoTran ? B->d1 : B->d0;
+  kb = transB == NoTran ? B->d0 : B->d1;
+  if (k != kb || C->d0 != m || C->d1 != n) {
+    sprintf(str_assert, "(%d * %d) X (%d * %d) = (%d * %d)\n", A->d0, A->d1,
+            B->d0, B->d1, C->d0, C->d1);
+    ASSERT(0, str_assert)
+  }
+  ASSERT(m <= SMALL_MAX && n <= SMALL_MAX && k <= SMALL_MAX,
+         "Too large for cgemm_small().\n")
+  SMALL_CHECK_D2(A, B, C)
+  sa = A->d2 == 1 ? 0 : A->d0 * A->d1;
+  sb = B->d2 == 1 ? 0 : B->d0 * B->d1;
+  sc = m * n;
+  zero = beta.re == 0 && beta.im == 0;
+
+#pragma omp parallel for schedule(static) shared(A, B, C) private( \
+    b, i, j, p, l, nb, ar, ai, br, bi, cr, ci, acr, aci, t, ia, ib, ic)
+  for (b = 0; b < C->d2; b += SMALL_LANE) {
+    nb = C->d2 - b < SMALL_LANE ? C->d2 - b : SMALL_LANE;
+    small_cload(A->data + b * sa, A->d0 * A->d1, sa, nb, transA == CTran, ar,
+                ai);
+    small_cload(B->data + b * sb, B->d0 * B->d1, sb, nb, transB == CTran, br,
+                bi);
+    if (!zero) small_cload(C->data + b * sc, sc, sc, nb, 0, cr, ci);
+
+    for (j = 0; j < n; j++)
+      for (i = 0; i < m; i++) {
+        for (l = 0; l < SMALL_LANE; l++) acr[l] = aci[l] = 0;
+        for (p = 0; p < k; p++) {
+          ia = transA == NoTran ? i + p * A->d0 : p + i * A->d0;
+          ib = transB == NoTran ? p + j * B->d0 : j + p * B->d0;
+          for (l = 0; l < SMALL_LANE; l++) {
+            acr[l] += ar[ia][l] * br[ib][l] - ai[ia][l] * bi[ib][l];
+            aci[l] += ar[ia][l] * bi[ib][l] + ai[ia][l] * br[ib][l];
+          }
+        }
+        ic = i + j * m;
+        for (l = 0; l < SMALL_LANE; l++) {
+          t = alpha.re * acr[l] - alpha.im * aci[l];
+          aci[l] = alpha.re * aci[l] + alpha.im * acr[l];
+          acr[l] = t;
+        }
+        if (zero)
+          for (l = 0; l < SMALL_LANE; l++) {
+            cr[ic][l] = acr[l];
+            ci[ic][l] = aci[l];
+          }
+        else
+          for (l = 0; l < SMALL_LANE; l++) {
+            t = beta.re * cr[ic][l] - beta.im * ci[ic][l] + acr[l];
+            ci[ic][l] = beta.re * ci[ic][l] + beta.im * cr[ic][l] + aci[l];
+            cr[ic][l] = t;
+          }
+      }
+    small_cstore(cr, ci, sc, sc, nb, C->data + b * sc);
+  }
+}
+
+/**** gemv ****/
+
+void gemv_small(char transA, DTYPE alpha, MAT* A, MAT* X, DTYPE beta, MAT* Y) {
+  UINT m, k, nb, sa;
+  ITER b, i, p, l;
+  UINT ia;
+  DTYPE a[ELEM][SMALL_LANE], x[SMALL_MAX][SMALL_LANE], y[SMALL_MAX][SMALL_LANE],
+      acc[SMALL_LANE];
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  if (transA == CTran) {
+    printf("ERROR : can't conjugate transpose real number matrix\n");
+    return;
+  }
+  m = transA == NoTran ? A->d0 : A->d1;
+  k = transA == NoTran ? A->d1 : A->d0;
+  if (X->d0 * X->d1 != k || Y->d0 * Y->d1 != m) ASSERT_DIM_INVALID()
+  ASSERT(m <= SMALL_MAX && k <= SMALL_MAX, "Too large for gemv_small().\n")
+  if (X->d2 != Y->d2 || (A->d2 != 1 && A->d2 != Y->d2)) ASSERT_DIM_INVALID()
+  sa = A->d2 == 1 ? 0 : A->d0 * A->d1;
+
+#pragma omp parallel for schedule(static) shared(A, X, Y) private( \
+    b, i, p, l, nb, a, x, y, acc, ia)
+  for (b = 0; b < Y->d2; b += SMALL_LANE) {
+    nb = Y->d2 - b < SMALL_LANE ? Y->d2 - b : SMALL_LANE;
+    small_load(A->data + b * sa, A->d0 * A->d1, sa, nb, a);
+    small_load(X->data + b * k, k, k, nb, x);
+    if (beta != 0) small_load(Y->data + b * m, m, m, nb, y);
+
+    for (i = 0; i < m; i++) {
+      for (l = 0; l < SMALL_LANE; l++) acc[l] = 0;
+      for (p = 0; p < k; p++) {
+        ia = transA == NoTran ? i + p * A->d0 : p + i * A->d0;
+        for (l = 0; l < SMALL_LANE; l++) acc[l] += a[ia][l] * x[p][l];
+      }
+      if (beta == 0)
+        for (l = 0; l < SMALL_LANE; l++) y[i][l] = alpha * acc[l];
+      else
+        for (l = 0; l < SMALL_LANE; l++)
+          y[i][l] = alpha * acc[l] + beta * y[i][l];
+    }
+    small_store(y, m, m, nb, Y->data + b * m);
+  }
+}
+
+void cgemv_small(char transA, CTYPE alpha, CMAT* A, CMAT* X, CTYPE beta,
+                 CMAT* Y) {
+  UINT m, k, nb, sa;
+  ITER b, i, p, l;
+  DTYPE ar[ELEM][SMALL_LANE], ai[ELEM][SMALL_LANE], xr[SMALL_MAX][SMALL_LANE],
+      xi[SMALL_MAX][SMALL_LANE], yr[SMALL_MAX][SMALL_LANE],
+      yi[SMALL_MAX][SMALL_LANE], acr[SMALL_LANE], aci[SMALL_LANE], t;
+  UINT ia;
+  int zero;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  m = transA == NoTran ? A->d0 : A->d1;
+  k = transA == NoTran ? A->d1 : A->d0;
+  if (X->d0 * X->d1 != k || Y->d0 * Y->d1 != m) ASSERT_DIM_INVALID()
+  ASSERT(m <= SMALL_MAX && k <= SMALL_MAX, "Too large for cgemv_small().\n")
+  if (X->d2 != Y->d2 || (A->d2 != 1 && A->d2 != Y->d2)) ASSERT_DIM_INVALID()
+  sa = A->d2 == 1 ? 0 : A->d0 * A->d1;
+  zero = beta.re == 0 && beta.im == 0;
+
+#pragma omp parallel for schedule(static) shared(A, X, Y) private( \
+    b, i, p, l, nb, ar, ai, xr, xi, yr, yi, acr, aci, t, ia)
+  for (b = 0; b < Y->d2; b += SMALL_LANE) {
+    nb = Y->d2 - b < SMALL_LANE ? Y->d2 - b : SMALL_LANE;
+    small_cload(A->data + b * sa, A->d0 * A->d1, sa, nb, transA == CTran, ar,
+                ai);
+    small_cload(X->data + b * k, k, k, nb, 0, xr, xi);
+    if (!zero) small_cload(Y->data + b * m, m, m, nb, 0, yr, yi);
+
+    for (i = 0; i < m; i++) {
+      for (l = 0; l < SMALL_LANE; l++) acr[l] = aci[l] = 0;
+      for (p = 0; p < k; p++) {
+        ia = transA == NoTran ? i + p * A->d0 : p + i * A->d0;
+        for (l = 0; l < SMALL_LANE; l++) {
+          acr[l] += ar[ia][l] * xr[p][l] - ai[ia][l] * xi[p][l];
+          aci[l] += ar[ia][l] * xi[p][l] + ai[ia][l] * xr[p][l];
+        }
+      }
+      for (l = 0; l < SMALL_LANE; l++) {
+        t = alpha.re * acr[l] - alpha.im * aci[l];
+        aci[l] = alpha.re * aci[l] + alpha.im * acr[l];
+        acr[l] = t;
+      }
+      if (zero)
+        for (l = 0; l < SMALL_LANE; l++) {
+          yr[i][l] = acr[l];
+          yi[i][l] = aci[l];
+        }
+      else
+        for (l = 0; l < SMALL_LANE; l++) {
+          t = beta.re * yr[i][l] - beta.im * yi[i][l] + acr[l];
+          yi[i][l] = beta.re * yi[i][l] + beta.im * yr[i][l] + aci[l];
+          yr[i][l] = t;
+        }
+    }
+    small_cstore(yr, yi, m, m, nb, Y->data + b * m);
+  }
+}
+
+/**** inverse and determinant ****/
+/* Both sides of every select below are loaded up front, one select per
+ * loop. Otherwise gcc -O2 leaves these loops as branches. */
+
+/* Row of pivot for column c of n x n chunk a, per slice into pr,
+ * |pivot| into pv. Complex takes |re| + |im|.
+ * pr is kept in DTYPE so the selects stay in one vector width. */
+static void small_pivot(DTYPE (*a)[SMALL_LANE], UINT n, UINT c, DTYPE* pr,
+                        DTYPE* pv) {
+  ITER r, l;
+  DTYPE t, u, w, rr, q[SMALL_LANE], v[SMALL_LANE];
+  for (l = 0; l < SMALL_LANE; l++) {
+    q[l] = c;
+    v[l] = fabs(a[c + c * n][l]);
+  }
+  for (r = c + 1; r < n; r++) {
+    rr = r;
+    for (l = 0; l < SMALL_LANE; l++) {
+      t = fabs(a[r + c * n][l]);
+      u = v[l];
+      w = q[l];
+      q[l] = t > u ? rr : w;
+    }
+    for (l = 0; l < SMALL_LANE; l++) {
+      t = fabs(a[r + c * n][l]);
+      u = v[l];
+      v[l] = t > u ? t : u;
+    }
+  }
+  for (l = 0; l < SMALL_LANE; l++) {
+    pr[l] = q[l];
+    pv[l] = v[l];
+  }
+}
+
+static void small_cpivot(DTYPE (*ar)[SMALL_LANE], DTYPE (*ai)[SMALL_LANE],
+                         UINT n, UINT c, DTYPE* pr, DTYPE* pv) {
+  ITER r, l;
+  DTYPE t, u, w, rr, q[SMALL_LANE], v[SMALL_LANE];
+  for (l = 0; l < SMALL_LANE; l++) {
+    q[l] = c;
+    v[l] = fabs(ar[c + c * n][l]) + fabs(ai[c + c * n][l]);
+  }
+  for (r = c + 1; r < n; r++) {
+    rr = r;
+    for (l = 0; l < SMALL_LANE; l++) {
+      t = fabs(ar[r + c * n][l]) + fabs(ai[r + c * n][l]);
+      u = v[l];
+      w = q[l];
+      q[l] = t > u ? rr : w;
+    }
+    for (l = 0; l < SMALL_LANE; l++) {
+      t = fabs(ar[r + c * n][l]) + fabs(ai[r + c * n][l]);
+      u = v[l];
+      v[l] = t > u ? t : u;
+    }
+  }
+  for (l = 0; l < SMALL_LANE; l++) {
+    pr[l] = q[l];
+    pv[l] = v[l];
+  }
+}
+
+/* Swap row c with row pr of each slice, on columns from j0 to n - 1.
+ * Row c goes through locals, so each loop touches a single row of a. */
+static void small_swap(DTYPE (*a)[SMALL_LANE], UINT n, UINT c, UINT j0,
+                       DTYPE* pr) {
+  ITER r, j, l;
+  DTYPE s, t, w, rr, p[SMALL_LANE], u[SMALL_LANE], v[SMALL_LANE];
+  for (l = 0; l < SMALL_LANE; l++) p[l] = pr[l];
+  for (j = j0; j < n; j++) {
+    for (l = 0; l < SMALL_LANE; l++) u[l] = v[l] = a[c + j * n][l];
+    for (r = c + 1; r < n; r++) {
+      rr = r;
+      for (l = 0; l < SMALL_LANE; l++) {
+        s = a[r + j * n][l];
+        w = v[l];
+        v[l] = p[l] == rr ? s : w;
+      }
+      for (l = 0; l < SMALL_LANE; l++) {
+        s = a[r + j * n][l];
+        t = u[l];
+        a[r + j * n][l] = p[l] == rr ? t : s;
+      }
+    }
+    for (l = 0; l < SMALL_LANE; l++) a[c + j * n][l] = v[l];
+  }
+}
+
+/* Swap row c with row pr of each slice, lane by lane. One row index per
+ * lane costs n moves per slice, where small_swap() selects over rows. */
+static void small_xrow(DTYPE (*a)[SMALL_LANE], UINT n, UINT c, DTYPE* pr) {
+  ITER j, l, p;
+  DTYPE t;
+  for (l = 0; l < SMALL_LANE; l++) {
+    p = (ITER)pr[l];
+    for (j = 0; j < n; j++) {
+      t = a[c + j * n][l];
+      a[c + j * n][l] = a[p + j * n][l];
+      a[p + j * n][l] = t;
+    }
+  }
+}
+
+/* Same on columns. */
+static void small_xcol(DTYPE (*a)[SMALL_LANE], UINT n, UINT c, DTYPE* pr) {
+  ITER i, l, p;
+  DTYPE t;
+  for (l = 0; l < SMALL_LANE; l++) {
+    p = (ITER)pr[l];
+    for (i = 0; i < n; i++) {
+      t = a[i + c * n][l];
+      a[i + c * n][l] = a[i + p * n][l];
+      a[i + p * n][l] = t;
+    }
+  }
+}
+
+/* Adjugate of 3 x 3 and 4 x 4 by tables, lanes run inside each entry.
+ * 3 x 3 as invert_3by3(), Y[e] = X[p] * X[q] - X[r] * X[s],
+ * {p, q, r, s} of row e. */
+static const UINT small_cof3[9][4] = {{4, 8, 7, 5}, {7, 2, 1, 8}, {1, 5, 4, 2},
+                                      {6, 5, 3, 8}, {0, 8, 6, 2}, {3, 2, 0, 5},
+                                      {3, 7, 6, 4}, {6, 1, 0, 7}, {0, 4, 3, 1}};
+
+/* 4 x 4 as invert_4by4(), 2 x 2 minors of columns {2, 3} then {0, 1},
+ * M[k] = X[p] * X[q] - X[r] * X[s], */
+static const UINT small_min4[12][4] = {
+    {8, 13, 9, 12}, {8, 14, 10, 12}, {8, 15, 11, 12}, {9, 14, 10, 13},
+    {9, 15, 11, 13}, {10, 15, 11, 14}, {0, 5, 1, 4}, {0, 6, 2, 4},
+    {0, 7, 3, 4}, {1, 6, 2, 5}, {1, 7, 3, 5}, {2, 7, 3, 6}};
+
+/* then Y[e] = sign * (X[x0] * M[k0] - X[x1] * M[k1] + X[x2] * M[k2]),
+ * {sign, x0, k0, x1, k1, x2, k2} of row e. */
+static const int small_cof4[16][7] = {
+    {1, 5, 5, 6, 4, 7, 3},     {-1, 1, 5, 2, 4, 3, 3},
+    {1, 13, 11, 14, 10, 15, 9}, {-1, 9, 11, 10, 10, 11, 9},
+    {-1, 4, 5, 6, 2, 7, 1},    {1, 0, 5, 2, 2, 3, 1},
+    {-1, 12, 11, 14, 8, 15, 7}, {1, 8, 11, 10, 8, 11, 7},
+    {1, 4, 4, 5, 2, 7, 0},     {-1, 0, 4, 1, 2, 3, 0},
+    {1, 12, 10, 13, 8, 15, 6},  {-1, 8, 10, 9, 8, 11, 6},
+    {-1, 4, 3, 5, 1, 6, 0},    {1, 0, 3, 1, 1, 2, 0},
+    {-1, 12, 9, 13, 7, 14, 6},  {1, 8, 9, 9, 7, 10, 6}};
+
+/* Complex products in the tables, re and im of X * Y. */
+#define SMALL_MULR(xr, xi, yr, yi) ((xr) * (yr) - (xi) * (yi))
+#define SMALL_MULI(xr, xi, yr, yi) ((xr) * (yi) + (xi) * (yr))
+
+static int small_cadj(DTYPE (*ar)[SMALL_LANE], DTYPE (*ai)[SMALL_LANE],
+                      UINT n, DTYPE (*yr)[SMALL_LANE],
+                      DTYPE (*yi)[SMALL_LANE]) {
+  ITER e, i, l;
+  const UINT* q;
+  const int* p;
+  DTYPE mr[12][SMALL_LANE], mi[12][SMALL_LANE], tr[16][SMALL_LANE],
+      ti[16][SMALL_LANE], dr[SMALL_LANE], di[SMALL_LANE], sg, u;
+  int singular = 0;
+  if (n == 2) {
+    for (l = 0; l < SMALL_LANE; l++) {
+      tr[0][l] = ar[3][l];
+      ti[0][l] = ai[3][l];
+      tr[1][l] = -ar[1][l];
+      ti[1][l] = -ai[1][l];
+      tr[2][l] = -ar[2][l];
+      ti[2][l] = -ai[2][l];
+      tr[3][l] = ar[0][l];
+      ti[3][l] = ai[0][l];
+    }
+  } else if (n == 3) {
+    for (e = 0; e < 9; e++) {
+      q = small_cof3[e];
+      for (l = 0; l < SMALL_LANE; l++) {
+        tr[e][l] =
+            SMALL_MULR(ar[q[0]][l], ai[q[0]][l], ar[q[1]][l], ai[q[1]][l]) -
+            SMALL_MULR(ar[q[2]][l], ai[q[2]][l], ar[q[3]][l], ai[q[3]][l]);
+        ti[e][l] =
+            SMALL_MULI(ar[q[0]][l], ai[q[0]][l], ar[q[1]][l], ai[q[1]][l]) -
+            SMALL_MULI(ar[q[2]][l], ai[q[2]][l], ar[q[3]][l], ai[q[3]][l]);
+      }
+    }
+  } else {
+    for (e = 0; e < 12; e++) {
+      q = small_min4[e];
+      for (l = 0; l < SMALL_LANE; l++) {
+        mr[e][l] =
+            SMALL_MULR(ar[q[0]][l], ai[q[0]][l], ar[q[1]][l], ai[q[1]][l]) -
+            SMALL_MULR(ar[q[2]][l], ai[q[2]][l], ar[q[3]][l], ai[q[3]][l]);
+        mi[e][l] =
+            SMALL_MULI(ar[q[0]][l], ai[q[0]][l], ar[q[1]][l], ai[q[1]][l]) -
+            SMALL_MULI(ar[q[2]][l], ai[q[2]][l], ar[q[3]][l], ai[q[3]][l]);
+      }
+    }
+    for (e = 0; e < 16; e++) {
+      p = small_cof4[e];
+      sg = p[0];
+      for (l = 0; l < SMALL_LANE; l++) {
+        tr[e][l] =
+            sg *
+            (SMALL_MULR(ar[p[1]][l], ai[p[1]][l], mr[p[2]][l], mi[p[2]][l]) -
+             SMALL_MULR(ar[p[3]][l], ai[p[3]][l], mr[p[4]][l], mi[p[4]][l]) +
+             SMALL_MULR(ar[p[5]][l], ai[p[5]][l], mr[p[6]][l], mi[p[6]][l]));
+        ti[e][l] =
+            sg *
+            (SMALL_MULI(ar[p[1]][l], ai[p[1]][l], mr[p[2]][l], mi[p[2]][l]) -
+             SMALL_MULI(ar[p[3]][l], ai[p[3]][l], mr[p[4]][l], mi[p[4]][l]) +
+             SMALL_MULI(ar[p[5]][l], ai[p[5]][l], mr[p[6]][l], mi[p[6]][l]));
+      }
+    }
+  }
+  for (l = 0; l < SMALL_LANE; l++) dr[l] = di[l] = 0;
+  for (i = 0; i < n; i++)
+    for (l = 0; l < SMALL_LANE; l++) {
+      dr[l] += SMALL_MULR(ar[i * n][l], ai[i * n][l], tr[i][l], ti[i][l]);
+      di[l] += SMALL_MULI(ar[i * n][l], ai[i * n][l], tr[i][l], ti[i][l]);
+    }
+  for (l = 0; l < SMALL_LANE; l++)
+    singular |= dr[l] * dr[l] + di[l] * di[l] < FZERO * FZERO;
+  // 1 / d = conj(d) / |d|^2
+  for (l = 0; l < SMALL_LANE; l++) {
+    u = 1 / (dr[l] * dr[l] + di[l] * di[l]);
+    dr[l] *= u;
+    di[l] *= -u;
+  }
+  for (e = 0; e < n * n; e++)
+    for (l = 0; l < SMALL_LANE; l++) {
+      yr[e][l] = SMALL_MULR(tr[e][l], ti[e][l], dr[l], di[l]);
+      yi[e][l] = SMALL_MULI(tr[e][l], ti[e][l], dr[l], di[l]);
+    }
+  return singular;
+}
+
+void invert_small(MAT* mat, MAT* inv) {
+  UINT n, nb, size;
+  ITER b, c, r, j, l, er;
+  DTYPE a[ELEM][SMALL_LANE], ua[SMALL_MAX][SMALL_LANE],
+      pr[SMALL_MAX][SMALL_LANE], pv[SMALL_LANE], f[SMALL_LANE];
+  MAT x, y;
+  MP_MARK mark;
+  int singular = 0;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  ASSERT((mat->d0 == mat->d1), "This function requires SQUARE MATRIX.\n");
+  if (mat->d0 != inv->d0 || mat->d1 != inv->d1 || mat->d2 != inv->d2)
+    ASSERT_DIM_INVALID()
+  ASSERT(mat->d0 <= SMALL_MAX, "Too large for invert_small().\n")
+  n = mat->d0;
+  size = n * n;
+
+  // Up to 6 x 6, closed forms of invert() beat elimination across lanes.
+  // Slices go to invert() SMALL_CHUNK at a time.
+  if (n >= 2 && n <= 6) {
+#pragma omp parallel for schedule(static) shared(mat, inv) private(b, x, y, mark)
+    for (b = 0; b < mat->d2; b += SMALL_CHUNK) {
+      x = *mat;
+      y = *inv;
+      x.d2 = y.d2 = mat->d2 - b < SMALL_CHUNK ? mat->d2 - b : SMALL_CHUNK;
+      x.data = mat->data + b * size;
+      y.data = inv->data + b * size;
+      // closed forms don't take X == Y
+      mark = mp_mark();
+      if (x.data == y.data) {
+        x.data = mp_scratch(sizeof(DTYPE) * size * x.d2);
+        memcpy(x.data, y.data, sizeof(DTYPE) * size * x.d2);
+      }
+      invert(&x, &y);
+      mp_release(mark);
+    }
+    return;
+  }
+
+#pragma omp parallel for schedule(static) shared(mat, inv) private( \
+    b, c, r, j, l, nb, pr, a, ua, pv, f, er) reduction(|:singular)
+  for (b = 0; b < mat->d2; b += SMALL_LANE) {
+    nb = mat->d2 - b < SMALL_LANE ? mat->d2 - b : SMALL_LANE;
+    small_load(mat->data + b * size, size, size, nb, a);
+    // unused lanes take identity
+    for (j = 0; j < n; j++)
+      for (l = nb; l < SMALL_LANE; l++) a[j + j * n][l] = 1;
+
+    // Gauss-Jordan in place, inverse of the row-swapped matrix builds up
+    // where its columns are eliminated.
+    for (c = 0; c < n; c++) {
+      small_pivot(a, n, c, pr[c], pv);
+      for (l = 0; l < SMALL_LANE; l++) singular |= pv[l] < FZERO;
+      small_xrow(a, n, c, pr[c]);
+
+      // row c /= pivot, kept in ua
+      for (l = 0; l < SMALL_LANE; l++) {
+        f[l] = 1 / a[c + c * n][l];
+        a[c + c * n][l] = 1;
+      }
+      for (j = 0; j < n; j++)
+        for (l = 0; l < SMALL_LANE; l++) ua[j][l] = a[c + j * n][l] *= f[l];
+
+      // row r -= a(r,c) * row c
+      for (r = 0; r < n; r++) {
+        if (r == c) continue;
+        for (l = 0; l < SMALL_LANE; l++) {
+          f[l] = a[r + c * n][l];
+          a[r + c * n][l] = 0;
+        }
+        for (j = 0; j < n; j++) {
+          er = r + j * n;
+          for (l = 0; l < SMALL_LANE; l++) a[er][l] -= f[l] * ua[j][l];
+        }
+      }
+    }
+    // inv(P * A) * P, swaps of rows undone on columns in reverse
+    for (c = n; c-- > 0;) small_xcol(a, n, c, pr[c]);
+    small_store(a, size, size, nb, inv->data + b * size);
+  }
+  if (singular) ASSERT(0, "This matrix is singural.\n")
+}
+
+void cinvert_small(CMAT* mat, CMAT* inv) {
+  UINT n, nb, size;
+  ITER b, c, r, j, l, ec, er;
+  DTYPE ar[ELEM][SMALL_LANE], ai[ELEM][SMALL_LANE], yr[ELEM][SMALL_LANE],
+      yi[ELEM][SMALL_LANE], uar[SMALL_MAX][SMALL_LANE],
+      uai[SMALL_MAX][SMALL_LANE], uyr[SMALL_MAX][SMALL_LANE],
+      uyi[SMALL_MAX][SMALL_LANE], pr[SMALL_LANE], pv[SMALL_LANE],
+      fr[SMALL_LANE], fi[SMALL_LANE], t;
+  int singular = 0;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  ASSERT((mat->d0 == mat->d1), "This function requires SQUARE MATRIX.\n");
+  if (mat->d0 != inv->d0 || mat->d1 != inv->d1 || mat->d2 != inv->d2)
+    ASSERT_DIM_INVALID()
+  ASSERT(mat->d0 <= SMALL_MAX, "Too large for cinvert_small().\n")
+  n = mat->d0;
+  size = n * n;
+
+#pragma omp parallel for schedule(static) shared(mat, inv) private( \
+    b, c, r, j, l, nb, pr, ar, ai, yr, yi, uar, uai, uyr, uyi, pv, fr, fi, \
+    t, ec, er) reduction(|:singular)
+  for (b = 0; b < mat->d2; b += SMALL_LANE) {
+    nb = mat->d2 - b < SMALL_LANE ? mat->d2 - b : SMALL_LANE;
+    small_cload(mat->data + b * size, size, size, nb, 0, ar, ai);
+    for (j = 0; j < n; j++)
+      for (l = nb; l < SMALL_LANE; l++) ar[j + j * n][l] = 1;
+    if (n >= 2 && n <= 4) {
+      singular |= small_cadj(ar, ai, n, yr, yi);
+      small_cstore(yr, yi, size, size, nb, inv->data + b * size);
+      continue;
+    }
+    for (j = 0; j < size; j++)
+      for (l = 0; l < SMALL_LANE; l++) yr[j][l] = yi[j][l] = 0;
+    for (j = 0; j < n; j++)
+      for (l = 0; l < SMALL_LANE; l++) yr[j + j * n][l] = 1;
+
+    for (c = 0; c < n; c++) {
+      small_cpivot(ar, ai, n, c, pr, pv);
+      for (l = 0; l < SMALL_LANE; l++) singular |= pv[l] < FZERO;
+      small_swap(ar, n, c, c, pr);
+      small_swap(ai, n, c, c, pr);
+      small_swap(yr, n, c, 0, pr);
+      small_swap(yi, n, c, 0, pr);
+
+      // row c /= pivot, 1 / x = conj(x) / |x|^2
+      ec = c + c * n;
+      for (l = 0; l < SMALL_LANE; l++) {
+        t = 1 / (ar[ec][l] * ar[ec][l] + ai[ec][l] * ai[ec][l]);
+        fr[l] = ar[ec][l] * t;
+        fi[l] = -ai[ec][l] * t;
+      }
+      for (j = c; j < n; j++) {
+        ec = c + j * n;
+        for (l = 0; l < SMALL_LANE; l++) {
+          t = ar[ec][l] * fr[l] - ai[ec][l] * fi[l];
+          ai[ec][l] = uai[j][l] = ar[ec][l] * fi[l] + ai[ec][l] * fr[l];
+          ar[ec][l] = uar[j][l] = t;
+        }
+      }
+      for (j = 0; j < n; j++) {
+        ec = c + j * n;
+        for (l = 0; l < SMALL_LANE; l++) {
+          t = yr[ec][l] * fr[l] - yi[ec][l] * fi[l];
+          yi[ec][l] = uyi[j][l] = yr[ec][l] * fi[l] + yi[ec][l] * fr[l];
+          yr[ec][l] = uyr[j][l] = t;
+        }
+      }
+
+      // row r -= a(r,c) * row c
+      for (r = 0; r < n; r++) {
+        if (r == c) continue;
+        er = r + c * n;
+        for (l = 0; l < SMALL_LANE; l++) {
+          fr[l] = ar[er][l];
+          fi[l] = ai[er][l];
+        }
+        for (j = c; j < n; j++) {
+          er = r + j * n;
+          for (l = 0; l < SMALL_LANE; l++) {
+            ar[er][l] -= fr[l] * uar[j][l] - fi[l] * uai[j][l];
+            ai[er][l] -= fr[l] * uai[j][l] + fi[l] * uar[j][l];
+          }
+        }
+        for (j = 0; j < n; j++) {
+          er = r + j * n;
+          for (l = 0; l < SMALL_LANE; l++) {
+            yr[er][l] -= fr[l] * uyr[j][l] - fi[l] * uyi[j][l];
+            yi[er][l] -= fr[l] * uyi[j][l] + fi[l] * uyr[j][l];
+          }
+        }
+      }
+    }
+    small_cstore(yr, yi, size, size, nb, inv->data + b * size);
+  }
+  if (singular) ASSERT(0, "This matrix is singural.\n")
+}
+
+/* LU with partial pivoting, det is product of pivots with sign of swaps.
+ * Zero pivot gives det 0. */
+void det_small(MAT* mat, MAT* d) {
+  UINT n, nb, size;
+  ITER b, c, r, j, l, ec, er;
+  DTYPE a[ELEM][SMALL_LANE], u[SMALL_MAX][SMALL_LANE], pr[SMALL_LANE],
+      pv[SMALL_LANE], f[SMALL_LANE], det[SMALL_LANE], t;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  ASSERT((mat->d0 == mat->d1), "This function requires SQUARE MATRIX.\n");
+  if (d->d0 * d->d1 * d->d2 != mat->d2) ASSERT_DIM_INVALID()
+  ASSERT(mat->d0 <= SMALL_MAX, "Too large for det_small().\n")
+  n = mat->d0;
+  size = n * n;
+
+#pragma omp parallel for schedule(static) shared(mat, d) private( \
+    b, c, r, j, l, nb, pr, a, u, pv, f, det, t, ec, er)
+  for (b = 0; b < mat->d2; b += SMALL_LANE) {
+    nb = mat->d2 - b < SMALL_LANE ? mat->d2 - b : SMALL_LANE;
+    small_load(mat->data + b * size, size, size, nb, a);
+    for (l = 0; l < SMALL_LANE; l++) det[l] = 1;
+
+    for (c = 0; c < n; c++) {
+      small_pivot(a, n, c, pr, pv);
+      small_swap(a, n, c, c, pr);
+      ec = c + c * n;
+      for (l = 0; l < SMALL_LANE; l++) {
+        t = a[ec][l];
+        det[l] *= pr[l] == c ? t : -t;
+      }
+      for (l = 0; l < SMALL_LANE; l++) {
+        t = a[ec][l];
+        f[l] = t != 0 ? 1 / t : 0;
+      }
+      for (j = c + 1; j < n; j++)
+        for (l = 0; l < SMALL_LANE; l++) u[j][l] = a[c + j * n][l];
+      for (r = c + 1; r < n; r++) {
+        er = r + c * n;
+        for (l = 0; l < SMALL_LANE; l++) pv[l] = a[er][l] * f[l];
+        for (j = c + 1; j < n; j++) {
+          er = r + j * n;
+          for (l = 0; l < SMALL_LANE; l++) a[er][l] -= pv[l] * u[j][l];
+        }
+      }
+    }
+    for (l = 0; l < nb; l++) d->data[b + l] = det[l];
+  }
+}
+
+void cdet_small(CMAT* mat, CMAT* d) {
+  UINT n, nb, size;
+  ITER b, c, r, j, l, ec, er;
+  DTYPE ar[ELEM][SMALL_LANE], ai[ELEM][SMALL_LANE], ur[SMALL_MAX][SMALL_LANE],
+      ui[SMALL_MAX][SMALL_LANE], pr[SMALL_LANE], pv[SMALL_LANE],
+      fr[SMALL_LANE], fi[SMALL_LANE], dr[SMALL_LANE], di[SMALL_LANE],
+      gr[SMALL_LANE], gi[SMALL_LANE], t, s;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  ASSERT((mat->d0 == mat->d1), "This function requires SQUARE MATRIX.\n");
+  if (d->d0 * d->d1 * d->d2 != mat->d2) ASSERT_DIM_INVALID()
+  ASSERT(mat->d0 <= SMALL_MAX, "Too large for cdet_small().\n")
+  n = mat->d0;
+  size = n * n;
+
+#pragma omp parallel for schedule(static) shared(mat, d) private( \
+    b, c, r, j, l, nb, pr, ar, ai, ur, ui, pv, fr, fi, dr, di, gr, gi, t, s, \
+    ec, er)
+  for (b = 0; b < mat->d2; b += SMALL_LANE) {
+    nb = mat->d2 - b < SMALL_LANE ? mat->d2 - b : SMALL_LANE;
+    small_cload(mat->data + b * size, size, size, nb, 0, ar, ai);
+    for (l = 0; l < SMALL_LANE; l++) {
+      dr[l] = 1;
+      di[l] = 0;
+    }
+
+    for (c = 0; c < n; c++) {
+      small_cpivot(ar, ai, n, c, pr, pv);
+      small_swap(ar, n, c, c, pr);
+      small_swap(ai, n, c, c, pr);
+      ec = c + c * n;
+      for (l = 0; l < SMALL_LANE; l++) {
+        s = 1 - 2 * (pr[l] != c);
+        t = s * (dr[l] * ar[ec][l] - di[l] * ai[ec][l]);
+        di[l] = s * (dr[l] * ai[ec][l] + di[l] * ar[ec][l]);
+        dr[l] = t;
+      }
+      for (l = 0; l < SMALL_LANE; l++) {
+        t = ar[ec][l] * ar[ec][l] + ai[ec][l] * ai[ec][l];
+        t = t != 0 ? 1 / t : 0;
+        fr[l] = ar[ec][l] * t;
+        fi[l] = -ai[ec][l] * t;
+      }
+      for (j = c + 1; j < n; j++)
+        for (l = 0; l < SMALL_LANE; l++) {
+          ur[j][l] = ar[c + j * n][l];
+          ui[j][l] = ai[c + j * n][l];
+        }
+      for (r = c + 1; r < n; r++) {
+        er = r + c * n;
+        // g = a(r,c) / a(c,c)
+        for (l = 0; l < SMALL_LANE; l++) {
+          gr[l] = ar[er][l] * fr[l] - ai[er][l] * fi[l];
+          gi[l] = ar[er][l] * fi[l] + ai[er][l] * fr[l];
+        }
+        for (j = c + 1; j < n; j++) {
+          er = r + j * n;
+          for (l = 0; l < SMALL_LANE; l++) {
+            ar[er][l] -= gr[l] * ur[j][l] - gi[l] * ui[j][l];
+            ai[er][l] -= gr[l] * ui[j][l] + gi[l] * ur[j][l];
+          }
+        }
+      }
+    }
+    for (l = 0; l < nb; l++) {
+      d->data[b + l].re = dr[l];
+      d->data[b + l].im = di[l];
+    }
+  }
+}
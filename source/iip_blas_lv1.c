@@ -10,8 +10,14 @@
  * ===========================================================
  */
 #include "iip_blas_lv1.h"
+#include "iip_matrix.h"
+#include <float.h>
 #include <math.h>
 
+#if USE_OMP
+#include <omp.h>
+#endif
+
 /*
  *
  * NTYPE == 0 -> float ->  <T> = real : s | complex : c
@@ -75,6 +81,15 @@ void omp_axpy(UINT N, DTYPE alpha, DTYPE *X, UINT INCX, DTYPE *Y, UINT INCY) {
   printf("%s\n", __func__);
 #endif
 
+  // Contiguous and aligned, as for whole MAT : vectorized without peeling.
+  if (INCX == 1 && INCY == 1 && IS_ALIGNED(X) && IS_ALIGNED(Y)) {
+    DTYPE *x = ASSUME_ALIGNED(X);
+    DTYPE *y = ASSUME_ALIGNED(Y);
+#pragma omp parallel for schedule(static) shared(x, y) private(i)
+    for (i = 0; i < N; i++) y[i] += x[i] * alpha;
+    return;
+  }
+
 #pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(X, Y) private(i)
   for (i = 0; i < N; i++) {
     Y[i * INCY] = X[i * INCX] * alpha + Y[i * INCY];
@@ -266,6 +281,458 @@ void omp_ccopy_mat(UINT N, CTYPE *src, SINT src_inc, CTYPE *des, SINT des_inc) {
   */
 }
 
+/**** axpy, copy on view ****/
+/* x is broadcast over d2 of y when x->d2 is 1.
+ * Packed columns go in one call per slice, a row(d0 = 1) in one call with
+ * increment ld1, otherwise one call per column.
+ * Transposed x is read along its rows with increment ld1, conjugated x is
+ * copied on scratch stack first. y can't be flagged. */
+static void trans_view_check(UINT d0, UINT d1, UINT d2, UINT y0, UINT y1,
+                             UINT y2) {
+  if (d1 != y0 || d0 != y1) {
+    sprintf(str_assert, " %d x %d (T) | %d x %d\n", d1, d0, y0, y1);
+    ASSERT(0, str_assert)
+  }
+  if (d2 != y2 && d2 != 1) ASSERT_DIM_INVALID()
+}
+
+void axpy_view(DTYPE alpha, MAT_VIEW *x, MAT_VIEW *y) {
+  ITER j, k;
+  UINT kx;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  ASSERT(!y->trans, "Transposed view can't be output.\n")
+  if (x->trans) {
+    trans_view_check(x->d0, x->d1, x->d2, y->d0, y->d1, y->d2);
+    for (k = 0; k < y->d2; k++) {
+      kx = x->d2 == 1 ? 0 : k;
+      for (j = 0; j < y->d1; j++)
+        axpy_inc(y->d0, alpha, &(x->data[kx * x->ld2 + j]), x->ld1,
+                 &(y->data[k * y->ld2 + j * y->ld1]), 1);
+    }
+    return;
+  }
+  ASSERT_DIM_EQUAL(x, y)
+  if (x->d2 != y->d2 && x->d2 != 1) ASSERT_DIM_INVALID()
+
+  for (k = 0; k < y->d2; k++) {
+    kx = x->d2 == 1 ? 0 : k;
+    if (x->ld1 == x->d0 && y->ld1 == y->d0)
+      axpy_inc(y->d0 * y->d1, alpha, &(x->data[kx * x->ld2]), 1,
+               &(y->data[k * y->ld2]), 1);
+    else if (y->d0 == 1)
+      axpy_inc(y->d1, alpha, &(x->data[kx * x->ld2]), x->ld1,
+               &(y->data[k * y->ld2]), y->ld1);
+    else
+      for (j = 0; j < y->d1; j++)
+        axpy_inc(y->d0, alpha, &(x->data[kx * x->ld2 + j * x->ld1]), 1,
+                 &(y->data[k * y->ld2 + j * y->ld1]), 1);
+  }
+}
+
+void axpy_cview(CTYPE alpha, CMAT_VIEW *x, CMAT_VIEW *y) {
+  ITER j, k;
+  UINT kx;
+  CMAT_VIEW t;
+  MP_MARK mark;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  ASSERT(!y->trans && !y->conj, "Transposed view can't be output.\n")
+  if (x->conj) {
+    mark = mp_mark();
+    t = mp_scratch_conj(x);
+    axpy_cview(alpha, &t, y);
+    mp_release(mark);
+    return;
+  }
+  if (x->trans) {
+    trans_view_check(x->d0, x->d1, x->d2, y->d0, y->d1, y->d2);
+    for (k = 0; k < y->d2; k++) {
+      kx = x->d2 == 1 ? 0 : k;
+      for (j = 0; j < y->d1; j++)
+        caxpy_inc(y->d0, alpha, &(x->data[kx * x->ld2 + j]), x->ld1,
+                  &(y->data[k * y->ld2 + j * y->ld1]), 1);
+    }
+    return;
+  }
+  ASSERT_DIM_EQUAL(x, y)
+  if (x->d2 != y->d2 && x->d2 != 1) ASSERT_DIM_INVALID()
+
+  for (k = 0; k < y->d2; k++) {
+    kx = x->d2 == 1 ? 0 : k;
+    if (x->ld1 == x->d0 && y->ld1 == y->d0)
+      caxpy_inc(y->d0 * y->d1, alpha, &(x->data[kx * x->ld2]), 1,
+                &(y->data[k * y->ld2]), 1);
+    else if (y->d0 == 1)
+      caxpy_inc(y->d1, alpha, &(x->data[kx * x->ld2]), x->ld1,
+                &(y->data[k * y->ld2]), y->ld1);
+    else
+      for (j = 0; j < y->d1; j++)
+        caxpy_inc(y->d0, alpha, &(x->data[kx * x->ld2 + j * x->ld1]), 1,
+                  &(y->data[k * y->ld2 + j * y->ld1]), 1);
+  }
+}
+
+void copy_view(MAT_VIEW *src, MAT_VIEW *des) {
+  ITER j, k;
+  UINT ks;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  ASSERT(!des->trans, "Transposed view can't be output.\n")
+  if (src->trans) {
+    trans_view_check(src->d0, src->d1, src->d2, des->d0, des->d1, des->d2);
+    for (k = 0; k < des->d2; k++) {
+      ks = src->d2 == 1 ? 0 : k;
+      for (j = 0; j < des->d1; j++)
+        copy_mat_inc(des->d0, &(src->data[ks * src->ld2 + j]), src->ld1,
+                     &(des->data[k * des->ld2 + j * des->ld1]), 1);
+    }
+    return;
+  }
+  ASSERT_DIM_EQUAL(src, des)
+  if (src->d2 != des->d2 && src->d2 != 1) ASSERT_DIM_INVALID()
+
+  for (k = 0; k < des->d2; k++) {
+    ks = src->d2 == 1 ? 0 : k;
+    if (src->ld1 == src->d0 && des->ld1 == des->d0)
+      copy_mat_inc(des->d0 * des->d1, &(src->data[ks * src->ld2]), 1,
+                   &(des->data[k * des->ld2]), 1);
+    else if (des->d0 == 1)
+      copy_mat_inc(des->d1, &(src->data[ks * src->ld2]), src->ld1,
+                   &(des->data[k * des->ld2]), des->ld1);
+    else
+      for (j = 0; j < des->d1; j++)
+        copy_mat_inc(des->d0, &(src->data[ks * src->ld2 + j * src->ld1]), 1,
+                     &(des->data[k * des->ld2 + j * des->ld1]), 1);
+  }
+}
+
+void ccopy_view(CMAT_VIEW *src, CMAT_VIEW *des) {
+  ITER j, k;
+  UINT ks;
+  CMAT_VIEW t;
+  MP_MARK mark;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  ASSERT(!des->trans && !des->conj, "Transposed view can't be output.\n")
+  if (src->conj) {
+    mark = mp_mark();
+    t = mp_scratch_conj(src);
+    ccopy_view(&t, des);
+    mp_release(mark);
+    return;
+  }
+  if (src->trans) {
+    trans_view_check(src->d0, src->d1, src->d2, des->d0, des->d1, des->d2);
+    for (k = 0; k < des->d2; k++) {
+      ks = src->d2 == 1 ? 0 : k;
+      for (j = 0; j < des->d1; j++)
+        ccopy_mat_inc(des->d0, &(src->data[ks * src->ld2 + j]), src->ld1,
+                      &(des->data[k * des->ld2 + j * des->ld1]), 1);
+    }
+    return;
+  }
+  ASSERT_DIM_EQUAL(src, des)
+  if (src->d2 != des->d2 && src->d2 != 1) ASSERT_DIM_INVALID()
+
+  for (k = 0; k < des->d2; k++) {
+    ks = src->d2 == 1 ? 0 : k;
+    if (src->ld1 == src->d0 && des->ld1 == des->d0)
+      ccopy_mat_inc(des->d0 * des->d1, &(src->data[ks * src->ld2]), 1,
+                    &(des->data[k * des->ld2]), 1);
+    else if (des->d0 == 1)
+      ccopy_mat_inc(des->d1, &(src->data[ks * src->ld2]), src->ld1,
+                    &(des->data[k * des->ld2]), des->ld1);
+    else
+      for (j = 0; j < des->d1; j++)
+        ccopy_mat_inc(des->d0, &(src->data[ks * src->ld2 + j * src->ld1]), 1,
+                      &(des->data[k * des->ld2 + j * des->ld1]), 1);
+  }
+}
+
+/* axpy and copy on d0 x d1 blocks at data + off, columns ld apart.
+ * A vector of increment inc is a block of 1 x n with ld = inc. */
+void axpy_mat_ld(UINT d0, UINT d1, DTYPE alpha, MAT *x, UINT offx, UINT ldx,
+                 MAT *y, UINT offy, UINT ldy) {
+  MAT_VIEW vx, vy;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  vx = ld_view(x, offx, d0, d1, ldx);
+  vy = ld_view(y, offy, d0, d1, ldy);
+  axpy_view(alpha, &vx, &vy);
+}
+
+void axpy_cmat_ld(UINT d0, UINT d1, CTYPE alpha, CMAT *x, UINT offx,
+                  UINT ldx, CMAT *y, UINT offy, UINT ldy) {
+  CMAT_VIEW vx, vy;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  vx = ld_cview(x, offx, d0, d1, ldx);
+  vy = ld_cview(y, offy, d0, d1, ldy);
+  axpy_cview(alpha, &vx, &vy);
+}
+
+void copy_mat_ld(UINT d0, UINT d1, MAT *src, UINT offs, UINT lds, MAT *des,
+                 UINT offd, UINT ldd) {
+  MAT_VIEW vs, vd;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  vs = ld_view(src, offs, d0, d1, lds);
+  vd = ld_view(des, offd, d0, d1, ldd);
+  copy_view(&vs, &vd);
+}
+
+void ccopy_mat_ld(UINT d0, UINT d1, CMAT *src, UINT offs, UINT lds,
+                  CMAT *des, UINT offd, UINT ldd) {
+  CMAT_VIEW vs, vd;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  vs = ld_cview(src, offs, d0, d1, lds);
+  vd = ld_cview(des, offd, d0, d1, ldd);
+  ccopy_view(&vs, &vd);
+}
+
+/**** reduction ****/
+/* Non-BLAS reductions share red_run(). A leaf reduces up to REDUCE_BLOCK
+ * elements into s[0], s[1] with REDUCE_ACC accumulators, so that the loop
+ * is not bound to one add chain and vectorizes. Leaves are added
+ * pairwise, error grows with log(N) instead of N. Threads take contiguous
+ * ranges and add their partials in reduction clause.
+ * x and y step incx, incy elements of xw, yw DTYPEs. */
+typedef void (*RED_LEAF)(UINT n, DTYPE *x, ITER incx, DTYPE *y, ITER incy,
+                         DTYPE alpha, DTYPE *s);
+
+/* a0[] += E0 (and a1[] += E1) for k in [0, n), then s[] = sum of a?[]. */
+#define RED_ACC(n, E0)                                   \
+  {                                                      \
+    ITER i, j, k;                                        \
+    DTYPE a0[REDUCE_ACC];                                \
+    for (j = 0; j < REDUCE_ACC; j++) a0[j] = 0;          \
+    for (i = 0; i + REDUCE_ACC <= n; i += REDUCE_ACC)    \
+      for (j = 0; j < REDUCE_ACC; j++) {                 \
+        k = i + j;                                       \
+        a0[j] += E0;                                     \
+      }                                                  \
+    for (j = 0; i < n; i++, j++) {                       \
+      k = i;                                             \
+      a0[j] += E0;                                       \
+    }                                                    \
+    for (j = REDUCE_ACC / 2; j > 0; j /= 2)              \
+      for (i = 0; i < j; i++) a0[i] += a0[i + j];        \
+    s[0] = a0[0];                                        \
+  }
+
+#define RED_ACC2(n, E0, E1)                              \
+  {                                                      \
+    ITER i, j, k;                                        \
+    DTYPE a0[REDUCE_ACC], a1[REDUCE_ACC];                \
+    for (j = 0; j < REDUCE_ACC; j++) a0[j] = a1[j] = 0;  \
+    for (i = 0; i + REDUCE_ACC <= n; i += REDUCE_ACC)    \
+      for (j = 0; j < REDUCE_ACC; j++) {                 \
+        k = i + j;                                       \
+        a0[j] += E0;                                     \
+        a1[j] += E1;                                     \
+      }                                                  \
+    for (j = 0; i < n; i++, j++) {                       \
+      k = i;                                             \
+      a0[j] += E0;                                       \
+      a1[j] += E1;                                       \
+    }                                                    \
+    for (j = REDUCE_ACC / 2; j > 0; j /= 2)              \
+      for (i = 0; i < j; i++) {                          \
+        a0[i] += a0[i + j];                              \
+        a1[i] += a1[i + j];                              \
+      }                                                  \
+    s[0] = a0[0];                                        \
+    s[1] = a1[0];                                        \
+  }
+
+static void red_dot(UINT n, DTYPE *x, ITER incx, DTYPE *y, ITER incy,
+                    DTYPE alpha, DTYPE *s) {
+  if (incx == 1 && incy == 1)
+    RED_ACC(n, x[k] * y[k])
+  else
+    RED_ACC(n, x[k * incx] * y[k * incy])
+}
+
+static void red_asum(UINT n, DTYPE *x, ITER incx, DTYPE *y, ITER incy,
+                     DTYPE alpha, DTYPE *s) {
+  if (incx == 1)
+    RED_ACC(n, fabs(x[k]))
+  else
+    RED_ACC(n, fabs(x[k * incx]))
+}
+
+/* sum of (alpha * x)^2, alpha scales nrm2 away from overflow. */
+static void red_sq(UINT n, DTYPE *x, ITER incx, DTYPE *y, ITER incy,
+                   DTYPE alpha, DTYPE *s) {
+  if (incx == 1)
+    RED_ACC(n, (alpha * x[k]) * (alpha * x[k]))
+  else
+    RED_ACC(n, (alpha * x[k * incx]) * (alpha * x[k * incx]))
+}
+
+/* x is CTYPE from here, one element is x[2k], x[2k + 1]. */
+static void red_casum(UINT n, DTYPE *x, ITER incx, DTYPE *y, ITER incy,
+                      DTYPE alpha, DTYPE *s) {
+  RED_ACC(n, fabs(x[2 * k * incx]) + fabs(x[2 * k * incx + 1]))
+}
+
+static void red_csq(UINT n, DTYPE *x, ITER incx, DTYPE *y, ITER incy,
+                    DTYPE alpha, DTYPE *s) {
+  RED_ACC(n, (alpha * x[2 * k * incx]) * (alpha * x[2 * k * incx]) +
+                 (alpha * x[2 * k * incx + 1]) * (alpha * x[2 * k * incx + 1]))
+}
+
+/* complex x, real y */
+static void red_cdot(UINT n, DTYPE *x, ITER incx, DTYPE *y, ITER incy,
+                     DTYPE alpha, DTYPE *s) {
+  if (incx == 1 && incy == 1)
+    RED_ACC2(n, x[2 * k] * y[k], x[2 * k + 1] * y[k])
+  else
+    RED_ACC2(n, x[2 * k * incx] * y[k * incy],
+             x[2 * k * incx + 1] * y[k * incy])
+}
+
+/* complex x, complex y */
+static void red_udot(UINT n, DTYPE *x, ITER incx, DTYPE *y, ITER incy,
+                     DTYPE alpha, DTYPE *s) {
+  if (incx == 1 && incy == 1)
+    RED_ACC2(n, x[2 * k] * y[2 * k] - x[2 * k + 1] * y[2 * k + 1],
+             x[2 * k] * y[2 * k + 1] + x[2 * k + 1] * y[2 * k])
+  else
+    RED_ACC2(n,
+             x[2 * k * incx] * y[2 * k * incy] -
+                 x[2 * k * incx + 1] * y[2 * k * incy + 1],
+             x[2 * k * incx] * y[2 * k * incy + 1] +
+                 x[2 * k * incx + 1] * y[2 * k * incy])
+}
+
+static void red_pair(RED_LEAF f, UINT n, DTYPE *x, ITER incx, UINT xw,
+                     DTYPE *y, ITER incy, UINT yw, DTYPE alpha, DTYPE *s) {
+  UINT h;
+  DTYPE t[2] = {0, 0};
+  if (n <= REDUCE_BLOCK) {
+    s[0] = s[1] = 0;
+    f(n, x, incx, y, incy, alpha, s);
+    return;
+  }
+  // first half takes whole leaves
+  h = (n / 2 + REDUCE_BLOCK - 1) / REDUCE_BLOCK * REDUCE_BLOCK;
+  red_pair(f, h, x, incx, xw, y, incy, yw, alpha, s);
+  red_pair(f, n - h, x + h * incx * xw, incx, xw,
+           y ? y + h * incy * yw : NULL, incy, yw, alpha, t);
+  s[0] += t[0];
+  s[1] += t[1];
+}
+
+static void red_run(RED_LEAF f, UINT N, DTYPE *x, ITER incx, UINT xw,
+                    DTYPE *y, ITER incy, UINT yw, DTYPE alpha, DTYPE *s) {
+#if USE_OMP
+  DTYPE s0 = 0, s1 = 0;
+  if (N >= REDUCE_OMP_MIN && omp_get_max_threads() > 1 && !omp_in_parallel()) {
+#pragma omp parallel shared(f, N, x, incx, xw, y, incy, yw, alpha) \
+    reduction(+ : s0, s1)
+    {
+      UINT nb = (N + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+      UINT t = omp_get_thread_num(), nt = omp_get_num_threads();
+      UINT b0 = (UINT)((unsigned long long)nb * t / nt) * REDUCE_BLOCK;
+      UINT b1 = (UINT)((unsigned long long)nb * (t + 1) / nt) * REDUCE_BLOCK;
+      DTYPE p[2];
+      if (b1 > N) b1 = N;
+      if (b1 > b0) {
+        red_pair(f, b1 - b0, x + b0 * incx * xw, incx, xw,
+                 y ? y + b0 * incy * yw : NULL, incy, yw, alpha, p);
+        s0 += p[0];
+        s1 += p[1];
+      }
+    }
+    s[0] = s0;
+    s[1] = s1;
+    return;
+  }
+#endif
+  red_pair(f, N, x, incx, xw, y, incy, yw, alpha, s);
+}
+
+/* Index of max or min |x| (|re| + |im| for complex), first one on ties.
+ * A pass finds the value and the leaf holding it, then only that leaf is
+ * searched for the index. */
+#define RED_ABS(x, i, incx, xw)                   \
+  ((xw) == 1 ? fabs((x)[(i) * (incx)])            \
+             : fabs((x)[2 * (i) * (incx)]) + fabs((x)[2 * (i) * (incx) + 1]))
+
+static DTYPE red_absmax(UINT n, DTYPE *x, ITER incx, UINT xw, int is_max) {
+  ITER i, j;
+  DTYPE a[REDUCE_ACC], t, u;
+  for (j = 0; j < REDUCE_ACC; j++) a[j] = is_max ? 0 : HUGE_VAL;
+  i = 0;
+  // one select per loop, so that it vectorizes
+  if (xw == 1 && incx == 1) {
+    if (is_max)
+      for (; i + REDUCE_ACC <= n; i += REDUCE_ACC)
+        for (j = 0; j < REDUCE_ACC; j++) {
+          t = fabs(x[i + j]);
+          u = a[j];
+          a[j] = t > u ? t : u;
+        }
+    else
+      for (; i + REDUCE_ACC <= n; i += REDUCE_ACC)
+        for (j = 0; j < REDUCE_ACC; j++) {
+          t = fabs(x[i + j]);
+          u = a[j];
+          a[j] = t < u ? t : u;
+        }
+  }
+  for (j = 0; i < n; i++, j = (j + 1) % REDUCE_ACC) {
+    t = RED_ABS(x, i, incx, xw);
+    if (is_max ? t > a[j] : t < a[j]) a[j] = t;
+  }
+  t = a[0];
+  for (j = 1; j < REDUCE_ACC; j++)
+    if (is_max ? a[j] > t : a[j] < t) t = a[j];
+  return t;
+}
+
+static UINT red_arg(UINT N, DTYPE *x, ITER incx, UINT xw, int is_max) {
+  ITER i;
+  UINT n, bi = 0;
+  DTYPE bv = is_max ? -1 : HUGE_VAL;
+
+#pragma omp parallel if (N >= REDUCE_OMP_MIN) shared(x, bi, bv)
+  {
+    ITER j;
+    UINT m, ti = 0;
+    DTYPE v, tv = is_max ? -1 : HUGE_VAL;
+#pragma omp for schedule(static)
+    for (j = 0; j < N; j += REDUCE_BLOCK) {
+      m = N - j < REDUCE_BLOCK ? N - j : REDUCE_BLOCK;
+      v = red_absmax(m, x + j * incx * xw, incx, xw, is_max);
+      if (is_max ? v > tv : v < tv) {
+        tv = v;
+        ti = j;
+      }
+    }
+#pragma omp critical(red_arg)
+    if ((is_max ? tv > bv : tv < bv) || (tv == bv && ti < bi)) {
+      bv = tv;
+      bi = ti;
+    }
+  }
+  n = N - bi < REDUCE_BLOCK ? N - bi : REDUCE_BLOCK;
+  for (i = bi; i < bi + n; i++)
+    if (RED_ABS(x, i, incx, xw) == bv) return i;
+  return bi;
+}
+
 /* get sum of every element in matrix */
 
 /*** Get sum of the magnitudes of elements of a vector ***/
@@ -287,8 +754,7 @@ DTYPE asum_mat(MAT *mat, UINT inc) {
 
 // DTYPE = double
 #elif NTYPE == 1
-  cblas_dasum(mat_size, mat->data, inc);
-  return 1;
+  return cblas_dasum(mat_size, mat->data, inc);
 #endif
 
 // USE_BLAS = 0 -> just c implement
@@ -297,14 +763,9 @@ DTYPE asum_mat(MAT *mat, UINT inc) {
 #endif
 }
 DTYPE omp_asum(UINT N, DTYPE *data, UINT inc) {
-  ITER i = 0;
-  DTYPE sum = 0;
-
-  for (i = 0; i < N; i++) {
-    sum += (data[i * inc] < 0 ? (-data[i * inc]) : data[i * inc]);
-  }
-
-  return sum;
+  DTYPE s[2];
+  red_run(red_asum, N, data, inc, 1, NULL, 0, 0, 1, s);
+  return s[0];
 }
 
 DTYPE asum_cmat(CMAT *mat, UINT inc) {
@@ -335,15 +796,13 @@ DTYPE asum_cmat(CMAT *mat, UINT inc) {
 }
 
 DTYPE omp_casum(UINT N, CTYPE *data, UINT inc) {
-  ITER i = 0;
-  DTYPE sum = 0;
-
-  for (i = 0; i < N; i++) {
-    sum += (data[i * inc].re < 0 ? (-data[i * inc].re) : data[i * inc].re);
-    sum += (data[i * inc].im < 0 ? (-data[i * inc].im) : data[i * inc].im);
-  }
-
-  return sum;
+  DTYPE s[2];
+  // contiguous re, im is a real vector of 2N
+  if (inc == 1)
+    red_run(red_asum, 2 * N, (DTYPE *)data, 1, 1, NULL, 0, 0, 1, s);
+  else
+    red_run(red_casum, N, (DTYPE *)data, inc, 2, NULL, 0, 0, 1, s);
+  return s[0];
 }
 
 /*** Get a vector-vector dot product ***/
@@ -378,15 +837,9 @@ ASSERT(N, "size is 0.\n");
 }
 
 DTYPE omp_dot(UINT N, DTYPE *src_x, ITER x_inc, DTYPE *src_y, ITER y_inc) {
-  ITER i = 0;
-  DTYPE dot = 0;
-
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(src_x, src_y) private(i)
-  for (i = 0; i < N; i++) {
-    dot += src_x[i * x_inc] * src_y[i * y_inc];
-  }
-
-  return dot;
+  DTYPE s[2];
+  red_run(red_dot, N, src_x, x_inc, 1, src_y, y_inc, 1, 1, s);
+  return s[0];
 }
 
 /* (complex vector)-(real vector) dot product. */
@@ -429,18 +882,11 @@ ASSERT(N, "size is 0.\n");
 }
 
 CTYPE omp_cdot(UINT N, CTYPE *src_x, ITER x_inc, DTYPE *src_y, ITER y_inc) {
-  ITER i = 0;
+  DTYPE s[2];
   CTYPE dot;
-
-  dot.re = 0;
-  dot.im = 0;
-
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(src_x, src_y) private(i)
-  for (i = 0; i < N; i++) {
-    dot.re += src_x[i * x_inc].re * src_y[i * y_inc];
-    dot.im += src_x[i * x_inc].im * src_y[i * y_inc];
-  }
-
+  red_run(red_cdot, N, (DTYPE *)src_x, x_inc, 2, src_y, y_inc, 1, 1, s);
+  dot.re = s[0];
+  dot.im = s[1];
   return dot;
 }
 
@@ -486,20 +932,12 @@ ASSERT(N, "size is 0.\n");
 }
 
 CTYPE omp_udot(UINT N, CTYPE *src_x, ITER x_inc, CTYPE *src_y, ITER y_inc) {
-  ITER i = 0;
+  DTYPE s[2];
   CTYPE dot;
-
-  dot.re = 0;
-  dot.im = 0;
-
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(src_x, src_y) private(i)
-  for (i = 0; i < N; i++) {
-    dot.re += src_x[i * x_inc].re * src_y[i * y_inc].re;
-    dot.im += src_x[i * x_inc].re * src_y[i * y_inc].im;
-    dot.re -= src_x[i * x_inc].im * src_y[i * y_inc].im;
-    dot.im += src_x[i * x_inc].im * src_y[i * y_inc].re;
-  }
-
+  red_run(red_udot, N, (DTYPE *)src_x, x_inc, 2, (DTYPE *)src_y, y_inc, 2, 1,
+          s);
+  dot.re = s[0];
+  dot.im = s[1];
   return dot;
 }
 
@@ -635,19 +1073,17 @@ UINT amax_inc(MAT *src, UINT inc) {
 
   if (mat_size == 0) {
     printf("Wrong MAT size!\n");
-    return;
+    return 0;
   }
 
 #if USE_CBLAS
 // DTYPE = float
 #if NTYPE == 0
-  cblas_isamax(mat_size, src->data, inc);
-  return;
+  return cblas_isamax(mat_size, src->data, inc);
 
 // DTYPE = double
 #elif NTYPE == 1
-  cblas_idamax(mat_size, src->data, inc);
-  return;
+  return cblas_idamax(mat_size, src->data, inc);
 #endif
 
 // USE_BLAS = 0 -> just c implement
@@ -656,19 +1092,7 @@ UINT amax_inc(MAT *src, UINT inc) {
 #endif
 }
 UINT omp_amax(UINT N, DTYPE *src, UINT inc) {
-  ITER i = 0;
-  UINT idx = 0;
-  DTYPE max = src[0];
-
-  //#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(src_x, src_y) private(i)
-  for (i = 1; i < N; i++) {
-    if (max < (src[i * inc] < 0 ? -src[i * inc] : src[i * inc])) {
-      idx = i;
-      max = (src[i * inc] < 0 ? -src[i * inc] : src[i * inc]);
-    }
-  }
-
-  return idx;
+  return red_arg(N, src, inc, 1, 1);
 }
 
 UINT temp_amax_cmat(CMAT *src) { return camax_inc(src, 1); }
@@ -680,19 +1104,17 @@ UINT camax_inc(CMAT *src, UINT inc) {
 
   if (mat_size == 0) {
     printf("Wrong MAT size!\n");
-    return;
+    return 0;
   }
 
 #if USE_CBLAS
 // DTYPE = float
 #if NTYPE == 0
-  cblas_icamax(mat_size, src->data, inc);
-  return;
+  return cblas_icamax(mat_size, src->data, inc);
 
 // DTYPE = double
 #elif NTYPE == 1
-  cblas_izamax(mat_size, src->data, inc);
-  return;
+  return cblas_izamax(mat_size, src->data, inc);
 #endif
 // USE_BLAS = 0 -> just c implement
 #else
@@ -700,19 +1122,7 @@ UINT camax_inc(CMAT *src, UINT inc) {
 #endif
 }
 UINT omp_camax(UINT N, CTYPE *src, UINT inc) {
-  ITER i = 0;
-  UINT idx = 0;
-  DTYPE max = ABS_CTYPE(src[0]);
-
-  //#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(src_x, src_y) private(i)
-  for (i = 1; i < N; i++) {
-    if (max < ABS_CTYPE(src[i])) {
-      idx = i;
-      max = ABS_CTYPE(src[i]);
-    }
-  }
-
-  return idx;
+  return red_arg(N, (DTYPE *)src, inc, 2, 1);
 }
 
 /*** Finds MIN_ABS_VALUE_ELEMENT's index ***/
@@ -725,7 +1135,7 @@ UINT amin_inc(MAT *src, UINT inc) {
 
   if (mat_size == 0) {
     printf("Wrong MAT size!\n");
-    return;
+    return 0;
   }
 
 #if USE_CBLAS
@@ -748,19 +1158,7 @@ UINT amin_inc(MAT *src, UINT inc) {
 #endif
 }
 UINT omp_amin(UINT N, DTYPE *src, UINT inc) {
-  ITER i = 0;
-  UINT idx = 0;
-  DTYPE min = src[0];
-
-  //#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(src_x, src_y) private(i)
-  for (i = 1; i < N; i++) {
-    if (min > (src[i * inc] < 0 ? -src[i * inc] : src[i * inc])) {
-      idx = i;
-      min = (src[i * inc] < 0 ? -src[i * inc] : src[i * inc]);
-    }
-  }
-
-  return idx;
+  return red_arg(N, src, inc, 1, 0);
 }
 
 UINT temp_amin_cmat(CMAT *src) { return camin_inc(src, 1); }
@@ -772,7 +1170,7 @@ UINT camin_inc(CMAT *src, UINT inc) {
 
   if (mat_size == 0) {
     printf("Wrong MAT size!\n");
-    return;
+    return 0;
   }
 
 #if USE_CBLAS
@@ -795,19 +1193,7 @@ UINT camin_inc(CMAT *src, UINT inc) {
 #endif
 }
 UINT omp_camin(UINT N, CTYPE *src, UINT inc) {
-  ITER i = 0;
-  UINT idx = 0;
-  DTYPE min = ABS_CTYPE(src[0]);
-
-  //#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(src_x, src_y) private(i)
-  for (i = 1; i < N; i++) {
-    if (min > ABS_CTYPE(src[i])) {
-      idx = i;
-      min = ABS_CTYPE(src[i]);
-    }
-  }
-
-  return idx;
+  return red_arg(N, (DTYPE *)src, inc, 2, 0);
 }
 
 /*** Get absolute value of complex number ***/
@@ -822,19 +1208,17 @@ DTYPE nrm2_inc(MAT *src, UINT inc) {
 
   if (mat_size == 0) {
     printf("Wrong MAT size!\n");
-    return;
+    return 0;
   }
 
 #if USE_CBLAS
 // DTYPE = float
 #if NTYPE == 0
-  cblas_snrm2(mat_size, src->data, inc);
-  return;
+  return cblas_snrm2(mat_size, src->data, inc);
 
 // DTYPE = double
 #elif NTYPE == 1
-  cblas_dnrm2(mat_size, src->data, inc);
-  return;
+  return cblas_dnrm2(mat_size, src->data, inc);
 #endif
 
 // USE_BLAS = 0 -> just c implement
@@ -842,15 +1226,32 @@ DTYPE nrm2_inc(MAT *src, UINT inc) {
   return omp_nrm2(mat_size, src->data, inc);
 #endif
 }
-DTYPE omp_nrm2(UINT N, DTYPE *data, UINT inc) {
-  ITER i = 0;
-  DTYPE temp = 0;
+/* Squares overflow or underflow far before the norm does. In that case
+ * sum again scaled by 1 / max|x|, which is exact in power of 2. */
+#if NTYPE == 0
+#define NRM2_BIG FLT_MAX
+#define NRM2_SMALL FLT_MIN
+#elif NTYPE == 1
+#define NRM2_BIG DBL_MAX
+#define NRM2_SMALL DBL_MIN
+#endif
 
-  for (i = 0; i < N; i++) {
-    temp += data[i] * data[i];
-  }
+static DTYPE red_nrm2(RED_LEAF f, UINT N, DTYPE *data, UINT inc, UINT xw) {
+  DTYPE s[2], m;
+  int e;
+  red_run(f, N, data, inc, xw, NULL, 0, 0, 1, s);
+  if (s[0] != s[0]) return s[0];
+  if (s[0] <= NRM2_BIG && s[0] >= NRM2_SMALL) return sqrt(s[0]);
+  m = RED_ABS(data, red_arg(N, data, inc, xw, 1), inc, xw);
+  if (m == 0 || m > NRM2_BIG) return m;
+  frexp(m, &e);
+  m = ldexp(1, -e);
+  red_run(f, N, data, inc, xw, NULL, 0, 0, m, s);
+  return sqrt(s[0]) / m;
+}
 
-  return 0;  // sqrt(temp);
+DTYPE omp_nrm2(UINT N, DTYPE *data, UINT inc) {
+  return red_nrm2(red_sq, N, data, inc, 1);
 }
 
 DTYPE nrm2_cmat(CMAT *src) { return cnrm2_inc(src, 1); }
@@ -862,19 +1263,17 @@ DTYPE cnrm2_inc(CMAT *src, UINT inc) {
 
   if (mat_size == 0) {
     printf("Wrong MAT size!\n");
-    return;
+    return 0;
   }
 
 #if USE_CBLAS
 // DTYPE = float
 #if NTYPE == 0
-  cblas_snrm2(mat_size, src->data, inc);
-  return;
+  return cblas_scnrm2(mat_size, src->data, inc);
 
 // DTYPE = double
 #elif NTYPE == 1
-  cblas_dnrm2(mat_size, src->data, inc);
-  return;
+  return cblas_dznrm2(mat_size, src->data, inc);
 #endif
 
 // USE_BLAS = 0 -> just c implement
@@ -883,14 +1282,8 @@ DTYPE cnrm2_inc(CMAT *src, UINT inc) {
 #endif
 }
 DTYPE omp_cnrm2(UINT N, CTYPE *data, UINT inc) {
-  ITER i = 0;
-  DTYPE temp = 0;
-
-  for (i = 0; i < N; i++) {
-    temp += ABS_CTYPE(data[i]) * ABS_CTYPE(data[i]);
-  }
-
-  return sqrt(temp);
+  if (inc == 1) return red_nrm2(red_sq, 2 * N, (DTYPE *)data, 1, 1);
+  return red_nrm2(red_csq, N, (DTYPE *)data, inc, 2);
 }
 
 /*** Performs rotation of points in the plane. ***/
@@ -1016,6 +1409,13 @@ void scal_inc(UINT size, DTYPE alpha, DTYPE *X, UINT incx) {
 void omp_scal(UINT size, DTYPE alpha, DTYPE *X, UINT incx) {
   ITER i;
 
+  if (incx == 1 && IS_ALIGNED(X)) {
+    DTYPE *x = ASSUME_ALIGNED(X);
+#pragma omp parallel for schedule(static) shared(x) private(i)
+    for (i = 0; i < size; i++) x[i] *= alpha;
+    return;
+  }
+
 #pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(X) private(i)
   for (i = 0; i < size * incx; i += incx) {
     X[i] *= alpha;
@@ -1085,6 +1485,26 @@ void omp_uscal(UINT size, CTYPE alpha, CTYPE *X, UINT incx) {
   }
 }
 
+/* planes are multiplied without shuffles of re and im */
+void pscal_pcmat(CTYPE alpha, PCMAT *mat) {
+  ITER i;
+  UINT size;
+  DTYPE *re, *im;
+  DTYPE temp;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  size = mat->d0 * mat->d1 * mat->d2;
+  re = mat->re;
+  im = mat->im;
+#pragma omp parallel for schedule(static) shared(re, im, alpha) private(i, temp)
+  for (i = 0; i < size; i++) {
+    temp = re[i] * alpha.re - im[i] * alpha.im;
+    im[i] = re[i] * alpha.im + im[i] * alpha.re;
+    re[i] = temp;
+  }
+}
+
 /** column scaling **/
 void col_scal(DTYPE alpha, MAT *X, UINT idx) {
   ITER i;
@@ -1296,3 +1716,132 @@ void omp_crotg(CTYPE *a, CTYPE *b, DTYPE *c, CTYPE *s) {
   (*a) = r_;
   (*b) = z_;
 }
+
+/**** axpy, scal of TMAT ****/
+/* size of a slice of y and the number of slices, x of d2 = 1 is broadcast */
+static UINT taxpy_dims(TMAT *x, TMAT *y, UINT *size) {
+  ASSERT(x->dtype == y->dtype, "dtype must be equal.\n")
+  if (x->d0 != y->d0 || x->d1 != y->d1) ASSERT_DIM_INVALID()
+  if (x->d2 == y->d2) {
+    *size = x->d0 * x->d1 * x->d2;
+    return 1;
+  }
+  if (x->d2 != 1) ASSERT_DIM_INVALID()
+  *size = x->d0 * x->d1;
+  return y->d2;
+}
+
+void axpy_tmat(double alpha, TMAT *x, TMAT *y) {
+  UINT size, nb;
+  ITER i, k;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  nb = taxpy_dims(x, y, &size);
+  for (k = 0; k < nb; k++) {
+    if (x->dtype == DT_NATIVE)
+      axpy_inc(size, alpha, (DTYPE *)x->data, 1, (DTYPE *)y->data + k * size,
+               1);
+#if NTYPE == 1
+    else if (x->dtype == DT_S) {
+      float a = (float)alpha, *X = (float *)x->data,
+            *Y = (float *)y->data + k * size;
+#if USE_CBLAS
+      cblas_saxpy(size, a, X, 1, Y, 1);
+#else
+#pragma omp parallel for schedule(static) shared(X, Y) private(i)
+      for (i = 0; i < size; i++) Y[i] += a * X[i];
+#endif
+    }
+#else
+    else if (x->dtype == DT_D) {
+      double *X = (double *)x->data, *Y = (double *)y->data + k * size;
+#if USE_CBLAS
+      cblas_daxpy(size, alpha, X, 1, Y, 1);
+#else
+#pragma omp parallel for schedule(static) shared(X, Y) private(i)
+      for (i = 0; i < size; i++) Y[i] += alpha * X[i];
+#endif
+    }
+#endif
+    else
+      ASSERT(0, "Use caxpy_tmat() for complex.\n")
+  }
+}
+
+void caxpy_tmat(CTYPE_D alpha, TMAT *x, TMAT *y) {
+  UINT size, nb;
+  ITER i, k;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  nb = taxpy_dims(x, y, &size);
+  for (k = 0; k < nb; k++) {
+    if (x->dtype == DT_CNATIVE) {
+      CTYPE a;
+      a.re = alpha.re;
+      a.im = alpha.im;
+      caxpy_inc(size, a, (CTYPE *)x->data, 1, (CTYPE *)y->data + k * size, 1);
+    }
+#if NTYPE == 1
+    else if (x->dtype == DT_C) {
+      CTYPE_S a, *X = (CTYPE_S *)x->data, *Y = (CTYPE_S *)y->data + k * size;
+      a.re = (float)alpha.re;
+      a.im = (float)alpha.im;
+#if USE_CBLAS
+      cblas_caxpy(size, &a, X, 1, Y, 1);
+#else
+#pragma omp parallel for schedule(static) shared(X, Y, a) private(i)
+      for (i = 0; i < size; i++) CXADD_mul(Y[i], a, X[i])
+#endif
+    }
+#else
+    else if (x->dtype == DT_Z) {
+      CTYPE_D *X = (CTYPE_D *)x->data, *Y = (CTYPE_D *)y->data + k * size;
+#if USE_CBLAS
+      cblas_zaxpy(size, &alpha, X, 1, Y, 1);
+#else
+#pragma omp parallel for schedule(static) shared(X, Y, alpha) private(i)
+      for (i = 0; i < size; i++) CXADD_mul(Y[i], alpha, X[i])
+#endif
+    }
+#endif
+    else
+      ASSERT(0, "Use axpy_tmat() for real.\n")
+  }
+}
+
+/* mat *= alpha, real or complex */
+void scal_tmat(double alpha, TMAT *mat) {
+  UINT size;
+  ITER i;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  size = mat->d0 * mat->d1 * mat->d2;
+  if (mat->dtype == DT_NATIVE)
+    scal_inc(size, alpha, (DTYPE *)mat->data, 1);
+  else if (mat->dtype == DT_CNATIVE)
+    cscal_inc(size, alpha, (CTYPE *)mat->data, 1);
+  else {
+    // complex of other precision is scaled as pairs of real
+    if (mat->dtype == DT_C || mat->dtype == DT_Z) size *= 2;
+#if NTYPE == 1
+    float a = (float)alpha, *X = (float *)mat->data;
+#if USE_CBLAS
+    cblas_sscal(size, a, X, 1);
+#else
+#pragma omp parallel for schedule(static) shared(X) private(i)
+    for (i = 0; i < size; i++) X[i] *= a;
+#endif
+#else
+    double *X = (double *)mat->data;
+#if USE_CBLAS
+    cblas_dscal(size, alpha, X, 1);
+#else
+#pragma omp parallel for schedule(static) shared(X) private(i)
+    for (i = 0; i < size; i++) X[i] *= alpha;
+#endif
+#endif
+  }
+}
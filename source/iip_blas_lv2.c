@@ -10,6 +10,13 @@
  * ===========================================================
  */
 #include "iip_blas_lv2.h"
+#include "iip_backend.h"
+#include "iip_blas_lv3.h"
+#include "iip_matrix.h"
+
+#if USE_OMP
+#include <omp.h>
+#endif
 
 /****  gemv ****/
 
@@ -29,60 +36,171 @@ void gemv_mat(char transA, DTYPE alpha, MAT *A, MAT *X, DTYPE beta, MAT *Y) {
     return;
   }
 
+  /* Column-major d0 x d1 is row-major d1 x d0, so that
+   * NoTran : Y(d1) = A^T * X(d0),  Tran : Y(d0) = A * X(d1). */
   m = A->d1;
   n = A->d0;
-  lda = m;
+  lda = n;
 
 #if DEBUG
   printf("trans : %d m : %u n: %u lda : %u\nalpha : %lf beta : %lf\n", transA,
          m, n, lda, alpha, beta);
 #endif
 
-#if USE_CBLAS
-#if NTYPE == 0
-  cblas_sgemv(CblasColMajor, transA, m, n, alpha, A->data, lda, X->data, 1,
-              beta, Y->data, 1);
-#else
-  cblas_dgemv(CblasColMajor, transA, m, n, alpha, A->data, lda, X->data, 1,
-              beta, Y->data, 1);
+  route_gemv(transA, m, n, alpha, A->data, lda, X->data, 1, beta, Y->data, 1);
+}
 
+/* Increment of vector view, a column or a row. */
+static UINT view_inc(UINT d0, UINT d1, UINT ld1) {
+  if (d1 == 1) return 1;
+  if (d0 == 1) return ld1;
+  printf("Use Vector for Vector operation\n");
+  return 0;
+}
+
+/* trans flag of A is folded into transA, that of X and Y is meaningless. */
+void gemv_view(char transA, DTYPE alpha, MAT_VIEW *A, MAT_VIEW *X, DTYPE beta,
+               MAT_VIEW *Y) {
+  UINT m, n, lda, incx, incy;
+#if DEBUG
+  printf("%s\n", __func__);
 #endif
-#else
-  omp_gemv(transA, m, n, alpha, A->data, lda, X->data, 1, beta, Y->data, 1);
-#endif
+
+  if (transA == CTran) {
+    printf("ERROR : can't conjugate transpose real number matrix\n");
+    return;
+  }
+  transA = view_op(transA, A);
+  incx = view_inc(X->d0, X->d1, X->ld1);
+  incy = view_inc(Y->d0, Y->d1, Y->ld1);
+  if (incx == 0 || incy == 0) return;
+  if (A->d2 != 1) {
+    printf("Use 2D-Matrix for BLAS operation\n");
+    return;
+  }
+
+  // same as gemv_mat()
+  m = A->d1;
+  n = A->d0;
+  lda = A->ld1;
+
+  if (transA == NoTran)
+    ASSERT(X->d0 * X->d1 == n && Y->d0 * Y->d1 == m, "Wrong vector size.\n")
+  else
+    ASSERT(X->d0 * X->d1 == m && Y->d0 * Y->d1 == n, "Wrong vector size.\n")
+
+  route_gemv(transA, m, n, alpha, A->data, lda, X->data, incx, beta, Y->data,
+             incy);
+}
+
+/**** blocked gemv ****/
+/* r(<= GEMV_MR) rows of row-major A dotted with contiguous x at once,
+ * GEMV_ACC accumulators each. Missing rows repeat row 0 and are dropped. */
+static void gemv_rows(UINT r, UINT n, DTYPE *A, ITER lda, DTYPE *x,
+                      DTYPE alpha, DTYPE beta, DTYPE *Y, ITER incy) {
+  ITER i, j, l;
+  DTYPE *a[GEMV_MR];
+  DTYPE acc[GEMV_MR][GEMV_ACC], xv[GEMV_ACC];
+
+  for (j = 0; j < GEMV_MR; j++) {
+    a[j] = A + (j < r ? j : 0) * lda;
+    for (l = 0; l < GEMV_ACC; l++) acc[j][l] = 0;
+  }
+  for (i = 0; i + GEMV_ACC <= n; i += GEMV_ACC) {
+    for (l = 0; l < GEMV_ACC; l++) xv[l] = x[i + l];
+    for (j = 0; j < GEMV_MR; j++)
+      for (l = 0; l < GEMV_ACC; l++) acc[j][l] += a[j][i + l] * xv[l];
+  }
+  for (l = 0; i < n; i++, l++)
+    for (j = 0; j < GEMV_MR; j++) acc[j][l] += a[j][i] * x[i];
+
+  for (j = 0; j < r; j++) {
+    for (i = GEMV_ACC / 2; i > 0; i /= 2)
+      for (l = 0; l < i; l++) acc[j][l] += acc[j][l + i];
+    Y[j * incy] =
+        alpha * acc[j][0] + (beta == 0 ? 0 : beta * Y[j * incy]);
+  }
 }
 
+/* Y(nb) = alpha * A^T * X(m) + beta * Y for nb(<= GEMV_NB) columns of
+ * row-major A. Rows are added GEMV_MR at once into t on stack. */
+static void gemv_cols(UINT m, UINT nb, DTYPE *A, ITER lda, DTYPE *X,
+                      ITER incx, DTYPE alpha, DTYPE beta, DTYPE *Y,
+                      ITER incy) {
+  ITER i, j, l;
+  DTYPE *a0, *a1, *a2, *a3;
+  DTYPE x0, x1, x2, x3;
+  DTYPE t[GEMV_NB];
+
+  for (j = 0; j < nb; j++) t[j] = 0;
+  for (i = 0; i + 4 <= m; i += 4) {
+    a0 = A + i * lda;
+    a1 = a0 + lda;
+    a2 = a1 + lda;
+    a3 = a2 + lda;
+    x0 = X[i * incx];
+    x1 = X[(i + 1) * incx];
+    x2 = X[(i + 2) * incx];
+    x3 = X[(i + 3) * incx];
+    for (j = 0; j + GEMV_ACC <= nb; j += GEMV_ACC)
+      for (l = 0; l < GEMV_ACC; l++)
+        t[j + l] += a0[j + l] * x0 + a1[j + l] * x1 + a2[j + l] * x2 +
+                    a3[j + l] * x3;
+    for (; j < nb; j++)
+      t[j] += a0[j] * x0 + a1[j] * x1 + a2[j] * x2 + a3[j] * x3;
+  }
+  for (; i < m; i++) {
+    a0 = A + i * lda;
+    x0 = X[i * incx];
+    for (j = 0; j < nb; j++) t[j] += a0[j] * x0;
+  }
+
+  for (j = 0; j < nb; j++)
+    Y[j * incy] = alpha * t[j] + (beta == 0 ? 0 : beta * Y[j * incy]);
+}
+
+/* Row-major Y = alpha * op(A) * X + beta * Y, Y is not read when beta is 0.
+ * NoTran : threads take GEMV_MR rows at once, X is packed if strided.
+ * Tran   : threads take blocks of columns, each streaming every row of A
+ *          over its block, so that A is read once along rows. */
 void omp_gemv(char tranA, UINT m, UINT n, DTYPE alpha, DTYPE *A, UINT lda,
               DTYPE *X, SINT incx, DTYPE beta, DTYPE *Y, SINT incy) {
   ITER i, j;
-  DTYPE temp;
-
+  UINT nb, nblk;
+  DTYPE *x;
+  MP_MARK mark;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
 
   if (tranA == Tran) {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(A, X, Y) private(temp, j, i)
-    for (j = 0; j < n; j++) {
-      temp = 0;
-      for (i = 0; i < m; i++) {
-        temp += A[j + i * n] * X[i * incx];
-      }
-      temp *= alpha;
-      temp += beta * Y[j * incy];
-      Y[j * incy] = temp;
+    nb = GEMV_NB;
+#if USE_OMP
+    if (!omp_in_parallel()) {
+      nblk = (n + omp_get_max_threads() - 1) / omp_get_max_threads();
+      nblk = (nblk + GEMV_ACC - 1) / GEMV_ACC * GEMV_ACC;
+      if (nblk < nb) nb = nblk;
     }
+#endif
+    nblk = (n + nb - 1) / nb;
+#pragma omp parallel for schedule(static) shared(A, X, Y) private(j)
+    for (j = 0; j < nblk; j++)
+      gemv_cols(m, n - j * nb < nb ? n - j * nb : nb, A + j * nb, lda, X,
+                incx, alpha, beta, Y + j * nb * incy, incy);
   } else if (tranA == NoTran) {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(A, X, Y) private(temp, j, i)
-    for (j = 0; j < lda; j++) {
-      temp = 0;
-      for (i = 0; i < n; i++) {
-        temp += A[i + n * j] * X[i * incx];
-      }
-      temp *= alpha;
-      temp += beta * Y[j * incy];
-      Y[j * incy] = temp;
+    mark = mp_mark();
+    x = X;
+    if (incx != 1) {
+      x = (DTYPE *)mp_scratch(sizeof(DTYPE) * n);
+      for (i = 0; i < n; i++) x[i] = X[i * incx];
     }
+    nblk = (m + GEMV_MR - 1) / GEMV_MR;
+#pragma omp parallel for schedule(static) shared(A, x, Y) private(j)
+    for (j = 0; j < nblk; j++)
+      gemv_rows(m - j * GEMV_MR < GEMV_MR ? m - j * GEMV_MR : GEMV_MR, n,
+                A + j * GEMV_MR * lda, lda, x, alpha, beta,
+                Y + j * GEMV_MR * incy, incy);
+    mp_release(mark);
   } else {
     printf("ERROR : Transpose argument is invalid\n");
     return;
@@ -105,66 +223,626 @@ void gemv_cmat(char transA, CTYPE alpha, CMAT *A, CMAT *X, CTYPE beta, CMAT *Y)
     return;
   }
 
+  /* Column-major d0 x d1 is row-major d1 x d0, so that
+   * NoTran : Y(d1) = A^T * X(d0),  Tran : Y(d0) = A * X(d1). */
   m = A->d1;
   n = A->d0;
-  lda = m;
+  lda = n;
 
 #if DEBUG
   printf("trans : %d m : %u n: %u lda : %u\nalpha : %lf|%lf beta : %lf|%lf\n",
          transA, m, n, lda, alpha.re, alpha.im, beta.re, beta.im);
 #endif
 
-#if USE_CBLAS
-#if NTYPE == 0
-  cblas_cgemv(CblasColMajor, transA, m, n, &alpha, A->data, lda, X->data, 1,
-              &beta, Y->data, 1);
-#else
-  cblas_zgemv(CblasColMajor, transA, m, n, &alpha, A->data, lda, X->data, 1,
-              &beta, Y->data, 1);
+  route_cgemv(transA, m, n, alpha, A->data, lda, X->data, 1, beta, Y->data, 1);
+}
 
+/* trans and conj flags of A are folded into transA, conjugated X is copied
+ * on scratch stack as conjugated A without transpose is. */
+void gemv_cview(char transA, CTYPE alpha, CMAT_VIEW *A, CMAT_VIEW *X,
+                CTYPE beta, CMAT_VIEW *Y) {
+  UINT m, n, lda, incx, incy;
+  char op;
+  CMAT_VIEW tA, tX;
+  MP_MARK mark;
+#if DEBUG
+  printf("%s\n", __func__);
 #endif
-#else
-  omp_cgemv(transA, m, n, alpha, A->data, lda, X->data, 1, beta, Y->data, 1);
+
+  ASSERT(!Y->conj, "Conjugated view can't be output.\n")
+  mark = mp_mark();
+  op = cview_op(transA, A);
+  if (op == 0) {
+    tA = mp_scratch_conj(A);
+    A = &tA;
+    op = cview_op(transA, A);
+  }
+  transA = op;
+  if (X->conj) {
+    tX = mp_scratch_conj(X);
+    X = &tX;
+  }
+
+  incx = view_inc(X->d0, X->d1, X->ld1);
+  incy = view_inc(Y->d0, Y->d1, Y->ld1);
+  if (incx == 0 || incy == 0 || A->d2 != 1) {
+    if (A->d2 != 1) printf("Use 2D-Matrix for BLAS operation\n");
+    mp_release(mark);
+    return;
+  }
+
+  // same as gemv_cmat()
+  m = A->d1;
+  n = A->d0;
+  lda = A->ld1;
+
+  if (transA == NoTran)
+    ASSERT(X->d0 * X->d1 == n && Y->d0 * Y->d1 == m, "Wrong vector size.\n")
+  else
+    ASSERT(X->d0 * X->d1 == m && Y->d0 * Y->d1 == n, "Wrong vector size.\n")
+
+  route_cgemv(transA, m, n, alpha, A->data, lda, X->data, incx, beta, Y->data,
+              incy);
+  mp_release(mark);
+}
+
+/* gemv_mat() on d0 x d1 block of A at data + off, columns lda apart.
+ * X and Y are vectors at data + off of increment inc. */
+void gemv_mat_ld(char transA, UINT d0, UINT d1, DTYPE alpha, MAT *A,
+                 UINT offa, UINT lda, MAT *X, UINT offx, UINT incx,
+                 DTYPE beta, MAT *Y, UINT offy, UINT incy) {
+  MAT_VIEW va, vx, vy;
+#if DEBUG
+  printf("%s\n", __func__);
 #endif
+  va = ld_view(A, offa, d0, d1, lda);
+  vx = ld_view(X, offx, 1, transA == NoTran ? d0 : d1, incx);
+  vy = ld_view(Y, offy, 1, transA == NoTran ? d1 : d0, incy);
+  gemv_view(transA, alpha, &va, &vx, beta, &vy);
+}
+
+void gemv_cmat_ld(char transA, UINT d0, UINT d1, CTYPE alpha, CMAT *A,
+                  UINT offa, UINT lda, CMAT *X, UINT offx, UINT incx,
+                  CTYPE beta, CMAT *Y, UINT offy, UINT incy) {
+  CMAT_VIEW va, vx, vy;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  va = ld_cview(A, offa, d0, d1, lda);
+  vx = ld_cview(X, offx, 1, transA == NoTran ? d0 : d1, incx);
+  vy = ld_cview(Y, offy, 1, transA == NoTran ? d1 : d0, incy);
+  gemv_cview(transA, alpha, &va, &vx, beta, &vy);
+}
+
+/* r(<= GEMV_CMR) complex rows of A on x packed as xr = {re, im, ...} and
+ * xs = {im, re, ...}. Along the interleaved row, p += a * xr and
+ * q += a * xs, so that dot = (even p - odd p) + i (p of all q). */
+static void gemv_crows(UINT r, UINT n, CTYPE *A, ITER lda, DTYPE *xr,
+                       DTYPE *xs, CTYPE alpha, CTYPE beta, CTYPE *Y,
+                       ITER incy) {
+  ITER i, j, l;
+  UINT n2 = 2 * n;
+  DTYPE *a[GEMV_CMR];
+  DTYPE p[GEMV_CMR][GEMV_ACC], q[GEMV_CMR][GEMV_ACC];
+  DTYPE vr[GEMV_ACC], vs[GEMV_ACC];
+  CTYPE t, y;
+
+  for (j = 0; j < GEMV_CMR; j++) {
+    a[j] = (DTYPE *)(A + (j < r ? j : 0) * lda);
+    for (l = 0; l < GEMV_ACC; l++) p[j][l] = q[j][l] = 0;
+  }
+  for (i = 0; i + GEMV_ACC <= n2; i += GEMV_ACC) {
+    for (l = 0; l < GEMV_ACC; l++) {
+      vr[l] = xr[i + l];
+      vs[l] = xs[i + l];
+    }
+    for (j = 0; j < GEMV_CMR; j++)
+      for (l = 0; l < GEMV_ACC; l++) {
+        p[j][l] += a[j][i + l] * vr[l];
+        q[j][l] += a[j][i + l] * vs[l];
+      }
+  }
+  // GEMV_ACC is even, so that the tail starts on a real part
+  for (l = 0; i < n2; i++, l++)
+    for (j = 0; j < GEMV_CMR; j++) {
+      p[j][l] += a[j][i] * xr[i];
+      q[j][l] += a[j][i] * xs[i];
+    }
+
+  for (j = 0; j < r; j++) {
+    for (i = GEMV_ACC / 2; i > 1; i /= 2)
+      for (l = 0; l < i; l++) {
+        p[j][l] += p[j][l + i];
+        q[j][l] += q[j][l + i];
+      }
+    t.re = p[j][0] - p[j][1];
+    t.im = q[j][0] + q[j][1];
+    y.re = alpha.re * t.re - alpha.im * t.im;
+    y.im = alpha.re * t.im + alpha.im * t.re;
+    if (beta.re != 0 || beta.im != 0) CXADD_mul(y, beta, Y[j * incy])
+    Y[j * incy] = y;
+  }
 }
 
+/* Y(nb) = alpha * op(A) * X(m) + beta * Y for nb(<= GEMV_NB / 2) complex
+ * columns of row-major A, op is Tran or CTran. Interleaved rows of A are
+ * added as u += a * re(x) and v += a * im(x), which are combined at last
+ * for A or conj(A). */
+static void gemv_ccols(char tranA, UINT m, UINT nb, CTYPE *A, ITER lda,
+                       CTYPE *X, ITER incx, CTYPE alpha, CTYPE beta,
+                       CTYPE *Y, ITER incy) {
+  ITER i, j, l;
+  UINT nb2 = 2 * nb;
+  DTYPE *a0, *a1, *a2, *a3;
+  DTYPE r0, r1, r2, r3, i0, i1, i2, i3;
+  DTYPE u[GEMV_NB], v[GEMV_NB];
+  CTYPE t, y;
+
+  for (j = 0; j < nb2; j++) u[j] = v[j] = 0;
+  for (i = 0; i + 4 <= m; i += 4) {
+    a0 = (DTYPE *)(A + i * lda);
+    a1 = a0 + 2 * lda;
+    a2 = a1 + 2 * lda;
+    a3 = a2 + 2 * lda;
+    r0 = X[i * incx].re;
+    r1 = X[(i + 1) * incx].re;
+    r2 = X[(i + 2) * incx].re;
+    r3 = X[(i + 3) * incx].re;
+    i0 = X[i * incx].im;
+    i1 = X[(i + 1) * incx].im;
+    i2 = X[(i + 2) * incx].im;
+    i3 = X[(i + 3) * incx].im;
+    for (j = 0; j + GEMV_ACC <= nb2; j += GEMV_ACC)
+      for (l = 0; l < GEMV_ACC; l++) {
+        u[j + l] += a0[j + l] * r0 + a1[j + l] * r1 + a2[j + l] * r2 +
+                    a3[j + l] * r3;
+        v[j + l] += a0[j + l] * i0 + a1[j + l] * i1 + a2[j + l] * i2 +
+                    a3[j + l] * i3;
+      }
+    for (; j < nb2; j++) {
+      u[j] += a0[j] * r0 + a1[j] * r1 + a2[j] * r2 + a3[j] * r3;
+      v[j] += a0[j] * i0 + a1[j] * i1 + a2[j] * i2 + a3[j] * i3;
+    }
+  }
+  for (; i < m; i++) {
+    a0 = (DTYPE *)(A + i * lda);
+    r0 = X[i * incx].re;
+    i0 = X[i * incx].im;
+    for (j = 0; j < nb2; j++) {
+      u[j] += a0[j] * r0;
+      v[j] += a0[j] * i0;
+    }
+  }
+
+  for (j = 0; j < nb; j++) {
+    if (tranA == CTran) {
+      t.re = u[2 * j] + v[2 * j + 1];
+      t.im = v[2 * j] - u[2 * j + 1];
+    } else {
+      t.re = u[2 * j] - v[2 * j + 1];
+      t.im = v[2 * j] + u[2 * j + 1];
+    }
+    y.re = alpha.re * t.re - alpha.im * t.im;
+    y.im = alpha.re * t.im + alpha.im * t.re;
+    if (beta.re != 0 || beta.im != 0) CXADD_mul(y, beta, Y[j * incy])
+    Y[j * incy] = y;
+  }
+}
+
+/* Same as omp_gemv(), CTran is taken along with Tran. */
 void omp_cgemv(char tranA, UINT m, UINT n, CTYPE alpha, CTYPE *A, UINT lda,
                CTYPE *X, SINT incx, CTYPE beta, CTYPE *Y, SINT incy) {
   ITER i, j;
-  CTYPE temp;
-  DTYPE temp2;
+  UINT nb, nblk;
+  DTYPE *xr, *xs;
+  MP_MARK mark;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
 
-  if (tranA == Tran) {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(A, X, Y) private(temp, j, i, \
-                                                                   temp2)
-    for (j = 0; j < n; j++) {
-      temp.re = 0;
-      temp.im = 0;
-      for (i = 0; i < m; i++) {
-        CXADD_mul(temp, A[j + i * n], X[i * incx]);
-      }
-      CXMUL(temp, alpha, temp2);
-      CXADD_mul(temp, beta, Y[j * incy]);
-      Y[j * incy] = temp;
+  if (tranA == Tran || tranA == CTran) {
+    nb = GEMV_NB / 2;
+#if USE_OMP
+    if (!omp_in_parallel()) {
+      nblk = (n + omp_get_max_threads() - 1) / omp_get_max_threads();
+      nblk = (nblk + GEMV_ACC - 1) / GEMV_ACC * GEMV_ACC;
+      if (nblk < nb) nb = nblk;
     }
+#endif
+    nblk = (n + nb - 1) / nb;
+#pragma omp parallel for schedule(static) shared(A, X, Y) private(j)
+    for (j = 0; j < nblk; j++)
+      gemv_ccols(tranA, m, n - j * nb < nb ? n - j * nb : nb, A + j * nb,
+                 lda, X, incx, alpha, beta, Y + j * nb * incy, incy);
   } else if (tranA == NoTran) {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(A, X, Y) private(temp, j, i, \
-                                                                   temp2)
-    for (j = 0; j < lda; j++) {
-      temp.re = 0;
-      temp.im = 0;
-      for (i = 0; i < n; i++) {
-        CXADD_mul(temp, A[i + n * j], X[i * incx]);
+    mark = mp_mark();
+    xr = (DTYPE *)mp_scratch(sizeof(DTYPE) * 4 * n);
+    xs = xr + 2 * n;
+    for (i = 0; i < n; i++) {
+      xr[2 * i] = xs[2 * i + 1] = X[i * incx].re;
+      xr[2 * i + 1] = xs[2 * i] = X[i * incx].im;
+    }
+    nblk = (m + GEMV_CMR - 1) / GEMV_CMR;
+#pragma omp parallel for schedule(static) shared(A, xr, xs, Y) private(j)
+    for (j = 0; j < nblk; j++)
+      gemv_crows(m - j * GEMV_CMR < GEMV_CMR ? m - j * GEMV_CMR : GEMV_CMR, n,
+                 A + j * GEMV_CMR * lda, lda, xr, xs, alpha, beta,
+                 Y + j * GEMV_CMR * incy, incy);
+    mp_release(mark);
+  } else {
+    printf("ERROR : Transpose argument is invalid\n");
+    return;
+  }
+}
+
+/**** gemv of k right-hand sides ****/
+/* r(<= 2) rows of A dotted with kc(<= GEMV_KR) vectors of X at once, so
+ * that a pair of rows is read from memory once for every vector. Missing
+ * rows and vectors repeat the first and are dropped. */
+static void gemv_rhs_rows(UINT r, UINT kc, UINT n, DTYPE *A, ITER lda,
+                          DTYPE *X, ITER ldx, DTYPE alpha, DTYPE beta,
+                          DTYPE *Y, ITER ldy) {
+  ITER i, j, c, l;
+  DTYPE *a[2], *x[GEMV_KR];
+  DTYPE acc[2][GEMV_KR][GEMV_KL];
+
+  for (j = 0; j < 2; j++) a[j] = A + (j < r ? j : 0) * lda;
+  for (c = 0; c < GEMV_KR; c++) {
+    x[c] = X + (c < kc ? c : 0) * ldx;
+    for (l = 0; l < GEMV_KL; l++) acc[0][c][l] = acc[1][c][l] = 0;
+  }
+  for (i = 0; i + GEMV_KL <= n; i += GEMV_KL)
+    for (c = 0; c < GEMV_KR; c++)
+      for (l = 0; l < GEMV_KL; l++) {
+        acc[0][c][l] += a[0][i + l] * x[c][i + l];
+        acc[1][c][l] += a[1][i + l] * x[c][i + l];
       }
-      CXMUL(temp, alpha, temp2);
-      CXADD_mul(temp, beta, Y[j * incy]);
-      Y[j * incy] = temp;
+  for (l = 0; i < n; i++, l++)
+    for (c = 0; c < GEMV_KR; c++) {
+      acc[0][c][l] += a[0][i] * x[c][i];
+      acc[1][c][l] += a[1][i] * x[c][i];
+    }
+
+  for (j = 0; j < r; j++)
+    for (c = 0; c < kc; c++) {
+      for (i = GEMV_KL / 2; i > 0; i /= 2)
+        for (l = 0; l < i; l++) acc[j][c][l] += acc[j][c][l + i];
+      Y[j + c * ldy] = alpha * acc[j][c][0] +
+                       (beta == 0 ? 0 : beta * Y[j + c * ldy]);
     }
+}
+
+/* Columns [0, nb) of A^T * X for kc(<= GEMV_KR) vectors, as gemv_cols()
+ * with every vector in the inner loop, so that four rows of A are read
+ * once for all. nb <= GEMV_NB / GEMV_KR. */
+static void gemv_rhs_cols(UINT m, UINT nb, UINT kc, DTYPE *A, ITER lda,
+                          DTYPE *X, ITER ldx, DTYPE alpha, DTYPE beta,
+                          DTYPE *Y, ITER ldy) {
+  ITER i, j, c, l;
+  DTYPE *a0, *a1, *a2, *a3, *x[GEMV_KR];
+  DTYPE x0[GEMV_KR], x1[GEMV_KR], x2[GEMV_KR], x3[GEMV_KR];
+  DTYPE t[GEMV_KR][GEMV_NB / GEMV_KR];
+
+  for (c = 0; c < GEMV_KR; c++) {
+    x[c] = X + (c < kc ? c : 0) * ldx;
+    for (j = 0; j < nb; j++) t[c][j] = 0;
+  }
+  for (i = 0; i + 4 <= m; i += 4) {
+    a0 = A + i * lda;
+    a1 = a0 + lda;
+    a2 = a1 + lda;
+    a3 = a2 + lda;
+    for (c = 0; c < GEMV_KR; c++) {
+      x0[c] = x[c][i];
+      x1[c] = x[c][i + 1];
+      x2[c] = x[c][i + 2];
+      x3[c] = x[c][i + 3];
+    }
+    for (j = 0; j + GEMV_KL <= nb; j += GEMV_KL)
+      for (c = 0; c < GEMV_KR; c++)
+        for (l = 0; l < GEMV_KL; l++)
+          t[c][j + l] += a0[j + l] * x0[c] + a1[j + l] * x1[c] +
+                         a2[j + l] * x2[c] + a3[j + l] * x3[c];
+    for (; j < nb; j++)
+      for (c = 0; c < GEMV_KR; c++)
+        t[c][j] += a0[j] * x0[c] + a1[j] * x1[c] + a2[j] * x2[c] +
+                   a3[j] * x3[c];
+  }
+  for (; i < m; i++)
+    for (c = 0; c < GEMV_KR; c++)
+      for (j = 0; j < nb; j++) t[c][j] += A[i * lda + j] * x[c][i];
+
+  for (c = 0; c < kc; c++)
+    for (j = 0; j < nb; j++)
+      Y[j + c * ldy] =
+          alpha * t[c][j] + (beta == 0 ? 0 : beta * Y[j + c * ldy]);
+}
+
+/* omp_gemv() on k vectors, the columns of X and Y of ldx and ldy.
+ * A is read once for every GEMV_KR vectors, rather than for each. */
+void omp_gemv_rhs(char tranA, UINT m, UINT n, UINT k, DTYPE alpha, DTYPE *A,
+                  UINT lda, DTYPE *X, UINT ldx, DTYPE beta, DTYPE *Y,
+                  UINT ldy) {
+  ITER j, c;
+  UINT nb, nblk;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  if (tranA == Tran) {
+    nb = GEMV_NB / GEMV_KR;
+#if USE_OMP
+    if (!omp_in_parallel()) {
+      nblk = (n + omp_get_max_threads() - 1) / omp_get_max_threads();
+      nblk = (nblk + GEMV_KL - 1) / GEMV_KL * GEMV_KL;
+      if (nblk < nb) nb = nblk;
+    }
+#endif
+    nblk = (n + nb - 1) / nb;
+#pragma omp parallel for schedule(static) shared(A, X, Y) private(j, c)
+    for (j = 0; j < nblk; j++)
+      for (c = 0; c < k; c += GEMV_KR)
+        gemv_rhs_cols(m, n - j * nb < nb ? n - j * nb : nb,
+                      k - c < GEMV_KR ? k - c : GEMV_KR, A + j * nb, lda,
+                      X + c * ldx, ldx, alpha, beta, Y + j * nb + c * ldy,
+                      ldy);
+  } else if (tranA == NoTran) {
+#pragma omp parallel for schedule(static) shared(A, X, Y) private(j, c)
+    for (j = 0; j < m; j += 2)
+      for (c = 0; c < k; c += GEMV_KR)
+        gemv_rhs_rows(m - j < 2 ? 1 : 2, k - c < GEMV_KR ? k - c : GEMV_KR, n,
+                      A + j * lda, lda, X + c * ldx, ldx, alpha, beta,
+                      Y + j + c * ldy, ldy);
   } else {
     printf("ERROR : Transpose argument is invalid\n");
     return;
   }
 }
+
+/* Columns of X and Y are vectors of gemv_mat(). When gemm of the size goes
+ * to BLAS, Y = op(A^T) * X, as column-major, is one gemm of k columns,
+ * otherwise omp_gemv_rhs(). A single column stays on gemv. */
+void gemv_rhs_mat(char transA, DTYPE alpha, MAT *A, MAT *X, DTYPE beta,
+                  MAT *Y) {
+  UINT m, n, lx, ly;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  if (transA == CTran) {
+    printf("ERROR : can't conjugate transpose real number matrix\n");
+    return;
+  }
+  if (A->ndim != 1 || X->d2 != 1 || Y->d2 != 1) {
+    printf("Use 2D-Matrix for BLAS operation\n");
+    return;
+  }
+  // same as gemv_mat()
+  m = A->d1;
+  n = A->d0;
+  lx = transA == NoTran ? n : m;
+  ly = transA == NoTran ? m : n;
+  ASSERT(X->d0 == lx && Y->d0 == ly && X->d1 == Y->d1, "Wrong vector size.\n")
+
+  if (X->d1 == 1) {
+    route_gemv(transA, m, n, alpha, A->data, n, X->data, 1, beta, Y->data, 1);
+    return;
+  }
+  if (blas_use(BLAS_GEMM, (unsigned long long)ly * X->d1 * lx))
+    gemm_batch(transA == NoTran ? Tran : NoTran, NoTran, ly, X->d1, lx, alpha,
+               A->data, n, 0, X->data, lx, 0, beta, Y->data, ly, 0, 1);
+  else
+    omp_gemv_rhs(transA, m, n, X->d1, alpha, A->data, n, X->data, lx, beta,
+                 Y->data, ly);
+}
+
+/* Same as gemv_rhs_mat(), on cgemm. CTran is Y = conj(A) * X, as column-
+ * major, which gemm has no op for. It runs as
+ * conj(Y) = conj(alpha) * A * conj(X) + conj(beta) * conj(Y), with conj(X)
+ * on scratch stack and Y conjugated in place. */
+void gemv_rhs_cmat(char transA, CTYPE alpha, CMAT *A, CMAT *X, CTYPE beta,
+                   CMAT *Y) {
+  UINT m, n, lx, ly;
+  ITER i, size;
+  CTYPE *x;
+  MP_MARK mark;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  if (A->ndim != 1 || X->d2 != 1 || Y->d2 != 1) {
+    printf("Use 2D-Matrix for BLAS operation\n");
+    return;
+  }
+  m = A->d1;
+  n = A->d0;
+  lx = transA == NoTran ? n : m;
+  ly = transA == NoTran ? m : n;
+  ASSERT(X->d0 == lx && Y->d0 == ly && X->d1 == Y->d1, "Wrong vector size.\n")
+
+  if (X->d1 == 1) {
+    route_cgemv(transA, m, n, alpha, A->data, n, X->data, 1, beta, Y->data, 1);
+    return;
+  }
+  // a thin omp_cgemm() streams A no faster than omp_cgemv() transposed
+  if (transA != NoTran &&
+      !blas_use(BLAS_CGEMM, (unsigned long long)ly * X->d1 * lx)) {
+    for (i = 0; i < X->d1; i++)
+      omp_cgemv(transA, m, n, alpha, A->data, n, X->data + i * lx, 1, beta,
+                Y->data + i * ly, 1);
+    return;
+  }
+  if (transA != CTran) {
+    cgemm_batch(transA == NoTran ? Tran : NoTran, NoTran, ly, X->d1, lx,
+                alpha, A->data, n, 0, X->data, lx, 0, beta, Y->data, ly, 0,
+                1);
+    return;
+  }
+
+  mark = mp_mark();
+  size = (ITER)lx * X->d1;
+  x = (CTYPE *)mp_scratch(sizeof(CTYPE) * size);
+  for (i = 0; i < size; i++) {
+    x[i].re = X->data[i].re;
+    x[i].im = -X->data[i].im;
+  }
+  size = (ITER)ly * Y->d1;
+  for (i = 0; i < size; i++) Y->data[i].im = -Y->data[i].im;
+  alpha.im = -alpha.im;
+  beta.im = -beta.im;
+  cgemm_batch(NoTran, NoTran, ly, X->d1, lx, alpha, A->data, n, 0, x, lx, 0,
+              beta, Y->data, ly, 0, 1);
+  for (i = 0; i < size; i++) Y->data[i].im = -Y->data[i].im;
+  mp_release(mark);
+}
+
+/**** gemv of TMAT ****/
+/* Fallback of the precision other than DTYPE, row-major as omp_gemv().
+ * NoTran : Y(m) = alpha * A * X(n),  Tran : Y(n) = alpha * A^T * X(m) */
+#define TGEMV_DEF(NAME, T)                                                   \
+  static void NAME(char transA, UINT m, UINT n, T alpha, T *A, UINT lda,    \
+                   T *X, T beta, T *Y) {                                     \
+    ITER i, j;                                                               \
+    T s;                                                                     \
+    if (transA == NoTran) {                                                  \
+      _Pragma("omp parallel for schedule(static) private(i, j, s)")          \
+      for (i = 0; i < m; i++) {                                              \
+        s = 0;                                                               \
+        for (j = 0; j < n; j++) s += A[i * lda + j] * X[j];                  \
+        Y[i] = alpha * s + (beta == 0 ? 0 : beta * Y[i]);                    \
+      }                                                                      \
+    } else {                                                                 \
+      for (j = 0; j < n; j++) Y[j] = beta == 0 ? 0 : beta * Y[j];            \
+      for (i = 0; i < m; i++) {                                              \
+        s = alpha * X[i];                                                    \
+        _Pragma("omp parallel for schedule(static) private(j)")              \
+        for (j = 0; j < n; j++) Y[j] += A[i * lda + j] * s;                  \
+      }                                                                      \
+    }                                                                        \
+  }
+
+#define TCGEMV_DEF(NAME, T, CT)                                              \
+  static void NAME(char transA, UINT m, UINT n, CT alpha, CT *A, UINT lda,  \
+                   CT *X, CT beta, CT *Y) {                                  \
+    ITER i, j;                                                               \
+    CT a, s;                                                                 \
+    T re;                                                                    \
+    UINT ny = transA == NoTran ? m : n;                                      \
+    _Pragma("omp parallel for schedule(static) private(i, j, a, s, re)")     \
+    for (i = 0; i < ny; i++) {                                               \
+      s.re = s.im = 0;                                                       \
+      for (j = 0; j < (transA == NoTran ? n : m); j++) {                     \
+        a = transA == NoTran ? A[i * lda + j] : A[j * lda + i];              \
+        if (transA == CTran) a.im = -a.im;                                   \
+        CXADD_mul(s, a, X[j])                                                \
+      }                                                                      \
+      re = alpha.re * s.re - alpha.im * s.im;                                \
+      s.im = alpha.re * s.im + alpha.im * s.re;                              \
+      s.re = re;                                                             \
+      if (beta.re != 0 || beta.im != 0) CXADD_mul(s, beta, Y[i])             \
+      Y[i] = s;                                                              \
+    }                                                                        \
+  }
+
+#if NTYPE == 0
+TGEMV_DEF(tgemv_d, double)
+TCGEMV_DEF(tgemv_z, double, CTYPE_D)
+#else
+TGEMV_DEF(tgemv_s, float)
+TCGEMV_DEF(tgemv_c, float, CTYPE_S)
+#endif
+
+static int tgemv_check(TMAT *A, TMAT *X, TMAT *Y) {
+  ASSERT(A->dtype == X->dtype && A->dtype == Y->dtype,
+         "dtype must be equal.\n")
+  if (X->ndim != 0 || Y->ndim != 0) {
+    printf("Use Vector for Vector operation\n");
+    return 0;
+  }
+  if (A->ndim != 1) {
+    printf("Use 2D-Matrix for BLAS operation\n");
+    return 0;
+  }
+  return 1;
+}
+
+/* same as gemv_mat() */
+void gemv_tmat(char transA, double alpha, TMAT *A, TMAT *X, double beta,
+               TMAT *Y) {
+  UINT m, n;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  if (!tgemv_check(A, X, Y)) return;
+  m = A->d1;
+  n = A->d0;
+
+  if (A->dtype == DT_S) {
+#if USE_CBLAS
+    cblas_sgemv(CblasRowMajor, transA, m, n, (float)alpha, (float *)A->data, n,
+                (float *)X->data, 1, (float)beta, (float *)Y->data, 1);
+#elif NTYPE == 0
+    omp_gemv(transA, m, n, alpha, A->data, n, X->data, 1, beta, Y->data, 1);
+#else
+    tgemv_s(transA, m, n, (float)alpha, (float *)A->data, n, (float *)X->data,
+            (float)beta, (float *)Y->data);
+#endif
+  } else if (A->dtype == DT_D) {
+#if USE_CBLAS
+    cblas_dgemv(CblasRowMajor, transA, m, n, alpha, (double *)A->data, n,
+                (double *)X->data, 1, beta, (double *)Y->data, 1);
+#elif NTYPE == 1
+    omp_gemv(transA, m, n, alpha, A->data, n, X->data, 1, beta, Y->data, 1);
+#else
+    tgemv_d(transA, m, n, alpha, (double *)A->data, n, (double *)X->data, beta,
+            (double *)Y->data);
+#endif
+  } else
+    ASSERT(0, "Use cgemv_tmat() for complex.\n")
+}
+
+void cgemv_tmat(char transA, CTYPE_D alpha, TMAT *A, TMAT *X, CTYPE_D beta,
+                TMAT *Y) {
+  UINT m, n;
+  CTYPE_S alpha_s, beta_s;
+  CTYPE alpha_n, beta_n;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  if (!tgemv_check(A, X, Y)) return;
+  m = A->d1;
+  n = A->d0;
+  alpha_s.re = (float)alpha.re;
+  alpha_s.im = (float)alpha.im;
+  beta_s.re = (float)beta.re;
+  beta_s.im = (float)beta.im;
+  alpha_n.re = alpha.re;
+  alpha_n.im = alpha.im;
+  beta_n.re = beta.re;
+  beta_n.im = beta.im;
+
+  if (A->dtype == DT_C) {
+#if USE_CBLAS
+    cblas_cgemv(CblasRowMajor, transA, m, n, &alpha_s, A->data, n, X->data, 1,
+                &beta_s, Y->data, 1);
+#elif NTYPE == 0
+    omp_cgemv(transA, m, n, alpha_n, A->data, n, X->data, 1,
+              beta_n, Y->data, 1);
+#else
+    tgemv_c(transA, m, n, alpha_s, (CTYPE_S *)A->data, n, (CTYPE_S *)X->data,
+            beta_s, (CTYPE_S *)Y->data);
+#endif
+  } else if (A->dtype == DT_Z) {
+#if USE_CBLAS
+    cblas_zgemv(CblasRowMajor, transA, m, n, &alpha, A->data, n, X->data, 1,
+                &beta, Y->data, 1);
+#elif NTYPE == 1
+    omp_cgemv(transA, m, n, alpha_n, A->data, n, X->data, 1,
+              beta_n, Y->data, 1);
+#else
+    tgemv_z(transA, m, n, alpha, (CTYPE_D *)A->data, n, (CTYPE_D *)X->data,
+            beta, (CTYPE_D *)Y->data);
+#endif
+  } else
+    ASSERT(0, "Use gemv_tmat() for real.\n")
+}
@@ -10,6 +10,12 @@
  * ===========================================================
  */
 #include "iip_blas_lv3.h"
+#include "iip_backend.h"
+#include "iip_matrix.h"
+
+#if USE_OMP
+#include <omp.h>
+#endif
 
 /*
  **  cblas_?gemm(layout,transA,transB,m,n,k,alpha,A,lda,B,ldb,beta,C,ldc)
@@ -48,7 +54,6 @@ void gemm_mat(char transA, char transB, DTYPE alpha, MAT* A, MAT* B, DTYPE beta,
           MAT* C) {
   UINT m, n, k;
   UINT lda, ldb, ldc;
-  ITER i;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
@@ -86,146 +91,379 @@ void gemm_mat(char transA, char transB, DTYPE alpha, MAT* A, MAT* B, DTYPE beta,
 
   /** BATCH OPERATION **/
   if (A->d2 == B->d2) {
-    for (i = 0; i < A->d2; i++) {
-#if USE_CBLAS
-#if NTYPE == 0
-      cblas_sgemm(CblasColMajor, transA, transB, m, n, k, alpha,
-                  &(A->data[i * (A->d0 * A->d1)]), lda,
-                  &(B->data[i * B->d0 * B->d1]), ldb, beta,
-                  &(C->data[i * C->d0 * C->d1]), ldc);
-#else
-      cblas_dgemm(CblasColMajor, transA, transB, m, n, k, alpha,
-                  &(A->data[i * A->d0 * A->d1]), lda,
-                  &(B->data[i * B->d0 * B->d1]), ldb, beta,
-                  &(C->data[i * C->d0 * C->d1]), ldc);
-#endif
-#else
-      omp_gemm(transA, transB, m, n, k, alpha, &(A->data[i * A->d0 * A->d1]),
-               lda, &(B->data[i * B->d0 * B->d1]), ldb, beta,
-               &(C->data[i * C->d0 * C->d1]), ldc);
-#endif
-    }
+    gemm_batch(transA, transB, m, n, k, alpha, A->data, lda, A->d0 * A->d1,
+               B->data, ldb, B->d0 * B->d1, beta, C->data, ldc,
+               C->d0 * C->d1, A->d2);
   } else if (A->d2 == 1 && B->d2 != 1) {
     if (C->d2 != B->d2) ASSERT_DIM_INVALID()
-    for (i = 0; i < B->d2; i++) {
-#if USE_CBLAS
-#if NTYPE == 0
-      cblas_sgemm(CblasColMajor, transA, transB, m, n, k, alpha, A->data, lda,
-                  &(B->data[i * B->d0 * B->d1]), ldb, beta,
-                  &(C->data[i * C->d0 * C->d1]), ldc);
-#else
-      cblas_dgemm(CblasColMajor, transA, transB, m, n, k, alpha, A->data, lda,
-                  &(B->data[i * B->d0 * B->d1]), ldb, beta,
-                  &(C->data[i * C->d0 * C->d1]), ldc);
-#endif
-#else
-      omp_gemm(transA, transB, m, n, k, alpha, A->data, lda,
-               &(B->data[i * B->d0 * B->d1]), ldb, beta,
-               &(C->data[i * C->d0 * C->d1]), ldc);
-#endif
-    }
+    gemm_batch(transA, transB, m, n, k, alpha, A->data, lda, 0, B->data,
+               ldb, B->d0 * B->d1, beta, C->data, ldc, C->d0 * C->d1,
+               B->d2);
   } else if (A->d2 != 1 && B->d2 == 1) {
     if (C->d2 != A->d2) ASSERT_DIM_INVALID()
-    for (i = 0; i < A->d2; i++) {
-#if USE_CBLAS
-#if NTYPE == 0
-      cblas_sgemm(CblasColMajor, transA, transB, m, n, k, alpha,
-                  &(A->data[i * A->d0 * A->d1]), lda, B->data, ldb, beta,
-                  &(C->data[i * C->d0 * C->d1]), ldc);
-#else
-      cblas_dgemm(CblasColMajor, transA, transB, m, n, k, alpha,
-                  &(A->data[i * A->d0 * A->d1]), lda, B->data, ldb, beta,
-                  &(C->data[i * C->d0 * C->d1]), ldc);
-#endif
-#else
-      omp_gemm(transA, transB, m, n, k, alpha, &(A->data[i * A->d0 * A->d1]),
-               lda, B->data, ldb, beta, &(C->data[i * C->d0 * C->d1]), ldc);
+    gemm_batch(transA, transB, m, n, k, alpha, A->data, lda, A->d0 * A->d1,
+               B->data, ldb, 0, beta, C->data, ldc, C->d0 * C->d1,
+               A->d2);
+  } else
+    ASSERT_DIM_INVALID()
+}
+
+/* gemm_mat() on views. Every operand is given with its own ld,
+ * trans flag of A and B is folded into transA and transB. */
+void gemm_view(char transA, char transB, DTYPE alpha, MAT_VIEW* A, MAT_VIEW* B,
+               DTYPE beta, MAT_VIEW* C) {
+  UINT m, n, k, kb;
+  UINT ia, ib, ic;
+#if DEBUG
+  printf("%s\n", __func__);
 #endif
-    }
+
+  if ((transA == CTran) || (transB == CTran)) {
+    printf("ERROR : can't conjugate transpose real number matrix\n");
+    return;
+  }
+  ASSERT(!C->trans, "Transposed view can't be output.\n")
+  transA = view_op(transA, A);
+  transB = view_op(transB, B);
+  m = transA == NoTran ? A->d0 : A->d1;
+  k = transA == NoTran ? A->d1 : A->d0;
+  n = transB == NoTran ? B->d1 : B->d0;
+  kb = transB == NoTran ? B->d0 : B->d1;
+  if (k != kb || C->d0 != m || C->d1 != n) {
+    sprintf(str_assert, "(%d * %d) X (%d * %d) = (%d * %d)\n", A->d0, A->d1,
+            B->d0, B->d1, C->d0, C->d1);
+    ASSERT(0, str_assert)
+  }
+
+  /** BATCH OPERATION **/
+  if (A->d2 == B->d2 || (A->d2 == 1 && B->d2 != 1) ||
+      (A->d2 != 1 && B->d2 == 1)) {
+    if (C->d2 != (A->d2 > B->d2 ? A->d2 : B->d2)) ASSERT_DIM_INVALID()
   } else
     ASSERT_DIM_INVALID()
+  ia = A->d2 == 1 ? 0 : A->ld2;
+  ib = B->d2 == 1 ? 0 : B->ld2;
+  ic = C->ld2;
+
+  gemm_batch(transA, transB, m, n, k, alpha, A->data, A->ld1, ia, B->data,
+             B->ld1, ib, beta, C->data, C->ld1, ic, C->d2);
 }
 
-void omp_gemm(char transA, char transB, UINT m, UINT n, UINT k, DTYPE alpha,
-              DTYPE* A, UINT lda, DTYPE* B, UINT ldb, DTYPE beta, DTYPE* C,
-              UINT ldc) {
-  ITER i, j, l;
-  DTYPE temp;
+/* gemm_mat() on blocks at data + off, columns ld apart, as cblas_?gemm()
+ * takes them. op(A) is m x k, op(B) is k x n and C is m x n. */
+void gemm_mat_ld(char transA, char transB, UINT m, UINT n, UINT k,
+                 DTYPE alpha, MAT* A, UINT offa, UINT lda, MAT* B, UINT offb,
+                 UINT ldb, DTYPE beta, MAT* C, UINT offc, UINT ldc) {
+  MAT_VIEW va, vb, vc;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
+  va = transA == NoTran ? ld_view(A, offa, m, k, lda)
+                        : ld_view(A, offa, k, m, lda);
+  vb = transB == NoTran ? ld_view(B, offb, k, n, ldb)
+                        : ld_view(B, offb, n, k, ldb);
+  vc = ld_view(C, offc, m, n, ldc);
+  gemm_view(transA, transB, alpha, &va, &vb, beta, &vc);
+}
 
-  if ((transA == NoTran) && (transB == NoTran)) {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(A,B,C) private(temp, i, j,l)
-    for (l = 0; l < m; l++) {
-      for (j = 0; j < n; j++) {
-        temp = 0;
-        for (i = 0; i < k; i++) {
-          temp += A[i * m + l] * B[i + j * k];
-        }
-        C[l + m * j] *= beta;
+/**** packed gemm ****/
+/* op(A) block of mc x kc into panels of GEMM_MR rows, a[p * GEMM_MR + i]
+ * per panel, scaled by alpha. Rows past mc are zero. */
+static void gemm_pack_a(char transA, UINT mc, UINT kc, DTYPE alpha, DTYPE* A,
+                        UINT lda, DTYPE* a) {
+  ITER i, p, ir;
+  UINT mr;
 
-        temp *= alpha;
-        C[l + m * j] += temp;
+  for (ir = 0; ir < mc; ir += GEMM_MR) {
+    mr = mc - ir < GEMM_MR ? mc - ir : GEMM_MR;
+    if (transA == NoTran) {
+      for (p = 0; p < kc; p++) {
+        for (i = 0; i < mr; i++) a[p * GEMM_MR + i] = alpha * A[ir + i + p * lda];
+        for (; i < GEMM_MR; i++) a[p * GEMM_MR + i] = 0;
       }
+    } else {
+      for (i = 0; i < mr; i++)
+        for (p = 0; p < kc; p++)
+          a[p * GEMM_MR + i] = alpha * A[p + (ir + i) * lda];
+      for (; i < GEMM_MR; i++)
+        for (p = 0; p < kc; p++) a[p * GEMM_MR + i] = 0;
     }
+    a += GEMM_MR * kc;
   }
+}
 
-  if ((transA != NoTran) && (transB == NoTran)) {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(A, B, C) private(temp, i, j, \
-                                                                   l)
-    for (l = 0; l < m; l++) {
-      for (j = 0; j < n; j++) {
-        temp = 0;
-        for (i = 0; i < k; i++) {
-          temp += A[l * k + i] * B[i + j * k];
-        }
-        C[l + m * j] *= beta;
+/* op(B) panel of kc x nr into b[p * GEMM_NR + j]. Columns past nr are
+ * zero. */
+static void gemm_pack_panel(char transB, UINT kc, UINT nr, DTYPE* B, UINT ldb,
+                            DTYPE* b) {
+  ITER j, p;
 
-        temp *= alpha;
-        C[l + m * j] += temp;
-      }
+  if (transB == NoTran) {
+    for (j = 0; j < nr; j++)
+      for (p = 0; p < kc; p++) b[p * GEMM_NR + j] = B[p + j * ldb];
+  } else {
+    for (p = 0; p < kc; p++)
+      for (j = 0; j < nr; j++) b[p * GEMM_NR + j] = B[j + p * ldb];
+  }
+  for (j = nr; j < GEMM_NR; j++)
+    for (p = 0; p < kc; p++) b[p * GEMM_NR + j] = 0;
+}
+
+/* op(B) block of kc x nc into panels of GEMM_NR columns, threaded over
+ * panels when par. */
+static void gemm_pack_b(char transB, UINT kc, UINT nc, DTYPE* B, UINT ldb,
+                        DTYPE* b, int par) {
+  ITER jr;
+
+#define GEMM_PANEL(jr)                                                      \
+  gemm_pack_panel(transB, kc, nc - (jr) < GEMM_NR ? nc - (jr) : GEMM_NR,    \
+                  transB == NoTran ? B + (jr) * ldb : B + (jr), ldb,        \
+                  b + (jr) * kc)
+  if (par) {
+#pragma omp parallel for schedule(static) shared(B, b) private(jr)
+    for (jr = 0; jr < nc; jr += GEMM_NR) GEMM_PANEL(jr);
+  } else {
+    for (jr = 0; jr < nc; jr += GEMM_NR) GEMM_PANEL(jr);
+  }
+#undef GEMM_PANEL
+}
+
+/* C(mr x nr) = a * b + beta * C on one GEMM_MR x GEMM_NR tile.
+ * Trip counts are constant so that the compiler keeps ab in registers. */
+static void gemm_micro(UINT kc, DTYPE* a, DTYPE* b, DTYPE beta, DTYPE* C,
+                       UINT ldc, UINT mr, UINT nr) {
+  DTYPE ab[GEMM_MR * GEMM_NR];
+  ITER i, j, p;
+
+  for (i = 0; i < GEMM_MR * GEMM_NR; i++) ab[i] = 0;
+  for (p = 0; p < kc; p++) {
+    for (j = 0; j < GEMM_NR; j++)
+      for (i = 0; i < GEMM_MR; i++) ab[j * GEMM_MR + i] += a[i] * b[j];
+    a += GEMM_MR;
+    b += GEMM_NR;
+  }
+
+  if (beta == 0) {
+    for (j = 0; j < nr; j++)
+      for (i = 0; i < mr; i++) C[i + j * ldc] = ab[j * GEMM_MR + i];
+  } else if (beta == 1) {
+    for (j = 0; j < nr; j++)
+      for (i = 0; i < mr; i++) C[i + j * ldc] += ab[j * GEMM_MR + i];
+  } else {
+    for (j = 0; j < nr; j++)
+      for (i = 0; i < mr; i++)
+        C[i + j * ldc] = beta * C[i + j * ldc] + ab[j * GEMM_MR + i];
+  }
+}
+
+/* C = alpha * op(A) * op(B) + beta * C, one dot per element straight from
+ * A and B, for products too small to pay packing. */
+static void gemm_direct(char transA, char transB, UINT m, UINT n, UINT k,
+                        DTYPE alpha, DTYPE* A, UINT lda, DTYPE* B, UINT ldb,
+                        DTYPE beta, DTYPE* C, UINT ldc) {
+  ITER i, j, p;
+  UINT ra, ca, rb, cb;
+  DTYPE t;
+
+  // op(A)(i,p) = A[i * ra + p * ca], op(B)(p,j) = B[p * rb + j * cb]
+  ra = transA == NoTran ? 1 : lda;
+  ca = transA == NoTran ? lda : 1;
+  rb = transB == NoTran ? 1 : ldb;
+  cb = transB == NoTran ? ldb : 1;
+  for (j = 0; j < n; j++)
+    for (i = 0; i < m; i++) {
+      t = 0;
+      for (p = 0; p < k; p++) t += A[i * ra + p * ca] * B[p * rb + j * cb];
+      C[i + j * ldc] =
+          beta == 0 ? alpha * t : alpha * t + beta * C[i + j * ldc];
     }
+}
+
+/* op(A) block of mc x kc packed on scratch of calling thread, swept by
+ * micro-tiles over packed op(B) of kc x nc into C. */
+static void gemm_block(char transA, UINT mc, UINT nc, UINT kc, DTYPE alpha,
+                       DTYPE* A, UINT lda, DTYPE* b, DTYPE beta, DTYPE* C,
+                       UINT ldc) {
+  ITER ir, jr;
+  DTYPE* a;
+  MP_MARK mark;
+
+  mark = mp_mark();
+  a = (DTYPE*)mp_scratch(sizeof(DTYPE) * kc * (mc + GEMM_MR));
+  gemm_pack_a(transA, mc, kc, alpha, A, lda, a);
+  for (jr = 0; jr < nc; jr += GEMM_NR)
+    for (ir = 0; ir < mc; ir += GEMM_MR)
+      gemm_micro(kc, a + ir * kc, b + jr * kc, beta, C + ir + jr * ldc, ldc,
+                 mc - ir < GEMM_MR ? mc - ir : GEMM_MR,
+                 nc - jr < GEMM_NR ? nc - jr : GEMM_NR);
+  mp_release(mark);
+}
+
+/* Column-major C = alpha * op(A) * op(B) + beta * C, C is not read when
+ * beta is 0. Under GEMM_SMALL_MNK of m * n * k it runs gemm_direct().
+ * Otherwise op(B) is packed by GEMM_KC x GEMM_NC, then threads take
+ * blocks of op(A) by GEMM_MC rows, pack them on own scratch and sweep
+ * micro-tiles over the packed op(B). Called from a parallel region, it
+ * stays on the calling thread. */
+void omp_gemm(char transA, char transB, UINT m, UINT n, UINT k, DTYPE alpha,
+              DTYPE* A, UINT lda, DTYPE* B, UINT ldb, DTYPE beta, DTYPE* C,
+              UINT ldc) {
+  ITER i, j, ib, jc, pc;
+  UINT nc, kc, mb, nblk;
+  DTYPE bt;
+  DTYPE* b;
+  MP_MARK mark;
+  int par = 0;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  if (m == 0 || n == 0) return;
+  if (k == 0 || alpha == 0) {
+#pragma omp parallel for schedule(static) shared(C) private(i, j)
+    for (j = 0; j < n; j++)
+      for (i = 0; i < m; i++)
+        C[i + j * ldc] = beta == 0 ? 0 : beta * C[i + j * ldc];
+    return;
+  }
+  if ((unsigned long long)m * n * k < GEMM_SMALL_MNK) {
+    gemm_direct(transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+    return;
   }
-  if ((transA != NoTran) && (transB != NoTran)) {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(A, B, C) private(temp, i, j, \
-                                                                   l)
-    for (l = 0; l < m; l++) {
-      for (j = 0; j < n; j++) {
-        temp = 0;
-        for (i = 0; i < k; i++) {
-          temp += A[l * k + i] * B[i * n + j];
-        }
-        C[l + m * j] *= beta;
 
-        temp *= alpha;
-        C[l + m * j] += temp;
+  // Shrink row blocks so that every thread has one. Inside a parallel
+  // region such as gemm_batch(), a nested region costs more than a slice,
+  // so no threads are started at all.
+  mb = GEMM_MC;
+#if USE_OMP
+  par = omp_get_max_threads() > 1 && !omp_in_parallel();
+  if (par) {
+    nblk = (m + GEMM_MR - 1) / GEMM_MR;
+    nblk = (nblk + omp_get_max_threads() - 1) / omp_get_max_threads();
+    if (nblk * GEMM_MR < mb) mb = nblk * GEMM_MR;
+  }
+#endif
+  nblk = (m + mb - 1) / mb;
+
+  mark = mp_mark();
+  b = (DTYPE*)mp_scratch(sizeof(DTYPE) * GEMM_KC *
+                         ((n < GEMM_NC ? n : GEMM_NC) + GEMM_NR));
+
+#define GEMM_BLOCK(ib)                                                   \
+  gemm_block(transA, m - (ib) * mb < mb ? m - (ib) * mb : mb, nc, kc,    \
+             alpha,                                                      \
+             transA == NoTran ? A + (ib) * mb + pc * lda                 \
+                              : A + pc + (ib) * mb * lda,                \
+             lda, b, bt, C + (ib) * mb + jc * ldc, ldc)
+  for (jc = 0; jc < n; jc += GEMM_NC) {
+    nc = n - jc < GEMM_NC ? n - jc : GEMM_NC;
+    for (pc = 0; pc < k; pc += GEMM_KC) {
+      kc = k - pc < GEMM_KC ? k - pc : GEMM_KC;
+      gemm_pack_b(transB, kc, nc,
+                  transB == NoTran ? B + pc + jc * ldb : B + jc + pc * ldb,
+                  ldb, b, par);
+      bt = pc == 0 ? beta : 1;
+
+      if (par) {
+#pragma omp parallel for schedule(dynamic, 1) shared(A, C, b) private(ib)
+        for (ib = 0; ib < nblk; ib++) GEMM_BLOCK(ib);
+      } else {
+        for (ib = 0; ib < nblk; ib++) GEMM_BLOCK(ib);
       }
     }
   }
-  if ((transA == NoTran) && (transB != NoTran)) {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(A, B, C) private(temp, i, j, \
-                                                                   l)
-    for (l = 0; l < m; l++) {
-      for (j = 0; j < n; j++) {
-        temp = 0;
-        for (i = 0; i < k; i++) {
-          temp += A[i * m + l] * B[i * n + j];
-        }
-        C[l + m * j] *= beta;
+#undef GEMM_BLOCK
+  mp_release(mark);
+}
 
-        temp *= alpha;
-        C[l + m * j] += temp;
-      }
+/* Threads of a batch take one slice each, so BLAS is kept to one thread
+ * over them when slices of op and size go to it. Returns threads of BLAS
+ * to restore by blas_set_threads(), 0 if nothing to restore. */
+static int batch_blas_begin(int op, unsigned long long size) {
+#if USE_OMP
+  if (omp_get_max_threads() > 1 && !omp_in_parallel() && blas_use(op, size))
+    return blas_set_threads(1);
+#else
+  (void)op;
+  (void)size;
+#endif
+  return 0;
+}
+
+/* route_gemm() over batch of slices, where slice i of A is A + i * sa, and
+ * so B and C. Stride 0 shares a slice. With MKL, slices routed to BLAS are
+ * one call to cblas_?gemm_batch(). Otherwise slices under GEMM_BATCH_MNK
+ * of m * n * k are given to threads one by one, each running
+ * single-threaded gemm(BLAS is set to one thread meanwhile), and larger
+ * ones are issued in turn, threaded inside. */
+void gemm_batch(char transA, char transB, UINT m, UINT n, UINT k, DTYPE alpha,
+                DTYPE* A, UINT lda, UINT sa, DTYPE* B, UINT ldb, UINT sb,
+                DTYPE beta, DTYPE* C, UINT ldc, UINT sc, UINT batch) {
+  ITER i;
+  int nt;
+#if USE_MKL
+  CBLAS_TRANSPOSE ta, tb;
+  MKL_INT mm, nn, kk, la, lb, lc, size;
+  const DTYPE **pa, **pb;
+  DTYPE** pc;
+  MP_MARK mark;
+#endif
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  if (batch == 0) return;
+#if USE_MKL
+  if (batch > 1 && blas_use(BLAS_GEMM, (unsigned long long)m * n * k)) {
+    mark = mp_mark();
+    pa = (const DTYPE**)mp_scratch(sizeof(DTYPE*) * batch);
+    pb = (const DTYPE**)mp_scratch(sizeof(DTYPE*) * batch);
+    pc = (DTYPE**)mp_scratch(sizeof(DTYPE*) * batch);
+    for (i = 0; i < batch; i++) {
+      pa[i] = A + i * sa;
+      pb[i] = B + i * sb;
+      pc[i] = C + i * sc;
     }
+    ta = (CBLAS_TRANSPOSE)transA;
+    tb = (CBLAS_TRANSPOSE)transB;
+    mm = m;
+    nn = n;
+    kk = k;
+    la = lda;
+    lb = ldb;
+    lc = ldc;
+    size = batch;
+#if NTYPE == 0
+    cblas_sgemm_batch(CblasColMajor, &ta, &tb, &mm, &nn, &kk, &alpha, pa, &la,
+                      pb, &lb, &beta, pc, &lc, 1, &size);
+#else
+    cblas_dgemm_batch(CblasColMajor, &ta, &tb, &mm, &nn, &kk, &alpha, pa, &la,
+                      pb, &lb, &beta, pc, &lc, 1, &size);
+#endif
+    blas_count(BLAS_GEMM, ROUTE_BLAS, batch);
+    mp_release(mark);
+    return;
+  }
+#endif
+
+#define GEMM_SLICE(i)                                                  \
+  route_gemm(transA, transB, m, n, k, alpha, A + (i) * sa, lda,        \
+             B + (i) * sb, ldb, beta, C + (i) * sc, ldc)
+  if (batch > 1 && (unsigned long long)m * n * k < GEMM_BATCH_MNK) {
+    nt = batch_blas_begin(BLAS_GEMM, (unsigned long long)m * n * k);
+#pragma omp parallel for schedule(dynamic, 1) shared(A, B, C) private(i)
+    for (i = 0; i < batch; i++) GEMM_SLICE(i);
+    if (nt > 0) blas_set_threads(nt);
+  } else {
+    for (i = 0; i < batch; i++) GEMM_SLICE(i);
   }
+#undef GEMM_SLICE
 }
 
 void gemm_cmat(char transA, char transB, CTYPE alpha, CMAT* A, CMAT* B, CTYPE beta,
            CMAT* C) {
   UINT m, n, k;
   UINT lda, ldb, ldc;
-  ITER i;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
@@ -256,236 +494,849 @@ void gemm_cmat(char transA, char transB, CTYPE alpha, CMAT* A, CMAT* B, CTYPE be
     ldb = B->d0;
   }
 
+  /** BATCH OPERATION **/
   if (A->d2 == B->d2) {
-    for (i = 0; i < A->d2; i++) {
-#if USE_CBLAS
-#if NTYPE == 0
-      cblas_cgemm(CblasColMajor, transA, transB, m, n, k, &alpha,
-                  &(A->data[i * (A->d0 * A->d1)]), lda,
-                  &(B->data[i * B->d0 * B->d1]), ldb, &beta,
-                  &(C->data[i * C->d0 * C->d1]), ldc);
-#else
-      cblas_zgemm(CblasColMajor, transA, transB, m, n, k, &alpha,
-                  &(A->data[i * A->d0 * A->d1]), lda,
-                  &(B->data[i * B->d0 * B->d1]), ldb, &beta,
-                  &(C->data[i * C->d0 * C->d1]), ldc);
+    cgemm_batch(transA, transB, m, n, k, alpha, A->data, lda, A->d0 * A->d1,
+                B->data, ldb, B->d0 * B->d1, beta, C->data, ldc,
+                C->d0 * C->d1, A->d2);
+  } else if (A->d2 == 1 && B->d2 != 1) {
+    if (C->d2 != B->d2) ASSERT_DIM_INVALID()
+    cgemm_batch(transA, transB, m, n, k, alpha, A->data, lda, 0, B->data,
+                ldb, B->d0 * B->d1, beta, C->data, ldc, C->d0 * C->d1,
+                B->d2);
+  } else if (A->d2 != 1 && B->d2 == 1) {
+    if (C->d2 != A->d2) ASSERT_DIM_INVALID()
+    cgemm_batch(transA, transB, m, n, k, alpha, A->data, lda, A->d0 * A->d1,
+                B->data, ldb, 0, beta, C->data, ldc, C->d0 * C->d1,
+                A->d2);
+  } else
+    ASSERT_DIM_INVALID()
+}
+
+/* gemm_cmat() on views. Every operand is given with its own ld,
+ * trans and conj flags of A and B are folded into transA and transB.
+ * Only conjugate without transpose takes a copy, on scratch stack. */
+void gemm_cview(char transA, char transB, CTYPE alpha, CMAT_VIEW* A,
+                CMAT_VIEW* B, CTYPE beta, CMAT_VIEW* C) {
+  UINT m, n, k, kb;
+  UINT ia, ib, ic;
+  char opA, opB;
+  CMAT_VIEW tA, tB;
+  MP_MARK mark;
+#if DEBUG
+  printf("%s\n", __func__);
 #endif
-#else
-      omp_cgemm(transA, transB, m, n, k, alpha, &(A->data[i * A->d0 * A->d1]),
-                lda, &(B->data[i * B->d0 * B->d1]), ldb, beta,
-                &(C->data[i * C->d0 * C->d1]), ldc);
+
+  ASSERT(!C->trans && !C->conj, "Transposed view can't be output.\n")
+  mark = mp_mark();
+  opA = cview_op(transA, A);
+  if (opA == 0) {
+    tA = mp_scratch_conj(A);
+    A = &tA;
+    opA = cview_op(transA, A);
+  }
+  opB = cview_op(transB, B);
+  if (opB == 0) {
+    tB = mp_scratch_conj(B);
+    B = &tB;
+    opB = cview_op(transB, B);
+  }
+  transA = opA;
+  transB = opB;
+
+  m = transA == NoTran ? A->d0 : A->d1;
+  k = transA == NoTran ? A->d1 : A->d0;
+  n = transB == NoTran ? B->d1 : B->d0;
+  kb = transB == NoTran ? B->d0 : B->d1;
+  if (k != kb || C->d0 != m || C->d1 != n) {
+    sprintf(str_assert, "(%d * %d) X (%d * %d) = (%d * %d)\n", A->d0, A->d1,
+            B->d0, B->d1, C->d0, C->d1);
+    ASSERT(0, str_assert)
+  }
+
+  /** BATCH OPERATION **/
+  if (A->d2 == B->d2 || (A->d2 == 1 && B->d2 != 1) ||
+      (A->d2 != 1 && B->d2 == 1)) {
+    if (C->d2 != (A->d2 > B->d2 ? A->d2 : B->d2)) ASSERT_DIM_INVALID()
+  } else
+    ASSERT_DIM_INVALID()
+  ia = A->d2 == 1 ? 0 : A->ld2;
+  ib = B->d2 == 1 ? 0 : B->ld2;
+  ic = C->ld2;
+
+  cgemm_batch(transA, transB, m, n, k, alpha, A->data, A->ld1, ia, B->data,
+              B->ld1, ib, beta, C->data, C->ld1, ic, C->d2);
+  mp_release(mark);
+}
+
+void gemm_cmat_ld(char transA, char transB, UINT m, UINT n, UINT k,
+                  CTYPE alpha, CMAT* A, UINT offa, UINT lda, CMAT* B,
+                  UINT offb, UINT ldb, CTYPE beta, CMAT* C, UINT offc,
+                  UINT ldc) {
+  CMAT_VIEW va, vb, vc;
+#if DEBUG
+  printf("%s\n", __func__);
 #endif
+  va = transA == NoTran ? ld_cview(A, offa, m, k, lda)
+                        : ld_cview(A, offa, k, m, lda);
+  vb = transB == NoTran ? ld_cview(B, offb, k, n, ldb)
+                        : ld_cview(B, offb, n, k, ldb);
+  vc = ld_cview(C, offc, m, n, ldc);
+  gemm_cview(transA, transB, alpha, &va, &vb, beta, &vc);
+}
+
+/**** packed complex gemm ****/
+/* op(A)(i,p) of column-major A, alpha * op(A) in t */
+#define CGEMM_OPA(t, i, p)                                          \
+  {                                                                 \
+    c = transA == NoTran ? A[(i) + (p) * lda] : A[(p) + (i) * lda]; \
+    if (transA == CTran) c.im = -c.im;                              \
+    t.re = alpha.re * c.re - alpha.im * c.im;                       \
+    t.im = alpha.re * c.im + alpha.im * c.re;                       \
+  }
+#define CGEMM_OPB(t, p, j)                                          \
+  {                                                                 \
+    t = transB == NoTran ? B[(p) + (j) * ldb] : B[(j) + (p) * ldb]; \
+    if (transB == CTran) t.im = -t.im;                              \
+  }
+
+/* 4M : op(A) block of mc x kc into panels of GEMM_CMR rows, scaled by
+ * alpha. Each p of a panel holds GEMM_CMR re and GEMM_CMR im.
+ * Rows past mc are zero. */
+static void cgemm_pack_a(char transA, UINT mc, UINT kc, CTYPE alpha, CTYPE* A,
+                         UINT lda, DTYPE* a) {
+  ITER i, p, ir;
+  UINT mr;
+  CTYPE c, t;
+
+  for (ir = 0; ir < mc; ir += GEMM_CMR) {
+    mr = mc - ir < GEMM_CMR ? mc - ir : GEMM_CMR;
+    for (p = 0; p < kc; p++) {
+      for (i = 0; i < mr; i++) {
+        CGEMM_OPA(t, ir + i, p)
+        a[p * 2 * GEMM_CMR + i] = t.re;
+        a[p * 2 * GEMM_CMR + GEMM_CMR + i] = t.im;
+      }
+      for (; i < GEMM_CMR; i++)
+        a[p * 2 * GEMM_CMR + i] = a[p * 2 * GEMM_CMR + GEMM_CMR + i] = 0;
     }
-  } else if (A->d2 == 1 && B->d2 != 1) {
-    for (i = 0; i < B->d2; i++) {
-      if (C->d2 != B->d2) ASSERT_DIM_INVALID()
-#if USE_CBLAS
-#if NTYPE == 0
-      cblas_cgemm(CblasColMajor, transA, transB, m, n, k, &alpha, A->data, lda,
-                  &(B->data[i * B->d0 * B->d1]), ldb, &beta,
-                  &(C->data[i * C->d0 * C->d1]), ldc);
-#else
-      cblas_zgemm(CblasColMajor, transA, transB, m, n, k, &alpha, A->data, lda,
-                  &(B->data[i * B->d0 * B->d1]), ldb, &beta,
-                  &(C->data[i * C->d0 * C->d1]), ldc);
+    a += 2 * GEMM_CMR * kc;
+  }
+}
+
+/* 4M : op(B) panel of kc x nr, laid out as cgemm_pack_a(). Columns past
+ * nr are zero. */
+static void cgemm_pack_panel(char transB, UINT kc, UINT nr, CTYPE* B,
+                             UINT ldb, DTYPE* b) {
+  ITER j, p;
+  CTYPE t;
+
+  for (p = 0; p < kc; p++) {
+    for (j = 0; j < nr; j++) {
+      CGEMM_OPB(t, p, j)
+      b[p * 2 * GEMM_CNR + j] = t.re;
+      b[p * 2 * GEMM_CNR + GEMM_CNR + j] = t.im;
+    }
+    for (; j < GEMM_CNR; j++)
+      b[p * 2 * GEMM_CNR + j] = b[p * 2 * GEMM_CNR + GEMM_CNR + j] = 0;
+  }
+}
+
+/* 4M : op(B) block of kc x nc into panels of GEMM_CNR columns, threaded
+ * over panels when par. */
+static void cgemm_pack_b(char transB, UINT kc, UINT nc, CTYPE* B, UINT ldb,
+                         DTYPE* b, int par) {
+  ITER jr;
+
+#define CGEMM_PANEL(jr)                                                     \
+  cgemm_pack_panel(transB, kc, nc - (jr) < GEMM_CNR ? nc - (jr) : GEMM_CNR, \
+                   transB == NoTran ? B + (jr) * ldb : B + (jr), ldb,       \
+                   b + (jr) * 2 * kc)
+  if (par) {
+#pragma omp parallel for schedule(static) shared(B, b) private(jr)
+    for (jr = 0; jr < nc; jr += GEMM_CNR) CGEMM_PANEL(jr);
+  } else {
+    for (jr = 0; jr < nc; jr += GEMM_CNR) CGEMM_PANEL(jr);
+  }
+#undef CGEMM_PANEL
+}
+
+/* 3M : re, im and re + im of op(A) block, each as gemm_pack_a() at
+ * a, a + size and a + 2 * size, where size is kc x mc rounded up to
+ * GEMM_MR. */
+static void cgemm_pack_a3(char transA, UINT mc, UINT kc, CTYPE alpha, CTYPE* A,
+                          UINT lda, DTYPE* a) {
+  ITER i, p, ir;
+  UINT mr, size;
+  CTYPE c, t;
+
+  size = kc * ((mc + GEMM_MR - 1) / GEMM_MR) * GEMM_MR;
+  for (ir = 0; ir < mc; ir += GEMM_MR) {
+    mr = mc - ir < GEMM_MR ? mc - ir : GEMM_MR;
+    for (p = 0; p < kc; p++) {
+      for (i = 0; i < mr; i++) {
+        CGEMM_OPA(t, ir + i, p)
+        a[p * GEMM_MR + i] = t.re;
+        a[size + p * GEMM_MR + i] = t.im;
+        a[2 * size + p * GEMM_MR + i] = t.re + t.im;
+      }
+      for (; i < GEMM_MR; i++)
+        a[p * GEMM_MR + i] = a[size + p * GEMM_MR + i] =
+            a[2 * size + p * GEMM_MR + i] = 0;
+    }
+    a += GEMM_MR * kc;
+  }
+}
+
+/* 3M : re, im and re + im of op(B) panel of kc x nr at b, b + size and
+ * b + 2 * size. Columns past nr are zero. */
+static void cgemm_pack_panel3(char transB, UINT kc, UINT nr, CTYPE* B,
+                              UINT ldb, DTYPE* b, UINT size) {
+  ITER j, p;
+  CTYPE t;
+
+  for (p = 0; p < kc; p++) {
+    for (j = 0; j < nr; j++) {
+      CGEMM_OPB(t, p, j)
+      b[p * GEMM_NR + j] = t.re;
+      b[size + p * GEMM_NR + j] = t.im;
+      b[2 * size + p * GEMM_NR + j] = t.re + t.im;
+    }
+    for (; j < GEMM_NR; j++)
+      b[p * GEMM_NR + j] = b[size + p * GEMM_NR + j] =
+          b[2 * size + p * GEMM_NR + j] = 0;
+  }
+}
+
+/* 3M : op(B) block of kc x nc, each part as gemm_pack_b(), where size is
+ * kc x nc rounded up to GEMM_NR. Threaded over panels when par. */
+static void cgemm_pack_b3(char transB, UINT kc, UINT nc, CTYPE* B, UINT ldb,
+                          DTYPE* b, int par) {
+  ITER jr;
+  UINT size;
+
+  size = kc * ((nc + GEMM_NR - 1) / GEMM_NR) * GEMM_NR;
+#define CGEMM_PANEL3(jr)                                                  \
+  cgemm_pack_panel3(transB, kc, nc - (jr) < GEMM_NR ? nc - (jr) : GEMM_NR, \
+                    transB == NoTran ? B + (jr) * ldb : B + (jr), ldb,     \
+                    b + (jr) * kc, size)
+  if (par) {
+#pragma omp parallel for schedule(static) shared(B, b) private(jr)
+    for (jr = 0; jr < nc; jr += GEMM_NR) CGEMM_PANEL3(jr);
+  } else {
+    for (jr = 0; jr < nc; jr += GEMM_NR) CGEMM_PANEL3(jr);
+  }
+#undef CGEMM_PANEL3
+}
+
+/* C(mr x nr) = ab + beta * C where ab is given as re and im tiles of
+ * leading dimension ldt. */
+static void cgemm_store(DTYPE* re, DTYPE* im, UINT ldt, CTYPE beta, CTYPE* C,
+                        UINT ldc, UINT mr, UINT nr) {
+  ITER i, j;
+  CTYPE c;
+
+  if (beta.re == 0 && beta.im == 0) {
+    for (j = 0; j < nr; j++)
+      for (i = 0; i < mr; i++) {
+        C[i + j * ldc].re = re[j * ldt + i];
+        C[i + j * ldc].im = im[j * ldt + i];
+      }
+  } else {
+    for (j = 0; j < nr; j++)
+      for (i = 0; i < mr; i++) {
+        c = C[i + j * ldc];
+        C[i + j * ldc].re = beta.re * c.re - beta.im * c.im + re[j * ldt + i];
+        C[i + j * ldc].im = beta.re * c.im + beta.im * c.re + im[j * ldt + i];
+      }
+  }
+}
+
+/* 4M : re = ar * br - ai * bi, im = ar * bi + ai * br on one
+ * GEMM_CMR x GEMM_CNR tile. */
+static void cgemm_micro(UINT kc, DTYPE* a, DTYPE* b, CTYPE beta, CTYPE* C,
+                        UINT ldc, UINT mr, UINT nr) {
+  DTYPE re[GEMM_CMR * GEMM_CNR], im[GEMM_CMR * GEMM_CNR];
+  ITER i, j, p;
+
+  for (i = 0; i < GEMM_CMR * GEMM_CNR; i++) re[i] = im[i] = 0;
+  for (p = 0; p < kc; p++) {
+    for (j = 0; j < GEMM_CNR; j++)
+      for (i = 0; i < GEMM_CMR; i++) {
+        re[j * GEMM_CMR + i] +=
+            a[i] * b[j] - a[GEMM_CMR + i] * b[GEMM_CNR + j];
+        im[j * GEMM_CMR + i] +=
+            a[i] * b[GEMM_CNR + j] + a[GEMM_CMR + i] * b[j];
+      }
+    a += 2 * GEMM_CMR;
+    b += 2 * GEMM_CNR;
+  }
+  cgemm_store(re, im, GEMM_CMR, beta, C, ldc, mr, nr);
+}
+
+/* 3M : p1 = ar * br, p2 = ai * bi, p3 = (ar + ai) * (br + bi) by the real
+ * micro-kernel, then re = p1 - p2, im = p3 - p1 - p2. */
+static void cgemm_micro3(UINT kc, DTYPE* a, UINT sa, DTYPE* b, UINT sb,
+                         CTYPE beta, CTYPE* C, UINT ldc, UINT mr, UINT nr) {
+  DTYPE p1[GEMM_MR * GEMM_NR], p2[GEMM_MR * GEMM_NR], p3[GEMM_MR * GEMM_NR];
+  ITER i;
+
+  gemm_micro(kc, a, b, 0, p1, GEMM_MR, GEMM_MR, GEMM_NR);
+  gemm_micro(kc, a + sa, b + sb, 0, p2, GEMM_MR, GEMM_MR, GEMM_NR);
+  gemm_micro(kc, a + 2 * sa, b + 2 * sb, 0, p3, GEMM_MR, GEMM_MR, GEMM_NR);
+  for (i = 0; i < GEMM_MR * GEMM_NR; i++) {
+    p3[i] -= p1[i] + p2[i];
+    p1[i] -= p2[i];
+  }
+  cgemm_store(p1, p3, GEMM_MR, beta, C, ldc, mr, nr);
+}
+
+/* op(A) block of mc x kc packed on scratch of calling thread, swept by
+ * 3M or 4M micro-tiles over packed op(B) of kc x nc into C. sb is the
+ * part size of 3M op(B). */
+static void cgemm_block(char transA, UINT mc, UINT nc, UINT kc, CTYPE alpha,
+                        CTYPE* A, UINT lda, DTYPE* b, UINT sb, CTYPE beta,
+                        CTYPE* C, UINT ldc, UINT use3m) {
+  ITER ir, jr;
+  UINT sa;
+  DTYPE* a;
+  MP_MARK mark;
+
+  mark = mp_mark();
+  a = (DTYPE*)mp_scratch(sizeof(DTYPE) * 3 * kc * (mc + GEMM_MR));
+  if (use3m) {
+    sa = kc * ((mc + GEMM_MR - 1) / GEMM_MR) * GEMM_MR;
+    cgemm_pack_a3(transA, mc, kc, alpha, A, lda, a);
+    for (jr = 0; jr < nc; jr += GEMM_NR)
+      for (ir = 0; ir < mc; ir += GEMM_MR)
+        cgemm_micro3(kc, a + ir * kc, sa, b + jr * kc, sb, beta,
+                     C + ir + jr * ldc, ldc,
+                     mc - ir < GEMM_MR ? mc - ir : GEMM_MR,
+                     nc - jr < GEMM_NR ? nc - jr : GEMM_NR);
+  } else {
+    cgemm_pack_a(transA, mc, kc, alpha, A, lda, a);
+    for (jr = 0; jr < nc; jr += GEMM_CNR)
+      for (ir = 0; ir < mc; ir += GEMM_CMR)
+        cgemm_micro(kc, a + ir * 2 * kc, b + jr * 2 * kc, beta,
+                    C + ir + jr * ldc, ldc,
+                    mc - ir < GEMM_CMR ? mc - ir : GEMM_CMR,
+                    nc - jr < GEMM_CNR ? nc - jr : GEMM_CNR);
+  }
+  mp_release(mark);
+}
+
+/* Column-major C = alpha * op(A) * op(B) + beta * C, op is NoTran, Tran or
+ * CTran, conjugation and alpha are applied while packing. Blocking and
+ * threads are same as omp_gemm(). From CGEMM_3M_MIN on m, n and k, it runs
+ * 3M on the real micro-kernel, otherwise 4M on GEMM_CMR x GEMM_CNR tiles. */
+void omp_cgemm(char transA, char transB, UINT m, UINT n, UINT k, CTYPE alpha,
+               CTYPE* A, UINT lda, CTYPE* B, UINT ldb, CTYPE beta, CTYPE* C,
+               UINT ldc) {
+  ITER i, j, ib, jc, pc;
+  UINT nc, kc, mb, nblk, mt, nt, use3m, sb;
+  CTYPE bt, c;
+  DTYPE* b;
+  MP_MARK mark;
+  int par = 0;
+#if DEBUG
+  printf("%s\n", __func__);
 #endif
-#else
-      omp_cgemm(transA, transB, m, n, k, alpha, A->data, lda,
-                &(B->data[i * B->d0 * B->d1]), ldb, beta,
-                &(C->data[i * C->d0 * C->d1]), ldc);
+
+  if (m == 0 || n == 0) return;
+  if (k == 0 || (alpha.re == 0 && alpha.im == 0)) {
+#pragma omp parallel for schedule(static) shared(C) private(i, j, c)
+    for (j = 0; j < n; j++)
+      for (i = 0; i < m; i++) {
+        c = C[i + j * ldc];
+        if (beta.re == 0 && beta.im == 0) c.re = c.im = 0;
+        C[i + j * ldc].re = beta.re * c.re - beta.im * c.im;
+        C[i + j * ldc].im = beta.re * c.im + beta.im * c.re;
+      }
+    return;
+  }
+
+  use3m = m >= CGEMM_3M_MIN && n >= CGEMM_3M_MIN && k >= CGEMM_3M_MIN;
+  mt = use3m ? GEMM_MR : GEMM_CMR;
+  nt = use3m ? GEMM_NR : GEMM_CNR;
+
+  // Shrink row blocks so that every thread has one, no threads inside a
+  // parallel region as omp_gemm().
+  mb = GEMM_MC;
+#if USE_OMP
+  par = omp_get_max_threads() > 1 && !omp_in_parallel();
+  if (par) {
+    nblk = (m + mt - 1) / mt;
+    nblk = (nblk + omp_get_max_threads() - 1) / omp_get_max_threads();
+    if (nblk * mt < mb) mb = nblk * mt;
+  }
 #endif
+  nblk = (m + mb - 1) / mb;
+
+  mark = mp_mark();
+  b = (DTYPE*)mp_scratch(sizeof(DTYPE) * 3 * GEMM_KC *
+                         ((n < GEMM_NC ? n : GEMM_NC) + nt));
+
+#define CGEMM_BLOCK(ib)                                                   \
+  cgemm_block(transA, m - (ib) * mb < mb ? m - (ib) * mb : mb, nc, kc,    \
+              alpha,                                                      \
+              transA == NoTran ? A + (ib) * mb + pc * lda                 \
+                               : A + pc + (ib) * mb * lda,                \
+              lda, b, sb, bt, C + (ib) * mb + jc * ldc, ldc, use3m)
+  for (jc = 0; jc < n; jc += GEMM_NC) {
+    nc = n - jc < GEMM_NC ? n - jc : GEMM_NC;
+    for (pc = 0; pc < k; pc += GEMM_KC) {
+      kc = k - pc < GEMM_KC ? k - pc : GEMM_KC;
+      if (use3m)
+        cgemm_pack_b3(transB, kc, nc,
+                      transB == NoTran ? B + pc + jc * ldb : B + jc + pc * ldb,
+                      ldb, b, par);
+      else
+        cgemm_pack_b(transB, kc, nc,
+                     transB == NoTran ? B + pc + jc * ldb : B + jc + pc * ldb,
+                     ldb, b, par);
+      sb = kc * ((nc + GEMM_NR - 1) / GEMM_NR) * GEMM_NR;
+      if (pc == 0)
+        bt = beta;
+      else {
+        bt.re = 1;
+        bt.im = 0;
+      }
+
+      if (par) {
+#pragma omp parallel for schedule(dynamic, 1) shared(A, C, b) private(ib)
+        for (ib = 0; ib < nblk; ib++) CGEMM_BLOCK(ib);
+      } else {
+        for (ib = 0; ib < nblk; ib++) CGEMM_BLOCK(ib);
+      }
     }
-  } else if (A->d2 != 1 && B->d2 == 1) {
-    for (i = 0; i < A->d2; i++) {
-      if (C->d2 != A->d2) ASSERT_DIM_INVALID()
-#if USE_CBLAS
+  }
+#undef CGEMM_BLOCK
+  mp_release(mark);
+}
+
+/* route_cgemm() over batch of slices, same as gemm_batch(). */
+void cgemm_batch(char transA, char transB, UINT m, UINT n, UINT k, CTYPE alpha,
+                 CTYPE* A, UINT lda, UINT sa, CTYPE* B, UINT ldb, UINT sb,
+                 CTYPE beta, CTYPE* C, UINT ldc, UINT sc, UINT batch) {
+  ITER i;
+  int nt;
+#if USE_MKL
+  CBLAS_TRANSPOSE ta, tb;
+  MKL_INT mm, nn, kk, la, lb, lc, size;
+  const void **pa, **pb;
+  void** pc;
+  MP_MARK mark;
+#endif
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  if (batch == 0) return;
+#if USE_MKL
+  if (batch > 1 && blas_use(BLAS_CGEMM, (unsigned long long)m * n * k)) {
+    mark = mp_mark();
+    pa = (const void**)mp_scratch(sizeof(void*) * batch);
+    pb = (const void**)mp_scratch(sizeof(void*) * batch);
+    pc = (void**)mp_scratch(sizeof(void*) * batch);
+    for (i = 0; i < batch; i++) {
+      pa[i] = A + i * sa;
+      pb[i] = B + i * sb;
+      pc[i] = C + i * sc;
+    }
+    ta = (CBLAS_TRANSPOSE)transA;
+    tb = (CBLAS_TRANSPOSE)transB;
+    mm = m;
+    nn = n;
+    kk = k;
+    la = lda;
+    lb = ldb;
+    lc = ldc;
+    size = batch;
 #if NTYPE == 0
-      cblas_cgemm(CblasColMajor, transA, transB, m, n, k, &alpha,
-                  &(A->data[i * A->d0 * A->d1]), lda, B->data, ldb, &beta,
-                  &(C->data[i * C->d0 * C->d1]), ldc);
+    cblas_cgemm_batch(CblasColMajor, &ta, &tb, &mm, &nn, &kk, &alpha, pa, &la,
+                      pb, &lb, &beta, pc, &lc, 1, &size);
 #else
-      cblas_zgemm(CblasColMajor, transA, transB, m, n, k, &alpha,
-                  &(A->data[i * A->d0 * A->d1]), lda, B->data, ldb, &beta,
-                  &(C->data[i * C->d0 * C->d1]), ldc);
+    cblas_zgemm_batch(CblasColMajor, &ta, &tb, &mm, &nn, &kk, &alpha, pa, &la,
+                      pb, &lb, &beta, pc, &lc, 1, &size);
 #endif
-#else
-      omp_cgemm(transA, transB, m, n, k, alpha, &(A->data[i * A->d0 * A->d1]),
-                lda, B->data, ldb, beta, &(C->data[i * C->d0 * C->d1]), ldc);
+    blas_count(BLAS_CGEMM, ROUTE_BLAS, batch);
+    mp_release(mark);
+    return;
+  }
 #endif
-    }
-  } else
-    ASSERT_DIM_INVALID()
+
+#define CGEMM_SLICE(i)                                                 \
+  route_cgemm(transA, transB, m, n, k, alpha, A + (i) * sa, lda,       \
+              B + (i) * sb, ldb, beta, C + (i) * sc, ldc)
+  if (batch > 1 && (unsigned long long)m * n * k < GEMM_BATCH_MNK) {
+    nt = batch_blas_begin(BLAS_CGEMM, (unsigned long long)m * n * k);
+#pragma omp parallel for schedule(dynamic, 1) shared(A, B, C) private(i)
+    for (i = 0; i < batch; i++) CGEMM_SLICE(i);
+    if (nt > 0) blas_set_threads(nt);
+  } else {
+    for (i = 0; i < batch; i++) CGEMM_SLICE(i);
+  }
+#undef CGEMM_SLICE
 }
 
-void omp_cgemm(char transA, char transB, UINT m, UINT n, UINT k, CTYPE alpha,
-               CTYPE* A, UINT lda, CTYPE* B, UINT ldb, CTYPE beta, CTYPE* C,
-               UINT ldc) {
-  ITER i, j, l;
-  ITER adx, bdx;
-  CTYPE temp;
-  DTYPE temp2;
-  DTYPE o1, o2;
-  DTYPE t_r, t_i;
-#if DEBUG
-  printf("%s\n", __func__);
-#endif
-
-  if ((transA == NoTran)) {
-    if (transB == NoTran) {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(A, B, C) private(temp, i, j, \
-                                                                   l, temp2)
-      for (l = 0; l < m; l++) {
-        for (j = 0; j < n; j++) {
-          temp.im = 0;
-          temp.re = 0;
-          for (i = 0; i < k; i++) {
-            CXADD_mul(temp, A[i * m + l], B[i + j * k]);
-          }
-          CXMUL(C[l + m * j], beta, temp2);
-          CXMUL(temp, alpha, temp2);
-          CXADD(C[l + m * j], temp);
-        }
-      }
+/**** syrk, herk ****/
 
-    } else if (transB == Tran) {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(A, B, C) private(temp, i, j, \
-                                                                   l, temp2)
-      for (l = 0; l < m; l++) {
-        for (j = 0; j < n; j++) {
-          temp.re = 0;
-          temp.im = 0;
-          for (i = 0; i < k; i++) {
-            CXADD_mul(temp, A[i * m + l], B[i * n + j])
-          }
-          CXMUL(C[l + m * j], beta, temp2)
-          CXMUL(temp, alpha, temp2) CXADD(C[l + m * j], temp)
-        }
+/* Triangle uplo of C(nb x nb) = alpha * A * A^T + beta * C, A nb x k for
+ * NoTran, and of alpha * A^T * A + beta * C, A k x nb for Tran. NoTran
+ * sums rank-1 updates of 4 columns of A at once, Tran takes dots of
+ * columns, on a tile of scratch stack. */
+static void syrk_diag(char uplo, char trans, UINT nb, UINT k, DTYPE alpha,
+                      DTYPE* A, UINT lda, DTYPE beta, DTYPE* C, UINT ldc) {
+  ITER i, j, l, lo, hi;
+  DTYPE s0, s1, s2, s3, s;
+  DTYPE *a0, *a1, *a2, *a3, *t;
+  MP_MARK mark;
+
+  mark = mp_mark();
+  t = (DTYPE*)mp_scratch(sizeof(DTYPE) * nb * nb);
+  memset(t, 0, sizeof(DTYPE) * nb * nb);
+  if (trans == NoTran) {
+    for (l = 0; l + 4 <= k; l += 4) {
+      a0 = A + l * lda;
+      a1 = a0 + lda;
+      a2 = a1 + lda;
+      a3 = a2 + lda;
+      for (j = 0; j < nb; j++) {
+        lo = uplo == Lower ? j : 0;
+        hi = uplo == Lower ? nb : j + 1;
+        s0 = a0[j];
+        s1 = a1[j];
+        s2 = a2[j];
+        s3 = a3[j];
+        for (i = lo; i < hi; i++)
+          t[i + j * nb] += s0 * a0[i] + s1 * a1[i] + s2 * a2[i] + s3 * a3[i];
       }
-    } else  // tranB == CTran
-    {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(A, B, C) private(temp, i, j, \
-                                                                   l, temp2)
-      for (l = 0; l < m; l++) {
-        for (j = 0; j < n; j++) {
-          temp.re = 0;
-          temp.im = 0;
-          for (i = 0; i < k; i++) {
-            temp.re += A[i * m + l].re * B[i * n + j].re;
-            temp.re += A[i * m + l].im * B[i * n + j].im;
-            temp.im += A[i * m + l].im * (B[i * n + j].re);
-            temp.im -= A[i * m + l].re * (B[i * n + j].im);
-          }
-          CXMUL(C[l + m * j], beta, temp2)
-          CXMUL(temp, alpha, temp2) CXADD(C[l + m * j], temp)
-        }
+    }
+    for (; l < k; l++) {
+      a0 = A + l * lda;
+      for (j = 0; j < nb; j++) {
+        lo = uplo == Lower ? j : 0;
+        hi = uplo == Lower ? nb : j + 1;
+        s0 = a0[j];
+        for (i = lo; i < hi; i++) t[i + j * nb] += s0 * a0[i];
       }
     }
-  } else if (transA == Tran) {
-    if (transB == NoTran) {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(A, B, C) private(temp, i, j, \
-                                                                   l, temp2)
-      for (l = 0; l < m; l++) {
-        for (j = 0; j < n; j++) {
-          temp.re = 0;
-          temp.im = 0;
-          for (i = 0; i < k; i++) {
-            CXADD_mul(temp, A[i + l * k], B[i + j * k])
-          }
-          CXMUL(C[l + m * j], beta, temp2)
-          CXMUL(temp, alpha, temp2) CXADD(C[l + m * j], temp)
-        }
+  } else {
+    for (j = 0; j < nb; j++) {
+      lo = uplo == Lower ? j : 0;
+      hi = uplo == Lower ? nb : j + 1;
+      for (i = lo; i < hi; i++) {
+        a0 = A + i * lda;
+        a1 = A + j * lda;
+        s = 0;
+        for (l = 0; l < k; l++) s += a0[l] * a1[l];
+        t[i + j * nb] = s;
       }
+    }
+  }
+
+  for (j = 0; j < nb; j++) {
+    lo = uplo == Lower ? j : 0;
+    hi = uplo == Lower ? nb : j + 1;
+    for (i = lo; i < hi; i++)
+      C[i + j * ldc] = alpha * t[i + j * nb] +
+                       (beta == 0 ? 0 : beta * C[i + j * ldc]);
+  }
+  mp_release(mark);
+}
+
+/* Column-major triangle uplo of C(n x n) = alpha * op(A) * op(A)^T +
+ * beta * C, op(A) n x k. The other triangle is not touched, C is not read
+ * when beta is 0. Diagonal blocks of SYRK_NB go to threads, then the
+ * panel below(Lower) or above(Upper) each of them is one omp_gemm(). */
+void omp_syrk(char uplo, char trans, UINT n, UINT k, DTYPE alpha, DTYPE* A,
+              UINT lda, DTYPE beta, DTYPE* C, UINT ldc) {
+  ITER i, j, jb;
+  UINT nb, nblk;
+  char ta, tb;
+  int par = 0;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  if (n == 0) return;
+  if (trans == CTran) trans = Tran;
+  if (k == 0 || alpha == 0) {
+#pragma omp parallel for schedule(static) shared(C) private(i, j)
+    for (j = 0; j < n; j++)
+      for (i = uplo == Lower ? j : 0; i < (uplo == Lower ? n : j + 1); i++)
+        C[i + j * ldc] = beta == 0 ? 0 : beta * C[i + j * ldc];
+    return;
+  }
+
+  // no threads inside a parallel region, as omp_gemm()
+#if USE_OMP
+  par = omp_get_max_threads() > 1 && !omp_in_parallel();
+#endif
+  nblk = (n + SYRK_NB - 1) / SYRK_NB;
+#define SYRK_DIAG(jb)                                                        \
+  syrk_diag(uplo, trans,                                                     \
+            n - (jb) * SYRK_NB < SYRK_NB ? n - (jb) * SYRK_NB : SYRK_NB, k,  \
+            alpha,                                                           \
+            trans == NoTran ? A + (jb) * SYRK_NB : A + (jb) * SYRK_NB * lda, \
+            lda, beta, C + (jb) * SYRK_NB * (1 + (ITER)ldc), ldc)
+  if (par) {
+#pragma omp parallel for schedule(dynamic, 1) shared(A, C) private(jb)
+    for (jb = 0; jb < nblk; jb++) SYRK_DIAG(jb);
+  } else {
+    for (jb = 0; jb < nblk; jb++) SYRK_DIAG(jb);
+  }
+#undef SYRK_DIAG
+
+  // C(rows, cols) = alpha * op(A)(rows) * op(A)(cols)^T + beta * C
+  ta = trans == NoTran ? NoTran : Tran;
+  tb = trans == NoTran ? Tran : NoTran;
+  for (jb = 0; jb < n; jb += SYRK_NB) {
+    nb = n - jb < SYRK_NB ? n - jb : SYRK_NB;
+    if (uplo == Lower && jb + nb < n)
+      omp_gemm(ta, tb, n - jb - nb, nb, k, alpha,
+               trans == NoTran ? A + jb + nb : A + (jb + nb) * lda, lda,
+               trans == NoTran ? A + jb : A + jb * lda, lda, beta,
+               C + jb + nb + jb * ldc, ldc);
+    else if (uplo == Upper && jb > 0)
+      omp_gemm(ta, tb, jb, nb, k, alpha, A, lda,
+               trans == NoTran ? A + jb : A + jb * lda, lda, beta,
+               C + jb * ldc, ldc);
+  }
+}
+
+/* route_syrk() over batch of slices, same as gemm_batch(). */
+void syrk_batch(char uplo, char trans, UINT n, UINT k, DTYPE alpha, DTYPE* A,
+                UINT lda, UINT sa, DTYPE beta, DTYPE* C, UINT ldc, UINT sc,
+                UINT batch) {
+  ITER i;
+  int nt;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  if (batch > 1 && (unsigned long long)n * n * k < GEMM_BATCH_MNK) {
+    nt = batch_blas_begin(BLAS_SYRK, (unsigned long long)n * n * k);
+#pragma omp parallel for schedule(dynamic, 1) shared(A, C) private(i)
+    for (i = 0; i < batch; i++)
+      route_syrk(uplo, trans, n, k, alpha, A + i * sa, lda, beta, C + i * sc,
+                 ldc);
+    if (nt > 0) blas_set_threads(nt);
+  } else {
+    for (i = 0; i < batch; i++)
+      route_syrk(uplo, trans, n, k, alpha, A + i * sa, lda, beta, C + i * sc,
+                 ldc);
+  }
+}
+
+void syrk_mat(char uplo, char trans, DTYPE alpha, MAT* A, DTYPE beta,
+              MAT* C) {
+  UINT n, k;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  if (trans == CTran) {
+    printf("ERROR : can't conjugate transpose real number matrix\n");
+    return;
+  }
+  ASSERT(uplo == Upper || uplo == Lower, "Wrong uplo.\n")
+  n = trans == NoTran ? A->d0 : A->d1;
+  k = trans == NoTran ? A->d1 : A->d0;
+  ASSERT(C->d0 == n && C->d1 == n, "Wrong matrix size.\n")
+  if (A->d2 != C->d2) ASSERT_DIM_INVALID()
+
+  syrk_batch(uplo, trans, n, k, alpha, A->data, A->d0, A->d0 * A->d1, beta,
+             C->data, n, n * n, C->d2);
+}
+
+/* Same as syrk_diag(), C = alpha * A * A^H + beta * C for NoTran and
+ * alpha * A^H * A + beta * C for CTran. Imaginary part of the diagonal
+ * is set to 0. */
+static void herk_diag(char uplo, char trans, UINT nb, UINT k, DTYPE alpha,
+                      CTYPE* A, UINT lda, DTYPE beta, CTYPE* C, UINT ldc) {
+  ITER i, j, l, lo, hi;
+  CTYPE s0, s1, s;
+  CTYPE *a0, *a1, *t;
+  MP_MARK mark;
 
-    } else if (transB == Tran) {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(A, B, C) private(temp, i, j, \
-                                                                   l, temp2)
-      for (l = 0; l < m; l++) {
-        for (j = 0; j < n; j++) {
-          temp.re = 0;
-          temp.im = 0;
-          for (i = 0; i < k; i++) {
-            CXADD_mul(temp, A[i + l * k], B[i * n + j])
-          }
-          CXMUL(C[l + m * j], beta, temp2)
-          CXMUL(temp, alpha, temp2) CXADD(C[l + m * j], temp)
+  mark = mp_mark();
+  t = (CTYPE*)mp_scratch(sizeof(CTYPE) * nb * nb);
+  memset(t, 0, sizeof(CTYPE) * nb * nb);
+  if (trans == NoTran) {
+    // t(i,j) += a(i,l) * conj(a(j,l))
+    for (l = 0; l + 2 <= k; l += 2) {
+      a0 = A + l * lda;
+      a1 = a0 + lda;
+      for (j = 0; j < nb; j++) {
+        lo = uplo == Lower ? j : 0;
+        hi = uplo == Lower ? nb : j + 1;
+        s0 = a0[j];
+        s1 = a1[j];
+        for (i = lo; i < hi; i++) {
+          t[i + j * nb].re += s0.re * a0[i].re + s0.im * a0[i].im +
+                              s1.re * a1[i].re + s1.im * a1[i].im;
+          t[i + j * nb].im += s0.re * a0[i].im - s0.im * a0[i].re +
+                              s1.re * a1[i].im - s1.im * a1[i].re;
         }
       }
-    } else  // transB == CTran
-    {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) \
-    shared(A, B, C) private(temp, i, j, l, temp2, adx, bdx)
-      for (l = 0; l < m; l++) {
-        for (j = 0; j < n; j++) {
-          temp.re = 0;
-          temp.im = 0;
-          for (i = 0; i < k; i++) {
-            adx = i + l * k;
-            bdx = i * n + j;
-            temp.re += A[adx].re * B[bdx].re - A[adx].im * (-B[bdx].im);
-            temp.im += A[adx].re * (-B[bdx].im) + A[adx].im * (B[bdx].re);
-          }
-          CXMUL(C[l + m * j], beta, temp2)
-          CXMUL(temp, alpha, temp2) CXADD(C[l + m * j], temp)
+    }
+    for (; l < k; l++) {
+      a0 = A + l * lda;
+      for (j = 0; j < nb; j++) {
+        lo = uplo == Lower ? j : 0;
+        hi = uplo == Lower ? nb : j + 1;
+        s0 = a0[j];
+        for (i = lo; i < hi; i++) {
+          t[i + j * nb].re += s0.re * a0[i].re + s0.im * a0[i].im;
+          t[i + j * nb].im += s0.re * a0[i].im - s0.im * a0[i].re;
         }
       }
     }
-  } else  // transA == CTran
-  {
-    if (transB == NoTran) {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) \
-    shared(A, B, C) private(temp, i, j, l, temp2, adx, bdx)
-      for (l = 0; l < m; l++) {
-        for (j = 0; j < n; j++) {
-          temp.re = 0;
-          temp.im = 0;
-          for (i = 0; i < k; i++) {
-            adx = i + l * k;
-            bdx = i + j * k;
-            temp.re += A[adx].re * B[bdx].re + A[adx].im * (B[bdx].im);
-            temp.im += A[adx].re * B[bdx].im - A[adx].im * (B[bdx].re);
-          }
-          CXMUL(C[l + m * j], beta, temp2)
-          CXMUL(temp, alpha, temp2) CXADD(C[l + m * j], temp)
+  } else {
+    // t(i,j) = conj(A(:,i)) . A(:,j)
+    for (j = 0; j < nb; j++) {
+      lo = uplo == Lower ? j : 0;
+      hi = uplo == Lower ? nb : j + 1;
+      for (i = lo; i < hi; i++) {
+        a0 = A + i * lda;
+        a1 = A + j * lda;
+        s.re = s.im = 0;
+        for (l = 0; l < k; l++) {
+          s.re += a0[l].re * a1[l].re + a0[l].im * a1[l].im;
+          s.im += a0[l].re * a1[l].im - a0[l].im * a1[l].re;
         }
+        t[i + j * nb] = s;
       }
+    }
+  }
 
-    } else if (transB == Tran) {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) \
-    shared(A, B, C) private(i, j, l, adx, bdx, temp, temp2)
-      for (l = 0; l < m; l++) {
-        for (j = 0; j < n; j++) {
-          temp.re = 0;
-          temp.im = 0;
-          for (i = 0; i < k; i++) {
-            adx = i + l * k;
-            bdx = i * n + j;
-            temp.re += A[adx].re * B[bdx].re + (A[adx].im) * B[bdx].im;
-            temp.im += A[adx].re * B[bdx].im - A[adx].im * (B[bdx].re);
-          }
-          CXMUL(C[l + m * j], beta, temp2)
-          CXMUL(temp, alpha, temp2) CXADD(C[l + m * j], temp)
-        }
-      }
-    } else  // transB == CTran
-    {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) \
-    shared(A, B, C) private(i, j, l, adx, bdx, temp, temp2)
-      for (l = 0; l < m; l++) {
-        for (j = 0; j < n; j++) {
-          temp.re = 0;
-          temp.im = 0;
-          for (i = 0; i < k; i++) {
-            adx = i + l * k;
-            bdx = i * n + j;
-            temp.re += A[adx].re * B[bdx].re - A[adx].im * B[bdx].im;
-            temp.im -= A[adx].re * B[bdx].im + A[adx].im * B[bdx].re;
-          }
-          CXMUL(C[l + m * j], beta, temp2)
-          CXMUL(temp, alpha, temp2) CXADD(C[l + m * j], temp)
-        }
+  for (j = 0; j < nb; j++) {
+    lo = uplo == Lower ? j : 0;
+    hi = uplo == Lower ? nb : j + 1;
+    for (i = lo; i < hi; i++) {
+      s = t[i + j * nb];
+      if (beta != 0) {
+        s.re = alpha * s.re + beta * C[i + j * ldc].re;
+        s.im = alpha * s.im + beta * C[i + j * ldc].im;
+      } else {
+        s.re *= alpha;
+        s.im *= alpha;
       }
+      if (i == j) s.im = 0;
+      C[i + j * ldc] = s;
     }
   }
+  mp_release(mark);
+}
+
+/* Same as omp_syrk(), C = alpha * op(A) * op(A)^H + beta * C with real
+ * alpha and beta, op is NoTran or CTran. */
+void omp_herk(char uplo, char trans, UINT n, UINT k, DTYPE alpha, CTYPE* A,
+              UINT lda, DTYPE beta, CTYPE* C, UINT ldc) {
+  ITER i, j, jb;
+  UINT nb, nblk;
+  char ta, tb;
+  CTYPE ca, cb;
+  int par = 0;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  if (n == 0) return;
+  if (k == 0 || alpha == 0) {
+#pragma omp parallel for schedule(static) shared(C) private(i, j)
+    for (j = 0; j < n; j++)
+      for (i = uplo == Lower ? j : 0; i < (uplo == Lower ? n : j + 1); i++) {
+        C[i + j * ldc].re = beta == 0 ? 0 : beta * C[i + j * ldc].re;
+        C[i + j * ldc].im =
+            beta == 0 || i == j ? 0 : beta * C[i + j * ldc].im;
+      }
+    return;
+  }
+
+  // no threads inside a parallel region, as omp_gemm()
+#if USE_OMP
+  par = omp_get_max_threads() > 1 && !omp_in_parallel();
+#endif
+  nblk = (n + SYRK_NB - 1) / SYRK_NB;
+#define HERK_DIAG(jb)                                                        \
+  herk_diag(uplo, trans,                                                     \
+            n - (jb) * SYRK_NB < SYRK_NB ? n - (jb) * SYRK_NB : SYRK_NB, k,  \
+            alpha,                                                           \
+            trans == NoTran ? A + (jb) * SYRK_NB : A + (jb) * SYRK_NB * lda, \
+            lda, beta, C + (jb) * SYRK_NB * (1 + (ITER)ldc), ldc)
+  if (par) {
+#pragma omp parallel for schedule(dynamic, 1) shared(A, C) private(jb)
+    for (jb = 0; jb < nblk; jb++) HERK_DIAG(jb);
+  } else {
+    for (jb = 0; jb < nblk; jb++) HERK_DIAG(jb);
+  }
+#undef HERK_DIAG
+
+  ta = trans == NoTran ? NoTran : CTran;
+  tb = trans == NoTran ? CTran : NoTran;
+  ca.re = alpha;
+  ca.im = 0;
+  cb.re = beta;
+  cb.im = 0;
+  for (jb = 0; jb < n; jb += SYRK_NB) {
+    nb = n - jb < SYRK_NB ? n - jb : SYRK_NB;
+    if (uplo == Lower && jb + nb < n)
+      omp_cgemm(ta, tb, n - jb - nb, nb, k, ca,
+                trans == NoTran ? A + jb + nb : A + (jb + nb) * lda, lda,
+                trans == NoTran ? A + jb : A + jb * lda, lda, cb,
+                C + jb + nb + jb * ldc, ldc);
+    else if (uplo == Upper && jb > 0)
+      omp_cgemm(ta, tb, jb, nb, k, ca, A, lda,
+                trans == NoTran ? A + jb : A + jb * lda, lda, cb,
+                C + jb * ldc, ldc);
+  }
+}
+
+/* route_herk() over batch of slices, same as gemm_batch(). */
+void herk_batch(char uplo, char trans, UINT n, UINT k, DTYPE alpha, CTYPE* A,
+                UINT lda, UINT sa, DTYPE beta, CTYPE* C, UINT ldc, UINT sc,
+                UINT batch) {
+  ITER i;
+  int nt;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  if (batch > 1 && (unsigned long long)n * n * k < GEMM_BATCH_MNK) {
+    nt = batch_blas_begin(BLAS_HERK, (unsigned long long)n * n * k);
+#pragma omp parallel for schedule(dynamic, 1) shared(A, C) private(i)
+    for (i = 0; i < batch; i++)
+      route_herk(uplo, trans, n, k, alpha, A + i * sa, lda, beta, C + i * sc,
+                 ldc);
+    if (nt > 0) blas_set_threads(nt);
+  } else {
+    for (i = 0; i < batch; i++)
+      route_herk(uplo, trans, n, k, alpha, A + i * sa, lda, beta, C + i * sc,
+                 ldc);
+  }
+}
+
+void herk_cmat(char uplo, char trans, DTYPE alpha, CMAT* A, DTYPE beta,
+               CMAT* C) {
+  UINT n, k;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  if (trans == Tran) {
+    printf("ERROR : herk takes NoTran or CTran\n");
+    return;
+  }
+  ASSERT(uplo == Upper || uplo == Lower, "Wrong uplo.\n")
+  n = trans == NoTran ? A->d0 : A->d1;
+  k = trans == NoTran ? A->d1 : A->d0;
+  ASSERT(C->d0 == n && C->d1 == n, "Wrong matrix size.\n")
+  if (A->d2 != C->d2) ASSERT_DIM_INVALID()
+
+  herk_batch(uplo, trans, n, k, alpha, A->data, A->d0, A->d0 * A->d1, beta,
+             C->data, n, n * n, C->d2);
 }
 
 /**** REAL ****/
@@ -594,3 +1445,203 @@ void cmatmul(CMAT* A, CMAT* B, CMAT* C) {
   zero_zero.im = 0;
   gemm_cmat(NoTran, NoTran, one_zero, A, B, zero_zero, C);
 }
+
+/**** gemm of TMAT ****/
+/* Fallback of the precision other than DTYPE, plain column-major kernel.
+ * Columns of C are distributed over threads and the inner loop runs down
+ * a column, so that it vectorizes for NoTran of A. */
+#define TGEMM_DEF(NAME, T)                                                     \
+  static void NAME(char transA, char transB, UINT m, UINT n, UINT k, T alpha, \
+                   T *A, UINT lda, T *B, UINT ldb, T beta, T *C, UINT ldc) {  \
+    ITER i, j, p;                                                              \
+    T b, s, *c;                                                                \
+    _Pragma("omp parallel for schedule(static) private(i, j, p, b, s, c)")     \
+    for (j = 0; j < n; j++) {                                                  \
+      c = C + j * ldc;                                                         \
+      if (transA == NoTran) {                                                  \
+        for (i = 0; i < m; i++) c[i] = beta == 0 ? 0 : beta * c[i];           \
+        for (p = 0; p < k; p++) {                                              \
+          b = alpha * (transB == NoTran ? B[p + j * ldb] : B[j + p * ldb]);    \
+          for (i = 0; i < m; i++) c[i] += A[i + p * lda] * b;                  \
+        }                                                                      \
+      } else {                                                                 \
+        for (i = 0; i < m; i++) {                                              \
+          s = 0;                                                               \
+          for (p = 0; p < k; p++)                                              \
+            s += A[p + i * lda] *                                              \
+                 (transB == NoTran ? B[p + j * ldb] : B[j + p * ldb]);         \
+          c[i] = alpha * s + (beta == 0 ? 0 : beta * c[i]);                    \
+        }                                                                      \
+      }                                                                        \
+    }                                                                          \
+  }
+
+/* x = op(A)(i,p) or op(B)(p,j) with conjugate of CTran */
+#define TCX_LOAD(x, M, trans, r, c, ld) \
+  {                                     \
+    if (trans == NoTran)                \
+      x = M[(r) + (c) * (ld)];          \
+    else                                \
+      x = M[(c) + (r) * (ld)];          \
+    if (trans == CTran) x.im = -x.im;   \
+  }
+
+#define TCGEMM_DEF(NAME, T, CT)                                                \
+  static void NAME(char transA, char transB, UINT m, UINT n, UINT k,          \
+                   CT alpha, CT *A, UINT lda, CT *B, UINT ldb, CT beta, CT *C, \
+                   UINT ldc) {                                                 \
+    ITER i, j, p;                                                              \
+    CT a, b, s, *c;                                                            \
+    T re;                                                                      \
+    _Pragma("omp parallel for schedule(static) private(i, j, p, a, b, s, c, re)") \
+    for (j = 0; j < n; j++) {                                                  \
+      c = C + j * ldc;                                                         \
+      for (i = 0; i < m; i++) {                                                \
+        s.re = s.im = 0;                                                       \
+        for (p = 0; p < k; p++) {                                              \
+          TCX_LOAD(a, A, transA, i, p, lda)                                    \
+          TCX_LOAD(b, B, transB, p, j, ldb)                                    \
+          CXADD_mul(s, a, b)                                                   \
+        }                                                                      \
+        re = alpha.re * s.re - alpha.im * s.im;                                \
+        s.im = alpha.re * s.im + alpha.im * s.re;                              \
+        s.re = re;                                                             \
+        if (beta.re != 0 || beta.im != 0) CXADD_mul(s, beta, c[i])             \
+        c[i] = s;                                                              \
+      }                                                                        \
+    }                                                                          \
+  }
+
+#if NTYPE == 0
+TGEMM_DEF(tgemm_d, double)
+TCGEMM_DEF(tgemm_z, double, CTYPE_D)
+#else
+TGEMM_DEF(tgemm_s, float)
+TCGEMM_DEF(tgemm_c, float, CTYPE_S)
+#endif
+
+/* m, n, k, lda, ldb, ldc of gemm_mat() and the number of slices of C.
+ * A or B of d2 = 1 is broadcast. */
+static UINT tgemm_dims(char transA, char transB, TMAT *A, TMAT *B, TMAT *C,
+                       UINT *m, UINT *n, UINT *k, UINT *ld) {
+  ASSERT(A->dtype == B->dtype && A->dtype == C->dtype,
+         "dtype must be equal.\n")
+  *m = transA == NoTran ? A->d0 : A->d1;
+  *k = transA == NoTran ? A->d1 : A->d0;
+  *n = transB == NoTran ? B->d1 : B->d0;
+  if ((transB == NoTran ? B->d0 : B->d1) != *k || C->d0 != *m || C->d1 != *n)
+    ASSERT_DIM_INVALID()
+  if ((A->d2 != C->d2 && A->d2 != 1) || (B->d2 != C->d2 && B->d2 != 1))
+    ASSERT_DIM_INVALID()
+  ld[0] = A->d0;
+  ld[1] = B->d0;
+  ld[2] = C->d0;
+  return C->d2;
+}
+
+void gemm_tmat(char transA, char transB, double alpha, TMAT *A, TMAT *B,
+               double beta, TMAT *C) {
+  UINT m, n, k, ld[3], nb;
+  ITER i;
+  unsigned long long int sa, sb, sc;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  if (transA == CTran || transB == CTran) {
+    printf("ERROR : can't conjugate transpose real number matrix\n");
+    return;
+  }
+  nb = tgemm_dims(transA, transB, A, B, C, &m, &n, &k, ld);
+  sa = A->d2 == 1 ? 0 : (unsigned long long int)A->d0 * A->d1;
+  sb = B->d2 == 1 ? 0 : (unsigned long long int)B->d0 * B->d1;
+  sc = (unsigned long long int)C->d0 * C->d1;
+
+  for (i = 0; i < nb; i++) {
+    if (A->dtype == DT_S) {
+      float *a = (float *)A->data + i * sa, *b = (float *)B->data + i * sb,
+            *c = (float *)C->data + i * sc;
+#if USE_CBLAS
+      cblas_sgemm(CblasColMajor, transA, transB, m, n, k, (float)alpha, a,
+                  ld[0], b, ld[1], (float)beta, c, ld[2]);
+#elif NTYPE == 0
+      omp_gemm(transA, transB, m, n, k, alpha, a, ld[0], b, ld[1], beta, c,
+               ld[2]);
+#else
+      tgemm_s(transA, transB, m, n, k, (float)alpha, a, ld[0], b, ld[1],
+              (float)beta, c, ld[2]);
+#endif
+    } else if (A->dtype == DT_D) {
+      double *a = (double *)A->data + i * sa, *b = (double *)B->data + i * sb,
+             *c = (double *)C->data + i * sc;
+#if USE_CBLAS
+      cblas_dgemm(CblasColMajor, transA, transB, m, n, k, alpha, a, ld[0], b,
+                  ld[1], beta, c, ld[2]);
+#elif NTYPE == 1
+      omp_gemm(transA, transB, m, n, k, alpha, a, ld[0], b, ld[1], beta, c,
+               ld[2]);
+#else
+      tgemm_d(transA, transB, m, n, k, alpha, a, ld[0], b, ld[1], beta, c,
+              ld[2]);
+#endif
+    } else
+      ASSERT(0, "Use cgemm_tmat() for complex.\n")
+  }
+}
+
+void cgemm_tmat(char transA, char transB, CTYPE_D alpha, TMAT *A, TMAT *B,
+                CTYPE_D beta, TMAT *C) {
+  UINT m, n, k, ld[3], nb;
+  ITER i;
+  unsigned long long int sa, sb, sc;
+  CTYPE_S alpha_s, beta_s;
+  CTYPE alpha_n, beta_n;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  nb = tgemm_dims(transA, transB, A, B, C, &m, &n, &k, ld);
+  sa = A->d2 == 1 ? 0 : (unsigned long long int)A->d0 * A->d1;
+  sb = B->d2 == 1 ? 0 : (unsigned long long int)B->d0 * B->d1;
+  sc = (unsigned long long int)C->d0 * C->d1;
+  alpha_s.re = (float)alpha.re;
+  alpha_s.im = (float)alpha.im;
+  beta_s.re = (float)beta.re;
+  beta_s.im = (float)beta.im;
+  alpha_n.re = alpha.re;
+  alpha_n.im = alpha.im;
+  beta_n.re = beta.re;
+  beta_n.im = beta.im;
+
+  for (i = 0; i < nb; i++) {
+    if (A->dtype == DT_C) {
+      CTYPE_S *a = (CTYPE_S *)A->data + i * sa,
+              *b = (CTYPE_S *)B->data + i * sb,
+              *c = (CTYPE_S *)C->data + i * sc;
+#if USE_CBLAS
+      cblas_cgemm(CblasColMajor, transA, transB, m, n, k, &alpha_s, a, ld[0],
+                  b, ld[1], &beta_s, c, ld[2]);
+#elif NTYPE == 0
+      omp_cgemm(transA, transB, m, n, k, alpha_n, (CTYPE *)a,
+                ld[0], (CTYPE *)b, ld[1], beta_n, (CTYPE *)c,
+                ld[2]);
+#else
+      tgemm_c(transA, transB, m, n, k, alpha_s, a, ld[0], b, ld[1], beta_s, c,
+              ld[2]);
+#endif
+    } else if (A->dtype == DT_Z) {
+      CTYPE_D *a = (CTYPE_D *)A->data + i * sa,
+              *b = (CTYPE_D *)B->data + i * sb,
+              *c = (CTYPE_D *)C->data + i * sc;
+#if USE_CBLAS
+      cblas_zgemm(CblasColMajor, transA, transB, m, n, k, &alpha, a, ld[0], b,
+                  ld[1], &beta, c, ld[2]);
+#elif NTYPE == 1
+      omp_cgemm(transA, transB, m, n, k, alpha_n, (CTYPE *)a, ld[0],
+                (CTYPE *)b, ld[1], beta_n, (CTYPE *)c, ld[2]);
+#else
+      tgemm_z(transA, transB, m, n, k, alpha, a, ld[0], b, ld[1], beta, c,
+              ld[2]);
+#endif
+    } else
+      ASSERT(0, "Use gemm_tmat() for real.\n")
+  }
+}
@@ -11,6 +11,7 @@
  */
 
 #include "iip_fft.h"
+#include "iip_matrix.h"
 
 #if USE_MKL
 
@@ -174,13 +175,15 @@ void ooura_fft_col(UINT N,DTYPE*in,CTYPE*out){
   double*a; 
   int* ip;
   double* w;
+  MP_MARK mark;
   ITER i;
 #if DEBUG
  printf("%s\n",__func__); 
 #endif
-  a = mpalloc(sizeof(double)*N);
-  ip = mpalloc(sizeof(int)*((int)(sqrt(N/2))+1));
-  w = mpalloc(sizeof(double)*(N/2)); 
+  mark = mp_mark();
+  a = mp_scratch(sizeof(double)*N);
+  ip = mp_scratch(sizeof(int)*((int)(sqrt(N/2))+1));
+  w = mp_scratch(sizeof(double)*(N/2)); 
   ip[0]=0;
   for(i=0;i<N;i++)
     a[i] = in[i];
@@ -200,9 +203,7 @@ void ooura_fft_col(UINT N,DTYPE*in,CTYPE*out){
     out[i].im = -out[N-i].im;
   }
 
-  mpfree(w);
-  mpfree(ip);
-  mpfree(a);
+  mp_release(mark);
 
 }
 
@@ -226,14 +227,16 @@ void ooura_ifft_col(UINT N,CTYPE*in,DTYPE*out){
 double*a; 
 int* ip;
 double* w;
+MP_MARK mark;
 ITER i;
 
 #if DEBUG
  printf("%s\n",__func__); 
 #endif
-a = mpalloc(sizeof(double)*N);
-ip = mpalloc(sizeof(int)*((int)(sqrt(N/2))+1));
-w = mpalloc(sizeof(double)*(N/2)); 
+mark = mp_mark();
+a = mp_scratch(sizeof(double)*N);
+ip = mp_scratch(sizeof(int)*((int)(sqrt(N/2))+1));
+w = mp_scratch(sizeof(double)*(N/2)); 
 ip[0]=0;
 for(i=0;i<N/2;i++){
   a[2*i] = in[i].re;
@@ -251,9 +254,7 @@ for(i=0;i<N;i++){
   out[i] = a[i];
 }
 
-mpfree(w);
-mpfree(ip);
-mpfree(a);
+mp_release(mark);
 }
 
 
@@ -276,14 +277,16 @@ void ooura_cfft_col(UINT N,CTYPE*in,DTYPE*out){
   double*a; 
   int* ip;
   double* w;
+  MP_MARK mark;
   ITER i;
  
 #if DEBUG
  printf("%s\n",__func__); 
 #endif
-  a = mpalloc(sizeof(double)*2*N);
-  ip = mpalloc(sizeof(int)*((int)(sqrt(N))+3));
-  w = mpalloc(sizeof(double)*(N/2)); 
+  mark = mp_mark();
+  a = mp_scratch(sizeof(double)*2*N);
+  ip = mp_scratch(sizeof(int)*((int)(sqrt(N))+3));
+  w = mp_scratch(sizeof(double)*(N/2)); 
   ip[0]=0;
   for(i=0;i<N;i++){
     a[2*i] = in[i].re;
@@ -296,9 +299,7 @@ void ooura_cfft_col(UINT N,CTYPE*in,DTYPE*out){
     out[i]=a[i*2];
   }
 
-  mpfree(w);
-  mpfree(ip);
-  mpfree(a);
+  mp_release(mark);
 
 }
 
@@ -321,14 +322,16 @@ void ooura_cifft_col(UINT N,DTYPE*in,CTYPE*out){
   double*a; 
   int* ip;
   double* w;
+  MP_MARK mark;
   ITER i;
  
 #if DEBUG
  printf("%s\n",__func__); 
 #endif
-  a = mpalloc(sizeof(double)*2*N);
-  ip = mpalloc(sizeof(int)*((int)(sqrt(N))+3));
-  w = mpalloc(sizeof(double)*(N/2)); 
+  mark = mp_mark();
+  a = mp_scratch(sizeof(double)*2*N);
+  ip = mp_scratch(sizeof(int)*((int)(sqrt(N))+3));
+  w = mp_scratch(sizeof(double)*(N/2)); 
   ip[0]=0;
   for(i=0;i<N;i++){
     a[2*i] = in[i];
@@ -346,9 +349,7 @@ void ooura_cifft_col(UINT N,DTYPE*in,CTYPE*out){
     out[i].im=a[i*2 +1];
   }
 
-  mpfree(w);
-  mpfree(ip);
-  mpfree(a);
+  mp_release(mark);
 
 
 }
@@ -372,14 +373,16 @@ void ooura_hfft_col(UINT N, DTYPE* in,CTYPE* out){
   double*a; 
   int* ip;
   double* w;
+  MP_MARK mark;
   ITER i;
  
 #if DEBUG
  printf("%s\n",__func__); 
 #endif
-  a = mpalloc(sizeof(double)*N);
-  ip = mpalloc(sizeof(int)*((int)(sqrt(N/2))+1));
-  w = mpalloc(sizeof(double)*(N/2)); 
+  mark = mp_mark();
+  a = mp_scratch(sizeof(double)*N);
+  ip = mp_scratch(sizeof(int)*((int)(sqrt(N/2))+1));
+  w = mp_scratch(sizeof(double)*(N/2)); 
   ip[0]=0;
   for(i=0;i<N;i++){
     a[i] = in[i];
@@ -395,9 +398,7 @@ void ooura_hfft_col(UINT N, DTYPE* in,CTYPE* out){
   out[N/2].re = a[1];
   out[N/2].im = 0;
 
-  mpfree(w);
-  mpfree(ip);
-  mpfree(a);
+  mp_release(mark);
 }
 
 /**** Inverse Half FFT ****/
@@ -420,14 +421,16 @@ void ooura_hifft_col(UINT N,CTYPE*in,DTYPE*out){
 double*a; 
 int* ip;
 double* w;
+MP_MARK mark;
 ITER i;
 
 #if DEBUG
  printf("%s\n",__func__); 
 #endif
-a = mpalloc(sizeof(double)*N);
-ip = mpalloc(sizeof(int)*((int)(sqrt(N/2))+1));
-w = mpalloc(sizeof(double)*(N/2)); 
+mark = mp_mark();
+a = mp_scratch(sizeof(double)*N);
+ip = mp_scratch(sizeof(int)*((int)(sqrt(N/2))+1));
+w = mp_scratch(sizeof(double)*(N/2)); 
 ip[0]=0;
 for(i=0;i<N/2;i++){
   a[2*i] = in[i].re;
@@ -445,9 +448,121 @@ for(i=0;i<N;i++){
   out[i] = a[i];
 }
 
-mpfree(w);
-mpfree(ip);
-mpfree(a);
+mp_release(mark);
+}
+
+/**** Half FFT of TMAT ****/
+/* DTYPE goes to hfft() and hifft(). Work area of Ooura is double anyway,
+ * so the other precision is only converted on the way in and out. */
+#if NTYPE == 0
+typedef double OTYPE;
+typedef CTYPE_D COTYPE;
+#define DT_OTHER DT_D
+#define DT_COTHER DT_Z
+#else
+typedef float OTYPE;
+typedef CTYPE_S COTYPE;
+#define DT_OTHER DT_S
+#define DT_COTHER DT_C
+#endif
+
+static void ooura_hfft_col_o(UINT N, OTYPE* in, COTYPE* out) {
+  double* a;
+  int* ip;
+  double* w;
+  MP_MARK mark;
+  ITER i;
+
+  mark = mp_mark();
+  a = mp_scratch(sizeof(double) * N);
+  ip = mp_scratch(sizeof(int) * ((int)(sqrt(N / 2)) + 1));
+  w = mp_scratch(sizeof(double) * (N / 2));
+  ip[0] = 0;
+  for (i = 0; i < N; i++) a[i] = in[i];
+
+  rdft(N, 1, a, ip, w);
+
+  for (i = 0; i < (N / 2); i++) {
+    out[i].re = (OTYPE)a[2 * i];
+    out[i].im = (OTYPE)-a[2 * i + 1];
+  }
+  out[0].im = 0;
+  out[N / 2].re = (OTYPE)a[1];
+  out[N / 2].im = 0;
+  mp_release(mark);
+}
+
+static void ooura_hifft_col_o(UINT N, COTYPE* in, OTYPE* out) {
+  double* a;
+  int* ip;
+  double* w;
+  MP_MARK mark;
+  ITER i;
+
+  mark = mp_mark();
+  a = mp_scratch(sizeof(double) * N);
+  ip = mp_scratch(sizeof(int) * ((int)(sqrt(N / 2)) + 1));
+  w = mp_scratch(sizeof(double) * (N / 2));
+  ip[0] = 0;
+  for (i = 0; i < N / 2; i++) {
+    a[2 * i] = in[i].re;
+    a[2 * i + 1] = -in[i].im;
+  }
+  a[1] = in[N / 2].re;
+
+  rdft(N, -1, a, ip, w);
+
+  for (i = 0; i < N; i++) out[i] = (OTYPE)(a[i] * 2.0 / N);
+  mp_release(mark);
+}
+
+void hfft_tmat(TMAT* in, TMAT* out) {
+  MAT m;
+  CMAT c;
+  ITER i, j;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  if (in->dtype == DT_NATIVE && out->dtype == DT_CNATIVE) {
+    m = as_mat(in);
+    c = as_cmat(out);
+    hfft(&m, &c);
+    return;
+  }
+  ASSERT(in->dtype == DT_OTHER && out->dtype == DT_COTHER,
+         "dtype of in and out must be real and complex of same precision.\n")
+  ASSERT(in->d2 == out->d2, "d2 must be eqaul.\n")
+  for (i = 0; i < in->d2; i++)
+    for (j = 0; j < in->d1; j++)
+      ooura_hfft_col_o(in->d0,
+                       (OTYPE*)in->data + i * (in->d0 * in->d1) + j * in->d0,
+                       (COTYPE*)out->data + i * (out->d0 * out->d1) +
+                           j * out->d0);
+}
+
+void hifft_tmat(TMAT* in, TMAT* out) {
+  MAT m;
+  CMAT c;
+  ITER i, j;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  if (in->dtype == DT_CNATIVE && out->dtype == DT_NATIVE) {
+    c = as_cmat(in);
+    m = as_mat(out);
+    hifft(&c, &m);
+    return;
+  }
+  ASSERT(in->dtype == DT_COTHER && out->dtype == DT_OTHER,
+         "dtype of in and out must be complex and real of same precision.\n")
+  ASSERT(in->d1 == out->d1, "d1 must be eqaul.\n")
+  ASSERT(in->d2 == out->d2, "d2 must be eqaul.\n")
+  for (i = 0; i < in->d2; i++)
+    for (j = 0; j < in->d1; j++)
+      ooura_hifft_col_o(out->d0,
+                        (COTYPE*)in->data + i * (in->d0 * in->d1) + j * in->d0,
+                        (OTYPE*)out->data + i * (out->d0 * out->d1) +
+                            j * out->d0);
 }
 
 
@@ -4182,12 +4182,14 @@ CTYPE cdet_6by6(CTYPE* X) {
 /**** LAPACK *aq***/
 void invert_nbyn(DTYPE* X, DTYPE* Y, UINT n) {
   UINT* idx;
+  MP_MARK mark;
   ITER i;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
 #if USE_CBLAS
-  idx = mpalloc(sizeof(UINT) * n);
+  mark = mp_mark();
+  idx = mp_scratch(sizeof(UINT) * n);
 
 #pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(X, Y) private(i)
   for (i = 0; i < n * n; i++) Y[i] = X[i];
@@ -4199,7 +4201,7 @@ void invert_nbyn(DTYPE* X, DTYPE* Y, UINT n) {
   LAPACKE_dgetrf(LAPACK_COL_MAJOR, n, n, Y, n, idx);
   LAPACKE_dgetri(LAPACK_COL_MAJOR, n, Y, n, idx);
 #endif
-  mpfree(idx);
+  mp_release(mark);
 
 #else
   printf("ERROR : 'OpenBLAS' or 'INTEL MKL' is required for this operation\n");
@@ -4209,12 +4211,14 @@ void invert_nbyn(DTYPE* X, DTYPE* Y, UINT n) {
 
 void cinvert_nbyn(CTYPE* X, CTYPE* Y, UINT n) {
   UINT* idx;
+  MP_MARK mark;
   ITER i;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
 #if USE_CBLAS
-  idx = mpalloc(sizeof(UINT) * n);
+  mark = mp_mark();
+  idx = mp_scratch(sizeof(UINT) * n);
 #pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(X, Y) private(i)
   for (i = 0; i < n; i++) {
     Y[i].re = X[i].re;
@@ -4227,7 +4231,7 @@ void cinvert_nbyn(CTYPE* X, CTYPE* Y, UINT n) {
   LAPACKE_zgetrf(LAPACK_COL_MAJOR, n, n, Y, n, idx);
   LAPACKE_zgetri(LAPACK_COL_MAJOR, n, Y, n, idx);
 #endif
-  mpfree(idx);
+  mp_release(mark);
 
 #else
   printf("ERROR : 'OpenBLAS' or 'INTEL MKL' is required for this operation\n");
@@ -609,6 +609,78 @@ void abs_cmat_inc(UINT size, CTYPE* X, ITER incx) {
   }
 }
 
+/**** magnitude and phase of PCMAT ****/
+void abs_pcmat(PCMAT* mat, MAT* des) {
+  ITER i;
+  UINT size;
+  DTYPE *re, *im, *y;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  size = mat->d0 * mat->d1 * mat->d2;
+  if (des->d0 * des->d1 * des->d2 != size) ASSERT_DIM_INVALID()
+  re = mat->re;
+  im = mat->im;
+  y = des->data;
+#pragma omp parallel for schedule(static) shared(re, im, y) private(i)
+  for (i = 0; i < size; i++)
+#if NTYPE == 0
+    y[i] = sqrtf(re[i] * re[i] + im[i] * im[i]);
+#else
+    y[i] = sqrt(re[i] * re[i] + im[i] * im[i]);
+#endif
+}
+
+void angle_pcmat(PCMAT* mat, MAT* des) {
+  ITER i;
+  UINT size;
+  DTYPE *re, *im, *y;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  size = mat->d0 * mat->d1 * mat->d2;
+  if (des->d0 * des->d1 * des->d2 != size) ASSERT_DIM_INVALID()
+  re = mat->re;
+  im = mat->im;
+  y = des->data;
+#pragma omp parallel for schedule(static) shared(re, im, y) private(i)
+  for (i = 0; i < size; i++)
+#if NTYPE == 0
+    y[i] = atan2f(im[i], re[i]);
+#else
+    y[i] = atan2(im[i], re[i]);
+#endif
+}
+
+void polar_pcmat(MAT* mag, MAT* phase, PCMAT* des) {
+  ITER i;
+  UINT size;
+  DTYPE *m, *p, *re, *im;
+  DTYPE r;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  size = des->d0 * des->d1 * des->d2;
+  if (mag->d0 * mag->d1 * mag->d2 != size ||
+      phase->d0 * phase->d1 * phase->d2 != size)
+    ASSERT_DIM_INVALID()
+  m = mag->data;
+  p = phase->data;
+  re = des->re;
+  im = des->im;
+#pragma omp parallel for schedule(static) shared(m, p, re, im) private(i, r)
+  for (i = 0; i < size; i++) {
+    r = m[i];
+#if NTYPE == 0
+    re[i] = r * cosf(p[i]);
+    im[i] = r * sinf(p[i]);
+#else
+    re[i] = r * cos(p[i]);
+    im[i] = r * sin(p[i]);
+#endif
+  }
+}
+
 /**** max ****/
 DTYPE max_mat(MAT* mat, DIM* dim) {
   ITER i;
@@ -927,3 +999,235 @@ CTYPE CX(DTYPE r, DTYPE i) {
   t.im = i;
   return t;
 }
+
+/**** fused element-wise operation ****/
+#define EW_F32(fn) fn##f
+#define EW_F64(fn) fn
+#if NTYPE == 0
+#define EW_FN EW_F32
+#else
+#define EW_FN EW_F64
+#endif
+
+EW_CHAIN ew_chain() {
+  EW_CHAIN chain;
+  chain.n = 0;
+  return chain;
+}
+
+void ew_push(EW_CHAIN* chain, UINT code, DTYPE arg) {
+  ASSERT(chain->n < EW_MAX_OP, "Too many operations in chain.\n")
+  ASSERT(code >= EW_ABS && code <= EW_CEIL, "Invalid operation.\n")
+  chain->op[chain->n].code = code;
+  chain->op[chain->n].arg = arg;
+  chain->op[chain->n].mat = NULL;
+  chain->n++;
+}
+
+void ew_push_mat(EW_CHAIN* chain, UINT code, MAT* mat) {
+  ASSERT(chain->n < EW_MAX_OP, "Too many operations in chain.\n")
+  ASSERT(code >= EW_ADD_MAT && code <= EW_DIV_MAT, "Invalid operation.\n")
+  chain->op[chain->n].code = code;
+  chain->op[chain->n].arg = 0;
+  chain->op[chain->n].mat = mat;
+  chain->n++;
+}
+
+/* ops from k of chain on X[0 .. len), which is at off of the whole.
+ * Returns 1 when divided by zero. Defined for float and double, F maps
+ * a function of math.h to that of T. */
+#define EW_BLOCK_DEF(NAME, T, F)                                             \
+  static int NAME(EW_CHAIN* chain, UINT k, T* X, UINT len, ITER off) {      \
+    ITER i;                                                                  \
+    T a;                                                                     \
+    DTYPE* m;                                                                \
+    int zero = 0;                                                            \
+                                                                             \
+    for (; k < chain->n; k++) {                                              \
+      a = (T)chain->op[k].arg;                                               \
+      m = chain->op[k].mat ? chain->op[k].mat->data + off : NULL;            \
+      switch (chain->op[k].code) {                                           \
+        case EW_ABS:                                                         \
+          for (i = 0; i < len; i++) X[i] = F(fabs)(X[i]);                    \
+          break;                                                             \
+        case EW_SQRT:                                                        \
+          for (i = 0; i < len; i++) X[i] = F(sqrt)(F(fabs)(X[i]));           \
+          break;                                                             \
+        case EW_POW:                                                         \
+          if (a == 2)                                                        \
+            for (i = 0; i < len; i++) X[i] = X[i] * X[i];                    \
+          else                                                               \
+            for (i = 0; i < len; i++) X[i] = F(pow)(X[i], a);                \
+          break;                                                             \
+        case EW_SCAL:                                                        \
+          for (i = 0; i < len; i++) X[i] *= a;                               \
+          break;                                                             \
+        case EW_ADD:                                                         \
+          for (i = 0; i < len; i++) X[i] += a;                               \
+          break;                                                             \
+        case EW_LOG:                                                         \
+          for (i = 0; i < len; i++) X[i] = F(log)(F(fabs)(X[i]));            \
+          break;                                                             \
+        case EW_LOG10:                                                       \
+          for (i = 0; i < len; i++) X[i] = F(log10)(F(fabs)(X[i]));          \
+          break;                                                             \
+        case EW_LOG2:                                                        \
+          for (i = 0; i < len; i++) X[i] = F(log2)(F(fabs)(X[i]));           \
+          break;                                                             \
+        case EW_EXP:                                                         \
+          for (i = 0; i < len; i++) X[i] = F(exp)(X[i]);                     \
+          break;                                                             \
+        case EW_ROUND:                                                       \
+          for (i = 0; i < len; i++) X[i] = F(round)(X[i]);                   \
+          break;                                                             \
+        case EW_FLOOR:                                                       \
+          for (i = 0; i < len; i++) X[i] = F(floor)(X[i]);                   \
+          break;                                                             \
+        case EW_CEIL:                                                        \
+          for (i = 0; i < len; i++) X[i] = F(ceil)(X[i]);                    \
+          break;                                                             \
+        case EW_ADD_MAT:                                                     \
+          for (i = 0; i < len; i++) X[i] += (T)m[i];                         \
+          break;                                                             \
+        case EW_MUL_MAT:                                                     \
+          for (i = 0; i < len; i++) X[i] *= (T)m[i];                         \
+          break;                                                             \
+        case EW_DIV_MAT:                                                     \
+          for (i = 0; i < len; i++) {                                        \
+            zero |= (m[i] == 0);                                             \
+            X[i] /= (T)m[i];                                                 \
+          }                                                                  \
+          break;                                                             \
+      }                                                                      \
+    }                                                                        \
+    return zero;                                                             \
+  }
+
+EW_BLOCK_DEF(ew_block_s, float, EW_F32)
+EW_BLOCK_DEF(ew_block_d, double, EW_F64)
+#if NTYPE == 0
+#define ew_block ew_block_s
+#else
+#define ew_block ew_block_d
+#endif
+
+static void ew_check(EW_CHAIN* chain, UINT size) {
+  ITER k;
+  MAT* m;
+  for (k = 0; k < chain->n; k++) {
+    m = chain->op[k].mat;
+    if (m && m->d0 * m->d1 * m->d2 != size) ASSERT_DIM_INVALID()
+  }
+}
+
+/* chain on CMAT starts at 2 when |X|^2 is taken without sqrt */
+static UINT ew_cmat_start(EW_CHAIN* chain) {
+  ASSERT(chain->n > 0 && chain->op[0].code == EW_ABS,
+         "Chain of CMAT must begin with EW_ABS.\n")
+  return (chain->n > 1 && chain->op[1].code == EW_POW &&
+          chain->op[1].arg == 2)
+             ? 2
+             : 1;
+}
+
+void ew_run(EW_CHAIN* chain, MAT* src, MAT* des) {
+  ITER b, off;
+  UINT size, len, nblk;
+  int zero = 0;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  size = src->d0 * src->d1 * src->d2;
+  if (des->d0 * des->d1 * des->d2 != size) ASSERT_DIM_INVALID()
+  ew_check(chain, size);
+  nblk = (size + EW_BLOCK - 1) / EW_BLOCK;
+
+#pragma omp parallel for schedule(static) shared(chain, src, des) private(b, off, len) reduction(|:zero)
+  for (b = 0; b < nblk; b++) {
+    off = b * EW_BLOCK;
+    len = off + EW_BLOCK < size ? EW_BLOCK : size - off;
+    if (src != des)
+      memcpy(des->data + off, src->data + off, sizeof(DTYPE) * len);
+    zero |= ew_block(chain, 0, des->data + off, len, off);
+  }
+  ASSERT(!zero, "Divide by zero.\n")
+}
+
+void ew_run_cmat(EW_CHAIN* chain, CMAT* src, MAT* des) {
+  ITER b, i, off;
+  UINT size, len, nblk, k;
+  int zero = 0;
+  CTYPE* x;
+  DTYPE* y;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  size = src->d0 * src->d1 * src->d2;
+  if (des->d0 * des->d1 * des->d2 != size) ASSERT_DIM_INVALID()
+  k = ew_cmat_start(chain);
+  ew_check(chain, size);
+  nblk = (size + EW_BLOCK - 1) / EW_BLOCK;
+
+#pragma omp parallel for schedule(static) shared(chain, src, des, k) private(b, i, off, len, x, y) reduction(|:zero)
+  for (b = 0; b < nblk; b++) {
+    off = b * EW_BLOCK;
+    len = off + EW_BLOCK < size ? EW_BLOCK : size - off;
+    x = src->data + off;
+    y = des->data + off;
+    if (k == 2)
+      for (i = 0; i < len; i++) y[i] = x[i].re * x[i].re + x[i].im * x[i].im;
+    else
+      for (i = 0; i < len; i++)
+        y[i] = EW_FN(sqrt)(x[i].re * x[i].re + x[i].im * x[i].im);
+    zero |= ew_block(chain, k, y, len, off);
+  }
+  ASSERT(!zero, "Divide by zero.\n")
+}
+
+/* src of T or complex of T -> des of T */
+#define EW_LOAD(T, CT, F, src, k, y, len, off)                         \
+  {                                                                    \
+    ITER i;                                                            \
+    CT* x = (CT*)src->data + off;                                      \
+    if (k == 0)                                                        \
+      memcpy(y, (T*)src->data + off, sizeof(T) * len);                 \
+    else if (k == 2)                                                   \
+      for (i = 0; i < len; i++) y[i] = x[i].re * x[i].re + x[i].im * x[i].im; \
+    else                                                               \
+      for (i = 0; i < len; i++)                                        \
+        y[i] = F(sqrt)(x[i].re * x[i].re + x[i].im * x[i].im);         \
+  }
+
+void ew_run_tmat(EW_CHAIN* chain, TMAT* src, TMAT* des) {
+  ITER b, off;
+  UINT size, len, nblk, k;
+  int zero = 0;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  ASSERT(des->dtype == DT_S || des->dtype == DT_D, "des must be real.\n")
+  ASSERT(src->dtype == des->dtype || src->dtype == des->dtype + 2,
+         "src must be of same precision as des.\n")
+  size = src->d0 * src->d1 * src->d2;
+  if (des->d0 * des->d1 * des->d2 != size) ASSERT_DIM_INVALID()
+  ew_check(chain, size);
+  // real src is copied in place of |X|
+  k = src->dtype == des->dtype ? 0 : ew_cmat_start(chain);
+  nblk = (size + EW_BLOCK - 1) / EW_BLOCK;
+
+#pragma omp parallel for schedule(static) shared(chain, src, des, k) private(b, off, len) reduction(|:zero)
+  for (b = 0; b < nblk; b++) {
+    off = b * EW_BLOCK;
+    len = off + EW_BLOCK < size ? EW_BLOCK : size - off;
+    if (des->dtype == DT_S) {
+      float* y = (float*)des->data + off;
+      if (src != des) EW_LOAD(float, CTYPE_S, EW_F32, src, k, y, len, off)
+      zero |= ew_block_s(chain, k, y, len, off);
+    } else {
+      double* y = (double*)des->data + off;
+      if (src != des) EW_LOAD(double, CTYPE_D, EW_F64, src, k, y, len, off)
+      zero |= ew_block_d(chain, k, y, len, off);
+    }
+  }
+  ASSERT(!zero, "Divide by zero.\n")
+}
@@ -15,104 +15,110 @@
 
 char str_assert[256];
 
-/**** alloc_mat ****/
-
-MAT *alloc_mat_1d(UINT d0) {
+/**** MAT block ****/
+/* alloc_mat() and zeros() take MAT and its data as one block of slab cache :
+ * header padded to MAT_HEADER_SIZE, then data. The padding keeps size of
+ * the block, so that free_mat() releases both at once. */
+typedef struct MAT_BLOCK_INFO {
+  unsigned long long int size;
+  unsigned int tag;
+} MAT_BLOCK_INFO;
+
+#define MAT_BLOCK_TAG 0x3A7B10C4
+#define MAT_HEADER_SIZE(type)                                       \
+  (((sizeof(type) + sizeof(MAT_BLOCK_INFO) + MEM_ALIGN_SIZE - 1) / \
+    MEM_ALIGN_SIZE) *                                               \
+   MEM_ALIGN_SIZE)
+
+static void *mat_block_alloc(size_t header, unsigned long long int size) {
+  char *block;
+  MAT_BLOCK_INFO *info;
+
+  size += header;
+  block = (char *)mp_slab_alloc(size);
+  ASSERT(block, "Failed to allocate matrix.\n")
+  info = (MAT_BLOCK_INFO *)(block + header - sizeof(MAT_BLOCK_INFO));
+  info->size = size;
+  info->tag = MAT_BLOCK_TAG;
+  return block;
+}
+
+/* Returns 0 if mat is not a block of mat_block_alloc(). */
+static int mat_block_free(void *mat, void *data, size_t header) {
+  MAT_BLOCK_INFO *info;
+
+  if ((char *)data != (char *)mat + header) return 0;
+  info = (MAT_BLOCK_INFO *)((char *)mat + header - sizeof(MAT_BLOCK_INFO));
+  if (info->tag != MAT_BLOCK_TAG) return 0;
+  info->tag = 0;
+  mp_slab_free(mat, info->size);
+  return 1;
+}
+
+static MAT *new_mat(UINT ndim, UINT d0, UINT d1, UINT d2) {
   MAT *mat;
-#if DEBUG
-  printf("%s\n", __func__);
-#endif
 
-  mat = (MAT *)malloc(sizeof(MAT));
-  mat->ndim = 0;
+  mat = (MAT *)mat_block_alloc(MAT_HEADER_SIZE(MAT),
+                               sizeof(DTYPE) * d0 * d1 * d2);
+  mat->ndim = ndim;
   mat->d0 = d0;
-  mat->d1 = 1;
-  mat->d2 = 1;
+  mat->d1 = d1;
+  mat->d2 = d2;
+  mat->data = (DTYPE *)((char *)mat + MAT_HEADER_SIZE(MAT));
+  return mat;
+}
 
-  mat->data = (DTYPE *)malloc(sizeof(DTYPE) * d0);
+static CMAT *new_cmat(UINT ndim, UINT d0, UINT d1, UINT d2) {
+  CMAT *mat;
 
+  mat = (CMAT *)mat_block_alloc(MAT_HEADER_SIZE(CMAT),
+                                sizeof(CTYPE) * d0 * d1 * d2);
+  mat->ndim = ndim;
+  mat->d0 = d0;
+  mat->d1 = d1;
+  mat->d2 = d2;
+  mat->data = (CTYPE *)((char *)mat + MAT_HEADER_SIZE(CMAT));
   return mat;
 }
+
+/**** alloc_mat ****/
+
+MAT *alloc_mat_1d(UINT d0) {
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  return new_mat(0, d0, 1, 1);
+}
 MAT *alloc_mat_2d(UINT d0, UINT d1) {
-  MAT *mat;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
-
-  mat = (MAT *)malloc(sizeof(MAT));
-  mat->ndim = 1;
-  mat->d0 = d0;
-  mat->d1 = d1;
-  mat->d2 = 1;
-
-  mat->data = (DTYPE *)malloc(sizeof(DTYPE) * d0 * d1);
-
-  return mat;
+  return new_mat(1, d0, d1, 1);
 }
 MAT *alloc_mat_3d(UINT d0, UINT d1, UINT d2) {
-  MAT *mat;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
-
-  mat = (MAT *)malloc(sizeof(MAT));
-  mat->ndim = 2;
-  mat->d0 = d0;
-  mat->d1 = d1;
-  mat->d2 = d2;
-
-  mat->data = (DTYPE *)malloc(sizeof(DTYPE) * d0 * d1 * d2);
-
-  return mat;
+  return new_mat(2, d0, d1, d2);
 }
 
 CMAT *alloc_cmat_1d(UINT d0) {
-  CMAT *mat;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
-
-  mat = (CMAT *)malloc(sizeof(CMAT));
-  mat->ndim = 0;
-  mat->d0 = d0;
-  mat->d1 = 1;
-  mat->d2 = 1;
-
-  mat->data = (CTYPE *)malloc(sizeof(CTYPE) * d0);
-
-  return mat;
+  return new_cmat(0, d0, 1, 1);
 }
 CMAT *alloc_cmat_2d(UINT d0, UINT d1) {
-  CMAT *mat;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
-
-  mat = (CMAT *)malloc(sizeof(CMAT));
-  mat->ndim = 1;
-  mat->d0 = d0;
-  mat->d1 = d1;
-  mat->d2 = 1;
-
-  mat->data = (CTYPE *)malloc(sizeof(CTYPE) * d0 * d1);
-
-  return mat;
+  return new_cmat(1, d0, d1, 1);
 }
 CMAT *alloc_cmat_3d(UINT d0, UINT d1, UINT d2) {
-  CMAT *mat;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
-
-  mat = (CMAT *)malloc(sizeof(CMAT));
-  mat->ndim = 2;
-  mat->d0 = d0;
-  mat->d1 = d1;
-  mat->d2 = d2;
-
-  mat->data = (CTYPE *)malloc(sizeof(CTYPE) * d0 * d1 * d2);
-
-  return mat;
+  return new_cmat(2, d0, d1, d2);
 }
 
 /**** allocate MAT in memory pool : mpalloc_mat ***/
@@ -195,6 +201,34 @@ CMAT *mpalloc_cmat_3d(UINT d0, UINT d1, UINT d2) {
   mat->data = mpalloc(sizeof(CTYPE) * d0 * d1 * d2);
   return mat;
 }
+/**** allocate MAT in scratch stack : mp_scratch_mat ***/
+/* Released by mp_release() of a mark taken before. */
+MAT *mp_scratch_mat(UINT d0, UINT d1, UINT d2) {
+  MAT *mat;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  mat = mp_scratch(sizeof(MAT));
+  mat->ndim = 2;
+  mat->d0 = d0;
+  mat->d1 = d1;
+  mat->d2 = d2;
+  mat->data = mp_scratch(sizeof(DTYPE) * d0 * d1 * d2);
+  return mat;
+}
+CMAT *mp_scratch_cmat(UINT d0, UINT d1, UINT d2) {
+  CMAT *mat;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  mat = mp_scratch(sizeof(CMAT));
+  mat->ndim = 2;
+  mat->d0 = d0;
+  mat->d1 = d1;
+  mat->d2 = d2;
+  mat->data = mp_scratch(sizeof(CTYPE) * d0 * d1 * d2);
+  return mat;
+}
 /**** zeros  ****/
 
 MAT *zeros_1d(UINT d0) {
@@ -202,93 +236,56 @@ MAT *zeros_1d(UINT d0) {
 #if DEBUG
   printf("%s\n", __func__);
 #endif
-  mat = (MAT *)malloc(sizeof(MAT));
-  mat->ndim = 0;
-  mat->d0 = d0;
-  mat->d1 = 1;
-  mat->d2 = 1;
-
-  mat->data = (DTYPE *)malloc(sizeof(DTYPE) * d0);
+  mat = new_mat(0, d0, 1, 1);
   memset(mat->data, 0, sizeof(DTYPE) * d0);
-
   return mat;
 }
 
 MAT *zeros_2d(UINT d0, UINT d1) {
+  MAT *mat;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
-  MAT *mat = (MAT *)malloc(sizeof(MAT));
-  mat->ndim = 1;
-  mat->d0 = d0;
-  mat->d1 = d1;
-  mat->d2 = 1;
-
-  mat->data = (DTYPE *)malloc(sizeof(DTYPE) * d0 * d1);
+  mat = new_mat(1, d0, d1, 1);
   memset(mat->data, 0, sizeof(DTYPE) * d0 * d1);
-
   return mat;
 }
 MAT *zeros_3d(UINT d0, UINT d1, UINT d2) {
+  MAT *mat;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
-  MAT *mat = (MAT *)malloc(sizeof(MAT));
-  mat->ndim = 2;
-  mat->d0 = d0;
-  mat->d1 = d1;
-  mat->d2 = d2;
-
-  mat->data = (DTYPE *)malloc(sizeof(DTYPE) * d0 * d1 * d2);
+  mat = new_mat(2, d0, d1, d2);
   memset(mat->data, 0, sizeof(DTYPE) * d0 * d1 * d2);
-
   return mat;
 }
 
 CMAT *czeros_1d(UINT d0) {
+  CMAT *mat;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
-  CMAT *mat = (CMAT *)malloc(sizeof(CMAT));
-  mat->ndim = 0;
-  mat->d0 = d0;
-  mat->d1 = 1;
-  mat->d2 = 1;
-
-  mat->data = (CTYPE *)malloc(sizeof(CTYPE) * d0);
+  mat = new_cmat(0, d0, 1, 1);
   memset(mat->data, 0, sizeof(CTYPE) * d0);
-
   return mat;
 }
 
 CMAT *czeros_2d(UINT d0, UINT d1) {
+  CMAT *mat;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
-  CMAT *mat = (CMAT *)malloc(sizeof(CMAT));
-  mat->ndim = 1;
-  mat->d0 = d0;
-  mat->d1 = d1;
-  mat->d2 = 1;
-
-  mat->data = (CTYPE *)malloc(sizeof(CTYPE) * d0 * d1);
+  mat = new_cmat(1, d0, d1, 1);
   memset(mat->data, 0, sizeof(CTYPE) * d0 * d1);
-
   return mat;
 }
 CMAT *czeros_3d(UINT d0, UINT d1, UINT d2) {
+  CMAT *mat;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
-  CMAT *mat = (CMAT *)malloc(sizeof(CMAT));
-  mat->ndim = 2;
-  mat->d0 = d0;
-  mat->d1 = d1;
-  mat->d2 = d2;
-
-  mat->data = (CTYPE *)malloc(sizeof(CTYPE) * d0 * d1 * d2);
+  mat = new_cmat(2, d0, d1, d2);
   memset(mat->data, 0, sizeof(CTYPE) * d0 * d1 * d2);
-
   return mat;
 }
 
@@ -392,6 +389,12 @@ void fill_inc(UINT N, DTYPE*X, ITER incx, DTYPE v){
 #if DEBUG
   printf("%s\n", __func__);
 #endif
+  if (incx == 1 && IS_ALIGNED(X)) {
+    DTYPE *x = ASSUME_ALIGNED(X);
+#pragma omp parallel for schedule(static) shared(x) private(i)
+    for (i = 0; i < N; i++) x[i] = v;
+    return;
+  }
 #pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(X) private(i)
   for (i = 0; i < N; i+=incx) X[i] = v;
 }
@@ -627,6 +630,219 @@ CMAT *mpcsubmat_3d(CMAT *mat, ITER d0_st, ITER d0_ed, ITER d1_st, ITER d1_ed,
   return submat;
 }
 
+/**** view ****/
+
+MAT_VIEW view_mat(MAT *mat) {
+  MAT_VIEW view;
+
+  view.data = mat->data;
+  view.ndim = mat->ndim;
+  view.d0 = mat->d0;
+  view.d1 = mat->d1;
+  view.d2 = mat->d2;
+  view.ld1 = mat->d0;
+  view.ld2 = mat->d0 * mat->d1;
+  view.trans = 0;
+  return view;
+}
+
+CMAT_VIEW view_cmat(CMAT *mat) {
+  CMAT_VIEW view;
+
+  view.data = mat->data;
+  view.ndim = mat->ndim;
+  view.d0 = mat->d0;
+  view.d1 = mat->d1;
+  view.d2 = mat->d2;
+  view.ld1 = mat->d0;
+  view.ld2 = mat->d0 * mat->d1;
+  view.trans = 0;
+  view.conj = 0;
+  return view;
+}
+
+MAT_VIEW subview_1d(MAT *mat, ITER d0_st, ITER d0_ed) {
+  return subview_3d(mat, d0_st, d0_ed, -1, -1, -1, -1);
+}
+MAT_VIEW subview_2d(MAT *mat, ITER d0_st, ITER d0_ed, ITER d1_st,
+                    ITER d1_ed) {
+  return subview_3d(mat, d0_st, d0_ed, d1_st, d1_ed, -1, -1);
+}
+MAT_VIEW subview_3d(MAT *mat, ITER d0_st, ITER d0_ed, ITER d1_st, ITER d1_ed,
+                    ITER d2_st, ITER d2_ed) {
+  MAT_VIEW view;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  if (d0_st == -1) d0_st = 0;
+  if (d0_ed == -1) d0_ed = mat->d0;
+  if (d1_st == -1) d1_st = 0;
+  if (d1_ed == -1) d1_ed = mat->d1;
+  if (d2_st == -1) d2_st = 0;
+  if (d2_ed == -1) d2_ed = mat->d2;
+
+  ASSERT(0 <= d0_st && d0_st < d0_ed && d0_ed <= mat->d0 && 0 <= d1_st &&
+             d1_st < d1_ed && d1_ed <= mat->d1 && 0 <= d2_st &&
+             d2_st < d2_ed && d2_ed <= mat->d2,
+         "Wrong subview range.\n")
+
+  view.ld1 = mat->d0;
+  view.ld2 = mat->d0 * mat->d1;
+  view.data = mat->data + d0_st + d1_st * view.ld1 + d2_st * view.ld2;
+  view.d0 = d0_ed - d0_st;
+  view.d1 = d1_ed - d1_st;
+  view.d2 = d2_ed - d2_st;
+  view.ndim = view.d2 > 1 ? 2 : (view.d1 > 1 ? 1 : 0);
+  view.trans = 0;
+  return view;
+}
+
+CMAT_VIEW csubview_1d(CMAT *mat, ITER d0_st, ITER d0_ed) {
+  return csubview_3d(mat, d0_st, d0_ed, -1, -1, -1, -1);
+}
+CMAT_VIEW csubview_2d(CMAT *mat, ITER d0_st, ITER d0_ed, ITER d1_st,
+                      ITER d1_ed) {
+  return csubview_3d(mat, d0_st, d0_ed, d1_st, d1_ed, -1, -1);
+}
+CMAT_VIEW csubview_3d(CMAT *mat, ITER d0_st, ITER d0_ed, ITER d1_st,
+                      ITER d1_ed, ITER d2_st, ITER d2_ed) {
+  CMAT_VIEW view;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  if (d0_st == -1) d0_st = 0;
+  if (d0_ed == -1) d0_ed = mat->d0;
+  if (d1_st == -1) d1_st = 0;
+  if (d1_ed == -1) d1_ed = mat->d1;
+  if (d2_st == -1) d2_st = 0;
+  if (d2_ed == -1) d2_ed = mat->d2;
+
+  ASSERT(0 <= d0_st && d0_st < d0_ed && d0_ed <= mat->d0 && 0 <= d1_st &&
+             d1_st < d1_ed && d1_ed <= mat->d1 && 0 <= d2_st &&
+             d2_st < d2_ed && d2_ed <= mat->d2,
+         "Wrong subview range.\n")
+
+  view.ld1 = mat->d0;
+  view.ld2 = mat->d0 * mat->d1;
+  view.data = mat->data + d0_st + d1_st * view.ld1 + d2_st * view.ld2;
+  view.d0 = d0_ed - d0_st;
+  view.d1 = d1_ed - d1_st;
+  view.d2 = d2_ed - d2_st;
+  view.ndim = view.d2 > 1 ? 2 : (view.d1 > 1 ? 1 : 0);
+  view.trans = 0;
+  view.conj = 0;
+  return view;
+}
+
+/* The block, from off to its last element, must lie in data of mat. */
+static void ld_view_check(UINT size, UINT off, UINT d0, UINT d1, UINT ld) {
+  ASSERT(d0 > 0 && d1 > 0 && (d1 == 1 || ld >= d0) &&
+             (unsigned long long)off + (unsigned long long)(d1 - 1) * ld +
+                     d0 <=
+                 size,
+         "Wrong ld_view range.\n")
+}
+
+MAT_VIEW ld_view(MAT *mat, UINT off, UINT d0, UINT d1, UINT ld) {
+  MAT_VIEW view;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  ld_view_check(mat->d0 * mat->d1 * mat->d2, off, d0, d1, ld);
+
+  view.data = mat->data + off;
+  view.d0 = d0;
+  view.d1 = d1;
+  view.d2 = 1;
+  view.ld1 = d1 == 1 ? d0 : ld;
+  view.ld2 = view.ld1 * d1;
+  view.ndim = d1 > 1 ? 1 : 0;
+  view.trans = 0;
+  return view;
+}
+
+CMAT_VIEW ld_cview(CMAT *mat, UINT off, UINT d0, UINT d1, UINT ld) {
+  CMAT_VIEW view;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  ld_view_check(mat->d0 * mat->d1 * mat->d2, off, d0, d1, ld);
+
+  view.data = mat->data + off;
+  view.d0 = d0;
+  view.d1 = d1;
+  view.d2 = 1;
+  view.ld1 = d1 == 1 ? d0 : ld;
+  view.ld2 = view.ld1 * d1;
+  view.ndim = d1 > 1 ? 1 : 0;
+  view.trans = 0;
+  view.conj = 0;
+  return view;
+}
+
+/**** lazy transpose ****/
+
+MAT_VIEW trans_view(MAT_VIEW view) {
+  view.trans = !view.trans;
+  return view;
+}
+
+CMAT_VIEW trans_cview(CMAT_VIEW view) {
+  view.trans = !view.trans;
+  return view;
+}
+
+CMAT_VIEW conj_cview(CMAT_VIEW view) {
+  view.conj = !view.conj;
+  return view;
+}
+
+CMAT_VIEW hermit_cview(CMAT_VIEW view) {
+  view.trans = !view.trans;
+  view.conj = !view.conj;
+  return view;
+}
+
+char view_op(char trans, MAT_VIEW *view) {
+  return ((trans != NoTran) ^ view->trans) ? Tran : NoTran;
+}
+
+char cview_op(char trans, CMAT_VIEW *view) {
+  UINT t, c;
+
+  t = (trans != NoTran) ^ view->trans;
+  c = (trans == CTran) ^ view->conj;
+  if (c && !t) return 0;
+  return t ? (c ? CTran : Tran) : NoTran;
+}
+
+/* Conjugated copy of view on scratch stack, released by mp_release(). */
+CMAT_VIEW mp_scratch_conj(CMAT_VIEW *view) {
+  CMAT_VIEW des;
+  ITER i, j, k;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+
+  des = *view;
+  des.data = mp_scratch(sizeof(CTYPE) * view->d0 * view->d1 * view->d2);
+  des.ld1 = view->d0;
+  des.ld2 = view->d0 * view->d1;
+  des.conj = 0;
+  for (k = 0; k < view->d2; k++)
+#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(des, view) private(i, j)
+    for (j = 0; j < view->d1; j++)
+      for (i = 0; i < view->d0; i++) {
+        des.data[i + j * des.ld1 + k * des.ld2].re =
+            view->data[i + j * view->ld1 + k * view->ld2].re;
+        des.data[i + j * des.ld1 + k * des.ld2].im =
+            -view->data[i + j * view->ld1 + k * view->ld2].im;
+      }
+  return des;
+}
+
 /**** allocate DIM  ****/
 
 DIM *alloc_dim_0d() { return alloc_dim_3d(1, 1, 1); }
@@ -634,7 +850,7 @@ DIM *alloc_dim_1d(UINT d0) { return alloc_dim_3d(d0, 1, 1); }
 DIM *alloc_dim_2d(UINT d0, UINT d1) { return alloc_dim_3d(d0, d1, 1); }
 
 DIM *alloc_dim_3d(UINT d0, UINT d1, UINT d2) {
-  DIM *dim = (DIM *)malloc(sizeof(DIM));
+  DIM *dim = (DIM *)mp_slab_alloc(sizeof(DIM));
 #if DEBUG
   printf("%s\n", __func__);
 #endif
@@ -644,6 +860,13 @@ DIM *alloc_dim_3d(UINT d0, UINT d1, UINT d2) {
   return dim;
 }
 
+void free_dim(DIM *dim) {
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  mp_slab_free(dim, sizeof(DIM));
+}
+
 /**** element operation by DIM ****/
 DTYPE get_by_dim(MAT *mat, DIM *dim) {
   return mat->data[dim->d2 * mat->d0 * mat->d1 + dim->d1 * mat->d1 + dim->d0];
@@ -659,1064 +882,381 @@ void cset_by_dim(CMAT *mat, DIM *dim, CTYPE val) {
   mat->data[dim->d2 * mat->d0 * mat->d1 + dim->d1 * mat->d1 + dim->d0] = val;
 }
 
+/**** broadcasting ****/
+/* A op B -> C over shape of C, where each dim of A and B is 1 or that of C.
+ * A dim of 1 is walked with stride 0. Neighbouring dims which are
+ * contiguous in A, B and C alike are merged, e.g. same shape is one dim
+ * and (257,1,8)+(1,500,1) stays 3 dims.
+ * Rows of the innermost dim are cut in blocks of BCAST_BLOCK and every
+ * block of every row is distributed over threads at once. Inner loop is
+ * specialized for stride 0 or 1 of A and B, so that it vectorizes.
+ * Same shape on aligned data is one run whose blocks all start aligned,
+ * as BCAST_BLOCK elements are a multiple of MEM_ALIGN_SIZE bytes, and is
+ * told so to the compiler(BCAST_ALIGNED()). */
+typedef struct BCAST {
+  UINT ndim;
+  UINT n[3];
+  UINT sa[3];
+  UINT sb[3];
+  UINT sc[3];
+} BCAST;
+
+static BCAST bcast_plan(UINT a0, UINT a1, UINT a2, UINT b0, UINT b1, UINT b2,
+                        UINT c0, UINT c1, UINT c2) {
+  BCAST p;
+  UINT a[3], b[3], c[3];
+  UINT pa = 1, pb = 1, pc = 1;
+  ITER k, m;
+
+  a[0] = a0, a[1] = a1, a[2] = a2;
+  b[0] = b0, b[1] = b1, b[2] = b2;
+  c[0] = c0, c[1] = c1, c[2] = c2;
+
+  p.ndim = 0;
+  for (k = 0; k < 3; k++) {
+    if ((a[k] != c[k] && a[k] != 1) || (b[k] != c[k] && b[k] != 1))
+      ASSERT_DIM_INVALID()
+    if ((a[k] == 1 && b[k] == 1 && c[k] != 1)) ASSERT_DIM_INVALID()
+    if (c[k] != 1) {
+      m = p.ndim;
+      p.n[m] = c[k];
+      p.sa[m] = a[k] == 1 ? 0 : pa;
+      p.sb[m] = b[k] == 1 ? 0 : pb;
+      p.sc[m] = pc;
+      // merge into previous dim when contiguous in all of them
+      if (m > 0 && p.sa[m - 1] * p.n[m - 1] == p.sa[m] &&
+          p.sb[m - 1] * p.n[m - 1] == p.sb[m] &&
+          p.sc[m - 1] * p.n[m - 1] == p.sc[m])
+        p.n[m - 1] *= c[k];
+      else
+        p.ndim++;
+    }
+    pa *= a[k];
+    pb *= b[k];
+    pc *= c[k];
+  }
+  // every dim is 1
+  if (p.ndim == 0) {
+    p.ndim = 1;
+    p.n[0] = 1;
+    p.sa[0] = p.sb[0] = p.sc[0] = 1;
+  }
+  for (k = p.ndim; k < 3; k++) {
+    p.n[k] = 1;
+    p.sa[k] = p.sb[k] = p.sc[k] = 0;
+  }
+  return p;
+}
+
+/* 1 if plan p runs over A, B and C as one aligned run. */
+#define BCAST_ALIGNED(p, T, pa, pb, pc)                                   \
+  ((p).ndim == 1 && (p).sa[0] == 1 && (p).sb[0] == 1 &&                   \
+   BCAST_BLOCK * sizeof(T) % MEM_ALIGN_SIZE == 0 && IS_ALIGNED(pa) &&     \
+   IS_ALIGNED(pb) && IS_ALIGNED(pc))
+
+/* One block of a row. x is an element of A, y of B. */
+#define BCAST_ROW(T, EXPR)                       \
+  {                                              \
+    T x, y;                                      \
+    if (al) {                                    \
+      a = ASSUME_ALIGNED(a);                     \
+      b = ASSUME_ALIGNED(b);                     \
+      c = ASSUME_ALIGNED(c);                     \
+      for (i = 0; i < len; i++) {                \
+        x = a[i];                                \
+        y = b[i];                                \
+        EXPR                                     \
+      }                                          \
+    } else if (sa && sb)                         \
+      for (i = 0; i < len; i++) {                \
+        x = a[i];                                \
+        y = b[i];                                \
+        EXPR                                     \
+      }                                          \
+    else if (sa) {                               \
+      y = b[0];                                  \
+      for (i = 0; i < len; i++) {                \
+        x = a[i];                                \
+        EXPR                                     \
+      }                                          \
+    } else if (sb) {                             \
+      x = a[0];                                  \
+      for (i = 0; i < len; i++) {                \
+        y = b[i];                                \
+        EXPR                                     \
+      }                                          \
+    } else {                                     \
+      x = a[0];                                  \
+      y = b[0];                                  \
+      for (i = 0; i < len; i++) {                \
+        EXPR                                     \
+      }                                          \
+    }                                            \
+  }
+
+static void bcast_run(char op, MAT *A, MAT *B, MAT *C) {
+  BCAST p;
+  ITER t, i, i1, i2, r, st;
+  UINT nblk, len, sa, sb;
+  int zero = 0, al;
+  DTYPE *a, *b, *c;
+
+  p = bcast_plan(A->d0, A->d1, A->d2, B->d0, B->d1, B->d2, C->d0, C->d1,
+                 C->d2);
+  nblk = (p.n[0] + BCAST_BLOCK - 1) / BCAST_BLOCK;
+  sa = p.sa[0];
+  sb = p.sb[0];
+  al = BCAST_ALIGNED(p, DTYPE, A->data, B->data, C->data);
+
+#pragma omp parallel for schedule(static) shared(A, B, C, p) private(t, i, i1, i2, r, st, len, a, b, c) reduction(|:zero)
+  for (t = 0; t < (ITER)p.n[1] * p.n[2] * nblk; t++) {
+    r = t / nblk;
+    st = (t % nblk) * BCAST_BLOCK;
+    len = st + BCAST_BLOCK < p.n[0] ? BCAST_BLOCK : p.n[0] - st;
+    i1 = r % p.n[1];
+    i2 = r / p.n[1];
+    a = A->data + i1 * p.sa[1] + i2 * p.sa[2] + st * sa;
+    b = B->data + i1 * p.sb[1] + i2 * p.sb[2] + st * sb;
+    c = C->data + i1 * p.sc[1] + i2 * p.sc[2] + st;
+    switch (op) {
+      case '+':
+        BCAST_ROW(DTYPE, c[i] = x + y;)
+        break;
+      case '*':
+        BCAST_ROW(DTYPE, c[i] = x * y;)
+        break;
+      case '/':
+        BCAST_ROW(DTYPE, zero |= (y == 0); c[i] = x / y;)
+        break;
+    }
+  }
+  ASSERT(!zero, "Divide by zero.\n")
+}
+
+static void cbcast_run(char op, CMAT *A, CMAT *B, CMAT *C) {
+  BCAST p;
+  ITER t, i, i1, i2, r, st;
+  UINT nblk, len, sa, sb;
+  int zero = 0, al;
+  CTYPE *a, *b, *c;
+  DTYPE re, den;
+
+  p = bcast_plan(A->d0, A->d1, A->d2, B->d0, B->d1, B->d2, C->d0, C->d1,
+                 C->d2);
+  nblk = (p.n[0] + BCAST_BLOCK - 1) / BCAST_BLOCK;
+  sa = p.sa[0];
+  sb = p.sb[0];
+  al = BCAST_ALIGNED(p, CTYPE, A->data, B->data, C->data);
+
+#pragma omp parallel for schedule(static) shared(A, B, C, p) private(t, i, i1, i2, r, st, len, a, b, c, re, den) reduction(|:zero)
+  for (t = 0; t < (ITER)p.n[1] * p.n[2] * nblk; t++) {
+    r = t / nblk;
+    st = (t % nblk) * BCAST_BLOCK;
+    len = st + BCAST_BLOCK < p.n[0] ? BCAST_BLOCK : p.n[0] - st;
+    i1 = r % p.n[1];
+    i2 = r / p.n[1];
+    a = A->data + i1 * p.sa[1] + i2 * p.sa[2] + st * sa;
+    b = B->data + i1 * p.sb[1] + i2 * p.sb[2] + st * sb;
+    c = C->data + i1 * p.sc[1] + i2 * p.sc[2] + st;
+    switch (op) {
+      case '+':
+        BCAST_ROW(CTYPE, c[i].re = x.re + y.re; c[i].im = x.im + y.im;)
+        break;
+      case '*':
+        BCAST_ROW(CTYPE, re = x.re * y.re - x.im * y.im;
+                  c[i].im = x.re * y.im + x.im * y.re; c[i].re = re;)
+        break;
+      case '/':
+        BCAST_ROW(CTYPE, den = y.re * y.re + y.im * y.im; zero |= (den == 0);
+                  re = (x.re * y.re + x.im * y.im) / den;
+                  c[i].im = (x.im * y.re - x.re * y.im) / den; c[i].re = re;)
+        break;
+    }
+  }
+  ASSERT(!zero, "Divide by zero.\n")
+}
+
+/* Same as BCAST_ROW() on planes, (xr,xi) of A and (yr,yi) of B. Each
+ * plane is a plain DTYPE run, so that every loop is an omp simd loop
+ * (also taken by -fopenmp-simd without OpenMP). C may be A or B, which
+ * rules out restrict, but simd only needs no dependency across i. The
+ * temporaries set in a loop are private to each lane. */
+#define PBCAST_PRAGMA(x) _Pragma(#x)
+#define PBCAST_SIMD(...) \
+  PBCAST_PRAGMA(omp simd private(__VA_ARGS__) reduction(| : zero))
+#define PBCAST_ROW(EXPR)                         \
+  {                                              \
+    DTYPE xr, xi, yr, yi;                        \
+    if (al) {                                    \
+      ar = ASSUME_ALIGNED(ar);                   \
+      ai = ASSUME_ALIGNED(ai);                   \
+      br = ASSUME_ALIGNED(br);                   \
+      bi = ASSUME_ALIGNED(bi);                   \
+      cr = ASSUME_ALIGNED(cr);                   \
+      ci = ASSUME_ALIGNED(ci);                   \
+      PBCAST_SIMD(xr, xi, yr, yi, re, den)       \
+      for (i = 0; i < len; i++) {                \
+        xr = ar[i];                              \
+        xi = ai[i];                              \
+        yr = br[i];                              \
+        yi = bi[i];                              \
+        EXPR                                     \
+      }                                          \
+    } else if (sa && sb) {                       \
+      PBCAST_SIMD(xr, xi, yr, yi, re, den)       \
+      for (i = 0; i < len; i++) {                \
+        xr = ar[i];                              \
+        xi = ai[i];                              \
+        yr = br[i];                              \
+        yi = bi[i];                              \
+        EXPR                                     \
+      }                                          \
+    } else if (sa) {                             \
+      yr = br[0];                                \
+      yi = bi[0];                                \
+      PBCAST_SIMD(xr, xi, re, den)               \
+      for (i = 0; i < len; i++) {                \
+        xr = ar[i];                              \
+        xi = ai[i];                              \
+        EXPR                                     \
+      }                                          \
+    } else if (sb) {                             \
+      xr = ar[0];                                \
+      xi = ai[0];                                \
+      PBCAST_SIMD(yr, yi, re, den)               \
+      for (i = 0; i < len; i++) {                \
+        yr = br[i];                              \
+        yi = bi[i];                              \
+        EXPR                                     \
+      }                                          \
+    } else {                                     \
+      xr = ar[0];                                \
+      xi = ai[0];                                \
+      yr = br[0];                                \
+      yi = bi[0];                                \
+      PBCAST_SIMD(re, den)                       \
+      for (i = 0; i < len; i++) {                \
+        EXPR                                     \
+      }                                          \
+    }                                            \
+  }
+
+static void pbcast_run(char op, PCMAT *A, PCMAT *B, PCMAT *C) {
+  BCAST p;
+  ITER t, i, i1, i2, r, st, oa, ob, oc;
+  UINT nblk, len, sa, sb;
+  int zero = 0, al;
+  DTYPE *ar, *ai, *br, *bi, *cr, *ci;
+  DTYPE re, den;
+
+  p = bcast_plan(A->d0, A->d1, A->d2, B->d0, B->d1, B->d2, C->d0, C->d1,
+                 C->d2);
+  nblk = (p.n[0] + BCAST_BLOCK - 1) / BCAST_BLOCK;
+  sa = p.sa[0];
+  sb = p.sb[0];
+  al = BCAST_ALIGNED(p, DTYPE, A->re, B->re, C->re) && IS_ALIGNED(A->im) &&
+       IS_ALIGNED(B->im) && IS_ALIGNED(C->im);
+
+#pragma omp parallel for schedule(static) shared(A, B, C, p) private(t, i, i1, i2, r, st, oa, ob, oc, len, ar, ai, br, bi, cr, ci, re, den) reduction(|:zero)
+  for (t = 0; t < (ITER)p.n[1] * p.n[2] * nblk; t++) {
+    r = t / nblk;
+    st = (t % nblk) * BCAST_BLOCK;
+    len = st + BCAST_BLOCK < p.n[0] ? BCAST_BLOCK : p.n[0] - st;
+    i1 = r % p.n[1];
+    i2 = r / p.n[1];
+    oa = i1 * p.sa[1] + i2 * p.sa[2] + st * sa;
+    ob = i1 * p.sb[1] + i2 * p.sb[2] + st * sb;
+    oc = i1 * p.sc[1] + i2 * p.sc[2] + st;
+    ar = A->re + oa;
+    ai = A->im + oa;
+    br = B->re + ob;
+    bi = B->im + ob;
+    cr = C->re + oc;
+    ci = C->im + oc;
+    switch (op) {
+      case '+':
+        PBCAST_ROW(cr[i] = xr + yr; ci[i] = xi + yi;)
+        break;
+      case '*':
+        PBCAST_ROW(re = xr * yr - xi * yi; ci[i] = xr * yi + xi * yr;
+                   cr[i] = re;)
+        break;
+      case '/':
+        // one division per element, both planes multiply by 1/|y|^2
+        PBCAST_ROW(den = yr * yr + yi * yi; zero |= (den == 0);
+                   den = 1 / den; re = (xr * yr + xi * yi) * den;
+                   ci[i] = (xi * yr - xr * yi) * den; cr[i] = re;)
+        break;
+    }
+  }
+  ASSERT(!zero, "Divide by zero.\n")
+}
+
 /**** add elements - broadcasting ****/
 void add_elements(MAT *A, MAT *B, MAT *C) {
-  ITER i, j;
-  UINT a0, a1, b0, b1;
-  UINT a2, b2, c2;
-  UINT ia, ib, ic;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
+  bcast_run('+', A, B, C);
+}
 
-  a2 = A->d2;
-  b2 = B->d2;
-  c2 = C->d2;
-  a0 = A->d0;
-  a1 = A->d1;
-  b0 = B->d0;
-  b1 = B->d1;
+void cadd_elements(CMAT *A, CMAT *B, CMAT *C) {
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  cbcast_run('+', A, B, C);
+}
 
-  ic = C->d0 * C->d1;
-  /*1 to 1*/
-  if (a2 == b2) {
-    if (c2 != a2) ASSERT_DIM_INVALID()
-    ia = a0 * a1;
-    ib = b0 * b1;
-  }
-  /*1 to b2*/
-  else if (a2 == 1 && b2 != 1) {
-    if (b2 != c2) ASSERT_DIM_INVALID()
-    ia = 0;
-    ib = b0 * b1;
-  }
-  /* 1 to a2 */
-  else if (a2 != 1 && b2 == 1) {
-    if (a2 != c2) ASSERT_DIM_INVALID()
-    ib = 0;
-    ia = a0 * a1;
-  }
-  /* unmatching*/
-  else
-    ASSERT_DIM_INVALID()
+/**** mul elements - broadcasting ****/
+void mul_elements(MAT *A, MAT *B, MAT *C) {
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  bcast_run('*', A, B, C);
+}
 
-  /* 12 broadcasting cases..
-   * a0 a1 b0 b1 | c0 c1
-   * 1  1  1  b1 | 1  b1
-   * 1  1  b0 1  | b0 1
-   * 1  a1 1  1  | 1  a1
-   * a0 1  1  1  | a0 1
-   *
-   * 1  1  b0 b1 | b0 b1
-   * a0 a1 1  1  | a0 a1
-   * 1  a1 b0 1  | b0 a1
-   * a0 1  1  b1 | a0 b1
-   *
-   * 1  a1 b0 b1 | b0 a1 (a1==b1)
-   * a0 1  b0 b1 | b0 b1 (a0==b0)
-   * a0 a1 b0  1 | b0 a1 (a0==b0)
-   * a0 a1 1  b1 | a0 b1 (a1==b1)
-   */
-  // 1 1 1 b1
-  if (((a0 == 1) && (a1 == 1)) && ((b0 == 1) && (b1 != 1))) {
-    if ((C->d0 != 1) || (C->d1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b1; i++) {
-        C->data[ic * j + i] = A->data[ia * j + 0] + B->data[ib * j + i];
-      }
-  }
-  // 1 1 b0 1
-  else if (((a0 == 1) && (a1 == 1)) && ((b0 != 1) && (b1 == 1))) {
-    if ((C->d0 != b0) || (C->d1 != 1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0; i++) {  // b1 -> b0
-        C->data[ic * j + i] = A->data[ia * j + 0] + B->data[ib * j + i];
-      }
-  }
-  // 1 a1 1 1
-  else if (((a0 == 1) && (a1 != 1)) && ((b0 == 1) && (b1 == 1))) {
-    if ((C->d0 != 1) || (C->d1 != a1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a1; i++) {
-        C->data[ic * j + i] = A->data[ia * j + i] + B->data[ib * j + 0];
-      }
-  }
-  // a0 1 1 1
-  else if (((a0 != 1) && (a1 == 1)) && ((b0 == 1) && (b1 == 1))) {
-    if ((C->d0 != a0) || (C->d1 != 1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0; i++) {  // b1 -> a0
-        C->data[ic * j + i] = A->data[ia * j + i] + B->data[ib * j + 0];
-      }
-  }
-  // 1 1 b0 b1
-  else if (((a0 == 1) && (a1 == 1)) && ((b0 != 1) && (b1 != 1))) {
-    if ((C->d0 != b0) || (C->d1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * b1; i++) {
-        C->data[ic * j + i] = A->data[ia * j + 0] + B->data[ib * j + i];
-      }
-  }
-  // a0 a1 1 1
-  else if (((a0 != 1) && (a1 != 1)) && ((b0 == 1) && (b1 == 1))) {
-    if ((C->d0 != a0) || (C->d1 != a1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * a1; i++) {
-        C->data[ic * j + i] = A->data[ia * j + i] + B->data[ib * j + 0];
-      }
-  }
-  // 1 a1 b0 1
-  else if (((a0 == 1) && (a1 != 1)) && ((b0 != 1) && (b1 == 1))) {
-    if ((C->d0 != b0) || (C->d1 != a1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * a1; i++) {
-        C->data[ic * j + i] =
-            A->data[ia * j + i / a1] + B->data[ib * j + i % b0];
-      }
-  }
-  // a0 1 1 b1
-  else if (((a0 != 1) && (a1 == 1)) && ((b0 == 1) && (b1 != 1))) {
-    if ((C->d0 != a0) || (C->d1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * b1; i++) {
-        C->data[ic * j + i] =
-            A->data[ia * j + i % a0] + B->data[ib * j + i / b1];
-      }
-  }
-  // 1  a1 b0 b1 | b0 a1 (a1==b1)
-  else if (((a0 == 1) && (a1 != 1)) && ((b0 != 1) && (b1 != 1))) {
-    if (((C->d0 != b0) || (C->d1 != a1)) || (a1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * a1; i++) {
-        C->data[ic * j + i] = A->data[ia * j + i / b1] + B->data[ib * j + i];
-      }
-  }
-  // a0 1  b0 b1 | b0 b1 (a0==b0)
-  else if (((a0 != 1) && (a1 == 1)) && ((b0 != 1) && (b1 != 1))) {
-    if (((C->d0 != b0) || (C->d1 != b1)) || (a0 != b0)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * b1; i++) {
-        C->data[ic * j + i] = A->data[ia * j + i % b0] + B->data[ib * j + i];
-      }
-  }
-  // a0 a1 b0  1 | b0 a1 (a0==b0)
-  else if (((a0 != 1) && (a1 != 1)) && ((b0 != 1) && (b1 == 1))) {
-    if (((C->d0 != b0) || (C->d1 != a1)) || (a0 != b0)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * a1; i++) {
-        C->data[ic * j + i] = A->data[ia * j + i] + B->data[ib * j + i % a1];
-      }
-  }
-  // a0 a1 1  b1 | a0 b1 (a1==b1)
-  else if (((a0 != 1) && (a1 != 1)) && ((b0 == 1) && (b1 != 1))) {
-    if (((C->d0 != a0) || (C->d1 != b1)) || (a1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * b1; i++) {
-        C->data[ic * j + i] = A->data[ia * j + i] + B->data[ib * j + i / a0];
-      }
-  }
-  // CHANGE
-  // a0 a1 b0  b1 | a0 b1 (a0 == b0 && a1 == b1)
-  else if (a0 == b0 && a1 == b1) {
-    if (((C->d0 != a0) || (C->d1 != b1))) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * b1; i++) {
-        C->data[ic * j + i] = A->data[ia * j + i] + B->data[ib * j + i];
-      }
-  } else
-    ASSERT_DIM_INVALID()
+void cmul_elements(CMAT *A, CMAT *B, CMAT *C) {
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  cbcast_run('*', A, B, C);
 }
 
-void cadd_elements(CMAT *A, CMAT *B, CMAT *C) {
-  ITER i, j;
-  UINT a0, a1, b0, b1;
-  UINT a2, b2, c2;
-  UINT ia, ib, ic;
+/**** div elements - broadcasting ****/
+void div_elements(MAT *A, MAT *B, MAT *C) {
 #if DEBUG
   printf("%s\n", __func__);
 #endif
-
-  a2 = A->d2;
-  b2 = B->d2;
-  c2 = C->d2;
-  a0 = A->d0;
-  a1 = A->d1;
-  b0 = B->d0;
-  b1 = B->d1;
-
-  ic = C->d0 * C->d1;
-  /*1 to 1*/
-  if (a2 == b2) {
-    if (c2 != a2) ASSERT_DIM_INVALID()
-    ia = a0 * a1;
-    ib = b0 * b1;
-  }
-  /*1 to b2*/
-  else if (a2 == 1 && b2 != 1) {
-    if (b2 != c2) ASSERT_DIM_INVALID()
-    ia = 0;
-    ib = b0 * b1;
-  }
-  /* 1 to a2 */
-  else if (a2 != 1 && b2 == 1) {
-    if (a2 != c2) ASSERT_DIM_INVALID()
-    ib = 0;
-    ia = a0 * a1;
-  }
-  /* unmatching*/
-  else
-    ASSERT_DIM_INVALID()
-
-  /* 12 broadcasting cases..
-   * a0 a1 b0 b1 | c0 c1
-   * 1  1  1  b1 | 1  b1
-   * 1  1  b0 1  | b0 1
-   * 1  a1 1  1  | 1  a1
-   * a0 1  1  1  | a0 1
-   *
-   * 1  1  b0 b1 | b0 b1
-   * a0 a1 1  1  | a0 a1
-   * 1  a1 b0 1  | b0 a1
-   * a0 1  1  b1 | a0 b1
-   *
-   * 1  a1 b0 b1 | b0 a1 (a1==b1)
-   * a0 1  b0 b1 | b0 b1 (a0==b0)
-   * a0 a1 b0  1 | b0 a1 (a0==b0)
-   * a0 a1 1  b1 | a0 b1 (a1==b1)
-   */
-  // 1 1 1 b1
-  if (((a0 == 1) && (a1 == 1)) && ((b0 == 1) && (b1 != 1))) {
-    if ((C->d0 != 1) || (C->d1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b1; i++) {
-        CXEADD(C->data[ic * j + i], A->data[ia * j + 0], B->data[ib * j + i])
-      }
-  }
-  // 1 1 b0 1
-  else if (((a0 == 1) && (a1 == 1)) && ((b0 != 1) && (b1 == 1))) {
-    if ((C->d0 != b0) || (C->d1 != 1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0; i++) {
-        CXEADD(C->data[ic * j + i], A->data[ia * j + 0], B->data[ib * j + i])
-      }
-  }
-  // 1 a1 1 1
-  else if (((a0 == 1) && (a1 != 1)) && ((b0 == 1) && (b1 == 1))) {
-    if ((C->d0 != 1) || (C->d1 != a1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a1; i++) {
-        CXEADD(C->data[ic * j + i], A->data[ia * j + i], B->data[ib * j + 0])
-      }
-  }
-  // a0 1 1 1
-  else if (((a0 != 1) && (a1 == 1)) && ((b0 == 1) && (b1 == 1))) {
-    if ((C->d0 != a0) || (C->d1 != 1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0; i++) {
-        CXEADD(C->data[ic * j + i], A->data[ia * j + i], B->data[ib * j + 0])
-      }
-  }
-  // 1 1 b0 b1
-  else if (((a0 == 1) && (a1 == 1)) && ((b0 != 1) && (b1 != 1))) {
-    if ((C->d0 != b0) || (C->d1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * b1; i++) {
-        CXEADD(C->data[ic * j + i], A->data[ia * j + 0], B->data[ib * j + i])
-      }
-  }
-  // a0 a1 1 1
-  else if (((a0 != 1) && (a1 != 1)) && ((b0 == 1) && (b1 == 1))) {
-    if ((C->d0 != a0) || (C->d1 != a1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * a1; i++) {
-        CXEADD(C->data[ic * j + i], A->data[ia * j + i], B->data[ib * j + 0])
-      }
-  }
-  // 1 a1 b0 1
-  else if (((a0 == 1) && (a1 != 1)) && ((b0 != 1) && (b1 == 1))) {
-    if ((C->d0 != b0) || (C->d1 != a1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * a1; i++) {
-        CXEADD(C->data[ic * j + i], A->data[ia * j + i / a1],
-               B->data[ib * j + i % b0])
-      }
-  }
-  // a0 1 1 b1
-  else if (((a0 != 1) && (a1 == 1)) && ((b0 == 1) && (b1 != 1))) {
-    if ((C->d0 != a0) || (C->d1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * b1; i++) {
-        CXEADD(C->data[ic * j + i], A->data[ia * j + i % a0],
-               B->data[ib * j + i / b1])
-      }
-  }
-  // 1  a1 b0 b1 | b0 a1 (a1==b1)
-  else if (((a0 == 1) && (a1 != 1)) && ((b0 != 1) && (b1 != 1))) {
-    if (((C->d0 != b0) || (C->d1 != a1)) || (a1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * a1; i++) {
-        CXEADD(C->data[ic * j + i], A->data[ia * j + i / b1],
-               B->data[ib * j + i])
-      }
-  }
-  // a0 1  b0 b1 | b0 b1 (a0==b0)
-  else if (((a0 != 1) && (a1 == 1)) && ((b0 != 1) && (b1 != 1))) {
-    if (((C->d0 != b0) || (C->d1 != b1)) || (a0 != b0)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * b1; i++) {
-        CXEADD(C->data[ic * j + i], A->data[ia * j + i % b0],
-               B->data[ib * j + i])
-      }
-  }
-  // a0 a1 b0  1 | b0 a1 (a0==b0)
-  else if (((a0 != 1) && (a1 != 1)) && ((b0 != 1) && (b1 == 1))) {
-    if (((C->d0 != b0) || (C->d1 != a1)) || (a0 != b0)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * a1; i++) {
-        CXEADD(C->data[ic * j + i], A->data[ia * j + i],
-               B->data[ib * j + i % a1])
-      }
-  }
-  // a0 a1 1  b1 | a0 b1 (a1==b1)
-  else if (((a0 != 1) && (a1 != 1)) && ((b0 == 1) && (b1 != 1))) {
-    if (((C->d0 != a0) || (C->d1 != b1)) || (a1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * b1; i++) {
-        CXEADD(C->data[ic * j + i], A->data[ia * j + i],
-               B->data[ib * j + i / a0])
-      }
-  }  // a0 a1 b0  b1 | a0 b1 (a0 == b0 && a1 == b1)
-  else if (a0 == b0 && a1 == b1) {
-    if (((C->d0 != a0) || (C->d1 != b1))) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * b1; i++) {
-        CXEADD(C->data[ic * j + i], A->data[ia * j + i], B->data[ib * j + i])
-      }
-  } else
-    ASSERT_DIM_INVALID()
+  bcast_run('/', A, B, C);
 }
 
-/**** mul_elements ****/
-void mul_elements(MAT *A, MAT *B, MAT *C) {
-  ITER i, j;
-  UINT a0, a1, b0, b1;
-  UINT a2, b2, c2;
-  UINT ia, ib, ic;
+void cdiv_elements(CMAT *A, CMAT *B, CMAT *C) {
 #if DEBUG
   printf("%s\n", __func__);
 #endif
-
-  a2 = A->d2;
-  b2 = B->d2;
-  c2 = C->d2;
-  a0 = A->d0;
-  a1 = A->d1;
-  b0 = B->d0;
-  b1 = B->d1;
-
-  ic = C->d0 * C->d1;
-  /*1 to 1*/
-  if (a2 == b2) {
-    if (c2 != a2) ASSERT_DIM_INVALID()
-    ia = a0 * a1;
-    ib = b0 * b1;
-  }
-  /*1 to b2*/
-  else if (a2 == 1 && b2 != 1) {
-    if (b2 != c2) ASSERT_DIM_INVALID()
-    ia = 0;
-    ib = b0 * b1;
-  }
-  /* 1 to a2 */
-  else if (a2 != 1 && b2 == 1) {
-    if (a2 != c2) ASSERT_DIM_INVALID()
-    ib = 0;
-    ia = a0 * a1;
-  }
-  /* unmatching*/
-  else
-    ASSERT_DIM_INVALID()
-
-  /* 12 broadcasting cases..
-   * a0 a1 b0 b1 | c0 c1
-   * 1  1  1  b1 | 1  b1
-   * 1  1  b0 1  | b0 1
-   * 1  a1 1  1  | 1  a1
-   * a0 1  1  1  | a0 1
-   *
-   * 1  1  b0 b1 | b0 b1
-   * a0 a1 1  1  | a0 a1
-   * 1  a1 b0 1  | b0 a1
-   * a0 1  1  b1 | a0 b1
-   *
-   * 1  a1 b0 b1 | b0 a1 (a1==b1)
-   * a0 1  b0 b1 | b0 b1 (a0==b0)
-   * a0 a1 b0  1 | b0 a1 (a0==b0)
-   * a0 a1 1  b1 | a0 b1 (a1==b1)
-   */
-  // 1 1 1 b1
-
-  if (((a0 == 1) && (a1 == 1)) && ((b0 == 1) && (b1 != 1))) {
-    if ((C->d0 != 1) || (C->d1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b1; i++)
-        C->data[ic * j + i] =
-            B->data[ib * j + ib * j + i] * A->data[ia * j + ia * j + 0];
-  }
-  // 1 1 b0 1
-  else if (((a0 == 1) && (a1 == 1)) && ((b0 != 1) && (b1 == 1))) {
-    if ((C->d0 != b0) || (C->d1 != 1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0; i++)
-        C->data[ic * j + i] =
-            B->data[ib * j + ib * j + i] * A->data[ia * j + ia * j + 0];
-  }
-  // 1 a1 1 1
-  else if (((a0 == 1) && (a1 != 1)) && ((b0 == 1) && (b1 == 1))) {
-    if ((C->d0 != 1) || (C->d1 != a1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a1; i++)
-        C->data[ic * j + i] =
-            A->data[ia * j + ia * j + i] * B->data[ib * j + ib * j + 0];
-  }
-  // a0 1 1 1
-  else if (((a0 != 1) && (a1 == 1)) && ((b0 == 1) && (b1 == 1))) {
-    if ((C->d0 != a0) || (C->d1 != 1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0; i++)
-        C->data[ic * j + i] = A->data[ia * j + i] * B->data[ib * j + 0];
-  }
-  // 1 1 b0 b1
-  else if (((a0 == 1) && (a1 == 1)) && ((b0 != 1) && (b1 != 1))) {
-    if ((C->d0 != b0) || (C->d1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * b1; i++)
-        C->data[ic * j + i] = B->data[ib * j + i] * A->data[ia * j + 0];
-  }
-  // a0 a1 1 1
-  else if (((a0 != 1) && (a1 != 1)) && ((b0 == 1) && (b1 == 1))) {
-    if ((C->d0 != a0) || (C->d1 != a1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * a1; i++)
-        C->data[ic * j + i] = A->data[ia * j + i] * B->data[ib * j + 0];
-  }
-  // 1 a1 b0 1
-  else if (((a0 == 1) && (a1 != 1)) && ((b0 != 1) && (b1 == 1))) {
-    if ((C->d0 != b0) || (C->d1 != a1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * a1; i++)
-        C->data[ic * j + i] =
-            B->data[ib * j + i % b0] * A->data[ia * j + i / a1];
-  }
-  // a0 1 1 b1
-  else if (((a0 != 1) && (a1 == 1)) && ((b0 == 1) && (b1 != 1))) {
-    if ((C->d0 != a0) || (C->d1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * b1; i++)
-        C->data[ic * j + i] =
-            B->data[ib * j + i / b1] * A->data[ia * j + i % a0];
-  }
-  // 1  a1 b0 b1 | b0 a1 (a1==b1)
-  else if (((a0 == 1) && (a1 != 1)) && ((b0 != 1) && (b1 != 1))) {
-    if (((C->d0 != b0) || (C->d1 != a1)) || (a1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * a1; i++)
-        C->data[ic * j + i] = A->data[ia * j + i / b1] * B->data[ib * j + i];
-  }
-  // a0 1  b0 b1 | b0 b1 (a0==b0)
-  else if (((a0 != 1) && (a1 == 1)) && ((b0 != 1) && (b1 != 1))) {
-    if (((C->d0 != b0) || (C->d1 != b1)) || (a0 != b0)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * b1; i++)
-        C->data[ic * j + i] = A->data[ia * j + i % b0] * B->data[ib * j + i];
-  }
-  // a0 a1 b0  1 | b0 a1 (a0==b0)
-  else if (((a0 != 1) && (a1 != 1)) && ((b0 != 1) && (b1 == 1))) {
-    if (((C->d0 != b0) || (C->d1 != a1)) || (a0 != b0)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * a1; i++)
-        C->data[ic * j + i] = B->data[ib * j + i % a1] * A->data[ia * j + i];
-  }
-  // a0 a1 1  b1 | a0 b1 (a1==b1)
-  else if (((a0 != 1) && (a1 != 1)) && ((b0 == 1) && (b1 != 1))) {
-    if (((C->d0 != a0) || (C->d1 != b1)) || (a1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * b1; i++)
-        C->data[ic * j + i] = B->data[ib * j + i / a0] * A->data[ia * j + i];
-  }  // a0 a1 b0  b1 | a0 b1 (a0 == b0 && a1 == b1)
-  else if (a0 == b0 && a1 == b1) {
-    if (((C->d0 != a0) || (C->d1 != b1))) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * b1; i++) {
-        C->data[ic * j + i] = A->data[ia * j + i] * B->data[ib * j + i];
-      }
-  } else
-    ASSERT_DIM_INVALID()
+  cbcast_run('/', A, B, C);
 }
 
-void cmul_elements(CMAT *A, CMAT *B, CMAT *C) {
-  ITER i, j;
-  UINT a0, a1, b0, b1;
-  UINT a2, b2, c2;
-  UINT ia, ib, ic;
-#if DEBUG
-  printf("%s\n", __func__);
-#endif
-  a2 = A->d2;
-  b2 = B->d2;
-  c2 = C->d2;
-  a0 = A->d0;
-  a1 = A->d1;
-  b0 = B->d0;
-  b1 = B->d1;
-
-  ic = C->d0 * C->d1;
-  /*1 to 1*/
-  if (a2 == b2) {
-    if (c2 != a2) ASSERT_DIM_INVALID()
-    ia = a0 * a1;
-    ib = b0 * b1;
-  }
-  /*1 to b2*/
-  else if (a2 == 1 && b2 != 1) {
-    if (b2 != c2) ASSERT_DIM_INVALID()
-    ia = 0;
-    ib = b0 * b1;
-  }
-  /* 1 to a2 */
-  else if (a2 != 1 && b2 == 1) {
-    if (a2 != c2) ASSERT_DIM_INVALID()
-    ib = 0;
-    ia = a0 * a1;
-  }
-  /* unmatching*/
-  else
-    ASSERT_DIM_INVALID()
-
-  // 1 1 1 b1
-  if (((a0 == 1) && (a1 == 1)) && ((b0 == 1) && (b1 != 1))) {
-    if ((C->d0 != 1) || (C->d1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b1; i++)
-        CXEMUL(C->data[i], A->data[ia * j + 0], B->data[ib * j + i])
-  }
-  // 1 1 b0 1
-  else if (((a0 == 1) && (a1 == 1)) && ((b0 != 1) && (b1 == 1))) {
-    if ((C->d0 != b0) || (C->d1 != 1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0; i++)
-        CXEMUL(C->data[ic * j + i], A->data[ia * j + 0], B->data[ib * j + i])
-  }
-  // 1 a1 1 1
-  else if (((a0 == 1) && (a1 != 1)) && ((b0 == 1) && (b1 == 1))) {
-    if ((C->d0 != 1) || (C->d1 != a1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a1; i++) // b1 -> a1
-        CXEMUL(C->data[ic * j + i], A->data[ia * j + i], B->data[ib * j + 0])
-  }
-  // a0 1 1 1
-  else if (((a0 != 1) && (a1 == 1)) && ((b0 == 1) && (b1 == 1))) {
-    if ((C->d0 != a0) || (C->d1 != 1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0; i++)
-        CXEMUL(C->data[ic * j + i], A->data[ia * j + i], B->data[ib * j + 0])
-  }
-  // 1 1 b0 b1
-  else if (((a0 == 1) && (a1 == 1)) && ((b0 != 1) && (b1 != 1))) {
-    if ((C->d0 != b0) || (C->d1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * b1; i++)
-        CXEMUL(C->data[ic * j + i], A->data[ia * j + 0], B->data[ib * j + i])
-  }
-  // a0 a1 1 1
-  else if (((a0 != 1) && (a1 != 1)) && ((b0 == 1) && (b1 == 1))) {
-    if ((C->d0 != a0) || (C->d1 != a1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * a1; i++)
-        CXEMUL(C->data[ic * j + i], A->data[ia * j + i], B->data[ib * j + 0])
-  }
-  // 1 a1 b0 1
-  else if (((a0 == 1) && (a1 != 1)) && ((b0 != 1) && (b1 == 1))) {
-    if ((C->d0 != b0) || (C->d1 != a1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * a1; i++)
-        CXEMUL(C->data[ic * j + i], A->data[ia * j + i / a1],
-               B->data[ib * j + i % b0])
-  }
-  // a0 1 1 b1
-  else if (((a0 != 1) && (a1 == 1)) && ((b0 == 1) && (b1 != 1))) {
-    if ((C->d0 != a0) || (C->d1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * b1; i++)
-        CXEMUL(C->data[ic * j + i], A->data[ia * j + i % a0],
-               B->data[ib * j + i / b1])
-  }
-  // 1  a1 b0 b1 | b0 a1 (a1==b1)
-  else if (((a0 == 1) && (a1 != 1)) && ((b0 != 1) && (b1 != 1))) {
-    if (((C->d0 != b0) || (C->d1 != a1)) || (a1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * a1; i++)
-        CXEMUL(C->data[ic * j + i], A->data[ia * j + i / b1],
-               B->data[ib * j + i])
-  }
-  // a0 1  b0 b1 | b0 b1 (a0==b0)
-  else if (((a0 != 1) && (a1 == 1)) && ((b0 != 1) && (b1 != 1))) {
-    if (((C->d0 != b0) || (C->d1 != b1)) || (a0 != b0)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * b1; i++)
-        CXEMUL(C->data[ic * j + i], A->data[ia * j + i % b0],
-               B->data[ib * j + i])
-  }
-  // a0 a1 b0  1 | b0 a1 (a0==b0)
-  else if (((a0 != 1) && (a1 != 1)) && ((b0 != 1) && (b1 == 1))) {
-    if (((C->d0 != b0) || (C->d1 != a1)) || (a0 != b0)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * a1; i++)
-        CXEMUL(C->data[ic * j + i], A->data[ia * j + i],
-               B->data[ib * j + i % a1])
-  }
-  // a0 a1 1  b1 | a0 b1 (a1==b1)
-  else if (((a0 != 1) && (a1 != 1)) && ((b0 == 1) && (b1 != 1))) {
-    if (((C->d0 != a0) || (C->d1 != b1)) || (a1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * b1; i++)
-        CXEMUL(C->data[ic * j + i], A->data[ia * j + i],
-               B->data[ib * j + i / a0])
-  }  // a0 a1 b0  b1 | a0 b1 (a0 == b0 && a1 == b1)
-  else if (a0 == b0 && a1 == b1) {
-    if (((C->d0 != a0) || (C->d1 != b1))) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * b1; i++) {
-        CXEMUL(C->data[ic * j + i], A->data[ia * j + i], B->data[ib * j + i])
-      }
-  } else
-    ASSERT_DIM_INVALID()
+/**** planar element operations - broadcasting ****/
+void padd_elements(PCMAT *A, PCMAT *B, PCMAT *C) {
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  pbcast_run('+', A, B, C);
 }
 
-/**** div_elements - broadcasting operation ****/
-void div_elements(MAT *A, MAT *B, MAT *C) {
-  ITER i, j;
-  UINT a0, a1, b0, b1;
-  UINT a2, b2, c2;
-  UINT ia, ib, ic;
+void pmul_elements(PCMAT *A, PCMAT *B, PCMAT *C) {
 #if DEBUG
   printf("%s\n", __func__);
 #endif
-
-  a2 = A->d2;
-  b2 = B->d2;
-  c2 = C->d2;
-  a0 = A->d0;
-  a1 = A->d1;
-  b0 = B->d0;
-  b1 = B->d1;
-
-  ic = C->d0 * C->d1;
-  /*1 to 1*/
-  if (a2 == b2) {
-    if (c2 != a2) ASSERT_DIM_INVALID()
-    ia = a0 * a1;
-    ib = b0 * b1;
-  }
-  /*1 to b2*/
-  else if (a2 == 1 && b2 != 1) {
-    if (b2 != c2) ASSERT_DIM_INVALID()
-    ia = 0;
-    ib = b0 * b1;
-  }
-  /* 1 to a2 */
-  else if (a2 != 1 && b2 == 1) {
-    if (a2 != c2) ASSERT_DIM_INVALID()
-    ib = 0;
-    ia = a0 * a1;
-  }
-  /* unmatching*/
-  else
-    ASSERT_DIM_INVALID()
-
-  /* 12 broadcasting cases..
-   * a0 a1 b0 b1 | c0 c1
-   * 1  1  1  b1 | 1  b1
-   * 1  1  b0 1  | b0 1
-   * 1  a1 1  1  | 1  a1
-   * a0 1  1  1  | a0 1
-   *
-   * 1  1  b0 b1 | b0 b1
-   * a0 a1 1  1  | a0 a1
-   * 1  a1 b0 1  | b0 a1
-   * a0 1  1  b1 | a0 b1
-   *
-   * 1  a1 b0 b1 | b0 a1 (a1==b1)
-   * a0 1  b0 b1 | b0 b1 (a0==b0)
-   * a0 a1 b0  1 | b0 a1 (a0==b0)
-   * a0 a1 1  b1 | a0 b1 (a1==b1)
-   */
-  // 1 1 1 b1
-  if (((a0 == 1) && (a1 == 1)) && ((b0 == 1) && (b1 != 1))) {
-    if ((C->d0 != 1) || (C->d1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b1; i++) {
-        ASSERT(B->data[ib * j + i], "Divide by zero.\n")
-        C->data[ic * j + i] = A->data[ia * j + 0] / B->data[ib * j + i];
-      }
-  }
-  // 1 1 b0 1
-  else if (((a0 == 1) && (a1 == 1)) && ((b0 != 1) && (b1 == 1))) {
-    if ((C->d0 != b0) || (C->d1 != 1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0; i++) {
-        ASSERT(B->data[ib * j + i], "Divide by zero.\n")
-        C->data[ic * j + i] = A->data[ia * j + 0] / B->data[ib * j + i];
-      }
-  }
-  // 1 a1 1 1
-  else if (((a0 == 1) && (a1 != 1)) && ((b0 == 1) && (b1 == 1))) {
-    if ((C->d0 != 1) || (C->d1 != a1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a1; i++) {
-        ASSERT(B->data[ib * j], "Divide by zero.\n")
-        C->data[ic * j + i] = A->data[ia * j + i] / B->data[ib * j + 0];
-      }
-  }
-  // a0 1 1 1
-  else if (((a0 != 1) && (a1 == 1)) && ((b0 == 1) && (b1 == 1))) {
-    if ((C->d0 != a0) || (C->d1 != 1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a1; i++) {
-        ASSERT(B->data[ib * j], "Divide by zero.\n")
-        C->data[ic * j + i] = A->data[ia * j + i] / B->data[ib * j + 0];
-      }
-  }
-  // 1 1 b0 b1
-  else if (((a0 == 1) && (a1 == 1)) && ((b0 != 1) && (b1 != 1))) {
-    if ((C->d0 != b0) || (C->d1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * b1; i++) {
-        ASSERT(B->data[ib * j + i], "Divide by zero.\n")
-        C->data[ic * j + i] = A->data[ia * j + 0] / B->data[ib * j + i];
-      }
-  }
-  // a0 a1 1 1
-  else if (((a0 != 1) && (a1 != 1)) && ((b0 == 1) && (b1 == 1))) {
-    if ((C->d0 != a0) || (C->d1 != a1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * a1; i++) {
-        ASSERT(B->data[ib * j], "Divide by zero.\n")
-        C->data[ic * j + i] = A->data[ia * j + i] / B->data[ib * j + 0];
-      }
-  }
-  // 1 a1 b0 1
-  else if (((a0 == 1) && (a1 != 1)) && ((b0 != 1) && (b1 == 1))) {
-    if ((C->d0 != b0) || (C->d1 != a1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * a1; i++) {
-        ASSERT(B->data[ib * j + i % b0], "Divide by zero.\n")
-        C->data[ic * j + i] =
-            A->data[ia * j + i / a1] / B->data[ib * j + i % b0];
-      }
-  }
-  // a0 1 1 b1
-  else if (((a0 != 1) && (a1 == 1)) && ((b0 == 1) && (b1 != 1))) {
-    if ((C->d0 != a0) || (C->d1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * b1; i++) {
-        ASSERT(B->data[ib * j + i / b1], "Divide by zero.\n")
-        C->data[ic * j + i] =
-            A->data[ia * j + i % a0] / B->data[ib * j + i / b1];
-      }
-  }
-  // 1  a1 b0 b1 | b0 a1 (a1==b1)
-  else if (((a0 == 1) && (a1 != 1)) && ((b0 != 1) && (b1 != 1))) {
-    if (((C->d0 != b0) || (C->d1 != a1)) || (a1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * a1; i++) {
-        ASSERT(B->data[ib * j + i], "Divide by zero.\n")
-        C->data[ic * j + i] = A->data[ia * j + i / b1] / B->data[ib * j + i];
-      }
-  }
-  // a0 1  b0 b1 | b0 b1 (a0==b0)
-  else if (((a0 != 1) && (a1 == 1)) && ((b0 != 1) && (b1 != 1))) {
-    if (((C->d0 != b0) || (C->d1 != b1)) || (a0 != b0)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * b1; i++) {
-        ASSERT(B->data[ib * j + i], "Divide by zero.\n")
-        C->data[ic * j + i] = A->data[ia * j + i % b0] / B->data[ib * j + i];
-      }
-  }
-  // a0 a1 b0  1 | b0 a1 (a0==b0)
-  else if (((a0 != 1) && (a1 != 1)) && ((b0 != 1) && (b1 == 1))) {
-    if (((C->d0 != b0) || (C->d1 != a1)) || (a0 != b0)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * a1; i++) {
-        ASSERT(B->data[ib * j + i % a1], "Divide by zero.\n")
-        C->data[ic * j + i] = A->data[ia * j + i] / B->data[ib * j + i % a1];
-      }
-  }
-  // a0 a1 1  b1 | a0 b1 (a1==b1)
-  else if (((a0 != 1) && (a1 != 1)) && ((b0 == 1) && (b1 != 1))) {
-    if (((C->d0 != a0) || (C->d1 != b1)) || (a1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * b1; i++) {
-        ASSERT(B->data[ib * j + i / a0], "Divide by zero.\n")
-        C->data[ic * j + i] = A->data[ia * j + i] / B->data[ib * j + i / a0];
-      }
-  }  // a0 a1 b0  b1 | a0 b1 (a0 == b0 && a1 == b1)
-  else if (a0 == b0 && a1 == b1) {
-    if (((C->d0 != a0) || (C->d1 != b1))) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * b1; i++) {
-        ASSERT(B->data[ib * j + i / a0], "Divide by zero.\n")
-        C->data[ic * j + i] = A->data[ia * j + i] / B->data[ib * j + i];
-      }
-  } else
-    ASSERT_DIM_INVALID()
+  pbcast_run('*', A, B, C);
 }
 
-void cdiv_elements(CMAT *A, CMAT *B, CMAT *C) {
-  ITER i, j;
-  UINT a0, a1, b0, b1;
-  UINT a2, b2, c2;
-  UINT ia, ib, ic;
+void pdiv_elements(PCMAT *A, PCMAT *B, PCMAT *C) {
 #if DEBUG
   printf("%s\n", __func__);
 #endif
-
-  a2 = A->d2;
-  b2 = B->d2;
-  c2 = C->d2;
-  a0 = A->d0;
-  a1 = A->d1;
-  b0 = B->d0;
-  b1 = B->d1;
-
-  ic = C->d0 * C->d1;
-  /*1 to 1*/
-  if (a2 == b2) {
-    if (c2 != a2) ASSERT_DIM_INVALID()
-    ia = a0 * a1;
-    ib = b0 * b1;
-  }
-  /*1 to b2*/
-  else if (a2 == 1 && b2 != 1) {
-    if (b2 != c2) ASSERT_DIM_INVALID()
-    ia = 0;
-    ib = b0 * b1;
-  }
-  /* 1 to a2 */
-  else if (a2 != 1 && b2 == 1) {
-    if (a2 != c2) ASSERT_DIM_INVALID()
-    ib = 0;
-    ia = a0 * a1;
-  }
-  /* unmatching*/
-  else
-    ASSERT_DIM_INVALID()
-
-  /* 12 broadcasting cases..
-   * a0 a1 b0 b1 | c0 c1
-   * 1  1  1  b1 | 1  b1
-   * 1  1  b0 1  | b0 1
-   * 1  a1 1  1  | 1  a1
-   * a0 1  1  1  | a0 1
-   *
-   * 1  1  b0 b1 | b0 b1
-   * a0 a1 1  1  | a0 a1
-   * 1  a1 b0 1  | b0 a1
-   * a0 1  1  b1 | a0 b1
-   *
-   * 1  a1 b0 b1 | b0 a1 (a1==b1)
-   * a0 1  b0 b1 | b0 b1 (a0==b0)
-   * a0 a1 b0  1 | b0 a1 (a0==b0)
-   * a0 a1 1  b1 | a0 b1 (a1==b1)
-   */
-  // 1 1 1 b1
-  if (((a0 == 1) && (a1 == 1)) && ((b0 == 1) && (b1 != 1))) {
-    if ((C->d0 != 1) || (C->d1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b1; i++) {
-        CXEDIV(C->data[ic * j + i], A->data[ia * j + 0], B->data[ib * j + i])
-      }
-  }
-  // 1 1 b0 1
-  else if (((a0 == 1) && (a1 == 1)) && ((b0 != 1) && (b1 == 1))) {
-    if ((C->d0 != b0) || (C->d1 != 1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b1; i++) {
-        CXEDIV(C->data[ic * j + i], A->data[ia * j + 0], B->data[ib * j + i])
-      }
-  }
-  // 1 a1 1 1
-  else if (((a0 == 1) && (a1 != 1)) && ((b0 == 1) && (b1 == 1))) {
-    if ((C->d0 != 1) || (C->d1 != a1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a1; i++) {
-        CXEDIV(C->data[ic * j + i], A->data[ia * j + i], B->data[ib * j + 0])
-      }
-  }
-  // a0 1 1 1
-  else if (((a0 != 1) && (a1 == 1)) && ((b0 == 1) && (b1 == 1))) {
-    if ((C->d0 != a0) || (C->d1 != 1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b1; i++) {
-        CXEDIV(C->data[ic * j + i], A->data[ia * j + i], B->data[ib * j + 0])
-      }
-  }
-  // 1 1 b0 b1
-  else if (((a0 == 1) && (a1 == 1)) && ((b0 != 1) && (b1 != 1))) {
-    if ((C->d0 != b0) || (C->d1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * b1; i++) {
-        CXEDIV(C->data[ic * j + i], A->data[ia * j + 0], B->data[ib * j + i])
-      }
-  }
-  // a0 a1 1 1
-  else if (((a0 != 1) && (a1 != 1)) && ((b0 == 1) && (b1 == 1))) {
-    if ((C->d0 != a0) || (C->d1 != a1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * a1; i++) {
-        CXEDIV(C->data[ic * j + i], A->data[ia * j + i], B->data[ib * j + 0])
-      }
-  }
-  // 1 a1 b0 1
-  else if (((a0 == 1) && (a1 != 1)) && ((b0 != 1) && (b1 == 1))) {
-    if ((C->d0 != b0) || (C->d1 != a1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * a1; i++) {
-        CXEDIV(C->data[ic * j + i], A->data[ia * j + i / a1],
-               B->data[ib * j + i % b0])
-      }
-  }
-  // a0 1 1 b1
-  else if (((a0 != 1) && (a1 == 1)) && ((b0 == 1) && (b1 != 1))) {
-    if ((C->d0 != a0) || (C->d1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * b1; i++) {
-        CXEDIV(C->data[ic * j + i], A->data[ia * j + i % a0],
-               B->data[ib * j + i / b1])
-      }
-  }
-  // 1  a1 b0 b1 | b0 a1 (a1==b1)
-  else if (((a0 == 1) && (a1 != 1)) && ((b0 != 1) && (b1 != 1))) {
-    if (((C->d0 != b0) || (C->d1 != a1)) || (a1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * a1; i++) {
-        CXEDIV(C->data[ic * j + i], A->data[ia * j + i / b1],
-               B->data[ib * j + i])
-      }
-  }
-  // a0 1  b0 b1 | b0 b1 (a0==b0)
-  else if (((a0 != 1) && (a1 == 1)) && ((b0 != 1) && (b1 != 1))) {
-    if (((C->d0 != b0) || (C->d1 != b1)) || (a0 != b0)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * b1; i++) {
-        CXEDIV(C->data[ic * j + i], A->data[ia * j + i % b0],
-               B->data[ib * j + i])
-      }
-  }
-  // a0 a1 b0  1 | b0 a1 (a0==b0)
-  else if (((a0 != 1) && (a1 != 1)) && ((b0 != 1) && (b1 == 1))) {
-    if (((C->d0 != b0) || (C->d1 != a1)) || (a0 != b0)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < b0 * a1; i++) {
-        CXEDIV(C->data[ic * j + i], A->data[ia * j + i],
-               B->data[ib * j + i % a1])
-      }
-  }
-  // a0 a1 1  b1 | a0 b1 (a1==b1)
-  else if (((a0 != 1) && (a1 != 1)) && ((b0 == 1) && (b1 != 1))) {
-    if (((C->d0 != a0) || (C->d1 != b1)) || (a1 != b1)) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * b1; i++) {
-        CXEDIV(C->data[ic * j + i], A->data[ia * j + i],
-               B->data[ib * j + i / a0])
-      }
-  }  // a0 a1 b0  b1 | a0 b1 (a0 == b0 && a1 == b1)
-  else if (a0 == b0 && a1 == b1) {
-    if (((C->d0 != a0) || (C->d1 != b1))) ASSERT_DIM_INVALID()
-    for (j = 0; j < c2; j++)
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(C, B, A) private(i)
-      for (i = 0; i < a0 * b1; i++) {
-        CXEDIV(C->data[ic * j + i], A->data[ia * j + i], B->data[ib * j + i])
-      }
-  } else
-    ASSERT_DIM_INVALID()
+  pbcast_run('/', A, B, C);
 }
 
 /**** inverse elements ****/
@@ -1869,18 +1409,255 @@ void cshiftdim(CMAT *mat, SINT n) {
   else
     cpermute(mat, 312);
 }
+/**** tiled kernels of transpose and permute ****/
+
+/* des[j + i*ldd] = src[i + j*lds] for i < m, j < n, in nbatch slices of
+ * srcb and desb apart. Tiles of TRANS_BLOCK are taken, so that a tile of
+ * source stays in L1 while it is read across columns and destination is
+ * written along its columns. Tiles are distributed over threads, over
+ * slices as well. No division per element. */
+static void trans_tile(UINT m, UINT n, UINT nbatch, DTYPE *src, UINT lds,
+                       UINT srcb, DTYPE *des, UINT ldd, UINT desb) {
+  ITER t, i, j, ib, jb, ie, je;
+  UINT nbn = (n + TRANS_BLOCK - 1) / TRANS_BLOCK;
+  DTYPE *s, *d;
+
+#pragma omp parallel for schedule(dynamic,1) shared(src, des) private(t, i, j, ib, jb, ie, je, s, d)
+  for (t = 0; t < nbatch * nbn; t++) {
+    s = src + (t / nbn) * srcb;
+    d = des + (t / nbn) * desb;
+    jb = (t % nbn) * TRANS_BLOCK;
+    je = jb + TRANS_BLOCK < n ? jb + TRANS_BLOCK : n;
+    for (ib = 0; ib < m; ib += TRANS_BLOCK) {
+      ie = ib + TRANS_BLOCK < m ? ib + TRANS_BLOCK : m;
+      for (i = ib; i < ie; i++)
+        for (j = jb; j < je; j++) d[j + i * ldd] = s[i + j * lds];
+    }
+  }
+}
+
+static void ctrans_tile(UINT m, UINT n, UINT nbatch, CTYPE *src, UINT lds,
+                        UINT srcb, CTYPE *des, UINT ldd, UINT desb) {
+  ITER t, i, j, ib, jb, ie, je;
+  UINT nbn = (n + TRANS_CBLOCK - 1) / TRANS_CBLOCK;
+  CTYPE *s, *d;
+
+#pragma omp parallel for schedule(dynamic,1) shared(src, des) private(t, i, j, ib, jb, ie, je, s, d)
+  for (t = 0; t < nbatch * nbn; t++) {
+    s = src + (t / nbn) * srcb;
+    d = des + (t / nbn) * desb;
+    jb = (t % nbn) * TRANS_CBLOCK;
+    je = jb + TRANS_CBLOCK < n ? jb + TRANS_CBLOCK : n;
+    for (ib = 0; ib < m; ib += TRANS_CBLOCK) {
+      ie = ib + TRANS_CBLOCK < m ? ib + TRANS_CBLOCK : m;
+      for (i = ib; i < ie; i++)
+        for (j = jb; j < je; j++) d[j + i * ldd] = s[i + j * lds];
+    }
+  }
+}
+
+/* In-place n x n : tile (ib,jb) is swapped with tile (jb,ib) through a
+ * tile on stack, a diagonal tile with itself. Each pair of tiles belongs
+ * to one thread. */
+static void trans_square(UINT n, UINT d2, DTYPE *data) {
+  ITER t, i, j, ib, jb, ie, je;
+  UINT nb = (n + TRANS_BLOCK - 1) / TRANS_BLOCK;
+  DTYPE *a;
+  DTYPE buf[TRANS_BLOCK * TRANS_BLOCK];
+
+#pragma omp parallel for schedule(dynamic,1) shared(data) private(t, i, j, ib, jb, ie, je, a, buf)
+  for (t = 0; t < d2 * nb; t++) {
+    a = data + (t / nb) * n * n;
+    jb = (t % nb) * TRANS_BLOCK;
+    je = jb + TRANS_BLOCK < n ? jb + TRANS_BLOCK : n;
+    for (ib = 0; ib <= jb; ib += TRANS_BLOCK) {
+      ie = ib + TRANS_BLOCK < n ? ib + TRANS_BLOCK : n;
+      // tile (jb,ib) aside, (ib,jb)^T onto it, then the copy^T onto (ib,jb)
+      for (i = ib; i < ie; i++)
+        for (j = jb; j < je; j++) buf[(j - jb) + (i - ib) * TRANS_BLOCK] = a[j + i * n];
+      if (ib != jb)
+        for (i = ib; i < ie; i++)
+          for (j = jb; j < je; j++) a[j + i * n] = a[i + j * n];
+      for (j = jb; j < je; j++)
+        for (i = ib; i < ie; i++) a[i + j * n] = buf[(j - jb) + (i - ib) * TRANS_BLOCK];
+    }
+  }
+}
+
+static void ctrans_square(UINT n, UINT d2, CTYPE *data) {
+  ITER t, i, j, ib, jb, ie, je;
+  UINT nb = (n + TRANS_CBLOCK - 1) / TRANS_CBLOCK;
+  CTYPE *a;
+  CTYPE buf[TRANS_CBLOCK * TRANS_CBLOCK];
+
+#pragma omp parallel for schedule(dynamic,1) shared(data) private(t, i, j, ib, jb, ie, je, a, buf)
+  for (t = 0; t < d2 * nb; t++) {
+    a = data + (t / nb) * n * n;
+    jb = (t % nb) * TRANS_CBLOCK;
+    je = jb + TRANS_CBLOCK < n ? jb + TRANS_CBLOCK : n;
+    for (ib = 0; ib <= jb; ib += TRANS_CBLOCK) {
+      ie = ib + TRANS_CBLOCK < n ? ib + TRANS_CBLOCK : n;
+      // tile (jb,ib) aside, (ib,jb)^T onto it, then the copy^T onto (ib,jb)
+      for (i = ib; i < ie; i++)
+        for (j = jb; j < je; j++) buf[(j - jb) + (i - ib) * TRANS_CBLOCK] = a[j + i * n];
+      if (ib != jb)
+        for (i = ib; i < ie; i++)
+          for (j = jb; j < je; j++) a[j + i * n] = a[i + j * n];
+      for (j = jb; j < je; j++)
+        for (i = ib; i < ie; i++) a[i + j * n] = buf[(j - jb) + (i - ib) * TRANS_CBLOCK];
+    }
+  }
+}
+
+/* In-place d0 x d1 by following cycles of the permutation
+ * k = i + j*d0  ->  j + i*d1 = k*d1 mod (d0*d1 - 1).
+ * Only a bit per element is taken from scratch stack, slices over d2 are
+ * distributed over threads. */
+static void trans_cycle(UINT d0, UINT d1, UINT d2, DTYPE *data) {
+  ITER k, s, p;
+  unsigned long long int n = (unsigned long long int)d0 * d1;
+  UINT nbyte = (UINT)((n + 7) / 8);
+  unsigned char *visit;
+  DTYPE *a;
+  DTYPE temp, next;
+  MP_MARK mark;
+
+  mark = mp_mark();
+  visit = (unsigned char *)mp_scratch(nbyte * d2);
+  memset(visit, 0, nbyte * d2);
+#pragma omp parallel for schedule(dynamic,1) shared(data, visit) private(k, s, p, a, temp, next)
+  for (k = 0; k < d2; k++) {
+    unsigned char *v = visit + k * nbyte;
+    a = data + k * n;
+    for (s = 1; s < (ITER)n - 1; s++) {
+      if (v[s >> 3] & (1 << (s & 7))) continue;
+      temp = a[s];
+      p = s;
+      do {
+        p = (ITER)(((unsigned long long int)p * d1) % (n - 1));
+        next = a[p];
+        a[p] = temp;
+        temp = next;
+        v[p >> 3] |= (unsigned char)(1 << (p & 7));
+      } while (p != s);
+    }
+  }
+  mp_release(mark);
+}
+
+static void ctrans_cycle(UINT d0, UINT d1, UINT d2, CTYPE *data) {
+  ITER k, s, p;
+  unsigned long long int n = (unsigned long long int)d0 * d1;
+  UINT nbyte = (UINT)((n + 7) / 8);
+  unsigned char *visit;
+  CTYPE *a;
+  CTYPE temp, next;
+  MP_MARK mark;
+
+  mark = mp_mark();
+  visit = (unsigned char *)mp_scratch(nbyte * d2);
+  memset(visit, 0, nbyte * d2);
+#pragma omp parallel for schedule(dynamic,1) shared(data, visit) private(k, s, p, a, temp, next)
+  for (k = 0; k < d2; k++) {
+    unsigned char *v = visit + k * nbyte;
+    a = data + k * n;
+    for (s = 1; s < (ITER)n - 1; s++) {
+      if (v[s >> 3] & (1 << (s & 7))) continue;
+      temp = a[s];
+      p = s;
+      do {
+        p = (ITER)(((unsigned long long int)p * d1) % (n - 1));
+        next = a[p];
+        a[p] = temp;
+        temp = next;
+        v[p >> 3] |= (unsigned char)(1 << (p & 7));
+      } while (p != s);
+    }
+  }
+  mp_release(mark);
+}
+
 /**** permutate ****/
 
-/*
- * d2 = i/d0*d1
- * d1 = (i%(d0*d1))/d0
- * d0 = i % d0
- *
+/* Every order but 132 is a batch of 2D transposes of source axis 0
+ * (stride 1) against another axis, new[x,y,z] = old[a,b,c] :
+ *  seq    new dims     m   n   nbatch  lds   srcb  ldd     desb
+ *  213  (d1,d0,d2)    d0  d1    d2     d0    d0d1  d1      d0d1
+ *  231  (d1,d2,d0)    d0  d1    d2     d0    d0d1  d1*d2   d1
+ *  312  (d2,d0,d1)    d0  d2    d1     d0d1  d0    d2      d2*d0
+ *  321  (d2,d1,d0)    d0  d2    d1     d0d1  d0    d2*d1   d2
+ * 132 moves whole columns of d0.
+ * Returns 0 for invalid seq. */
+static int perm_plan(UINT seq, UINT d0, UINT d1, UINT d2, UINT *nd,
+                     UINT *arg) {
+  UINT dim[3];
+  UINT ax[3];
+  UINT d0d1 = d0 * d1;
+
+  dim[0] = d0;
+  dim[1] = d1;
+  dim[2] = d2;
+  ax[0] = seq / 100 - 1;
+  ax[1] = seq / 10 % 10 - 1;
+  ax[2] = seq % 10 - 1;
+  if (ax[0] > 2 || ax[1] > 2 || ax[2] > 2 || ax[0] == ax[1] ||
+      ax[1] == ax[2] || ax[0] == ax[2])
+    return 0;
+  nd[0] = dim[ax[0]];
+  nd[1] = dim[ax[1]];
+  nd[2] = dim[ax[2]];
+
+  arg[0] = d0;
+  switch (seq) {
+    case 213:
+      arg[1] = d1, arg[2] = d2, arg[3] = d0, arg[4] = d0d1;
+      arg[5] = d1, arg[6] = d0d1;
+      break;
+    case 231:
+      arg[1] = d1, arg[2] = d2, arg[3] = d0, arg[4] = d0d1;
+      arg[5] = d1 * d2, arg[6] = d1;
+      break;
+    case 312:
+      arg[1] = d2, arg[2] = d1, arg[3] = d0d1, arg[4] = d0;
+      arg[5] = d2, arg[6] = d2 * d0;
+      break;
+    case 321:
+      arg[1] = d2, arg[2] = d1, arg[3] = d0d1, arg[4] = d0;
+      arg[5] = d2 * d1, arg[6] = d2;
+      break;
+  }
+  return 1;
+}
+
+/* Memory order stays when axes longer than 1 keep their order,
+ * then only dims are changed. */
+static int perm_relabel(UINT seq, UINT d0, UINT d1, UINT d2) {
+  UINT dim[3];
+  UINT ax, k;
+  SINT last = -1;
+
+  dim[0] = d0;
+  dim[1] = d1;
+  dim[2] = d2;
+  for (k = 100; k > 0; k /= 10) {
+    ax = seq / k % 10 - 1;
+    if (dim[ax] == 1) continue;
+    if ((SINT)ax < last) return 0;
+    last = ax;
+  }
+  return 1;
+}
+
+/* Destination is written contiguously, tile by tile(see trans_tile()),
+ * into scratch stack and copied back once. 213 of square slices is
+ * swapped in place, an order which keeps memory order only relabels.
  * */
 void permute(MAT *mat, UINT seq) {
-  ITER i;
-  MAT *t;
-  UINT d0d1;
+  ITER j, k;
+  UINT d0, d1, d2;
+  UINT nd[3], arg[7];
+  DTYPE *t;
+  MP_MARK mark;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
@@ -1888,75 +1665,46 @@ void permute(MAT *mat, UINT seq) {
   /** Nothing to do**/
   if (seq == 123) return;
 
+  d0 = mat->d0;
+  d1 = mat->d1;
+  d2 = mat->d2;
+  if (!perm_plan(seq, d0, d1, d2, nd, arg)) ASSERT_ARG_INVALID()
+
+  mat->d0 = nd[0];
+  mat->d1 = nd[1];
+  mat->d2 = nd[2];
+  if (mat->d2 > 1)
+    mat->ndim = 2;
+  else if (mat->d1 > 1)
+    mat->ndim = 1;
+
+  if (perm_relabel(seq, d0, d1, d2)) return;
+  if (seq == 213 && d0 == d1) {
+    trans_square(d0, d2, mat->data);
+    return;
+  }
+
+  mark = mp_mark();
+  t = (DTYPE *)mp_scratch(sizeof(DTYPE) * d0 * d1 * d2);
   if (seq == 132) {
-    t = mpalloc_mat(mat->d0, mat->d1, mat->d2);
-    copy_mat(mat, t);
-    d0d1 = t->d0 * t->d1;
-    mat->d1 = t->d2;
-    mat->d2 = t->d1;
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(mat, t) private(i)
-    for (i = 0; i < mat->d0 * mat->d1 * mat->d2; i++) {
-      mat->data[((i % d0d1) / t->d0) * mat->d0 * mat->d1 +
-                (i / d0d1) * mat->d0 + i % t->d0] = t->data[i];
-    }
-    mpfree_mat(t);
-  } else if (seq == 213) {
-    t = mpalloc_mat(mat->d0, mat->d1, mat->d2);
-    copy_mat(mat, t);
-    d0d1 = t->d0 * t->d1;
-    mat->d0 = t->d1;
-    mat->d1 = t->d0;
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(mat, t) private(i)
-    for (i = 0; i < mat->d0 * mat->d1 * mat->d2; i++) {
-      mat->data[((i / d0d1)) * mat->d0 * mat->d1 + (i % t->d0) * mat->d0 +
-                (i % d0d1) / t->d0] = t->data[i];
-    }
-    mpfree_mat(t);
-  } else if (seq == 231) {
-    t = mpalloc_mat(mat->d0, mat->d1, mat->d2);
-    copy_mat(mat, t);
-    d0d1 = t->d0 * t->d1;
-    mat->d0 = t->d1;
-    mat->d1 = t->d2;
-    mat->d2 = t->d0;
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(mat, t) private(i)
-    for (i = 0; i < mat->d0 * mat->d1 * mat->d2; i++) {
-      mat->data[(i % t->d0) * mat->d0 * mat->d1 + (i / d0d1) * mat->d0 +
-                (i % d0d1) / t->d0] = t->data[i];
-    }
-    mpfree_mat(t);
-  } else if (seq == 312) {
-    t = mpalloc_mat(mat->d0, mat->d1, mat->d2);
-    copy_mat(mat, t);
-    d0d1 = t->d0 * t->d1;
-    mat->d0 = t->d2;
-    mat->d2 = t->d0;
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(mat, t) private(i)
-    for (i = 0; i < mat->d0 * mat->d1 * mat->d2; i++) {
-      mat->data[(i % d0d1) / t->d0 * mat->d0 * mat->d1 + (i % t->d0) * mat->d0 +
-                i / d0d1] = t->data[i];
-    }
-    mpfree_mat(t);
-  } else if (seq == 321) {
-    t = mpalloc_mat(mat->d0, mat->d1, mat->d2);
-    copy_mat(mat, t);
-    d0d1 = t->d0 * t->d1;
-    mat->d0 = t->d2;
-    mat->d2 = t->d0;
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(mat, t) private(i)
-    for (i = 0; i < mat->d0 * mat->d1 * mat->d2; i++) {
-      mat->data[(i % t->d0) * mat->d0 * mat->d1 + (i % d0d1) / t->d0 * mat->d0 +
-                i / d0d1] = t->data[i];
-    }
-    mpfree_mat(t);
+#pragma omp parallel for schedule(dynamic,1) shared(mat, t) private(j, k)
+    for (j = 0; j < d1; j++)
+      for (k = 0; k < d2; k++)
+        memcpy(t + k * d0 + j * d0 * d2, mat->data + j * d0 + k * d0 * d1,
+               sizeof(DTYPE) * d0);
   } else
-    ASSERT_ARG_INVALID()
+    trans_tile(arg[0], arg[1], arg[2], mat->data, arg[3], arg[4], t, arg[5],
+               arg[6]);
+  memcpy(mat->data, t, sizeof(DTYPE) * d0 * d1 * d2);
+  mp_release(mark);
 }
 
 void cpermute(CMAT *mat, UINT seq) {
-  ITER i;
-  CMAT *t;
-  UINT d0d1;
+  ITER j, k;
+  UINT d0, d1, d2;
+  UINT nd[3], arg[7];
+  CTYPE *t;
+  MP_MARK mark;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
@@ -1964,168 +1712,85 @@ void cpermute(CMAT *mat, UINT seq) {
   /** Nothing to do**/
   if (seq == 123) return;
 
+  d0 = mat->d0;
+  d1 = mat->d1;
+  d2 = mat->d2;
+  if (!perm_plan(seq, d0, d1, d2, nd, arg)) ASSERT_ARG_INVALID()
+
+  mat->d0 = nd[0];
+  mat->d1 = nd[1];
+  mat->d2 = nd[2];
+  if (mat->d2 > 1)
+    mat->ndim = 2;
+  else if (mat->d1 > 1)
+    mat->ndim = 1;
+
+  if (perm_relabel(seq, d0, d1, d2)) return;
+  if (seq == 213 && d0 == d1) {
+    ctrans_square(d0, d2, mat->data);
+    return;
+  }
+
+  mark = mp_mark();
+  t = (CTYPE *)mp_scratch(sizeof(CTYPE) * d0 * d1 * d2);
   if (seq == 132) {
-    t = mpalloc_cmat(mat->d0, mat->d1, mat->d2);
-    ccopy_mat(mat, t);
-    d0d1 = t->d0 * t->d1;
-    mat->d1 = t->d2;
-    mat->d2 = t->d1;
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(mat, t) private(i)
-    for (i = 0; i < mat->d0 * mat->d1 * mat->d2; i++) {
-      mat->data[((i % d0d1) / t->d0) * mat->d0 * mat->d1 +
-                (i / d0d1) * mat->d0 + i % t->d0]
-          .re = t->data[i].re;
-      mat->data[((i % d0d1) / t->d0) * mat->d0 * mat->d1 +
-                (i / d0d1) * mat->d0 + i % t->d0]
-          .im = t->data[i].im;
-    }
-    mpfree_cmat(t);
-  } else if (seq == 213) {
-    t = mpalloc_cmat(mat->d0, mat->d1, mat->d2);
-    ccopy_mat(mat, t);
-    d0d1 = t->d0 * t->d1;
-    mat->d0 = t->d1;
-    mat->d1 = t->d0;
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(mat, t) private(i)
-    for (i = 0; i < mat->d0 * mat->d1 * mat->d2; i++) {
-      mat->data[((i / d0d1)) * mat->d0 * mat->d1 + (i % t->d0) * mat->d0 +
-                (i % d0d1) / t->d0]
-          .re = t->data[i].re;
-      mat->data[((i / d0d1)) * mat->d0 * mat->d1 + (i % t->d0) * mat->d0 +
-                (i % d0d1) / t->d0]
-          .im = t->data[i].im;
-    }
-    mpfree_cmat(t);
-  } else if (seq == 231) {
-    t = mpalloc_cmat(mat->d0, mat->d1, mat->d2);
-    ccopy_mat(mat, t);
-    d0d1 = t->d0 * t->d1;
-    mat->d0 = t->d1;
-    mat->d1 = t->d2;
-    mat->d2 = t->d0;
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(mat, t) private(i)
-    for (i = 0; i < mat->d0 * mat->d1 * mat->d2; i++) {
-      mat->data[(i % t->d0) * mat->d0 * mat->d1 + (i / d0d1) * mat->d0 +
-                (i % d0d1) / t->d0]
-          .re = t->data[i].re;
-      mat->data[(i % t->d0) * mat->d0 * mat->d1 + (i / d0d1) * mat->d0 +
-                (i % d0d1) / t->d0]
-          .im = t->data[i].im;
-    }
-    mpfree_cmat(t);
-  } else if (seq == 312) {
-    t = mpalloc_cmat(mat->d0, mat->d1, mat->d2);
-    ccopy_mat(mat, t);
-    d0d1 = t->d0 * t->d1;
-    mat->d0 = t->d2;
-    mat->d2 = t->d0;
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(mat, t) private(i)
-    for (i = 0; i < mat->d0 * mat->d1 * mat->d2; i++) {
-      mat->data[(i % d0d1) / t->d0 * mat->d0 * mat->d1 + (i % t->d0) * mat->d0 +
-                i / d0d1]
-          .re = t->data[i].re;
-      mat->data[(i % d0d1) / t->d0 * mat->d0 * mat->d1 + (i % t->d0) * mat->d0 +
-                i / d0d1]
-          .im = t->data[i].im;
-    }
-    mpfree_cmat(t);
-  } else if (seq == 321) {
-    t = mpalloc_cmat(mat->d0, mat->d1, mat->d2);
-    ccopy_mat(mat, t);
-    d0d1 = t->d0 * t->d1;
-    mat->d0 = t->d2;
-    mat->d2 = t->d0;
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(mat, t) private(i)
-    for (i = 0; i < mat->d0 * mat->d1 * mat->d2; i++) {
-      mat->data[(i % t->d0) * mat->d0 * mat->d1 + (i % d0d1) / t->d0 * mat->d0 +
-                i / d0d1]
-          .re = t->data[i].re;
-      mat->data[(i % t->d0) * mat->d0 * mat->d1 + (i % d0d1) / t->d0 * mat->d0 +
-                i / d0d1]
-          .im = t->data[i].im;
-    }
-    mpfree_cmat(t);
+#pragma omp parallel for schedule(dynamic,1) shared(mat, t) private(j, k)
+    for (j = 0; j < d1; j++)
+      for (k = 0; k < d2; k++)
+        memcpy(t + k * d0 + j * d0 * d2, mat->data + j * d0 + k * d0 * d1,
+               sizeof(CTYPE) * d0);
   } else
-    ASSERT_ARG_INVALID()
+    ctrans_tile(arg[0], arg[1], arg[2], mat->data, arg[3], arg[4], t, arg[5],
+                arg[6]);
+  memcpy(mat->data, t, sizeof(CTYPE) * d0 * d1 * d2);
+  mp_release(mark);
 }
 /**** transpose ****/
-MAT *create_transpose(MAT *mat) {
-  ITER i, j;
-  UINT d0 = mat->d0;
-  UINT d1 = mat->d1;
-  UINT d2 = mat->d2;
-
+MAT *create_trans(MAT *mat) {
   MAT *t_mat;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
-  if (mat->ndim == 0) {
-    t_mat = alloc_mat(d1, d0);
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(t_mat, mat) private(i)
-    for (i = 0; i < d0; i++) {
-      t_mat->data[i] = mat->data[i];
-    }
-  } else if (mat->ndim == 1) {
-    t_mat = alloc_mat(d1, d0);
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(t_mat, mat) private(i)
-    for (i = 0; i < d0 * d1; i++) {
-      t_mat->data[i / d0 + i % d0 * d1] = mat->data[i];
-    }
-  } else {
-    t_mat = alloc_mat(d1, d0, d2);
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(t_mat, mat) private(i, j)
-    for (j = 0; j < d2; j++) {
-      for (i = 0; i < d0 * d1; i++) {
-        t_mat->data[j * d0 * d1 + i / d0 + i % d0 * d1] =
-            mat->data[j * d0 * d1 + i];
-      }
-    }
-  }
+  if (mat->ndim == 2)
+    t_mat = alloc_mat(mat->d1, mat->d0, mat->d2);
+  else
+    t_mat = alloc_mat(mat->d1, mat->d0);
+
+  // a row or a column keeps its order in memory
+  if (mat->d0 == 1 || mat->d1 == 1)
+    memcpy(t_mat->data, mat->data,
+           sizeof(DTYPE) * mat->d0 * mat->d1 * mat->d2);
+  else
+    trans_tile(mat->d0, mat->d1, mat->d2, mat->data, mat->d0,
+               mat->d0 * mat->d1, t_mat->data, mat->d1, mat->d0 * mat->d1);
   return t_mat;
 }
 
-CMAT *create_ctranspose(CMAT *mat) {
-  ITER i, j;
-  UINT d0 = mat->d0;
-  UINT d1 = mat->d1;
-  UINT d2 = mat->d2;
-
+CMAT *create_ctrans(CMAT *mat) {
   CMAT *t_mat;
 #if DEBUG
   printf("%s\n", __func__);
 #endif
-  if (mat->ndim == 0) {
-    t_mat = alloc_cmat(d1, d0);
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(t_mat, mat) private(i)
-    for (i = 0; i < d0; i++) {
-      t_mat->data[i].re = mat->data[i].re;
-      t_mat->data[i].im = mat->data[i].im;
-    }
-  } else if (mat->ndim == 1) {
-    t_mat = alloc_cmat(d1, d0);
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(t_mat, mat) private(i)
-    for (i = 0; i < d0 * d1; i++) {
-      t_mat->data[i / d0 + i % d0 * d1].re = mat->data[i].re;
-      t_mat->data[i / d0 + i % d0 * d1].im = mat->data[i].im;
-    }
-  } else {
-    t_mat = alloc_cmat(d1, d0, d2);
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(t_mat, mat) private(i, j)
-    for (j = 0; j < d2; j++) {
-      for (i = 0; i < d0 * d1; i++) {
-        t_mat->data[j * d0 * d1 + i / d0 + i % d0 * d1].re =
-            mat->data[j * d0 * d1 + i].re;
-        t_mat->data[j * d0 * d1 + i / d0 + i % d0 * d1].im =
-            mat->data[j * d0 * d1 + i].im;
-      }
-    }
-  }
+  if (mat->ndim == 2)
+    t_mat = alloc_cmat(mat->d1, mat->d0, mat->d2);
+  else
+    t_mat = alloc_cmat(mat->d1, mat->d0);
+
+  if (mat->d0 == 1 || mat->d1 == 1)
+    memcpy(t_mat->data, mat->data,
+           sizeof(CTYPE) * mat->d0 * mat->d1 * mat->d2);
+  else
+    ctrans_tile(mat->d0, mat->d1, mat->d2, mat->data, mat->d0,
+               mat->d0 * mat->d1, t_mat->data, mat->d1, mat->d0 * mat->d1);
   return t_mat;
 }
 
+/* Square is swapped in place. Rectangular goes through a tiled copy on
+ * scratch stack, unless scratch can't take the whole matrix, then cycles
+ * are followed in place(slower, a bit per element). */
 void transpose(MAT *mat) {
-  MAT *temp;
-  ITER i, j;
+  DTYPE *temp;
+  MP_MARK mark;
   UINT d0, d1, d2;
 
 #if DEBUG
@@ -2134,40 +1799,29 @@ void transpose(MAT *mat) {
   d0 = mat->d0;
   d1 = mat->d1;
   d2 = mat->d2;
-  temp = mpalloc_mat(mat->d0, mat->d1, mat->d2);
-  if (mat->ndim == 0) {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(temp, mat) private(i)
-    for (i = 0; i < d0; i++) {
-      temp->data[i] = mat->data[i];
-    }
-    mat->ndim = 1;
-    mat->d0 = d1;
-    mat->d1 = d0;
-  } else if (mat->ndim == 1) {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(temp, mat) private(i)
-    for (i = 0; i < d0 * d1; i++) {
-      temp->data[i / d0 + i % d0 * d1] = mat->data[i];
-    }
-    mat->d0 = d1;
-    mat->d1 = d0;
-  } else {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(temp, mat) private(i, j)
-    for (j = 0; j < d2; j++) {
-      for (i = 0; i < d0 * d1; i++) {
-        temp->data[j * d0 * d1 + i / d0 + i % d0 * d1] =
-            mat->data[j * d0 * d1 + i];
-      }
-    }
-    mat->d0 = d1;
-    mat->d1 = d0;
+  if (mat->ndim == 0) mat->ndim = 1;
+  mat->d0 = d1;
+  mat->d1 = d0;
+  if (d0 == 1 || d1 == 1) return;
+
+  if (d0 == d1) {
+    trans_square(d0, d2, mat->data);
+    return;
   }
-  copy_mat(temp, mat);
-  mpfree_mat(temp);
+  if (sizeof(DTYPE) * d0 * d1 * d2 > TRANS_SCRATCH_MAX) {
+    trans_cycle(d0, d1, d2, mat->data);
+    return;
+  }
+  mark = mp_mark();
+  temp = (DTYPE *)mp_scratch(sizeof(DTYPE) * d0 * d1 * d2);
+  trans_tile(d0, d1, d2, mat->data, d0, d0 * d1, temp, d1, d0 * d1);
+  memcpy(mat->data, temp, sizeof(DTYPE) * d0 * d1 * d2);
+  mp_release(mark);
 }
 
 void ctranspose(CMAT *mat) {
-  CMAT *temp;
-  ITER i, j;
+  CTYPE *temp;
+  MP_MARK mark;
   UINT d0, d1, d2;
 
 #if DEBUG
@@ -2176,39 +1830,97 @@ void ctranspose(CMAT *mat) {
   d0 = mat->d0;
   d1 = mat->d1;
   d2 = mat->d2;
-  temp = mpalloc_cmat(mat->d0, mat->d1, mat->d2);
-  if (mat->ndim == 0) {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(temp, mat) private(i)
-    for (i = 0; i < d0; i++) {
-      temp->data[i].re = mat->data[i].re;
-      temp->data[i].im = mat->data[i].im;
-    }
-    mat->ndim = 1;
-    mat->d0 = d1;
-    mat->d1 = d0;
-  } else if (mat->ndim == 1) {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(temp, mat) private(i)
-    for (i = 0; i < d0 * d1; i++) {
-      temp->data[i / d0 + i % d0 * d1].re = mat->data[i].re;
-      temp->data[i / d0 + i % d0 * d1].im = mat->data[i].im;
+  if (mat->ndim == 0) mat->ndim = 1;
+  mat->d0 = d1;
+  mat->d1 = d0;
+  if (d0 == 1 || d1 == 1) return;
+
+  if (d0 == d1) {
+    ctrans_square(d0, d2, mat->data);
+    return;
+  }
+  if (sizeof(CTYPE) * d0 * d1 * d2 > TRANS_SCRATCH_MAX) {
+    ctrans_cycle(d0, d1, d2, mat->data);
+    return;
+  }
+  mark = mp_mark();
+  temp = (CTYPE *)mp_scratch(sizeof(CTYPE) * d0 * d1 * d2);
+  ctrans_tile(d0, d1, d2, mat->data, d0, d0 * d1, temp, d1, d0 * d1);
+  memcpy(mat->data, temp, sizeof(CTYPE) * d0 * d1 * d2);
+  mp_release(mark);
+}
+
+/* Element (i,j) of the other triangle takes (j,i) of triangle uplo, by
+ * pairs of tiles of TRANS_BLOCK as trans_square(). Slices and columns of
+ * tiles are distributed over threads. */
+void mirror_mat(char uplo, MAT *mat) {
+  ITER t, i, j, ib, jb, ie, je;
+  UINT n, nb;
+  DTYPE *a;
+
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  ASSERT(mat->d0 == mat->d1, "mirror_mat() takes square matrix.\n")
+  ASSERT(uplo == Upper || uplo == Lower, "Wrong uplo.\n")
+  n = mat->d0;
+  nb = (n + TRANS_BLOCK - 1) / TRANS_BLOCK;
+
+#pragma omp parallel for schedule(dynamic,1) shared(mat) private(t, i, j, ib, jb, ie, je, a)
+  for (t = 0; t < mat->d2 * nb; t++) {
+    a = mat->data + (t / nb) * n * n;
+    jb = (t % nb) * TRANS_BLOCK;
+    je = jb + TRANS_BLOCK < n ? jb + TRANS_BLOCK : n;
+    for (ib = 0; ib <= jb; ib += TRANS_BLOCK) {
+      ie = ib + TRANS_BLOCK < n ? ib + TRANS_BLOCK : n;
+      // upper (i,j), i < j, from lower (j,i), or the other way
+      if (uplo == Lower)
+        for (j = jb; j < je; j++)
+          for (i = ib; i < ie && i < j; i++) a[i + j * n] = a[j + i * n];
+      else
+        for (i = ib; i < ie; i++)
+          for (j = i + 1 > jb ? i + 1 : jb; j < je; j++)
+            a[j + i * n] = a[i + j * n];
     }
-    mat->d0 = d1;
-    mat->d1 = d0;
-  } else {
-#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(temp, mat) private(i, j)
-    for (j = 0; j < d2; j++) {
-      for (i = 0; i < d0 * d1; i++) {
-        temp->data[j * d0 * d1 + i / d0 + i % d0 * d1].re =
-            mat->data[j * d0 * d1 + i].re;
-        temp->data[j * d0 * d1 + i / d0 + i % d0 * d1].im =
-            mat->data[j * d0 * d1 + i].im;
-      }
+  }
+}
+
+/* mirror_mat() with conjugation, and real diagonal. */
+void mirror_cmat(char uplo, CMAT *mat) {
+  ITER t, i, j, ib, jb, ie, je;
+  UINT n, nb;
+  CTYPE *a;
+
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  ASSERT(mat->d0 == mat->d1, "mirror_cmat() takes square matrix.\n")
+  ASSERT(uplo == Upper || uplo == Lower, "Wrong uplo.\n")
+  n = mat->d0;
+  nb = (n + TRANS_CBLOCK - 1) / TRANS_CBLOCK;
+
+#pragma omp parallel for schedule(dynamic,1) shared(mat) private(t, i, j, ib, jb, ie, je, a)
+  for (t = 0; t < mat->d2 * nb; t++) {
+    a = mat->data + (t / nb) * n * n;
+    jb = (t % nb) * TRANS_CBLOCK;
+    je = jb + TRANS_CBLOCK < n ? jb + TRANS_CBLOCK : n;
+    for (ib = 0; ib <= jb; ib += TRANS_CBLOCK) {
+      ie = ib + TRANS_CBLOCK < n ? ib + TRANS_CBLOCK : n;
+      if (uplo == Lower)
+        for (j = jb; j < je; j++)
+          for (i = ib; i < ie && i < j; i++) {
+            a[i + j * n].re = a[j + i * n].re;
+            a[i + j * n].im = -a[j + i * n].im;
+          }
+      else
+        for (i = ib; i < ie; i++)
+          for (j = i + 1 > jb ? i + 1 : jb; j < je; j++) {
+            a[j + i * n].re = a[i + j * n].re;
+            a[j + i * n].im = -a[i + j * n].im;
+          }
     }
-    mat->d0 = d1;
-    mat->d1 = d0;
+    for (j = jb; j < je; j++) a[j + j * n].im = 0;
   }
-  ccopy_mat(temp, mat);
-  mpfree_cmat(temp);
 }
 
 /* ex
@@ -2362,6 +2074,7 @@ CMAT *create_hermit(CMAT *mat) {
 
 void hermit(CMAT *mat) {
   CMAT *temp;
+  MP_MARK mark;
   ITER i, j; 
   UINT d0, d1, d2;
 
@@ -2371,7 +2084,8 @@ void hermit(CMAT *mat) {
   d0 = mat->d0;
   d1 = mat->d1;
   d2 = mat->d2;
-  temp = mpalloc_cmat(mat->d0, mat->d1, mat->d2);
+  mark = mp_mark();
+  temp = mp_scratch_cmat(mat->d0, mat->d1, mat->d2);
   if (mat->ndim == 0) {
 #pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(temp, mat) private(i)
     for (i = 0; i < d0; i++) {
@@ -2403,7 +2117,7 @@ void hermit(CMAT *mat) {
     mat->d1 = d0;
   }
   ccopy_mat(temp, mat);
-  mpfree_cmat(temp);
+  mp_release(mark);
 }
 
 /**** Identity Matrix****/
@@ -2484,10 +2198,13 @@ void ident_cmat(CMAT *mat) {
 }
 
 /**** miscellaneous  ****/
+/* MAT built by hand(header and data by malloc()) is also accepted,
+ * data of malloc_aligned() is not. */
 void free_mat(MAT *mat) {
 #if DEBUG
   printf("%s\n", __func__);
 #endif
+  if (mat_block_free(mat, mat->data, MAT_HEADER_SIZE(MAT))) return;
   free(mat->data);
   free(mat);
 }
@@ -2496,6 +2213,7 @@ void free_cmat(CMAT *mat) {
 #if DEBUG
   printf("%s\n", __func__);
 #endif
+  if (mat_block_free(mat, mat->data, MAT_HEADER_SIZE(CMAT))) return;
   free(mat->data);
   free(mat);
 }
@@ -2544,3 +2262,253 @@ void mpfree_cmat(CMAT *mat) {
   mpfree(mat->data);
   mpfree(mat);
 }
+
+/**** PCMAT, planar complex ****/
+/* One block : header, re, then im from the next MEM_ALIGN_SIZE boundary. */
+static PCMAT *new_pcmat(UINT ndim, UINT d0, UINT d1, UINT d2) {
+  PCMAT *mat;
+  unsigned long long int plane;
+
+  plane = ((sizeof(DTYPE) * (unsigned long long int)d0 * d1 * d2 +
+            MEM_ALIGN_SIZE - 1) /
+           MEM_ALIGN_SIZE) *
+          MEM_ALIGN_SIZE;
+  mat = (PCMAT *)mat_block_alloc(MAT_HEADER_SIZE(PCMAT), 2 * plane);
+  mat->ndim = ndim;
+  mat->d0 = d0;
+  mat->d1 = d1;
+  mat->d2 = d2;
+  mat->re = (DTYPE *)((char *)mat + MAT_HEADER_SIZE(PCMAT));
+  mat->im = (DTYPE *)((char *)mat->re + plane);
+  return mat;
+}
+
+PCMAT *alloc_pcmat_1d(UINT d0) {
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  return new_pcmat(0, d0, 1, 1);
+}
+PCMAT *alloc_pcmat_2d(UINT d0, UINT d1) {
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  return new_pcmat(1, d0, d1, 1);
+}
+PCMAT *alloc_pcmat_3d(UINT d0, UINT d1, UINT d2) {
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  return new_pcmat(2, d0, d1, d2);
+}
+
+void free_pcmat(PCMAT *mat) {
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  if (mat_block_free(mat, mat->re, MAT_HEADER_SIZE(PCMAT))) return;
+  free(mat->re);
+  free(mat);
+}
+
+void cmat2pcmat(CMAT *src, PCMAT *des) {
+  ITER i;
+  UINT size;
+  DTYPE *re, *im;
+  CTYPE *x;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  if (src->d0 != des->d0 || src->d1 != des->d1 || src->d2 != des->d2)
+    ASSERT_DIM_INVALID()
+  size = src->d0 * src->d1 * src->d2;
+  x = src->data;
+  re = des->re;
+  im = des->im;
+#pragma omp parallel for schedule(static) shared(x, re, im) private(i)
+  for (i = 0; i < size; i++) {
+    re[i] = x[i].re;
+    im[i] = x[i].im;
+  }
+}
+
+void pcmat2cmat(PCMAT *src, CMAT *des) {
+  ITER i;
+  UINT size;
+  DTYPE *re, *im;
+  CTYPE *x;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  if (src->d0 != des->d0 || src->d1 != des->d1 || src->d2 != des->d2)
+    ASSERT_DIM_INVALID()
+  size = src->d0 * src->d1 * src->d2;
+  x = des->data;
+  re = src->re;
+  im = src->im;
+#pragma omp parallel for schedule(static) shared(x, re, im) private(i)
+  for (i = 0; i < size; i++) {
+    x[i].re = re[i];
+    x[i].im = im[i];
+  }
+}
+
+/**** TMAT, runtime precision ****/
+UINT dtype_size(UINT dtype) {
+  switch (dtype) {
+    case DT_S:
+      return sizeof(float);
+    case DT_D:
+      return sizeof(double);
+    case DT_C:
+      return sizeof(CTYPE_S);
+    case DT_Z:
+      return sizeof(CTYPE_D);
+  }
+  ASSERT_ARG_INVALID()
+  return 0;
+}
+
+static TMAT *new_tmat(UINT dtype, UINT ndim, UINT d0, UINT d1, UINT d2) {
+  TMAT *mat;
+
+  mat = (TMAT *)mat_block_alloc(
+      MAT_HEADER_SIZE(TMAT),
+      (unsigned long long int)dtype_size(dtype) * d0 * d1 * d2);
+  mat->dtype = dtype;
+  mat->ndim = ndim;
+  mat->d0 = d0;
+  mat->d1 = d1;
+  mat->d2 = d2;
+  mat->data = (char *)mat + MAT_HEADER_SIZE(TMAT);
+  return mat;
+}
+
+TMAT *alloc_tmat_1d(UINT dtype, UINT d0) {
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  return new_tmat(dtype, 0, d0, 1, 1);
+}
+TMAT *alloc_tmat_2d(UINT dtype, UINT d0, UINT d1) {
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  return new_tmat(dtype, 1, d0, d1, 1);
+}
+TMAT *alloc_tmat_3d(UINT dtype, UINT d0, UINT d1, UINT d2) {
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  return new_tmat(dtype, 2, d0, d1, d2);
+}
+
+void free_tmat(TMAT *mat) {
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  if (mat_block_free(mat, mat->data, MAT_HEADER_SIZE(TMAT))) return;
+  free(mat->data);
+  free(mat);
+}
+
+/* n elements of sdt at src -> ddt at des. Complex is taken as pairs. */
+static void dtype_cvt(UINT sdt, void *src, UINT ddt, void *des,
+                      unsigned long long int n) {
+  ITER i;
+  float *fs;
+  double *ds;
+
+  if ((sdt == DT_S || sdt == DT_D) != (ddt == DT_S || ddt == DT_D))
+    ASSERT(0, "Can't convert between real and complex.\n")
+  if (sdt == ddt) {
+    memcpy(des, src, (size_t)dtype_size(sdt) * n);
+    return;
+  }
+  if (sdt == DT_C || sdt == DT_Z) n *= 2;
+  if (sdt == DT_S || sdt == DT_C) {
+    fs = (float *)src;
+    ds = (double *)des;
+#pragma omp parallel for schedule(static) shared(fs, ds) private(i)
+    for (i = 0; i < (ITER)n; i++) ds[i] = fs[i];
+  } else {
+    ds = (double *)src;
+    fs = (float *)des;
+#pragma omp parallel for schedule(static) shared(fs, ds) private(i)
+    for (i = 0; i < (ITER)n; i++) fs[i] = (float)ds[i];
+  }
+}
+
+void convert_tmat(TMAT *src, TMAT *des) {
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  if (src->d0 != des->d0 || src->d1 != des->d1 || src->d2 != des->d2)
+    ASSERT_DIM_INVALID()
+  dtype_cvt(src->dtype, src->data, des->dtype, des->data,
+            (unsigned long long int)src->d0 * src->d1 * src->d2);
+}
+
+TMAT *mat2tmat(MAT *mat, UINT dtype) {
+  TMAT *t;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  t = new_tmat(dtype, mat->ndim, mat->d0, mat->d1, mat->d2);
+  dtype_cvt(DT_NATIVE, mat->data, dtype, t->data,
+            (unsigned long long int)mat->d0 * mat->d1 * mat->d2);
+  return t;
+}
+
+TMAT *cmat2tmat(CMAT *mat, UINT dtype) {
+  TMAT *t;
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  t = new_tmat(dtype, mat->ndim, mat->d0, mat->d1, mat->d2);
+  dtype_cvt(DT_CNATIVE, mat->data, dtype, t->data,
+            (unsigned long long int)mat->d0 * mat->d1 * mat->d2);
+  return t;
+}
+
+void tmat2mat(TMAT *src, MAT *des) {
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  if (src->d0 != des->d0 || src->d1 != des->d1 || src->d2 != des->d2)
+    ASSERT_DIM_INVALID()
+  dtype_cvt(src->dtype, src->data, DT_NATIVE, des->data,
+            (unsigned long long int)src->d0 * src->d1 * src->d2);
+}
+
+void tmat2cmat(TMAT *src, CMAT *des) {
+#if DEBUG
+  printf("%s\n", __func__);
+#endif
+  if (src->d0 != des->d0 || src->d1 != des->d1 || src->d2 != des->d2)
+    ASSERT_DIM_INVALID()
+  dtype_cvt(src->dtype, src->data, DT_CNATIVE, des->data,
+            (unsigned long long int)src->d0 * src->d1 * src->d2);
+}
+
+MAT as_mat(TMAT *mat) {
+  MAT m;
+  ASSERT(mat->dtype == DT_NATIVE, "dtype is not DTYPE.\n")
+  m.data = (DTYPE *)mat->data;
+  m.ndim = mat->ndim;
+  m.d0 = mat->d0;
+  m.d1 = mat->d1;
+  m.d2 = mat->d2;
+  return m;
+}
+
+CMAT as_cmat(TMAT *mat) {
+  CMAT m;
+  ASSERT(mat->dtype == DT_CNATIVE, "dtype is not CTYPE.\n")
+  m.data = (CTYPE *)mat->data;
+  m.ndim = mat->ndim;
+  m.d0 = mat->d0;
+  m.d1 = mat->d1;
+  m.d2 = mat->d2;
+  return m;
+}
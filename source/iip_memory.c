@@ -10,206 +10,687 @@
  * ===========================================================
  */
 #include "iip_type.h"
+#include "iip_backend.h"
+
+#if USE_OMP
+#include <omp.h>
+#endif
+
+#if OS_UNIX
+#include <sys/mman.h>
+#endif
+
+#if OS_WIN
+#include <malloc.h>
+#endif
 
 /*****************************
  **** MEMORY MANAGER *********
  *****************************/
 
-void init(UINT mem_pool_size) {
-  int i;
-
-#if USE_CUDA
-  cudaDeviceProp prop;
-  cublasCreate(&handle);
-  cudaGetDeviceProperties(&prop, 0);
-  max_thread = prop.maxThreadsDim[0];
-  max_block = prop.maxGridSize[1];
+/**** THREAD LOCAL & LOCK ****/
+#if OS_WIN
+#define MEM_THREAD_LOCAL __declspec(thread)
+#else
+#define MEM_THREAD_LOCAL __thread
 #endif
 
-  for (i = 0; i < MAX_MEM_PAGE; i++) {
-    memory_pool[i] = NULL;
-    memory_log[i] = NULL;
-    log_cnt[i] = 0;
-  }
+#if USE_OMP
+#define MEM_LOCK omp_lock_t
+#define MEM_LOCK_INIT(x) omp_init_lock(x)
+#define MEM_LOCK_DESTROY(x) omp_destroy_lock(x)
+#define MEM_LOCK_SET(x) omp_set_lock(x)
+#define MEM_LOCK_UNSET(x) omp_unset_lock(x)
+#else
+#define MEM_LOCK int
+#define MEM_LOCK_INIT(x)
+#define MEM_LOCK_DESTROY(x)
+#define MEM_LOCK_SET(x)
+#define MEM_LOCK_UNSET(x)
+#endif
 
-  memory_pool[0] = (void*)malloc(MEM_PAGE_BASIC_SIZE);
-  memory_log[0] = (USED_MEM*)malloc(sizeof(USED_MEM) *
-                                    (MEM_PAGE_BASIC_SIZE / LOG_ALLOC_UNIT));
-  memset(memory_log[0], 0,
-         sizeof(USED_MEM) * (MEM_PAGE_BASIC_SIZE / LOG_ALLOC_UNIT));
-  pool_cnt = 1;
+/* Free blocks are kept in segregated lists,
+ * free_head[c] holds blocks of size [2^c, 2^(c+1)).
+ * bit c of free_map is set when free_head[c] is not empty. */
+#define MEM_CLASS_CNT 48
+/* Number of candidates examined for best fit in the class of a request. */
+#define MEM_FIT_SCAN 16
+
+struct MEM_BLOCK;
+
+/* Page chain of one thread.
+ * page[i] is (MEM_PAGE_BASIC_SIZE << i) bytes and is filled from offset 0
+ * up to top[i]. last[i] is offset of the last block in page[i]. */
+typedef struct MEM_ARENA {
+  void* memory_pool[MAX_MEM_PAGE];
+  unsigned long long int top[MAX_MEM_PAGE];
+  unsigned long long int last[MAX_MEM_PAGE];
+  unsigned int pool_cnt;
+  struct MEM_BLOCK* free_head[MEM_CLASS_CNT];
+  unsigned long long int free_map;
+  /* statistics, see mpstat() */
+  unsigned long long int live;
+  unsigned long long int high_water;
+  unsigned long long int alloc_cnt;
+  unsigned long long int free_cnt;
+  MEM_LOCK lock;
+} MEM_ARENA;
+
+/* In-band header in front of every block handed out by mpalloc().
+ * mpfree() reaches arena and page of a block through it, without any search.
+ * size counts header and payload, prev_size is size of the block just before
+ * in the same page (0 for the first block), which makes both neighbours
+ * reachable for coalescing. prev_free/next_free link free blocks. */
+typedef struct MEM_BLOCK {
+  MEM_ARENA* arena;
+  unsigned long long int size;
+  unsigned long long int prev_size;
+  unsigned int page_idx;
+  unsigned int state;
+  struct MEM_BLOCK* prev_free;
+  struct MEM_BLOCK* next_free;
+} MEM_BLOCK;
+
+#define MEM_BLOCK_USED 0x1D1B10C5
+#define MEM_BLOCK_FREE 0xF4EEB10C
+#define MEM_ALIGN MEM_ALIGN_SIZE
+#define MEM_ROUND(x) (((x) + MEM_ALIGN - 1) & ~((unsigned long long int)MEM_ALIGN - 1))
+#define MEM_HEADER_SIZE MEM_ROUND(sizeof(MEM_BLOCK))
+/* Smallest remainder worth splitting off a free block. */
+#define MEM_MIN_BLOCK (MEM_HEADER_SIZE + MEM_ALIGN)
+
+/* mem_arena[0] is created by init() and also serves as shared fallback
+ * when the table is full. */
+static MEM_ARENA* mem_arena[MAX_MEM_ARENA];
+static unsigned int arena_cnt = 0;
+static MEM_LOCK arena_table_lock;
+
+/* init() bumps mem_generation so that arenas cached by threads
+ * before finit() are never touched again. */
+static unsigned int mem_generation = 0;
+static MEM_THREAD_LOCAL MEM_ARENA* local_arena = NULL;
+static MEM_THREAD_LOCAL unsigned int local_generation = 0;
+
+/* Scratch stack of one thread, see mp_mark().
+ * chunk[i] holds at least (MEM_SCRATCH_BASIC_SIZE << i) bytes and the stack
+ * occupies chunk[0..cur-1] partially and chunk[cur] up to top. */
+#define MAX_SCRATCH_CHUNK 32
+#define MEM_SCRATCH_BASIC_SIZE 4096
+#define MP_MARK_SHIFT 48
+
+typedef struct MEM_SCRATCH {
+  char* chunk[MAX_SCRATCH_CHUNK];
+  unsigned long long int chunk_size[MAX_SCRATCH_CHUNK];
+  unsigned int cur;
+  unsigned long long int top;
+  struct MEM_SCRATCH* next;
+} MEM_SCRATCH;
+
+/* Every scratch stack is linked here so that finit() can release it. */
+static MEM_SCRATCH* scratch_list = NULL;
+static MEM_THREAD_LOCAL MEM_SCRATCH* local_scratch = NULL;
+static MEM_THREAD_LOCAL unsigned int local_scratch_generation = 0;
+
+/* Slab cache of small blocks, see mp_slab_alloc().
+ * Class c holds slots of (MEM_SLAB_MIN << c) bytes, carved from chunks of
+ * MEM_SLAB_CHUNK bytes. Each thread keeps up to MEM_SLAB_KEEP free slots per
+ * class, the rest go to shared lists. Chunks are kept for the process
+ * lifetime, independent of init() and finit(). */
+#define MEM_SLAB_MIN MEM_ALIGN_SIZE
+#define MEM_SLAB_CLASS_CNT 8
+#define MEM_SLAB_MAX (MEM_SLAB_MIN << (MEM_SLAB_CLASS_CNT - 1))
+#define MEM_SLAB_CHUNK (64 * 1024)
+#define MEM_SLAB_KEEP 256
+
+typedef struct MEM_SLOT {
+  struct MEM_SLOT* next;
+} MEM_SLOT;
+
+static MEM_SLOT* slab_shared[MEM_SLAB_CLASS_CNT];
+/* First slot of every chunk links the chunks. */
+static MEM_SLOT* slab_chunk_list = NULL;
+static unsigned long long int slab_reserved = 0;
+static MEM_THREAD_LOCAL MEM_SLOT* local_slab[MEM_SLAB_CLASS_CNT];
+static MEM_THREAD_LOCAL unsigned int local_slab_cnt[MEM_SLAB_CLASS_CNT];
+
+/* Arenas mem_arena[0..arena_claimed-1] belong to a thread, the rest were
+ * prepared by init_profile() and are handed to the next new threads. */
+static unsigned int arena_claimed = 0;
+
+/* How pages are obtained, see init_profile(). */
+static UINT mem_mode = MEM_MODE_MALLOC;
+
+static signed long long int page_alloc_isable(
+    MEM_ARENA* arena, int page_idx, unsigned long long int require_size);
+
+/**** ALIGNED MALLOC ****/
+void* malloc_aligned(unsigned long long int size) {
+  void* ptr;
+#if OS_WIN
+  ptr = _aligned_malloc((size_t)size, MEM_ALIGN_SIZE);
+#else
+  if (posix_memalign(&ptr, MEM_ALIGN_SIZE, (size_t)size) != 0) ptr = NULL;
+#endif
+  return ptr;
+}
 
-  // if (mem_pool_size > 0) mpfree(mpalloc(mem_pool_size));
+void free_aligned(void* ptr) {
+#if OS_WIN
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
+}
 
-  int size_before = 0;
-  FILE* fp;
-  fp = fopen("Memory_pool.log", "r");
+/**** PAGE ****/
+/* Pages of MEM_MODE_HUGE are mapped in whole huge pages from a huge page
+ * boundary, otherwise madvise() finds no aligned huge page to back. */
+#define MEM_HUGE_SIZE (2ULL << 20)
+#define MEM_HUGE_ROUND(x) (((x) + MEM_HUGE_SIZE - 1) & ~(MEM_HUGE_SIZE - 1))
+
+static void* page_map(unsigned long long int size) {
+  void* page;
+#if OS_UNIX
+  unsigned long long int i;
+  unsigned long long int head;
+  int flag = MAP_PRIVATE | MAP_ANONYMOUS;
+
+  if (mem_mode == MEM_MODE_PREFAULT) {
+#ifdef MAP_POPULATE
+    flag |= MAP_POPULATE;
+#endif
+  }
+  if (mem_mode == MEM_MODE_HUGE) {
+    // Over-map by one huge page and trim both ends to the boundary.
+    size = MEM_HUGE_ROUND(size);
+    page = mmap(NULL, size + MEM_HUGE_SIZE, PROT_READ | PROT_WRITE, flag, -1,
+                0);
+    if (page == MAP_FAILED) return NULL;
+    head = MEM_HUGE_ROUND((unsigned long long int)(size_t)page) -
+           (unsigned long long int)(size_t)page;
+    if (head > 0) munmap(page, head);
+    page = (char*)page + head;
+    if (MEM_HUGE_SIZE - head > 0)
+      munmap((char*)page + size, MEM_HUGE_SIZE - head);
+    // Advise before the first touch, so that faults map huge pages.
+#ifdef MADV_HUGEPAGE
+    madvise(page, size, MADV_HUGEPAGE);
+#endif
+    for (i = 0; i < size; i += 4096) ((volatile char*)page)[i] = 0;
+    return page;
+  }
+  if (mem_mode != MEM_MODE_MALLOC) {
+    page = mmap(NULL, size, PROT_READ | PROT_WRITE, flag, -1, 0);
+    if (page == MAP_FAILED) return NULL;
+#ifndef MAP_POPULATE
+    for (i = 0; i < size; i += 4096) ((volatile char*)page)[i] = 0;
+#endif
+    return page;
+  }
+#endif
+  page = malloc_aligned(size);
+  return page;
+}
 
-  char teomp_str[256];
-  if (fp != NULL) {
-    fgets(teomp_str, 255, fp);
-    fscanf(fp, "%d", &size_before);
-    fclose(fp);
+static void page_unmap(void* page, unsigned long long int size) {
+#if OS_UNIX
+  if (mem_mode == MEM_MODE_HUGE) size = MEM_HUGE_ROUND(size);
+  if (mem_mode != MEM_MODE_MALLOC) {
+    munmap(page, size);
+    return;
   }
+#endif
+  free_aligned(page);
+}
+
+static MEM_ARENA* alloc_arena() {
+  MEM_ARENA* arena;
+  int i;
 
-  unsigned long long int page_size = MEM_PAGE_BASIC_SIZE;
-  for (i = 0; i < size_before; i++) {
-    page_size *= 2;
+  arena = (MEM_ARENA*)malloc(sizeof(MEM_ARENA));
+  ASSERT(arena, "Failed to allocate memory arena.\n")
+  for (i = 0; i < MAX_MEM_PAGE; i++) {
+    arena->memory_pool[i] = NULL;
+    arena->top[i] = 0;
+    arena->last[i] = 0;
   }
-  page_size -= MEM_PAGE_BASIC_SIZE;
-
-  // if(page_size > mem_pool_size) {
-  // 	mpfree(mpalloc(page_size));
-  // 	printf("%lu bytes of memory pool ready.\n", page_size);
-  // }
-  // else if(mem_pool_size > 0) {
-  // 	mpfree(mpalloc(mem_pool_size));
-  // 	printf("%lu bytes of memory pool ready.\n", mem_pool_size);
-  // }
-
-  if (page_size < mem_pool_size && mem_pool_size > 0) {
-    page_size = mem_pool_size;
+  for (i = 0; i < MEM_CLASS_CNT; i++) arena->free_head[i] = NULL;
+  arena->free_map = 0;
+  arena->live = 0;
+  arena->high_water = 0;
+  arena->alloc_cnt = 0;
+  arena->free_cnt = 0;
+
+  arena->memory_pool[0] = page_map(MEM_PAGE_BASIC_SIZE);
+  arena->pool_cnt = 1;
+  MEM_LOCK_INIT(&(arena->lock));
+
+  return arena;
+}
+
+static void free_arena(MEM_ARENA* arena) {
+  int i;
+
+  for (i = 0; i < MAX_MEM_PAGE; i++) {
+    if (arena->memory_pool[i] != NULL) {
+      page_unmap(arena->memory_pool[i],
+                 (unsigned long long int)MEM_PAGE_BASIC_SIZE << i);
+    }
   }
+  MEM_LOCK_DESTROY(&(arena->lock));
+  free(arena);
+}
 
-  mpfree(mpalloc(((page_size + MEM_PAGE_BASIC_SIZE) >> 1) + (page_size & 1)));
+/* Adds pages until arena holds at least size bytes. */
+static void arena_reserve(MEM_ARENA* arena, unsigned long long int size) {
+  unsigned long long int page_size;
+
+  while (arena->pool_cnt < MAX_MEM_PAGE &&
+         ((unsigned long long int)MEM_PAGE_BASIC_SIZE << arena->pool_cnt) -
+                 MEM_PAGE_BASIC_SIZE <
+             size) {
+    page_size = (unsigned long long int)MEM_PAGE_BASIC_SIZE << arena->pool_cnt;
+    arena->memory_pool[arena->pool_cnt] = page_map(page_size);
+    ASSERT(arena->memory_pool[arena->pool_cnt],
+           "Failed to reserve memory pool.\n")
+    arena->pool_cnt++;
+  }
+}
 
-  // if (page_size > mem_pool_size && page_size > 0){
-  //	page_size *= 2;
-  //	page_size -= MEM_PAGE_BASIC_SIZE;
-  //}
+/* Returns arena of calling thread, creating it on first use. */
+static MEM_ARENA* get_arena() {
+  if (local_arena != NULL && local_generation == mem_generation)
+    return local_arena;
+
+  MEM_LOCK_SET(&arena_table_lock);
+  if (arena_claimed < arena_cnt) {
+    local_arena = mem_arena[arena_claimed];
+    arena_claimed++;
+  } else if (arena_cnt < MAX_MEM_ARENA) {
+    mem_arena[arena_cnt] = alloc_arena();
+    local_arena = mem_arena[arena_cnt];
+    arena_cnt++;
+    arena_claimed++;
+  } else
+    local_arena = mem_arena[0];
+  MEM_LOCK_UNSET(&arena_table_lock);
 
-  printf("\n *** ");
+  local_generation = mem_generation;
+  return local_arena;
+}
 
+/* Prints size with thousands separator, e.g. 16,776,960 */
+static void fprint_size(FILE* fp, unsigned long long int size) {
   unsigned long long int n2 = 0;
   unsigned long long int scale = 1;
-  while (page_size >= 1000) {
-    n2 = n2 + scale * (page_size % 1000);
-    page_size /= 1000;
+
+  while (size >= 1000) {
+    n2 = n2 + scale * (size % 1000);
+    size /= 1000;
     scale *= 1000;
   }
-  printf("%lu", page_size);
+  fprintf(fp, "%llu", size);
   while (scale != 1) {
     scale /= 1000;
-    page_size = n2 / scale;
+    size = n2 / scale;
     n2 = n2 % scale;
-    printf(",%03lu", page_size);
+    fprintf(fp, ",%03llu", size);
+  }
+}
+
+/* Parses '64M', '512K', '1G' or plain bytes. */
+static unsigned long long int parse_size(const char* str) {
+  char* end;
+  unsigned long long int size;
+
+  size = strtoull(str, &end, 10);
+  if (*end == 'k' || *end == 'K') size <<= 10;
+  if (*end == 'm' || *end == 'M') size <<= 20;
+  if (*end == 'g' || *end == 'G') size <<= 30;
+  return size;
+}
+
+void init(UINT mem_pool_size) {
+  char profile[MAX_CHAR];
+  char* token;
+  char* value;
+  UINT mode = MEM_MODE_MALLOC;
+  unsigned long long int main_size = mem_pool_size;
+  unsigned long long int thread_size = 0;
+  UINT num_thread = 0;
+
+  if (getenv("IIP_MEM_PROFILE") != NULL) {
+    strncpy(profile, getenv("IIP_MEM_PROFILE"), MAX_CHAR - 1);
+    profile[MAX_CHAR - 1] = '\0';
+    for (token = strtok(profile, ","); token != NULL;
+         token = strtok(NULL, ",")) {
+      value = strchr(token, '=');
+      if (value == NULL) continue;
+      *(value++) = '\0';
+      if (!strcmp(token, "mode")) {
+        if (!strcmp(value, "malloc")) mode = MEM_MODE_MALLOC;
+        if (!strcmp(value, "prefault")) mode = MEM_MODE_PREFAULT;
+        if (!strcmp(value, "huge")) mode = MEM_MODE_HUGE;
+      } else if (!strcmp(token, "main")) {
+        if (parse_size(value) > main_size) main_size = parse_size(value);
+      } else if (!strcmp(token, "thread"))
+        thread_size = parse_size(value);
+      else if (!strcmp(token, "threads"))
+        num_thread = (UINT)strtoul(value, NULL, 10);
+      else
+        printf(" *** [iip_sph_pp] Unknown key '%s' in IIP_MEM_PROFILE\n",
+               token);
+    }
+  }
+
+  init_profile(mode, main_size, thread_size, num_thread);
+}
+
+void init_profile(UINT mode, unsigned long long int main_size,
+                  unsigned long long int thread_size, UINT num_thread) {
+  int i;
+  MEM_STAT stat;
+
+#if USE_CUDA
+  cudaDeviceProp prop;
+  cublasCreate(&handle);
+  cudaGetDeviceProperties(&prop, 0);
+  max_thread = prop.maxThreadsDim[0];
+  max_block = prop.maxGridSize[1];
+#endif
+
+  ASSERT(mode <= MEM_MODE_HUGE, "Invalid memory pool mode.\n")
+  if (num_thread > MAX_MEM_ARENA - 1) num_thread = MAX_MEM_ARENA - 1;
+
+  for (i = 0; i < MAX_MEM_ARENA; i++) mem_arena[i] = NULL;
+  MEM_LOCK_INIT(&arena_table_lock);
+  mem_generation++;
+  mem_mode = mode;
+
+  mem_arena[0] = alloc_arena();
+  arena_reserve(mem_arena[0], main_size);
+  for (i = 1; i <= (int)num_thread; i++) {
+    mem_arena[i] = alloc_arena();
+    arena_reserve(mem_arena[i], thread_size);
   }
+  arena_cnt = num_thread + 1;
+  arena_claimed = 1;
+  local_arena = mem_arena[0];
+  local_generation = mem_generation;
 
-  printf(" bytes of memory pool ready.\n\n");
+  mpstat(&stat);
+  printf("\n *** ");
+  fprint_size(stdout, stat.reserved);
+  printf(" bytes of memory pool ready.\n");
+  blas_init();
+  printf("\n");
 }
 
 void finit() {
   int i;
+  MEM_STAT stat;
 
 #if USE_CUDA
   cublasDestory(handle);
 #endif
+  blas_close();
 
-  for (i = 0; i < MAX_MEM_PAGE; i++) {
-    if (memory_pool[i] != NULL) {
-      free(memory_pool[i]);
-    }
-    if (memory_log[i] != NULL) {
-      free(memory_log[i]);
-    }
-    log_cnt[i] = 0;
+  mpstat(&stat);
+
+  for (i = 0; i < (int)arena_cnt; i++) {
+    free_arena(mem_arena[i]);
+    mem_arena[i] = NULL;
+  }
+  arena_cnt = 0;
+  arena_claimed = 0;
+  local_arena = NULL;
+
+  while (scratch_list != NULL) {
+    MEM_SCRATCH* scratch = scratch_list;
+    scratch_list = scratch->next;
+    for (i = 0; i < MAX_SCRATCH_CHUNK; i++)
+      if (scratch->chunk[i] != NULL) free_aligned(scratch->chunk[i]);
+    free(scratch);
   }
+  local_scratch = NULL;
+  MEM_LOCK_DESTROY(&arena_table_lock);
+
+  printf("\n *** ");
+  fprint_size(stdout, stat.high_water);
+  printf(" bytes at high-water, ");
+  fprint_size(stdout, stat.reserved);
+  printf(" bytes of memory pool released.\n");
+}
 
-  unsigned long long int page_size = MEM_PAGE_BASIC_SIZE;
-  for (i = 0; i < pool_cnt; i++) {
-    page_size *= 2;
+/**** STATISTICS ****/
+void mpstat(MEM_STAT* stat) {
+  int i, c;
+  unsigned long long int page_size;
+  unsigned long long int hole_size = 0;
+  unsigned long long int largest_hole = 0;
+  MEM_ARENA* arena;
+  MEM_BLOCK* block;
+  MEM_SCRATCH* scratch;
+
+  memset(stat, 0, sizeof(MEM_STAT));
+
+  MEM_LOCK_SET(&arena_table_lock);
+  stat->arena_cnt = arena_cnt;
+  for (i = 0; i < (int)arena_cnt; i++) {
+    arena = mem_arena[i];
+    MEM_LOCK_SET(&(arena->lock));
+    stat->live += arena->live;
+    stat->high_water += arena->high_water;
+    if (i == 0) stat->main_high_water = arena->high_water;
+    stat->alloc_cnt += arena->alloc_cnt;
+    stat->free_cnt += arena->free_cnt;
+    stat->page_cnt += arena->pool_cnt;
+    for (c = 0; c < (int)arena->pool_cnt; c++) {
+      page_size = (unsigned long long int)MEM_PAGE_BASIC_SIZE << c;
+      stat->reserved += page_size;
+      if (page_size - arena->top[c] > stat->largest_free)
+        stat->largest_free = page_size - arena->top[c];
+    }
+    for (c = 0; c < MEM_CLASS_CNT; c++)
+      for (block = arena->free_head[c]; block != NULL; block = block->next_free) {
+        hole_size += block->size;
+        if (block->size > largest_hole) largest_hole = block->size;
+      }
+    MEM_LOCK_UNSET(&(arena->lock));
   }
-  page_size -= MEM_PAGE_BASIC_SIZE;
+  for (scratch = scratch_list; scratch != NULL; scratch = scratch->next)
+    for (c = 0; c < MAX_SCRATCH_CHUNK; c++)
+      stat->scratch_reserved += scratch->chunk_size[c];
+  MEM_LOCK_UNSET(&arena_table_lock);
+#pragma omp critical(mem_slab)
+  stat->slab_reserved = slab_reserved;
+
+  // Free space above top of a page is one piece by itself, only holes
+  // below it are taken for fragmentation.
+  if (hole_size > 0)
+    stat->fragmentation = 1.0 - (double)largest_hole / hole_size;
+  if (largest_hole > stat->largest_free) stat->largest_free = largest_hole;
+  // Largest block is accounted with its header.
+  stat->largest_free = stat->largest_free > MEM_HEADER_SIZE
+                           ? stat->largest_free - MEM_HEADER_SIZE
+                           : 0;
+}
 
-  FILE* fp;
-  fp = fopen("Memory_pool.log", "w+");
+void mpstat_json(FILE* fp) {
+  MEM_STAT stat;
+
+  mpstat(&stat);
+  fprintf(fp,
+          "{\"reserved\": %llu, \"live\": %llu, \"high_water\": %llu, "
+          "\"main_high_water\": %llu, "
+          "\"scratch_reserved\": %llu, \"slab_reserved\": %llu, "
+          "\"page_cnt\": %u, \"arena_cnt\": %u, "
+          "\"alloc_cnt\": %llu, \"free_cnt\": %llu, "
+          "\"fragmentation\": %.6f, \"largest_free\": %llu}\n",
+          stat.reserved, stat.live, stat.high_water, stat.main_high_water,
+          stat.scratch_reserved,
+          stat.slab_reserved, stat.page_cnt, stat.arena_cnt, stat.alloc_cnt, stat.free_cnt,
+          stat.fragmentation, stat.largest_free);
+}
 
-  printf("\n#Max_Page_Index\n");
-  printf("%d\n", pool_cnt);
-  printf("#Memory_Pool_Size\n");
+/**** FREE LIST ****/
+static int size_class(unsigned long long int size) {
+  int c = 0;
+  while (size >>= 1) c++;
+  return c < MEM_CLASS_CNT ? c : MEM_CLASS_CNT - 1;
+}
 
-  fprintf(fp, "#Max_Page_Index\n");
-  fprintf(fp, "%d\n", pool_cnt);
-  fprintf(fp, "#Memory_Pool_Size\n");
-  // fprintf(fp, "%'lu", page_size);
+static void free_list_push(MEM_ARENA* arena, MEM_BLOCK* block) {
+  int c = size_class(block->size);
 
-  unsigned long long int n2 = 0;
-  unsigned long long int scale = 1;
-  while (page_size >= 1000) {
-    n2 = n2 + scale * (page_size % 1000);
-    page_size /= 1000;
-    scale *= 1000;
+  block->state = MEM_BLOCK_FREE;
+  block->prev_free = NULL;
+  block->next_free = arena->free_head[c];
+  if (arena->free_head[c] != NULL) arena->free_head[c]->prev_free = block;
+  arena->free_head[c] = block;
+  arena->free_map |= 1ULL << c;
+}
+
+static void free_list_remove(MEM_ARENA* arena, MEM_BLOCK* block) {
+  int c = size_class(block->size);
+
+  if (block->prev_free != NULL)
+    block->prev_free->next_free = block->next_free;
+  else
+    arena->free_head[c] = block->next_free;
+  if (block->next_free != NULL) block->next_free->prev_free = block->prev_free;
+  if (arena->free_head[c] == NULL) arena->free_map &= ~(1ULL << c);
+}
+
+/* Best fit among the first MEM_FIT_SCAN blocks of the request's own class,
+ * otherwise head of the smallest larger class, which always fits. */
+static MEM_BLOCK* free_list_find(MEM_ARENA* arena, unsigned long long int need) {
+  int c, n;
+  MEM_BLOCK* block;
+  MEM_BLOCK* best = NULL;
+
+  c = size_class(need);
+  if (arena->free_map & (1ULL << c)) {
+    for (block = arena->free_head[c], n = 0; block != NULL && n < MEM_FIT_SCAN;
+         block = block->next_free, n++) {
+      if (block->size < need) continue;
+      if (best == NULL || block->size < best->size) best = block;
+      if (block->size == need) break;
+    }
+    if (best != NULL) return best;
   }
-  fprintf(fp, "%lu", page_size);
-  printf("%lu", page_size);
-  while (scale != 1) {
-    scale /= 1000;
-    page_size = n2 / scale;
-    n2 = n2 % scale;
-    fprintf(fp, ",%03lu", page_size);
-    printf(",%03lu", page_size);
+  for (c = c + 1; c < MEM_CLASS_CNT; c++)
+    if (arena->free_map & (1ULL << c)) return arena->free_head[c];
+
+  return NULL;
+}
+
+static void count_alloc(MEM_ARENA* arena, unsigned long long int size) {
+  arena->live += size;
+  arena->alloc_cnt++;
+  if (arena->live > arena->high_water) arena->high_water = arena->live;
+}
+
+/* Marks a free block as used, splitting off the unused tail. */
+static void* block_take(MEM_ARENA* arena, MEM_BLOCK* block,
+                        unsigned long long int need) {
+  MEM_BLOCK* rest;
+  MEM_BLOCK* next;
+
+  free_list_remove(arena, block);
+  if (block->size - need >= MEM_MIN_BLOCK) {
+    rest = (MEM_BLOCK*)((char*)block + need);
+    rest->arena = arena;
+    rest->size = block->size - need;
+    rest->prev_size = need;
+    rest->page_idx = block->page_idx;
+    // A free block is never the last one of its page.
+    next = (MEM_BLOCK*)((char*)rest + rest->size);
+    next->prev_size = rest->size;
+    block->size = need;
+    free_list_push(arena, rest);
   }
+  block->state = MEM_BLOCK_USED;
+  count_alloc(arena, block->size);
 
-  fprintf(fp, " bytes");
-  printf(" bytes\n");
+  return (char*)block + MEM_HEADER_SIZE;
+}
 
-  fclose(fp);
+/* Carves a block of 'need' bytes at top of page[page_idx]. */
+static void* page_carve(MEM_ARENA* arena, int page_idx,
+                        unsigned long long int need) {
+  MEM_BLOCK* block;
+
+  block = (MEM_BLOCK*)((char*)arena->memory_pool[page_idx] +
+                       arena->top[page_idx]);
+  block->arena = arena;
+  block->size = need;
+  block->prev_size =
+      arena->top[page_idx] > 0 ? arena->top[page_idx] - arena->last[page_idx]
+                               : 0;
+  block->page_idx = page_idx;
+  block->state = MEM_BLOCK_USED;
+
+  arena->last[page_idx] = arena->top[page_idx];
+  arena->top[page_idx] += need;
+  count_alloc(arena, need);
+
+  return (char*)block + MEM_HEADER_SIZE;
 }
 
 void* mpalloc(unsigned long long int size) {
-  unsigned long long int alloc_idx = 0;
   int i;
-  unsigned int page_size = 0;
-
-  for (i = 0; i < pool_cnt; i++) {
-    alloc_idx = page_alloc_isable(i, size);
+  unsigned long long int need;
+  unsigned long long int page_size = 0;
+  MEM_ARENA* arena;
+  MEM_BLOCK* block;
+  void* ptr = NULL;
+
+  need = MEM_HEADER_SIZE + (size > MEM_ALIGN ? MEM_ROUND(size) : MEM_ALIGN);
+  arena = get_arena();
+  MEM_LOCK_SET(&(arena->lock));
+
+  // Reuse a hole first.
+  block = free_list_find(arena, need);
+  if (block != NULL) {
+    ptr = block_take(arena, block, need);
+    MEM_LOCK_UNSET(&(arena->lock));
+    return ptr;
+  }
 
+  for (i = 0; i < (int)arena->pool_cnt; i++) {
 #if DEBUG
-    printf("alloc_idx(%d) = page_alloc_isable(%lu,%lu)\n", alloc_idx, i, size);
+    printf("page_alloc_isable(%d,%llu) = %lld\n", i, need,
+           page_alloc_isable(arena, i, need));
 #endif
     // Allocable, return allocated address.
-    if (alloc_idx != -1) {
-      memory_log[i][log_cnt[i]].size = size;
-      memory_log[i][log_cnt[i]].frag_idx = alloc_idx;
-      log_cnt[i]++;
-#if DEBUG
-      printf("memory_log[%d][%lu=log_cnt[%d]]\n", i, log_cnt[i], i);
-      printf("return %lu[%lu] + %ld\n", (unsigned long long int)memory_pool[i],
-             i, alloc_idx);
-#endif
-      return (unsigned long long int)memory_pool[i] + alloc_idx;
+    if (page_alloc_isable(arena, i, need) != -1) {
+      ptr = page_carve(arena, i, need);
+      MEM_LOCK_UNSET(&(arena->lock));
+      return ptr;
     }
   }
 
   do {
-    // No more space to alloc, call malloc()..
-    // printf("Additional MALLOC()!\n");
-    page_size = MEM_PAGE_BASIC_SIZE;
-    for (i = 0; i < pool_cnt; i++) {
-      page_size *= 2;
-    }
-    memory_pool[pool_cnt] = (void*)malloc(page_size);
-    memory_log[pool_cnt] =
-        (USED_MEM*)malloc(sizeof(USED_MEM) * (page_size / LOG_ALLOC_UNIT));
-    memset(memory_log[pool_cnt], 0,
-           sizeof(USED_MEM) * (page_size / LOG_ALLOC_UNIT));
-    pool_cnt++;
-  } while (page_alloc_isable(pool_cnt - 1, size) == -1);
+    // No more space to alloc, add a page.
+    if (arena->pool_cnt == MAX_MEM_PAGE) break;
+    page_size = (unsigned long long int)MEM_PAGE_BASIC_SIZE << arena->pool_cnt;
+    arena->memory_pool[arena->pool_cnt] = page_map(page_size);
+    if (arena->memory_pool[arena->pool_cnt] == NULL) break;
+    arena->pool_cnt++;
+  } while (page_alloc_isable(arena, arena->pool_cnt - 1, need) == -1);
 
   // Allocate
-  if (memory_pool[pool_cnt - 1] != NULL) {
-    memory_log[pool_cnt - 1][0].size = size;
-    memory_log[pool_cnt - 1][0].frag_idx = 0;
-    log_cnt[pool_cnt - 1]++;
-#if DEBUG
-    printf("return %lu[%lu]\n",
-           (unsigned long long int)memory_pool[pool_cnt - 1], pool_cnt - 1);
-#endif
-    return memory_pool[pool_cnt - 1];
+  i = arena->pool_cnt - 1;
+  if (arena->memory_pool[i] != NULL && page_alloc_isable(arena, i, need) != -1) {
+    ptr = page_carve(arena, i, need);
+    MEM_LOCK_UNSET(&(arena->lock));
+    return ptr;
   }
+  MEM_LOCK_UNSET(&(arena->lock));
 
   printf("Failed to Allocate!\n");
-  printf(" Allocation Size : %lu\n", size);
+  printf(" Allocation Size : %llu\n", size);
 
   exit(0);
 
@@ -217,56 +698,230 @@ void* mpalloc(unsigned long long int size) {
 }
 
 void mpfree(void* ptr) {
-  int i, j, k;
-  for (i = 0; i < pool_cnt; i++) {
-    for (j = 0; j < log_cnt[i]; j++) {
-      // Find!
-      if (ptr ==
-          (unsigned long long int)memory_pool[i] + memory_log[i][j].frag_idx) {
-        memory_log[i][j].size = 0;
-        memory_log[i][j].frag_idx = 0;
-        if (log_cnt[i] != j + 1) {
-          for (k = j; k < log_cnt[i] - 1; k++) {
-            memory_log[i][k].size = memory_log[i][k + 1].size;
-            memory_log[i][k].frag_idx = memory_log[i][k + 1].frag_idx;
-          }
-        }
-        log_cnt[i]--;
-
-        return;
-      }
+  MEM_BLOCK* block;
+  MEM_BLOCK* prev;
+  MEM_BLOCK* next;
+  MEM_ARENA* arena;
+  char* page;
+  unsigned int page_idx;
+  unsigned long long int offset;
+
+  block = (MEM_BLOCK*)((char*)ptr - MEM_HEADER_SIZE);
+  if (ptr == NULL || block->state != MEM_BLOCK_USED) {
+    printf("Memory redundancy release has been detected.\n");
+    exit(0);
+    return;
+  }
+
+  // Block may have been allocated by another thread.
+  arena = block->arena;
+  page_idx = block->page_idx;
+  page = (char*)arena->memory_pool[page_idx];
+
+  MEM_LOCK_SET(&(arena->lock));
+  offset = (char*)block - page;
+  arena->live -= block->size;
+  arena->free_cnt++;
+
+  // Coalesce with the following block.
+  if (offset + block->size < arena->top[page_idx]) {
+    next = (MEM_BLOCK*)((char*)block + block->size);
+    if (next->state == MEM_BLOCK_FREE) {
+      free_list_remove(arena, next);
+      block->size += next->size;
     }
   }
-  printf("Memory redundancy release has been detected.\n");
-  exit(0);
-  return;
+  // Coalesce with the preceding block.
+  if (block->prev_size > 0) {
+    prev = (MEM_BLOCK*)((char*)block - block->prev_size);
+    if (prev->state == MEM_BLOCK_FREE) {
+      free_list_remove(arena, prev);
+      prev->size += block->size;
+      block->state = MEM_BLOCK_FREE;
+      block = prev;
+      offset = (char*)block - page;
+    }
+  }
+
+  if (offset + block->size == arena->top[page_idx]) {
+    // Last block of the page, give it back to the top.
+    block->state = MEM_BLOCK_FREE;
+    arena->top[page_idx] = offset;
+    arena->last[page_idx] = offset - block->prev_size;
+  } else {
+    next = (MEM_BLOCK*)((char*)block + block->size);
+    next->prev_size = block->size;
+    free_list_push(arena, block);
+  }
+  MEM_LOCK_UNSET(&(arena->lock));
 }
 
-signed long long int page_alloc_isable(int page_idx,
-                                       unsigned long long int require_size) {
-  unsigned long long int max_remain = 0;
-  unsigned long long int max_remain_start_addr = 0;
+static signed long long int page_alloc_isable(
+    MEM_ARENA* arena, int page_idx, unsigned long long int require_size) {
   unsigned long long int page_size = 0;
-  unsigned long long int addr = 0;
+
+  page_size = (unsigned long long int)MEM_PAGE_BASIC_SIZE << page_idx;
+
+  if (page_size - arena->top[page_idx] >= require_size) {
+    return arena->top[page_idx];
+  } else
+    return -1;
+}
+
+/**** SCRATCH STACK ****/
+
+/* Returns scratch stack of calling thread, creating it on first use. */
+static MEM_SCRATCH* get_scratch() {
   int i;
-  page_size = MEM_PAGE_BASIC_SIZE;
-  for (i = 0; i < page_idx; i++) {
-    page_size *= 2;
+
+  if (local_scratch != NULL && local_scratch_generation == mem_generation)
+    return local_scratch;
+
+  local_scratch = (MEM_SCRATCH*)malloc(sizeof(MEM_SCRATCH));
+  ASSERT(local_scratch, "Failed to allocate scratch stack.\n")
+  for (i = 0; i < MAX_SCRATCH_CHUNK; i++) {
+    local_scratch->chunk[i] = NULL;
+    local_scratch->chunk_size[i] = 0;
   }
+  local_scratch->cur = 0;
+  local_scratch->top = 0;
 
-  if (log_cnt[page_idx] > 0) {
-    max_remain = page_size;
-    max_remain -= memory_log[page_idx][log_cnt[page_idx] - 1].frag_idx;
-    max_remain -= memory_log[page_idx][log_cnt[page_idx] - 1].size;
-    addr = memory_log[page_idx][log_cnt[page_idx] - 1].frag_idx +
-           memory_log[page_idx][log_cnt[page_idx] - 1].size;
-  } else {
-    max_remain = page_size;
-    addr = 0;
+  MEM_LOCK_SET(&arena_table_lock);
+  local_scratch->next = scratch_list;
+  scratch_list = local_scratch;
+  MEM_LOCK_UNSET(&arena_table_lock);
+
+  local_scratch_generation = mem_generation;
+  return local_scratch;
+}
+
+MP_MARK mp_mark() {
+  MEM_SCRATCH* scratch = get_scratch();
+  return ((MP_MARK)scratch->cur << MP_MARK_SHIFT) | scratch->top;
+}
+
+void* mp_scratch(unsigned long long int size) {
+  MEM_SCRATCH* scratch;
+  unsigned long long int need;
+  unsigned long long int chunk_size;
+  void* ptr;
+
+  scratch = get_scratch();
+  need = size > MEM_ALIGN ? MEM_ROUND(size) : MEM_ALIGN;
+
+  if (scratch->chunk[scratch->cur] == NULL ||
+      scratch->top + need > scratch->chunk_size[scratch->cur]) {
+    // Move to next chunk. Chunks above cur hold nothing alive.
+    if (scratch->chunk[scratch->cur] != NULL) scratch->cur++;
+    if (scratch->cur == MAX_SCRATCH_CHUNK) {
+      printf("Failed to Allocate!\n");
+      printf(" Scratch Size : %llu\n", size);
+      exit(0);
+    }
+    if (scratch->chunk_size[scratch->cur] < need) {
+      chunk_size = (unsigned long long int)MEM_SCRATCH_BASIC_SIZE
+                   << scratch->cur;
+      while (chunk_size < need) chunk_size *= 2;
+      if (scratch->chunk[scratch->cur] != NULL)
+        free_aligned(scratch->chunk[scratch->cur]);
+      scratch->chunk[scratch->cur] = (char*)malloc_aligned(chunk_size);
+      ASSERT(scratch->chunk[scratch->cur], "Failed to allocate scratch.\n")
+      scratch->chunk_size[scratch->cur] = chunk_size;
+    }
+    scratch->top = 0;
   }
 
-  if (max_remain >= require_size) {
-    return addr;
-  } else
-    return -1;
+  ptr = scratch->chunk[scratch->cur] + scratch->top;
+  scratch->top += need;
+  return ptr;
+}
+
+void mp_release(MP_MARK mark) {
+  MEM_SCRATCH* scratch = get_scratch();
+  scratch->cur = (unsigned int)(mark >> MP_MARK_SHIFT);
+  scratch->top = mark & ((1ULL << MP_MARK_SHIFT) - 1);
+}
+
+/**** SLAB CACHE ****/
+static int slab_class(unsigned long long int size) {
+  int c = 0;
+  while (((unsigned long long int)MEM_SLAB_MIN << c) < size) c++;
+  return c;
+}
+
+/* Fills empty free list of calling thread, from shared list if any,
+ * otherwise from a new chunk. */
+static void slab_refill(int c) {
+  unsigned long long int slot_size = (unsigned long long int)MEM_SLAB_MIN << c;
+  unsigned int i, n;
+  char* chunk;
+  MEM_SLOT* slot;
+
+#pragma omp critical(mem_slab)
+  {
+    // Take at most MEM_SLAB_KEEP/2, so that a refill never overflows.
+    for (n = 0; n < MEM_SLAB_KEEP / 2 && slab_shared[c] != NULL; n++) {
+      slot = slab_shared[c];
+      slab_shared[c] = slot->next;
+      slot->next = local_slab[c];
+      local_slab[c] = slot;
+    }
+    local_slab_cnt[c] += n;
+  }
+  if (local_slab[c] != NULL) return;
+
+  chunk = (char*)malloc_aligned(MEM_SLAB_CHUNK);
+  ASSERT(chunk, "Failed to allocate slab.\n")
+#pragma omp critical(mem_slab)
+  {
+    ((MEM_SLOT*)chunk)->next = slab_chunk_list;
+    slab_chunk_list = (MEM_SLOT*)chunk;
+    slab_reserved += MEM_SLAB_CHUNK;
+  }
+  // Slots from the end, so that they are handed out in address order.
+  n = (MEM_SLAB_CHUNK - MEM_SLAB_MIN) / slot_size;
+  for (i = n; i > 0; i--) {
+    slot = (MEM_SLOT*)(chunk + MEM_SLAB_MIN + (i - 1) * slot_size);
+    slot->next = local_slab[c];
+    local_slab[c] = slot;
+  }
+  local_slab_cnt[c] += n;
+}
+
+void* mp_slab_alloc(unsigned long long int size) {
+  int c;
+  MEM_SLOT* slot;
+
+  if (size > MEM_SLAB_MAX) return malloc_aligned(size);
+
+  c = slab_class(size);
+  if (local_slab[c] == NULL) slab_refill(c);
+  slot = local_slab[c];
+  local_slab[c] = slot->next;
+  local_slab_cnt[c]--;
+  return slot;
+}
+
+void mp_slab_free(void* ptr, unsigned long long int size) {
+  int c;
+  MEM_SLOT* slot = (MEM_SLOT*)ptr;
+
+  if (ptr == NULL) return;
+  if (size > MEM_SLAB_MAX) {
+    free_aligned(ptr);
+    return;
+  }
+
+  c = slab_class(size);
+  if (local_slab_cnt[c] < MEM_SLAB_KEEP) {
+    slot->next = local_slab[c];
+    local_slab[c] = slot;
+    local_slab_cnt[c]++;
+    return;
+  }
+#pragma omp critical(mem_slab)
+  {
+    slot->next = slab_shared[c];
+    slab_shared[c] = slot;
+  }
 }
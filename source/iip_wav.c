@@ -10,6 +10,7 @@
  * ===========================================================
  */
 #include "iip_wav.h"
+#include "iip_matrix.h"
 
 WAV *read_wav(char *file_path) {
   WAV *wav;
@@ -192,12 +193,7 @@ MAT *wav_buf2mat(WAV_BUF *buf) {
 #if DEBUG
   printf("%s\n", __func__);
 #endif
-  mat = (MAT *)malloc(sizeof(MAT));
-  mat->ndim = 1;
-  mat->d0 = buf->buf_size;
-  mat->d1 = buf->channels;
-  mat->d2 = 1;
-  mat->data = (DTYPE *)malloc(sizeof(DTYPE) * mat->d0 * mat->d1);
+  mat = alloc_mat_2d(buf->buf_size, buf->channels);
 
 #pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(mat, buf) private(i, j)
   for (i = 0; i < mat->d1; i++) {
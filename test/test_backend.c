@@ -0,0 +1,164 @@
+#include "header_for_test.h"
+#include "mother.h"
+
+/* Routing of gemm, gemv, syrk and herk between built-in kernels and the
+ * BLAS backend. Both routes are checked against each other and counted
+ * by blas_stat().
+ * With a backend, thresholds are tuned, saved and loaded back.
+ *  ex) IIP_BLAS_LIB=libopenblas.so.0 ./a.out  // built with USE_DLBLAS */
+
+#define TUNE_FILE "blas_tune.txt"
+
+int main() {
+  MAT *A, *B, *C, *R, *x, *y, *yr, *S, *Sr, *P, *Q;
+  CMAT *CA, *CB, *CC, *CR, *cx, *cy, *cyr, *CS, *CSr;
+  CTYPE ca, cb;
+  BLAS_STAT stat;
+  unsigned long long th[BLAS_OPS];
+  int op, has_blas, nt;
+  DTYPE err = 0, cerr = 0;
+
+  init(0);
+  has_blas = strcmp(blas_name(), "none") != 0;
+  printf("backend : %s\n", blas_name());
+  ca.re = 0.7;
+  ca.im = -0.3;
+  cb.re = 0.5;
+  cb.im = 0.2;
+
+  A = alloc_mat(70, 50);
+  B = alloc_mat(50, 60);
+  C = alloc_mat(70, 60);
+  R = alloc_mat(70, 60);
+  CA = alloc_cmat(70, 50);
+  CB = alloc_cmat(50, 60);
+  CC = alloc_cmat(70, 60);
+  CR = alloc_cmat(70, 60);
+  x = alloc_mat(70);
+  y = alloc_mat(50);
+  yr = alloc_mat(50);
+  cx = alloc_cmat(70);
+  cy = alloc_cmat(50);
+  cyr = alloc_cmat(50);
+  S = zeros(70, 70);
+  Sr = zeros(70, 70);
+  CS = czeros(70, 70);
+  CSr = czeros(70, 70);
+  randu(A, -1, 1);
+  randu(B, -1, 1);
+  randu(C, -1, 1);
+  randu(x, -1, 1);
+  randu(y, -1, 1);
+  crandu(CA, -1, 1, -1, 1);
+  crandu(CB, -1, 1, -1, 1);
+  crandu(CC, -1, 1, -1, 1);
+  crandu(cx, -1, 1, -1, 1);
+  crandu(cy, -1, 1, -1, 1);
+  copy_mat(C, R);
+  copy_mat(y, yr);
+  ccopy_mat(CC, CR);
+  ccopy_mat(cy, cyr);
+  for (op = 0; op < BLAS_OPS; op++) th[op] = blas_get_threshold(op);
+
+  // everything on built-in kernels, then everything on BLAS
+  for (op = 0; op < BLAS_OPS; op++) blas_set_threshold(op, BLAS_NEVER);
+  blas_stat_reset();
+  gemm_mat(NoTran, NoTran, 0.7, A, B, 0.5, R);
+  gemm_cmat(NoTran, NoTran, ca, CA, CB, cb, CR);
+  gemv_mat(NoTran, 0.7, A, x, 0.5, yr);
+  gemv_cmat(NoTran, ca, CA, cx, cb, cyr);
+  syrk_mat(Lower, NoTran, 0.7, A, 0, Sr);
+  herk_cmat(Lower, NoTran, 0.7, CA, 0, CSr);
+  blas_stat(&stat);
+  for (op = 0; op < BLAS_OPS; op++)
+    if (stat.builtin[op] != 1 || stat.blas[op] != 0)
+      printf("never : op %d routed %llu builtin, %llu blas\n", op,
+             stat.builtin[op], stat.blas[op]);
+
+  for (op = 0; op < BLAS_OPS; op++) blas_set_threshold(op, 0);
+  blas_stat_reset();
+  gemm_mat(NoTran, NoTran, 0.7, A, B, 0.5, C);
+  gemm_cmat(NoTran, NoTran, ca, CA, CB, cb, CC);
+  gemv_mat(NoTran, 0.7, A, x, 0.5, y);
+  gemv_cmat(NoTran, ca, CA, cx, cb, cy);
+  syrk_mat(Lower, NoTran, 0.7, A, 0, S);
+  herk_cmat(Lower, NoTran, 0.7, CA, 0, CS);
+  blas_stat(&stat);
+  for (op = 0; op < BLAS_OPS; op++)
+    if (stat.builtin[op] + stat.blas[op] != 1 ||
+        stat.blas[op] != (unsigned long long)has_blas)
+      printf("always : op %d routed %llu builtin, %llu blas\n", op,
+             stat.builtin[op], stat.blas[op]);
+  err = max_diff(C->data, R->data, 70 * 60);
+  err = fmax(err, max_diff(y->data, yr->data, 50));
+  err = fmax(err, max_diff(S->data, Sr->data, 70 * 70));
+  cerr = cmax_diff(CC->data, CR->data, 70 * 60);
+  cerr = fmax(cerr, cmax_diff(cy->data, cyr->data, 50));
+  cerr = fmax(cerr, cmax_diff(CS->data, CSr->data, 70 * 70));
+  printf("builtin against blas : real %.2e, complex %.2e\n", err, cerr);
+
+  // size 70 * 60 * 50 against a threshold on each side of it
+  blas_set_threshold(BLAS_GEMM, 70 * 60 * 50);
+  blas_set_threshold(BLAS_GEMV, 70 * 50 + 1);
+  blas_stat_reset();
+  gemm_mat(NoTran, NoTran, 0.7, A, B, 0.5, C);
+  gemv_mat(NoTran, 0.7, A, x, 0.5, y);
+  blas_stat(&stat);
+  if (stat.blas[BLAS_GEMM] != (unsigned long long)has_blas ||
+      stat.builtin[BLAS_GEMV] != 1)
+    printf("threshold : gemm %llu blas, gemv %llu builtin\n",
+           stat.blas[BLAS_GEMM], stat.builtin[BLAS_GEMV]);
+  for (op = 0; op < BLAS_OPS; op++) blas_set_threshold(op, th[op]);
+
+  // BLAS runs on one thread under threads of slices, then gets its own back
+  P = alloc_mat(8, 8, 16);
+  Q = alloc_mat(8, 8, 16);
+  randu(P, -1, 1);
+  nt = blas_set_threads(2);
+  gemm_mat(NoTran, NoTran, 1, P, P, 0, Q);
+  if (nt > 0 && blas_set_threads(nt) != 2)
+    printf("batch : threads of BLAS not restored\n");
+  free_mat(P);
+  free_mat(Q);
+
+#if USE_DLBLAS
+  if (blas_open("libiip_no_such_blas.so") || strcmp(blas_name(), stat.name))
+    printf("blas_open() of missing library changed backend\n");
+#endif
+
+  if (has_blas) {
+    blas_autotune(TUNE_FILE);
+    for (op = 0; op < BLAS_OPS; op++) th[op] = blas_get_threshold(op);
+    for (op = 0; op < BLAS_OPS; op++) blas_set_threshold(op, 1);
+    if (blas_load_tune(TUNE_FILE) != BLAS_OPS)
+      printf("blas_load_tune() : wrong number of thresholds\n");
+    for (op = 0; op < BLAS_OPS; op++)
+      if (blas_get_threshold(op) != th[op])
+        printf("blas_load_tune() : op %d %llu, tuned %llu\n", op,
+               blas_get_threshold(op), th[op]);
+    remove(TUNE_FILE);
+  } else
+    printf("no BLAS backend, autotune skipped\n");
+  blas_stat_json(stdout);
+
+  free_mat(A);
+  free_mat(B);
+  free_mat(C);
+  free_mat(R);
+  free_mat(x);
+  free_mat(y);
+  free_mat(yr);
+  free_cmat(CA);
+  free_cmat(CB);
+  free_cmat(CC);
+  free_cmat(CR);
+  free_cmat(cx);
+  free_cmat(cy);
+  free_cmat(cyr);
+  free_mat(S);
+  free_mat(Sr);
+  free_cmat(CS);
+  free_cmat(CSr);
+  finit();
+  return 0;
+}
@@ -0,0 +1,147 @@
+#include "header_for_test.h"
+#include "mother.h"
+
+/* Broadcasting add/mul/div_elements against an element-wise reference over
+ * every shape pair, and bandwidth of mixed shapes. */
+
+#define NUM_BIN 257
+#define NUM_FRAME 500
+#define NUM_CH 8
+#define REPEAT 20
+
+/* C[i,j,k] = A op B with every dim of 1 repeated */
+void ref(char op, MAT* A, MAT* B, MAT* C) {
+  ITER i, j, k;
+  DTYPE x, y;
+  for (k = 0; k < C->d2; k++)
+    for (j = 0; j < C->d1; j++)
+      for (i = 0; i < C->d0; i++) {
+        x = A->data[(A->d0 == 1 ? 0 : i) + (A->d1 == 1 ? 0 : j) * A->d0 +
+                    (A->d2 == 1 ? 0 : k) * A->d0 * A->d1];
+        y = B->data[(B->d0 == 1 ? 0 : i) + (B->d1 == 1 ? 0 : j) * B->d0 +
+                    (B->d2 == 1 ? 0 : k) * B->d0 * B->d1];
+        C->data[i + j * C->d0 + k * C->d0 * C->d1] =
+            op == '+' ? x + y : (op == '*' ? x * y : x / y);
+      }
+}
+
+int main() {
+  MAT *A, *B, *C, *R;
+  CMAT *CA, *CB, *CC;
+  UINT s[3] = {5, 4, 3};
+  UINT da[3], db[3];
+  ITER ma, mb, k, i, n;
+  DTYPE err = 0, cerr = 0;
+  long long t;
+
+  init(0);
+
+  // every pair of shapes, each dim either 1 or full
+  for (ma = 0; ma < 8; ma++)
+    for (mb = 0; mb < 8; mb++) {
+      for (k = 0; k < 3; k++) {
+        da[k] = (ma >> k) & 1 ? s[k] : 1;
+        db[k] = (mb >> k) & 1 ? s[k] : 1;
+      }
+      A = alloc_mat(da[0], da[1], da[2]);
+      B = alloc_mat(db[0], db[1], db[2]);
+      C = alloc_mat(da[0] > db[0] ? da[0] : db[0], da[1] > db[1] ? da[1] : db[1],
+                    da[2] > db[2] ? da[2] : db[2]);
+      R = alloc_mat(C->d0, C->d1, C->d2);
+      CA = alloc_cmat(da[0], da[1], da[2]);
+      CB = alloc_cmat(db[0], db[1], db[2]);
+      CC = alloc_cmat(C->d0, C->d1, C->d2);
+      randu(A, 1, 2);
+      randu(B, 1, 2);
+      for (i = 0; i < A->d0 * A->d1 * A->d2; i++) {
+        CA->data[i].re = A->data[i];
+        CA->data[i].im = 0;
+      }
+      for (i = 0; i < B->d0 * B->d1 * B->d2; i++) {
+        CB->data[i].re = B->data[i];
+        CB->data[i].im = 0;
+      }
+      n = C->d0 * C->d1 * C->d2;
+
+      add_elements(A, B, C);
+      ref('+', A, B, R);
+      err = fmax(err, max_diff(C->data, R->data, n));
+      cadd_elements(CA, CB, CC);
+      for (i = 0; i < n; i++) cerr = fmax(cerr, fabs(CC->data[i].re - R->data[i]));
+
+      mul_elements(A, B, C);
+      ref('*', A, B, R);
+      err = fmax(err, max_diff(C->data, R->data, n));
+      cmul_elements(CA, CB, CC);
+      for (i = 0; i < n; i++) cerr = fmax(cerr, fabs(CC->data[i].re - R->data[i]));
+
+      div_elements(A, B, C);
+      ref('/', A, B, R);
+      err = fmax(err, max_diff(C->data, R->data, n));
+      cdiv_elements(CA, CB, CC);
+      for (i = 0; i < n; i++) cerr = fmax(cerr, fabs(CC->data[i].re - R->data[i]));
+
+      free_mat(A);
+      free_mat(B);
+      free_mat(C);
+      free_mat(R);
+      free_cmat(CA);
+      free_cmat(CB);
+      free_cmat(CC);
+    }
+  printf("64 shape pairs, max error : %e, complex %e\n", err, cerr);
+
+  // (257,1,8) + (1,500,1) : a gain per bin and channel, a gain per frame
+  A = alloc_mat(NUM_BIN, 1, NUM_CH);
+  B = alloc_mat(1, NUM_FRAME);
+  C = alloc_mat(NUM_BIN, NUM_FRAME, NUM_CH);
+  R = alloc_mat(NUM_BIN, NUM_FRAME, NUM_CH);
+  randu(A, 1, 2);
+  randu(B, 1, 2);
+  n = NUM_BIN * NUM_FRAME * NUM_CH;
+  fill(C, 0);
+  fill(R, 0);
+
+  stopwatch(0);
+  for (i = 0; i < REPEAT; i++) add_elements(A, B, C);
+  t = stopwatch(1);
+  printf("(%d,1,%d) + (1,%d,1) : %.3lf ms, %.2lf GB/s written\n", NUM_BIN,
+         NUM_CH, NUM_FRAME, (double)t / REPEAT / 1000,
+         1.0 * n * sizeof(DTYPE) * REPEAT / t / 1000.0);
+
+  stopwatch(0);
+  for (i = 0; i < REPEAT; i++) mul_elements(C, C, R);
+  t = stopwatch(1);
+  printf("(%d,%d,%d) * same     : %.3lf ms, %.2lf GB/s read + written\n",
+         NUM_BIN, NUM_FRAME, NUM_CH, (double)t / REPEAT / 1000,
+         2.0 * n * sizeof(DTYPE) * REPEAT / t / 1000.0);
+
+  // same shape one element off alignment, against the aligned run above
+  {
+    MAT Cu = *C, Ru = *C;
+    MAT* U = alloc_mat(n);
+    Cu.ndim = Ru.ndim = 0;
+    Cu.d0 = Ru.d0 = n - 1;
+    Cu.d1 = Ru.d1 = Cu.d2 = Ru.d2 = 1;
+    Cu.data = C->data + 1;
+    Ru.data = U->data + 1;
+    mul_elements(&Cu, &Cu, &Ru);
+    printf("unaligned same shape, max error : %e\n",
+           max_diff(Ru.data, R->data + 1, n - 1));
+    free_mat(U);
+  }
+
+  stopwatch(0);
+  for (i = 0; i < REPEAT; i++) memcpy(R->data, C->data, sizeof(DTYPE) * n);
+  t = stopwatch(1);
+  printf("memcpy                   : %.3lf ms, %.2lf GB/s read + written\n",
+         (double)t / REPEAT / 1000,
+         2.0 * n * sizeof(DTYPE) * REPEAT / t / 1000.0);
+
+  free_mat(A);
+  free_mat(B);
+  free_mat(C);
+  free_mat(R);
+  finit();
+  return 0;
+}
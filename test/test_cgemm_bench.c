@@ -0,0 +1,154 @@
+#include "header_for_test.h"
+#include "mother.h"
+
+/* Packed omp_cgemm() against the element-wise loop and against
+ * cblas_zgemm() when built with BLAS, in GFLOP/s counting 8 flops per
+ * complex multiply-add. Error is checked on odd sizes for all nine
+ * combinations of NoTran/Tran/CTran, in 4M and in 3M. */
+
+#define REPEAT 3
+
+UINT sizes[4] = {128, 256, 512, 768};
+
+/* previous omp_cgemm() : one dot product per element of C */
+void cgemm_ref(char transA, char transB, UINT m, UINT n, UINT k, CTYPE alpha,
+               CTYPE* A, UINT lda, CTYPE* B, UINT ldb, CTYPE beta, CTYPE* C,
+               UINT ldc) {
+  ITER i, j, l;
+  CTYPE temp, a, b;
+  DTYPE temp2;
+#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(A, B, C) private(temp, temp2, i, j, l, a, b)
+  for (l = 0; l < m; l++) {
+    for (j = 0; j < n; j++) {
+      temp.re = 0;
+      temp.im = 0;
+      for (i = 0; i < k; i++) {
+        a = transA == NoTran ? A[i * lda + l] : A[l * lda + i];
+        b = transB == NoTran ? B[i + j * ldb] : B[i * ldb + j];
+        if (transA == CTran) a.im = -a.im;
+        if (transB == CTran) b.im = -b.im;
+        CXADD_mul(temp, a, b)
+      }
+      CXMUL(C[l + ldc * j], beta, temp2)
+      CXMUL(temp, alpha, temp2)
+      CXADD(C[l + ldc * j], temp)
+    }
+  }
+}
+
+void check(UINT m, UINT n, UINT k) {
+  CMAT *A, *B, *C, *R;
+  char tr[3] = {NoTran, Tran, CTran};
+  const char* name = "NTC";
+  CTYPE alpha, beta, zero;
+  ITER i, ta, tb;
+
+  A = alloc_cmat(k > m ? k : m, k > n ? k : n);
+  B = alloc_cmat(k > m ? k : m, k > n ? k : n);
+  C = alloc_cmat(m, n);
+  R = alloc_cmat(m, n);
+  crandu(A, -1, 1, -1, 1);
+  crandu(B, -1, 1, -1, 1);
+  alpha.re = 0.5;
+  alpha.im = -0.25;
+  beta.re = -2;
+  beta.im = 1;
+  zero.re = zero.im = 0;
+  for (ta = 0; ta < 3; ta++)
+    for (tb = 0; tb < 3; tb++) {
+      crandu(C, -1, 1, -1, 1);
+      ccopy_mat(C, R);
+      omp_cgemm(tr[ta], tr[tb], m, n, k, alpha, A->data, A->d0, B->data,
+                B->d0, beta, C->data, m);
+      cgemm_ref(tr[ta], tr[tb], m, n, k, alpha, A->data, A->d0, B->data,
+                B->d0, beta, R->data, m);
+      printf("%c%c %u x %u x %u : beta err %.3e", name[ta], name[tb], m, n, k,
+             cmax_diff(C->data, R->data, m * n));
+
+      // beta 0 must not read C
+      for (i = 0; i < m * n; i++) C->data[i].re = C->data[i].im = NAN;
+      omp_cgemm(tr[ta], tr[tb], m, n, k, alpha, A->data, A->d0, B->data,
+                B->d0, zero, C->data, m);
+      for (i = 0; i < m * n; i++) R->data[i].re = R->data[i].im = 0;
+      cgemm_ref(tr[ta], tr[tb], m, n, k, alpha, A->data, A->d0, B->data,
+                B->d0, zero, R->data, m);
+      printf(", beta 0 err %.3e\n", cmax_diff(C->data, R->data, m * n));
+    }
+  free_cmat(A);
+  free_cmat(B);
+  free_cmat(C);
+  free_cmat(R);
+}
+
+int main() {
+  CMAT *A, *B, *C, *R;
+  CTYPE one, zero;
+  UINT s, N;
+  ITER i;
+  long long t;
+  double flop;
+
+  init(0);
+  one.re = 1;
+  one.im = 0;
+  zero.re = zero.im = 0;
+
+  printf("4M\n");
+  check(37, 29, 101);
+  if (CGEMM_3M_MIN <= 1024) {
+    printf("3M from %d\n", CGEMM_3M_MIN);
+    check(CGEMM_3M_MIN + 3, CGEMM_3M_MIN + 5, CGEMM_3M_MIN + 201);
+  }
+
+  printf("\n   N :     loop   packed     BLAS\n");
+  for (s = 0; s < 4; s++) {
+    N = sizes[s];
+    flop = 8.0 * N * N * N * REPEAT;
+    A = alloc_cmat(N, N);
+    B = alloc_cmat(N, N);
+    C = alloc_cmat(N, N);
+    R = alloc_cmat(N, N);
+    crandu(A, -1, 1, -1, 1);
+    crandu(B, -1, 1, -1, 1);
+
+    printf("%4u : ", N);
+    // the loop takes too long on large N
+    if (N <= 512) {
+      stopwatch(0);
+      for (i = 0; i < REPEAT; i++)
+        cgemm_ref(NoTran, NoTran, N, N, N, one, A->data, N, B->data, N, zero,
+                  R->data, N);
+      t = stopwatch(1);
+      printf("%8.2lf ", flop / t / 1000.0);
+    } else
+      printf("       - ");
+
+    stopwatch(0);
+    for (i = 0; i < REPEAT; i++)
+      omp_cgemm(NoTran, NoTran, N, N, N, one, A->data, N, B->data, N, zero,
+                C->data, N);
+    t = stopwatch(1);
+    printf("%8.2lf ", flop / t / 1000.0);
+
+#if USE_CBLAS
+    stopwatch(0);
+    for (i = 0; i < REPEAT; i++)
+      cblas_zgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, N, N, N, &one,
+                  A->data, N, B->data, N, &zero, R->data, N);
+    t = stopwatch(1);
+    printf("%8.2lf ", flop / t / 1000.0);
+#else
+    printf("       - ");
+#endif
+    if (N <= 512) printf(" err %.3e", cmax_diff(C->data, R->data, N * N));
+    printf(" %s\n", N >= CGEMM_3M_MIN ? "3M" : "4M");
+
+    free_cmat(A);
+    free_cmat(B);
+    free_cmat(C);
+    free_cmat(R);
+  }
+
+  finit();
+  return 0;
+}
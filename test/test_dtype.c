@@ -0,0 +1,195 @@
+#include "mother.h"
+
+/* float32 and float64 TMAT side by side in one build : error of each
+ * precision against MAT of DTYPE, and time of the bandwidth-bound stages. */
+
+#define NUM_FFT 512
+#define NUM_FRAME 2000
+#define DIM 256
+#define SIZE 10000000
+#define REPEAT 5
+
+double max_diff_tmat(TMAT* T, MAT* R) {
+  MAT* M;
+  ITER i;
+  double d = 0;
+  M = alloc_mat(R->d0, R->d1, R->d2);
+  tmat2mat(T, M);
+  for (i = 0; i < R->d0 * R->d1 * R->d2; i++)
+    if (fabs(M->data[i] - R->data[i]) > d) d = fabs(M->data[i] - R->data[i]);
+  free_mat(M);
+  return d;
+}
+
+double max_diff_ctmat(TMAT* T, CMAT* R) {
+  CMAT* M;
+  ITER i;
+  double d = 0;
+  M = alloc_cmat(R->d0, R->d1, R->d2);
+  tmat2cmat(T, M);
+  for (i = 0; i < R->d0 * R->d1 * R->d2; i++) {
+    if (fabs(M->data[i].re - R->data[i].re) > d)
+      d = fabs(M->data[i].re - R->data[i].re);
+    if (fabs(M->data[i].im - R->data[i].im) > d)
+      d = fabs(M->data[i].im - R->data[i].im);
+  }
+  free_cmat(M);
+  return d;
+}
+
+int main() {
+  MAT *A, *B, *C, *X, *R, *XR;
+  CMAT *CA, *CB, *CC;
+  TMAT *tA[2], *tB[2], *tC[2], *tX[2], *tY[2], *tS[2];
+  UINT dt[2] = {DT_S, DT_D}, ct[2] = {DT_C, DT_Z};
+  const char* name[2] = {"float32", "float64"};
+  CTYPE one, zero;
+  CTYPE_D one_d, zero_d;
+  EW_CHAIN chain;
+  ITER p, k;
+  long long t;
+
+  init(0);
+  one.re = one_d.re = 1;
+  one.im = one_d.im = 0;
+  zero.re = zero_d.re = 0;
+  zero.im = zero_d.im = 0;
+
+  // gemm, real and complex
+  A = alloc_mat(DIM, DIM);
+  B = alloc_mat(DIM, DIM);
+  C = alloc_mat(DIM, DIM);
+  CA = alloc_cmat(DIM, DIM);
+  CB = alloc_cmat(DIM, DIM);
+  CC = alloc_cmat(DIM, DIM);
+  randu(A, -1, 1);
+  randu(B, -1, 1);
+  crandu(CA, -1, 1, -1, 1);
+  crandu(CB, -1, 1, -1, 1);
+  gemm_mat(NoTran, NoTran, 1, A, B, 0, C);
+  gemm_cmat(CTran, NoTran, one, CA, CB, zero, CC);
+  for (p = 0; p < 2; p++) {
+    tA[p] = mat2tmat(A, dt[p]);
+    tB[p] = mat2tmat(B, dt[p]);
+    tC[p] = alloc_tmat(dt[p], DIM, DIM);
+    stopwatch(0);
+    for (k = 0; k < REPEAT; k++)
+      gemm_tmat(NoTran, NoTran, 1, tA[p], tB[p], 0, tC[p]);
+    t = stopwatch(1);
+    printf("gemm   %s : %8.3lf ms, max error %e\n", name[p],
+           (double)t / REPEAT / 1000, max_diff_tmat(tC[p], C));
+    free_tmat(tA[p]);
+    free_tmat(tB[p]);
+    free_tmat(tC[p]);
+
+    tA[p] = cmat2tmat(CA, ct[p]);
+    tB[p] = cmat2tmat(CB, ct[p]);
+    tC[p] = alloc_tmat(ct[p], DIM, DIM);
+    stopwatch(0);
+    for (k = 0; k < REPEAT; k++)
+      cgemm_tmat(CTran, NoTran, one_d, tA[p], tB[p], zero_d, tC[p]);
+    t = stopwatch(1);
+    printf("cgemm  %s : %8.3lf ms, max error %e\n", name[p],
+           (double)t / REPEAT / 1000, max_diff_ctmat(tC[p], CC));
+    free_tmat(tA[p]);
+    free_tmat(tB[p]);
+    free_tmat(tC[p]);
+  }
+  free_mat(A);
+  free_mat(B);
+  free_mat(C);
+  free_cmat(CA);
+  free_cmat(CB);
+  free_cmat(CC);
+
+  // gemv, axpy, scal
+  A = alloc_mat(DIM, DIM / 2);
+  X = alloc_mat(DIM);
+  R = alloc_mat(DIM / 2);
+  randu(A, -1, 1);
+  randu(X, -1, 1);
+  randu(R, -1, 1);
+  for (p = 0; p < 2; p++) {
+    tA[p] = mat2tmat(A, dt[p]);
+    tX[p] = mat2tmat(X, dt[p]);
+    tY[p] = mat2tmat(R, dt[p]);
+    gemv_tmat(NoTran, 2, tA[p], tX[p], 0.5, tY[p]);
+    axpy_tmat(0.25, tY[p], tY[p]);
+    scal_tmat(3, tX[p]);
+  }
+  gemv_mat(NoTran, 2, A, X, 0.5, R);
+  axpy_mat(0.25, R, R);
+  scal_mat(3, X);
+  for (p = 0; p < 2; p++) {
+    printf("gemv, axpy, scal %s : max error %e %e\n", name[p],
+           max_diff_tmat(tY[p], R), max_diff_tmat(tX[p], X));
+    free_tmat(tA[p]);
+    free_tmat(tX[p]);
+    free_tmat(tY[p]);
+  }
+  free_mat(A);
+  free_mat(X);
+  free_mat(R);
+
+  // hfft of frames, then log power by fused chain
+  X = alloc_mat(NUM_FFT, NUM_FRAME);
+  CC = alloc_cmat(NUM_FFT / 2 + 1, NUM_FRAME);
+  R = alloc_mat(NUM_FFT / 2 + 1, NUM_FRAME);
+  randu(X, -1, 1);
+  hfft(X, CC);
+  chain = ew_chain();
+  ew_push(&chain, EW_ABS, 0);
+  ew_push(&chain, EW_POW, 2);
+  ew_push(&chain, EW_ADD, 1e-6);
+  ew_push(&chain, EW_LOG10, 0);
+  ew_run_cmat(&chain, CC, R);
+  for (p = 0; p < 2; p++) {
+    tX[p] = mat2tmat(X, dt[p]);
+    tS[p] = alloc_tmat(ct[p], NUM_FFT / 2 + 1, NUM_FRAME);
+    tY[p] = alloc_tmat(dt[p], NUM_FFT / 2 + 1, NUM_FRAME);
+    stopwatch(0);
+    for (k = 0; k < REPEAT; k++) hfft_tmat(tX[p], tS[p]);
+    t = stopwatch(1);
+    printf("hfft   %s : %8.3lf ms, max error %e\n", name[p],
+           (double)t / REPEAT / 1000, max_diff_ctmat(tS[p], CC));
+    ew_run_tmat(&chain, tS[p], tY[p]);
+    printf("log power %s : max error %e\n", name[p], max_diff_tmat(tY[p], R));
+    free_tmat(tX[p]);
+    free_tmat(tS[p]);
+    free_tmat(tY[p]);
+  }
+  free_mat(X);
+  free_cmat(CC);
+  free_mat(R);
+
+  // bandwidth-bound chain on 10M elements
+  X = alloc_mat(SIZE);
+  XR = alloc_mat(SIZE);
+  randu(X, -1, 1);
+  chain = ew_chain();
+  ew_push(&chain, EW_POW, 2);
+  ew_push(&chain, EW_SCAL, 0.5);
+  ew_push(&chain, EW_ADD, 1e-10);
+  ew_push(&chain, EW_SQRT, 0);
+  ew_run(&chain, X, XR);
+  for (p = 0; p < 2; p++) {
+    tX[p] = mat2tmat(X, dt[p]);
+    tY[p] = alloc_tmat(dt[p], SIZE);
+    stopwatch(0);
+    for (k = 0; k < REPEAT; k++) ew_run_tmat(&chain, tX[p], tY[p]);
+    t = stopwatch(1);
+    printf("chain  %s : %8.3lf ms, max error %e\n", name[p],
+           (double)t / REPEAT / 1000, max_diff_tmat(tY[p], XR));
+    stopwatch(0);
+    for (k = 0; k < REPEAT; k++) scal_tmat(0.5, tX[p]);
+    t = stopwatch(1);
+    printf("scal   %s : %8.3lf ms\n", name[p], (double)t / REPEAT / 1000);
+    free_tmat(tX[p]);
+    free_tmat(tY[p]);
+  }
+  free_mat(X);
+  free_mat(XR);
+
+  finit();
+  return 0;
+}
@@ -0,0 +1,102 @@
+#include "mother.h"
+
+/* Per-frame cost of hfft, work area from mpalloc()/mpfree()(before)
+ * against mp_mark()/mp_scratch()/mp_release()(after). */
+
+#define FFT_SIZE 512
+#define NUM_FRAME 500
+#define REPEAT 100
+#define NUM_ALLOC 1000000
+
+/* ooura_hfft_col as it was, with the work area from mpalloc() */
+void hfft_col_mpalloc(UINT N, DTYPE* in, CTYPE* out) {
+  double* a;
+  int* ip;
+  double* w;
+  ITER i;
+
+  a = mpalloc(sizeof(double) * N);
+  ip = mpalloc(sizeof(int) * ((int)(sqrt(N / 2)) + 1));
+  w = mpalloc(sizeof(double) * (N / 2));
+  ip[0] = 0;
+  for (i = 0; i < N; i++) a[i] = in[i];
+
+  rdft(N, 1, a, ip, w);
+
+  for (i = 0; i < (N / 2); i++) {
+    out[i].re = a[2 * i];
+    out[i].im = -a[2 * i + 1];
+  }
+  out[0].im = 0;
+  out[N / 2].re = a[1];
+  out[N / 2].im = 0;
+
+  mpfree(w);
+  mpfree(ip);
+  mpfree(a);
+}
+
+int main() {
+  MAT* A;
+  CMAT* B;
+  ITER i, j;
+  long long before, after;
+  void *a, *ip, *w;
+  MP_MARK mark;
+
+  init(0);
+  A = zeros(FFT_SIZE, NUM_FRAME);
+  B = czeros(FFT_SIZE / 2 + 1, NUM_FRAME);
+  randn(A, 0, 1);
+
+  // warm up
+  hfft(A, B);
+
+  stopwatch(0);
+  for (j = 0; j < REPEAT; j++)
+    for (i = 0; i < NUM_FRAME; i++)
+      hfft_col_mpalloc(FFT_SIZE, &(A->data[i * FFT_SIZE]),
+                       &(B->data[i * (FFT_SIZE / 2 + 1)]));
+  before = stopwatch(1);
+
+  stopwatch(0);
+  for (j = 0; j < REPEAT; j++) hfft(A, B);
+  after = stopwatch(1);
+
+  printf("hfft %d-point, per frame\n", FFT_SIZE);
+  printf(" mpalloc/mpfree        : %.3lf us\n",
+         (double)before / (REPEAT * NUM_FRAME));
+  printf(" mp_mark/mp_release    : %.3lf us\n",
+         (double)after / (REPEAT * NUM_FRAME));
+
+  // work area only
+  stopwatch(0);
+  for (i = 0; i < NUM_ALLOC; i++) {
+    a = mpalloc(sizeof(double) * FFT_SIZE);
+    ip = mpalloc(sizeof(int) * ((int)(sqrt(FFT_SIZE / 2)) + 1));
+    w = mpalloc(sizeof(double) * (FFT_SIZE / 2));
+    mpfree(w);
+    mpfree(ip);
+    mpfree(a);
+  }
+  before = stopwatch(1);
+
+  stopwatch(0);
+  for (i = 0; i < NUM_ALLOC; i++) {
+    mark = mp_mark();
+    a = mp_scratch(sizeof(double) * FFT_SIZE);
+    ip = mp_scratch(sizeof(int) * ((int)(sqrt(FFT_SIZE / 2)) + 1));
+    w = mp_scratch(sizeof(double) * (FFT_SIZE / 2));
+    mp_release(mark);
+  }
+  after = stopwatch(1);
+
+  printf("work area of one frame(3 buffers)\n");
+  printf(" mpalloc/mpfree        : %.3lf ns\n", 1000.0 * before / NUM_ALLOC);
+  printf(" mp_mark/mp_release    : %.3lf ns\n", 1000.0 * after / NUM_ALLOC);
+
+  free_mat(A);
+  free_cmat(B);
+  finit();
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include "header_for_test.h"
+#include "mother.h"
+
+/* log10(scale * |X|^2 + eps) as a chain of whole-matrix calls against one
+ * fused pass of ew_run(), on 10M elements. */
+
+#define SIZE 10000000
+#define REPEAT 5
+#define SCALE 0.5
+#define EPS 1e-10
+
+int main() {
+  MAT *X, *Y, *R, *G;
+  CMAT *CX, *CT;
+  EW_CHAIN chain;
+  ITER i, k;
+  long long t;
+
+  init(0);
+
+  X = alloc_mat(SIZE);
+  Y = alloc_mat(SIZE);
+  R = alloc_mat(SIZE);
+  G = alloc_mat(SIZE);
+  randu(X, -1, 1);
+  randu(G, 1, 2);
+
+  chain = ew_chain();
+  ew_push(&chain, EW_POW, 2);
+  ew_push(&chain, EW_SCAL, SCALE);
+  ew_push(&chain, EW_ADD, EPS);
+  ew_push(&chain, EW_LOG10, 0);
+
+  // real
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++) {
+    copy_mat(X, R);
+    pow_mat(R, 2);
+    scal_mat(SCALE, R);
+    add_mat(EPS, R);
+    log10_mat(R);
+  }
+  t = stopwatch(1);
+  printf("real    unfused : %8.3lf ms\n", (double)t / REPEAT / 1000);
+
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++) ew_run(&chain, X, Y);
+  t = stopwatch(1);
+  printf("real    fused   : %8.3lf ms, max error %e\n",
+         (double)t / REPEAT / 1000, max_diff(R->data, Y->data, SIZE));
+
+  // with a matrix operand in the chain
+  ew_push_mat(&chain, EW_MUL_MAT, G);
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++) {
+    copy_mat(X, R);
+    pow_mat(R, 2);
+    scal_mat(SCALE, R);
+    add_mat(EPS, R);
+    log10_mat(R);
+    mul_elements(R, G, R);
+  }
+  t = stopwatch(1);
+  printf("matrix  unfused : %8.3lf ms\n", (double)t / REPEAT / 1000);
+
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++) ew_run(&chain, X, Y);
+  t = stopwatch(1);
+  printf("matrix  fused   : %8.3lf ms, max error %e\n",
+         (double)t / REPEAT / 1000, max_diff(R->data, Y->data, SIZE));
+
+  // complex, |X| first
+  CX = alloc_cmat(SIZE);
+  CT = alloc_cmat(SIZE);
+  crandu(CX, -1, 1, -1, 1);
+  chain = ew_chain();
+  ew_push(&chain, EW_ABS, 0);
+  ew_push(&chain, EW_POW, 2);
+  ew_push(&chain, EW_SCAL, SCALE);
+  ew_push(&chain, EW_ADD, EPS);
+  ew_push(&chain, EW_LOG10, 0);
+
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++) {
+    ccopy_mat(CX, CT);
+    abs_cmat(CT);
+    for (i = 0; i < SIZE; i++) R->data[i] = CT->data[i].re;
+    pow_mat(R, 2);
+    scal_mat(SCALE, R);
+    add_mat(EPS, R);
+    log10_mat(R);
+  }
+  t = stopwatch(1);
+  printf("complex unfused : %8.3lf ms\n", (double)t / REPEAT / 1000);
+
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++) ew_run_cmat(&chain, CX, Y);
+  t = stopwatch(1);
+  printf("complex fused   : %8.3lf ms, max error %e\n",
+         (double)t / REPEAT / 1000, max_diff(R->data, Y->data, SIZE));
+
+  free_mat(X);
+  free_mat(Y);
+  free_mat(R);
+  free_mat(G);
+  free_cmat(CX);
+  free_cmat(CT);
+  finit();
+  return 0;
+}
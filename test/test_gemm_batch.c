@@ -0,0 +1,114 @@
+#include "mother.h"
+
+/* gemm_mat() over d2 slices against one gemm per slice issued in turn, as
+ * test/openBLAS_with_openMP.c does by hand. Per-bin workloads such as
+ * 257 bins of 8 x 8 are the target. */
+
+#define REPEAT 200
+
+UINT dims[4][2] = {{8, 257}, {32, 257}, {64, 64}, {256, 8}};
+
+/* one gemm per slice, as gemm_mat() did */
+void gemm_loop(MAT* A, MAT* B, MAT* C) {
+  ITER i;
+  UINT n = A->d0, s = A->d0 * A->d1;
+  for (i = 0; i < A->d2; i++) {
+#if USE_CBLAS
+    cblas_dgemm(CblasColMajor, NoTran, NoTran, n, n, n, 1, A->data + i * s, n,
+                B->data + i * s, n, 0, C->data + i * s, n);
+#else
+    omp_gemm(NoTran, NoTran, n, n, n, 1, A->data + i * s, n, B->data + i * s,
+             n, 0, C->data + i * s, n);
+#endif
+  }
+}
+
+void cgemm_loop(CMAT* A, CMAT* B, CMAT* C) {
+  ITER i;
+  UINT n = A->d0, s = A->d0 * A->d1;
+  CTYPE one, zero;
+  one.re = 1;
+  one.im = zero.re = zero.im = 0;
+  for (i = 0; i < A->d2; i++) {
+#if USE_CBLAS
+    cblas_zgemm(CblasColMajor, NoTran, NoTran, n, n, n, &one, A->data + i * s,
+                n, B->data + i * s, n, &zero, C->data + i * s, n);
+#else
+    omp_cgemm(NoTran, NoTran, n, n, n, one, A->data + i * s, n,
+              B->data + i * s, n, zero, C->data + i * s, n);
+#endif
+  }
+}
+
+int main() {
+  MAT *A, *B, *C, *R;
+  CMAT *CA, *CB, *CC, *CR;
+  CTYPE one, zero;
+  UINT n, d2, s, rep;
+  ITER i;
+  long long t_loop, t_batch;
+  double err;
+
+  init(0);
+  one.re = 1;
+  one.im = zero.re = zero.im = 0;
+
+  for (s = 0; s < 4; s++) {
+    n = dims[s][0];
+    d2 = dims[s][1];
+    rep = REPEAT * 8 * 8 * 8 / (n * n * n) + 1;
+    A = alloc_mat(n, n, d2);
+    B = alloc_mat(n, n, d2);
+    C = alloc_mat(n, n, d2);
+    R = alloc_mat(n, n, d2);
+    CA = alloc_cmat(n, n, d2);
+    CB = alloc_cmat(n, n, d2);
+    CC = alloc_cmat(n, n, d2);
+    CR = alloc_cmat(n, n, d2);
+    randu(A, -1, 1);
+    randu(B, -1, 1);
+    crandu(CA, -1, 1, -1, 1);
+    crandu(CB, -1, 1, -1, 1);
+
+    stopwatch(0);
+    for (i = 0; i < rep; i++) gemm_loop(A, B, R);
+    t_loop = stopwatch(1);
+    stopwatch(0);
+    for (i = 0; i < rep; i++) gemm_mat(NoTran, NoTran, 1, A, B, 0, C);
+    t_batch = stopwatch(1);
+    err = 0;
+    for (i = 0; i < n * n * d2; i++)
+      if (fabs(C->data[i] - R->data[i]) > err)
+        err = fabs(C->data[i] - R->data[i]);
+    printf(" real    %3u x %3u x %3u : loop %8.2lf us, batch %8.2lf us, err %.3e\n",
+           n, n, d2, (double)t_loop / rep, (double)t_batch / rep, err);
+
+    stopwatch(0);
+    for (i = 0; i < rep; i++) cgemm_loop(CA, CB, CR);
+    t_loop = stopwatch(1);
+    stopwatch(0);
+    for (i = 0; i < rep; i++) gemm_cmat(NoTran, NoTran, one, CA, CB, zero, CC);
+    t_batch = stopwatch(1);
+    err = 0;
+    for (i = 0; i < n * n * d2; i++) {
+      if (fabs(CC->data[i].re - CR->data[i].re) > err)
+        err = fabs(CC->data[i].re - CR->data[i].re);
+      if (fabs(CC->data[i].im - CR->data[i].im) > err)
+        err = fabs(CC->data[i].im - CR->data[i].im);
+    }
+    printf(" complex %3u x %3u x %3u : loop %8.2lf us, batch %8.2lf us, err %.3e\n",
+           n, n, d2, (double)t_loop / rep, (double)t_batch / rep, err);
+
+    free_mat(A);
+    free_mat(B);
+    free_mat(C);
+    free_mat(R);
+    free_cmat(CA);
+    free_cmat(CB);
+    free_cmat(CC);
+    free_cmat(CR);
+  }
+
+  finit();
+  return 0;
+}
@@ -0,0 +1,134 @@
+#include "header_for_test.h"
+#include "mother.h"
+
+/* Packed omp_gemm() against the dot-product loop it replaced and against
+ * cblas_dgemm() when built with BLAS, in GFLOP/s. Error is checked on odd
+ * sizes for all combinations of NoTran/Tran. */
+
+#define REPEAT 3
+
+UINT sizes[4] = {128, 256, 512, 1024};
+
+/* previous omp_gemm() : one dot product per element of C */
+void gemm_ref(char transA, char transB, UINT m, UINT n, UINT k, DTYPE alpha,
+              DTYPE* A, UINT lda, DTYPE* B, UINT ldb, DTYPE beta, DTYPE* C,
+              UINT ldc) {
+  ITER i, j, l;
+  DTYPE temp, a, b;
+#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(A, B, C) private(temp, i, j, l, a, b)
+  for (l = 0; l < m; l++) {
+    for (j = 0; j < n; j++) {
+      temp = 0;
+      for (i = 0; i < k; i++) {
+        a = transA == NoTran ? A[i * lda + l] : A[l * lda + i];
+        b = transB == NoTran ? B[i + j * ldb] : B[i * ldb + j];
+        temp += a * b;
+      }
+      C[l + ldc * j] = beta * C[l + ldc * j] + alpha * temp;
+    }
+  }
+}
+
+int main() {
+  MAT *A, *B, *C, *R;
+  char tr[2] = {NoTran, Tran};
+  // the second goes to gemm_direct()
+  UINT odd[2][3] = {{77, 53, 301}, {3, 5, 7}};
+  UINT m, n, k, s, N;
+  ITER i, o, ta, tb;
+  long long t;
+  double flop;
+
+  init(0);
+
+  // odd sizes, C = 0.5 * op(A) * op(B) + beta * C
+  for (o = 0; o < 2; o++) {
+    m = odd[o][0];
+    n = odd[o][1];
+    k = odd[o][2];
+    A = alloc_mat(k, k);
+    B = alloc_mat(k, k);
+    C = alloc_mat(m, n);
+    R = alloc_mat(m, n);
+    randu(A, -1, 1);
+    randu(B, -1, 1);
+    for (ta = 0; ta < 2; ta++)
+      for (tb = 0; tb < 2; tb++) {
+        randu(C, -1, 1);
+        copy_mat(C, R);
+        omp_gemm(tr[ta], tr[tb], m, n, k, 0.5, A->data, k, B->data, k, -2,
+                 C->data, m);
+        gemm_ref(tr[ta], tr[tb], m, n, k, 0.5, A->data, k, B->data, k, -2,
+                 R->data, m);
+        printf("%s%s %u x %u x %u : beta -2 err %.3e", ta ? "T" : "N",
+               tb ? "T" : "N", m, n, k, max_diff(C->data, R->data, m * n));
+
+        // beta 0 must not read C
+        for (i = 0; i < m * n; i++) C->data[i] = NAN;
+        omp_gemm(tr[ta], tr[tb], m, n, k, 0.5, A->data, k, B->data, k, 0,
+                 C->data, m);
+        for (i = 0; i < m * n; i++) R->data[i] = 0;
+        gemm_ref(tr[ta], tr[tb], m, n, k, 0.5, A->data, k, B->data, k, 0,
+                 R->data, m);
+        printf(", beta 0 err %.3e\n", max_diff(C->data, R->data, m * n));
+      }
+    free_mat(A);
+    free_mat(B);
+    free_mat(C);
+    free_mat(R);
+  }
+
+  // square, GFLOP/s
+  printf("\n   N :     loop   packed     BLAS\n");
+  for (s = 0; s < 4; s++) {
+    N = sizes[s];
+    flop = 2.0 * N * N * N * REPEAT;
+    A = alloc_mat(N, N);
+    B = alloc_mat(N, N);
+    C = alloc_mat(N, N);
+    R = alloc_mat(N, N);
+    randu(A, -1, 1);
+    randu(B, -1, 1);
+
+    printf("%4u : ", N);
+    // the loop takes too long on large N
+    if (N <= 512) {
+      stopwatch(0);
+      for (i = 0; i < REPEAT; i++)
+        gemm_ref(NoTran, NoTran, N, N, N, 1, A->data, N, B->data, N, 0,
+                 R->data, N);
+      t = stopwatch(1);
+      printf("%8.2lf ", flop / t / 1000.0);
+    } else
+      printf("       - ");
+
+    stopwatch(0);
+    for (i = 0; i < REPEAT; i++)
+      omp_gemm(NoTran, NoTran, N, N, N, 1, A->data, N, B->data, N, 0,
+               C->data, N);
+    t = stopwatch(1);
+    printf("%8.2lf ", flop / t / 1000.0);
+
+#if USE_CBLAS
+    stopwatch(0);
+    for (i = 0; i < REPEAT; i++)
+      cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, N, N, N, 1,
+                  A->data, N, B->data, N, 0, R->data, N);
+    t = stopwatch(1);
+    printf("%8.2lf ", flop / t / 1000.0);
+#else
+    printf("       - ");
+#endif
+    if (N <= 512)
+      printf(" err %.3e", max_diff(C->data, R->data, N * N));
+    printf("\n");
+
+    free_mat(A);
+    free_mat(B);
+    free_mat(C);
+    free_mat(R);
+  }
+
+  finit();
+  return 0;
+}
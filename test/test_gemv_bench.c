@@ -0,0 +1,241 @@
+#include "header_for_test.h"
+#include "mother.h"
+
+/* Non-BLAS omp_gemv() and omp_cgemv() against the loops before, on odd
+ * sizes and strides, and gemv_rhs_mat() against k calls of gemv_mat().
+ * Timing on 257 x N projections, in us. */
+
+#define REPEAT 20
+#define K 8
+
+UINT ms[5] = {1, 3, 17, 257, 1030};
+UINT ns[5] = {1, 5, 16, 257, 2051};
+
+/* row-major as omp_gemv(), one dot per output */
+void ref_gemv(char tr, UINT m, UINT n, DTYPE alpha, DTYPE* A, UINT lda,
+              DTYPE* X, SINT incx, DTYPE beta, DTYPE* Y, SINT incy) {
+  ITER i, j;
+  DTYPE t;
+  for (j = 0; j < (tr == NoTran ? m : n); j++) {
+    t = 0;
+    for (i = 0; i < (tr == NoTran ? n : m); i++)
+      t += (tr == NoTran ? A[i + lda * j] : A[j + i * lda]) * X[i * incx];
+    Y[j * incy] = alpha * t + beta * Y[j * incy];
+  }
+}
+
+void ref_cgemv(char tr, UINT m, UINT n, CTYPE alpha, CTYPE* A, UINT lda,
+               CTYPE* X, SINT incx, CTYPE beta, CTYPE* Y, SINT incy) {
+  ITER i, j;
+  CTYPE t, a;
+  DTYPE t2;
+  for (j = 0; j < (tr == NoTran ? m : n); j++) {
+    t.re = t.im = 0;
+    for (i = 0; i < (tr == NoTran ? n : m); i++) {
+      a = tr == NoTran ? A[i + lda * j] : A[j + i * lda];
+      if (tr == CTran) a.im = -a.im;
+      CXADD_mul(t, a, X[i * incx]);
+    }
+    CXMUL(t, alpha, t2);
+    CXADD_mul(t, beta, Y[j * incy]);
+    Y[j * incy] = t;
+  }
+}
+
+int main() {
+  MAT *A, *X, *Y, *R, *Xk, *Yk, *Yr, *x, *y;
+  CMAT *CA, *CX, *CY, *CR, *CXk, *CYk, *CYr, *cx, *cy;
+  CTYPE ca, cb;
+  char tr[3] = {NoTran, Tran, CTran};
+  UINT m, n, inc, lx, ly, N;
+  ITER a, b, t, i, r;
+  DTYPE err = 0, cerr = 0;
+  double t0, t1;
+
+  init(0);
+  A = alloc_mat(2051, 1030);
+  X = alloc_mat(3 * 2051);
+  Y = alloc_mat(3 * 2051);
+  R = alloc_mat(3 * 2051);
+  CA = alloc_cmat(2051, 1030);
+  CX = alloc_cmat(3 * 2051);
+  CY = alloc_cmat(3 * 2051);
+  CR = alloc_cmat(3 * 2051);
+  randu(A, -1, 1);
+  randu(X, -1, 1);
+  crandu(CA, -1, 1, -1, 1);
+  crandu(CX, -1, 1, -1, 1);
+  ca.re = 0.7;
+  ca.im = -0.3;
+  cb.re = 0.5;
+  cb.im = 0.2;
+
+  // row-major m x n with lda 2051, every op, inc 1 and 3
+  for (a = 0; a < 5; a++)
+    for (b = 0; b < 5; b++)
+      for (t = 0; t < 3; t++)
+        for (inc = 1; inc <= 3; inc += 2) {
+          m = ms[a];
+          n = ns[b];
+          if (tr[t] != CTran) {
+            randu(Y, -1, 1);
+            copy_mat(Y, R);
+            omp_gemv(tr[t], m, n, 0.7, A->data, 2051, X->data, inc, 0.5,
+                     Y->data, inc);
+            ref_gemv(tr[t], m, n, 0.7, A->data, 2051, X->data, inc, 0.5,
+                     R->data, inc);
+            err = fmax(err, max_diff(Y->data, R->data, Y->d0 * Y->d1));
+          }
+          crandu(CY, -1, 1, -1, 1);
+          ccopy_mat(CY, CR);
+          omp_cgemv(tr[t], m, n, ca, CA->data, 2051, CX->data, inc, cb,
+                    CY->data, inc);
+          ref_cgemv(tr[t], m, n, ca, CA->data, 2051, CX->data, inc, cb,
+                    CR->data, inc);
+          cerr = fmax(cerr, cmax_diff(CY->data, CR->data, CY->d0 * CY->d1));
+        }
+  printf("max error against loops : real %.2e, complex %.2e\n", err, cerr);
+
+  // beta 0 doesn't read Y
+  for (i = 0; i < 2051; i++) Y->data[i] = NAN;
+  omp_gemv(Tran, 1030, 2051, 1, A->data, 2051, X->data, 1, 0, Y->data, 1);
+  for (i = 0; i < 2051; i++)
+    if (isnan(Y->data[i])) {
+      printf("beta 0 : NaN of Y is read\n");
+      break;
+    }
+  free_mat(X);
+  free_mat(Y);
+  free_mat(R);
+  free_cmat(CX);
+  free_cmat(CY);
+  free_cmat(CR);
+  free_mat(A);
+  free_cmat(CA);
+
+  // gemv_rhs_mat() against column by column
+  A = alloc_mat(257, 300);
+  CA = alloc_cmat(257, 300);
+  randu(A, -1, 1);
+  crandu(CA, -1, 1, -1, 1);
+  err = cerr = 0;
+  for (t = 0; t < 3; t++) {
+    lx = tr[t] == NoTran ? 257 : 300;
+    ly = tr[t] == NoTran ? 300 : 257;
+    x = alloc_mat(lx);
+    y = alloc_mat(ly);
+    cx = alloc_cmat(lx);
+    cy = alloc_cmat(ly);
+    Xk = alloc_mat(lx, K);
+    Yk = alloc_mat(ly, K);
+    Yr = alloc_mat(ly, K);
+    CXk = alloc_cmat(lx, K);
+    CYk = alloc_cmat(ly, K);
+    CYr = alloc_cmat(ly, K);
+    randu(Xk, -1, 1);
+    randu(Yk, -1, 1);
+    crandu(CXk, -1, 1, -1, 1);
+    crandu(CYk, -1, 1, -1, 1);
+    copy_mat(Yk, Yr);
+    ccopy_mat(CYk, CYr);
+    for (i = 0; i < K; i++) {
+      if (tr[t] != CTran) {
+        memcpy(x->data, Xk->data + i * lx, sizeof(DTYPE) * lx);
+        memcpy(y->data, Yr->data + i * ly, sizeof(DTYPE) * ly);
+        gemv_mat(tr[t], 0.7, A, x, 0.5, y);
+        memcpy(Yr->data + i * ly, y->data, sizeof(DTYPE) * ly);
+      }
+      memcpy(cx->data, CXk->data + i * lx, sizeof(CTYPE) * lx);
+      memcpy(cy->data, CYr->data + i * ly, sizeof(CTYPE) * ly);
+      gemv_cmat(tr[t], ca, CA, cx, cb, cy);
+      memcpy(CYr->data + i * ly, cy->data, sizeof(CTYPE) * ly);
+    }
+    if (tr[t] != CTran) {
+      gemv_rhs_mat(tr[t], 0.7, A, Xk, 0.5, Yk);
+      err = fmax(err, max_diff(Yk->data, Yr->data, Yk->d0 * Yk->d1));
+    }
+    gemv_rhs_cmat(tr[t], ca, CA, CXk, cb, CYk);
+    cerr = fmax(cerr, cmax_diff(CYk->data, CYr->data, CYk->d0 * CYk->d1));
+    free_mat(x);
+    free_mat(y);
+    free_cmat(cx);
+    free_cmat(cy);
+    free_mat(Xk);
+    free_mat(Yk);
+    free_mat(Yr);
+    free_cmat(CXk);
+    free_cmat(CYk);
+    free_cmat(CYr);
+  }
+  printf("gemv_rhs against %d gemv : real %.2e, complex %.2e\n", K, err, cerr);
+  free_mat(A);
+  free_cmat(CA);
+
+  // A : 257 x N, Y(N) = A^T * X(257) as NoTran and back as Tran
+  printf("\n%8s %6s %10s %10s %10s %10s %12s %12s   (us)\n", "N", "op",
+         "loops", "gemv", "c loops", "cgemv", "gemv x 8", "gemv_rhs 8");
+  for (N = 1024; N <= 16384; N *= 4) {
+    A = alloc_mat(257, N);
+    CA = alloc_cmat(257, N);
+    Xk = alloc_mat(N, K);
+    Yk = alloc_mat(N, K);
+    CXk = alloc_cmat(N, K);
+    CYk = alloc_cmat(N, K);
+    randu(A, -1, 1);
+    crandu(CA, -1, 1, -1, 1);
+    randu(Xk, -1, 1);
+    crandu(CXk, -1, 1, -1, 1);
+    for (t = 0; t < 2; t++) {
+      m = N;
+      n = 257;
+      lx = tr[t] == NoTran ? 257 : N;
+      ly = tr[t] == NoTran ? N : 257;
+      printf("%8u %6s", N, tr[t] == NoTran ? "NoTran" : "Tran");
+
+      stopwatch(0);
+      for (r = 0; r < REPEAT; r++)
+        ref_gemv(tr[t], m, n, 1, A->data, n, Xk->data, 1, 0, Yk->data, 1);
+      printf(" %10.1lf", (double)stopwatch(1) / REPEAT);
+      stopwatch(0);
+      for (r = 0; r < REPEAT; r++)
+        omp_gemv(tr[t], m, n, 1, A->data, n, Xk->data, 1, 0, Yk->data, 1);
+      printf(" %10.1lf", (double)stopwatch(1) / REPEAT);
+
+      stopwatch(0);
+      for (r = 0; r < REPEAT; r++)
+        ref_cgemv(tr[t], m, n, ca, CA->data, n, CXk->data, 1, cb, CYk->data,
+                  1);
+      printf(" %10.1lf", (double)stopwatch(1) / REPEAT);
+      stopwatch(0);
+      for (r = 0; r < REPEAT; r++)
+        omp_cgemv(tr[t], m, n, ca, CA->data, n, CXk->data, 1, cb, CYk->data,
+                  1);
+      printf(" %10.1lf", (double)stopwatch(1) / REPEAT);
+
+      // K frames, one by one and at once
+      Xk->d0 = lx;
+      Yk->d0 = ly;
+      stopwatch(0);
+      for (r = 0; r < REPEAT; r++)
+        for (i = 0; i < K; i++)
+          omp_gemv(tr[t], m, n, 1, A->data, n, Xk->data + i * lx, 1, 0,
+                   Yk->data + i * ly, 1);
+      t0 = (double)stopwatch(1) / REPEAT;
+      stopwatch(0);
+      for (r = 0; r < REPEAT; r++) gemv_rhs_mat(tr[t], 1, A, Xk, 0, Yk);
+      t1 = (double)stopwatch(1) / REPEAT;
+      printf(" %12.1lf %12.1lf\n", t0, t1);
+      Xk->d0 = N;
+      Yk->d0 = N;
+    }
+    free_mat(A);
+    free_cmat(CA);
+    free_mat(Xk);
+    free_mat(Yk);
+    free_cmat(CXk);
+    free_cmat(CYk);
+  }
+
+  finit();
+  return 0;
+}
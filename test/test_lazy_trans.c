@@ -0,0 +1,151 @@
+#include "header_for_test.h"
+#include "mother.h"
+
+/* Transpose by flag of view against transpose() before gemm :
+ * results must be equal, and the flag costs no copy. */
+
+#define M 257
+#define N 500
+#define K 64
+#define REPEAT 20
+
+int main() {
+  MAT *A, *At, *B, *C_copy, *C_view, *x, *y_copy, *y_view, *D;
+  CMAT *P, *Ph, *Pc, *Q, *R_copy, *R_view;
+  MAT_VIEW vA, vB, vC, vx, vy, vD;
+  CMAT_VIEW vP, vQ, vR;
+  CTYPE one, zero;
+  ITER i;
+  long long before, after;
+
+  init(0);
+  one.re = 1;
+  one.im = 0;
+  zero.re = 0;
+  zero.im = 0;
+
+  // A is stored K x M, used as M x K.
+  A = alloc_mat(K, M);
+  B = alloc_mat(K, N);
+  C_copy = zeros(M, N);
+  C_view = zeros(M, N);
+  randn(A, 0, 1);
+  randn(B, 0, 1);
+
+  At = alloc_mat(K, M);
+  copy_mat(A, At);
+  transpose(At);
+  gemm_mat(NoTran, NoTran, 1, At, B, 0, C_copy);
+
+  vA = trans_view(view_mat(A));
+  vB = view_mat(B);
+  vC = view_mat(C_view);
+  gemm_view(NoTran, NoTran, 1, &vA, &vB, 0, &vC);
+  printf("gemm  A^T B      : %e\n",
+         max_diff(C_view->data, C_copy->data, M * N));
+
+  // Tran on a transposed view is A itself.
+  fill(C_view, 0);
+  vB = trans_view(view_mat(B));
+  {
+    MAT* Bt = alloc_mat(K, N);
+    MAT_VIEW vBt;
+    copy_mat(B, Bt);
+    transpose(Bt);
+    vBt = view_mat(Bt);
+    // (B^T)^T stored as N x K, Tran gives K x N again
+    gemm_view(NoTran, Tran, 1, &vA, &vBt, 0, &vC);
+    printf("gemm  A^T (B^T)^T: %e\n",
+           max_diff(C_view->data, C_copy->data, M * N));
+    free_mat(Bt);
+  }
+
+  // gemv : NoTran on transposed A of K x M is A * x
+  x = alloc_mat(M);
+  y_copy = zeros(K);
+  y_view = zeros(K);
+  randn(x, 0, 1);
+  gemv_mat(NoTran, 1, At, x, 0, y_copy);
+  vx = view_mat(x);
+  vy = view_mat(y_view);
+  gemv_view(NoTran, 1, &vA, &vx, 0, &vy);
+  printf("gemv             : %e\n", max_diff(y_view->data, y_copy->data, K));
+
+  // copy_view materializes the transpose.
+  D = zeros(M, K);
+  vD = view_mat(D);
+  copy_view(&vA, &vD);
+  printf("copy             : %e\n", max_diff(D->data, At->data, M * K));
+
+  // Hermitian : P^H * Q against P^H built by hand.
+  P = alloc_cmat(K, M);
+  Ph = alloc_cmat(M, K);
+  Q = alloc_cmat(K, N);
+  R_copy = czeros(M, N);
+  R_view = czeros(M, N);
+  crandn(P, zero, one);
+  crandn(Q, zero, one);
+  for (i = 0; i < M * K; i++) {
+    Ph->data[i].re = P->data[i / M + (i % M) * K].re;
+    Ph->data[i].im = -P->data[i / M + (i % M) * K].im;
+  }
+  gemm_cmat(NoTran, NoTran, one, Ph, Q, zero, R_copy);
+
+  vP = hermit_cview(view_cmat(P));
+  vQ = view_cmat(Q);
+  vR = view_cmat(R_view);
+  gemm_cview(NoTran, NoTran, one, &vP, &vQ, zero, &vR);
+  printf("gemm  P^H Q      : %e\n",
+         cmax_diff(R_view->data, R_copy->data, M * N));
+
+  // Conjugate only, copied on scratch stack.
+  vP = conj_cview(view_cmat(Ph));
+  gemm_cview(NoTran, NoTran, one, &vP, &vQ, zero, &vR);
+  Pc = alloc_cmat(M, K);
+  ccopy_mat(Ph, Pc);
+  for (i = 0; i < M * K; i++) Pc->data[i].im = -Pc->data[i].im;
+  gemm_cmat(NoTran, NoTran, one, Pc, Q, zero, R_copy);
+  printf("gemm  conj(P) Q  : %e\n",
+         cmax_diff(R_view->data, R_copy->data, M * N));
+
+  // transpose() then gemm against flag.
+  stopwatch(0);
+  for (i = 0; i < REPEAT; i++) {
+    MAT* T = alloc_mat(K, M);
+    copy_mat(A, T);
+    transpose(T);
+    gemm_mat(NoTran, NoTran, 1, T, B, 0, C_copy);
+    free_mat(T);
+  }
+  before = stopwatch(1);
+
+  vB = view_mat(B);
+  stopwatch(0);
+  for (i = 0; i < REPEAT; i++) {
+    vA = trans_view(view_mat(A));
+    gemm_view(NoTran, NoTran, 1, &vA, &vB, 0, &vC);
+  }
+  after = stopwatch(1);
+
+  printf("A^T B, %d x %d x %d\n", M, K, N);
+  printf(" transpose() + gemm : %.3lf ms\n", (double)before / REPEAT / 1000);
+  printf(" trans_view  + gemm : %.3lf ms\n", (double)after / REPEAT / 1000);
+
+  free_mat(A);
+  free_mat(At);
+  free_mat(B);
+  free_mat(C_copy);
+  free_mat(C_view);
+  free_mat(x);
+  free_mat(y_copy);
+  free_mat(y_view);
+  free_mat(D);
+  free_cmat(P);
+  free_cmat(Ph);
+  free_cmat(Pc);
+  free_cmat(Q);
+  free_cmat(R_copy);
+  free_cmat(R_view);
+  finit();
+  return 0;
+}
@@ -0,0 +1,210 @@
+#include "header_for_test.h"
+#include "mother.h"
+
+/* *_ld functions on blocks of a spectrogram against submat() copies :
+ * gemm, gemv, axpy and copy, real and complex, every op. A frame window
+ * is run in place on the parent buffer. */
+
+#define NUM_BIN 257
+#define NUM_FRAME 300
+#define BAND_ST 10
+#define NUM_BAND 20
+#define WIN 8
+#define REPEAT 100
+
+int main() {
+  MAT *S, *blk, *W, *out_ld, *out_copy, *x, *y_ld, *y_copy;
+  CMAT *CS, *cblk, *CW, *cout_ld, *cout_copy, *cx, *cy_ld, *cy_copy;
+  MAT_VIEW va, vb, vc;
+  CMAT_VIEW cva, cvb, cvc;
+  UINT off, t;
+  ITER i, r, ta, tb;
+  char tr[3] = {NoTran, Tran, CTran};
+  CTYPE ca, cb;
+  DTYPE err = 0, cerr = 0;
+  long long t_ld, t_copy;
+
+  init(0);
+  S = alloc_mat(NUM_BIN, NUM_FRAME);
+  CS = alloc_cmat(NUM_BIN, NUM_FRAME);
+  blk = alloc_mat(NUM_BAND, WIN);
+  cblk = alloc_cmat(NUM_BAND, WIN);
+  randu(S, -1, 1);
+  crandu(CS, -1, 1, -1, 1);
+  ca.re = 0.7;
+  ca.im = -0.3;
+  cb.re = 0.5;
+  cb.im = 0.2;
+
+  // window : bins BAND_ST ~ BAND_ST + NUM_BAND of frames t ~ t + WIN
+  t = 37;
+  off = t * NUM_BIN + BAND_ST;
+  submat(S, blk, BAND_ST, BAND_ST + NUM_BAND, t, t + WIN);
+  csubmat(CS, cblk, BAND_ST, BAND_ST + NUM_BAND, t, t + WIN);
+
+  // gemm : op(window) * op(W), window as A and as B
+  for (ta = 0; ta < 3; ta++)
+    for (tb = 0; tb < 3; tb++) {
+      UINT m = tr[ta] == NoTran ? NUM_BAND : WIN;
+      UINT k = tr[ta] == NoTran ? WIN : NUM_BAND;
+      W = tr[tb] == NoTran ? alloc_mat(k, 5) : alloc_mat(5, k);
+      CW = tr[tb] == NoTran ? alloc_cmat(k, 5) : alloc_cmat(5, k);
+      randu(W, -1, 1);
+      crandu(CW, -1, 1, -1, 1);
+      out_ld = alloc_mat(m, 5);
+      out_copy = alloc_mat(m, 5);
+      cout_ld = alloc_cmat(m, 5);
+      cout_copy = alloc_cmat(m, 5);
+      randu(out_ld, -1, 1);
+      copy_mat(out_ld, out_copy);
+      crandu(cout_ld, -1, 1, -1, 1);
+      ccopy_mat(cout_ld, cout_copy);
+
+      // on the copy, gemm_mat() takes no transposed shapes
+      va = view_mat(blk);
+      vb = view_mat(W);
+      vc = view_mat(out_copy);
+      cva = view_cmat(cblk);
+      cvb = view_cmat(CW);
+      cvc = view_cmat(cout_copy);
+      if (tr[ta] != CTran && tr[tb] != CTran) {
+        gemm_view(tr[ta], tr[tb], 0.7, &va, &vb, 0.5, &vc);
+        gemm_mat_ld(tr[ta], tr[tb], m, 5, k, 0.7, S, off, NUM_BIN, W, 0,
+                    W->d0, 0.5, out_ld, 0, m);
+        if (max_diff(out_ld->data, out_copy->data, m * 5) > err)
+          err = max_diff(out_ld->data, out_copy->data, m * 5);
+      }
+      gemm_cview(tr[ta], tr[tb], ca, &cva, &cvb, cb, &cvc);
+      gemm_cmat_ld(tr[ta], tr[tb], m, 5, k, ca, CS, off, NUM_BIN, CW, 0,
+                   CW->d0, cb, cout_ld, 0, m);
+      if (max_diff((DTYPE*)cout_ld->data, (DTYPE*)cout_copy->data, 2 * m * 5) >
+          cerr)
+        cerr = max_diff((DTYPE*)cout_ld->data, (DTYPE*)cout_copy->data,
+                        2 * m * 5);
+
+      // C as a block of a larger buffer too
+      if (tr[ta] == NoTran && tr[tb] == NoTran) {
+        MAT* big = zeros(m + 3, 9);
+        gemm_mat_ld(NoTran, NoTran, m, 5, k, 0.7, S, off, NUM_BIN, W, 0,
+                    W->d0, 0, big, 2 + 3 * (m + 3), m + 3);
+        gemm_mat(NoTran, NoTran, 0.7, blk, W, 0, out_copy);
+        for (i = 0; i < 5; i++)
+          if (max_diff(big->data + 2 + (3 + i) * (m + 3),
+                       out_copy->data + i * m, m) > err)
+            err = max_diff(big->data + 2 + (3 + i) * (m + 3),
+                           out_copy->data + i * m, m);
+        free_mat(big);
+      }
+      free_mat(W);
+      free_cmat(CW);
+      free_mat(out_ld);
+      free_mat(out_copy);
+      free_cmat(cout_ld);
+      free_cmat(cout_copy);
+    }
+  printf("gemm_ld : real %.2e, complex %.2e\n", err, cerr);
+
+  // gemv : as gemv_mat(), X is a row of S (increment NUM_BIN)
+  err = cerr = 0;
+  for (ta = 0; ta < 3; ta++) {
+    UINT lx = tr[ta] == NoTran ? NUM_BAND : WIN;
+    UINT ly = tr[ta] == NoTran ? WIN : NUM_BAND;
+    x = alloc_mat(lx);
+    cx = alloc_cmat(lx);
+    y_ld = alloc_mat(ly);
+    y_copy = alloc_mat(ly);
+    cy_ld = alloc_cmat(ly);
+    cy_copy = alloc_cmat(ly);
+    for (i = 0; i < lx; i++) {
+      x->data[i] = S->data[3 + i * NUM_BIN];
+      cx->data[i] = CS->data[3 + i * NUM_BIN];
+    }
+    randu(y_ld, -1, 1);
+    copy_mat(y_ld, y_copy);
+    crandu(cy_ld, -1, 1, -1, 1);
+    ccopy_mat(cy_ld, cy_copy);
+
+    if (tr[ta] != CTran) {
+      gemv_mat(tr[ta], 0.7, blk, x, 0.5, y_copy);
+      gemv_mat_ld(tr[ta], NUM_BAND, WIN, 0.7, S, off, NUM_BIN, S, 3, NUM_BIN,
+                  0.5, y_ld, 0, 1);
+      if (max_diff(y_ld->data, y_copy->data, ly) > err)
+        err = max_diff(y_ld->data, y_copy->data, ly);
+    }
+    gemv_cmat(tr[ta], ca, cblk, cx, cb, cy_copy);
+    gemv_cmat_ld(tr[ta], NUM_BAND, WIN, ca, CS, off, NUM_BIN, CS, 3, NUM_BIN,
+                 cb, cy_ld, 0, 1);
+    if (max_diff((DTYPE*)cy_ld->data, (DTYPE*)cy_copy->data, 2 * ly) > cerr)
+      cerr = max_diff((DTYPE*)cy_ld->data, (DTYPE*)cy_copy->data, 2 * ly);
+    free_mat(x);
+    free_cmat(cx);
+    free_mat(y_ld);
+    free_mat(y_copy);
+    free_cmat(cy_ld);
+    free_cmat(cy_copy);
+  }
+  printf("gemv_ld : real %.2e, complex %.2e\n", err, cerr);
+
+  // axpy and copy : window onto another window of S
+  err = cerr = 0;
+  out_ld = alloc_mat(NUM_BAND, WIN);
+  cout_ld = alloc_cmat(NUM_BAND, WIN);
+  submat(S, out_ld, 100, 100 + NUM_BAND, 200, 200 + WIN);
+  csubmat(CS, cout_ld, 100, 100 + NUM_BAND, 200, 200 + WIN);
+  axpy_mat(0.7, blk, out_ld);
+  axpy_cmat(ca, cblk, cout_ld);
+  axpy_mat_ld(NUM_BAND, WIN, 0.7, S, off, NUM_BIN, S, 200 * NUM_BIN + 100,
+              NUM_BIN);
+  axpy_cmat_ld(NUM_BAND, WIN, ca, CS, off, NUM_BIN, CS, 200 * NUM_BIN + 100,
+               NUM_BIN);
+  for (i = 0; i < WIN; i++) {
+    if (max_diff(S->data + (200 + i) * NUM_BIN + 100,
+                 out_ld->data + i * NUM_BAND, NUM_BAND) > err)
+      err = max_diff(S->data + (200 + i) * NUM_BIN + 100,
+                     out_ld->data + i * NUM_BAND, NUM_BAND);
+    if (max_diff((DTYPE*)(CS->data + (200 + i) * NUM_BIN + 100),
+                 (DTYPE*)(cout_ld->data + i * NUM_BAND), 2 * NUM_BAND) > cerr)
+      cerr = max_diff((DTYPE*)(CS->data + (200 + i) * NUM_BIN + 100),
+                      (DTYPE*)(cout_ld->data + i * NUM_BAND), 2 * NUM_BAND);
+  }
+  copy_mat_ld(NUM_BAND, WIN, S, off, NUM_BIN, out_ld, 0, NUM_BAND);
+  ccopy_mat_ld(NUM_BAND, WIN, CS, off, NUM_BIN, cout_ld, 0, NUM_BAND);
+  if (max_diff(out_ld->data, blk->data, NUM_BAND * WIN) > err)
+    err = max_diff(out_ld->data, blk->data, NUM_BAND * WIN);
+  if (max_diff((DTYPE*)cout_ld->data, (DTYPE*)cblk->data,
+               2 * NUM_BAND * WIN) > cerr)
+    cerr = max_diff((DTYPE*)cout_ld->data, (DTYPE*)cblk->data,
+                    2 * NUM_BAND * WIN);
+  printf("axpy_ld, copy_ld : real %.2e, complex %.2e\n", err, cerr);
+  free_mat(out_ld);
+  free_cmat(cout_ld);
+
+  // sliding window : submat + gemv against gemv_mat_ld in place
+  W = alloc_mat(NUM_BAND);
+  y_ld = alloc_mat(WIN);
+  randu(W, -1, 1);
+  stopwatch(0);
+  for (r = 0; r < REPEAT; r++)
+    for (t = 0; t + WIN <= NUM_FRAME; t++) {
+      submat(S, blk, BAND_ST, BAND_ST + NUM_BAND, t, t + WIN);
+      gemv_mat(NoTran, 1, blk, W, 0, y_ld);
+    }
+  t_copy = stopwatch(1);
+  stopwatch(0);
+  for (r = 0; r < REPEAT; r++)
+    for (t = 0; t + WIN <= NUM_FRAME; t++)
+      gemv_mat_ld(NoTran, NUM_BAND, WIN, 1, S, t * NUM_BIN + BAND_ST,
+                  NUM_BIN, W, 0, 1, 0, y_ld, 0, 1);
+  t_ld = stopwatch(1);
+  printf("sliding window of %d frames : submat %lld us, ld %lld us\n", WIN,
+         t_copy, t_ld);
+  free_mat(W);
+  free_mat(y_ld);
+
+  free_mat(S);
+  free_cmat(CS);
+  free_mat(blk);
+  free_cmat(cblk);
+  finit();
+  return 0;
+}
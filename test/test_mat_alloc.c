@@ -0,0 +1,99 @@
+#include "mother.h"
+
+/* Cost of creating and freeing a small MAT per frame, header and data by
+ * two malloc()(before) against one block of slab cache(after). */
+
+#define NUM_ALLOC 1000000
+#define NUM_LIVE 1000
+
+/* Keeps compiler from removing a pair of malloc() and free(). */
+DTYPE* volatile sink;
+
+/* alloc_mat_2d and free_mat as they were */
+MAT* alloc_mat_malloc(UINT d0, UINT d1) {
+  MAT* mat;
+
+  mat = (MAT*)malloc(sizeof(MAT));
+  mat->ndim = 1;
+  mat->d0 = d0;
+  mat->d1 = d1;
+  mat->d2 = 1;
+  mat->data = (DTYPE*)malloc(sizeof(DTYPE) * d0 * d1);
+  return mat;
+}
+
+void free_mat_malloc(MAT* mat) {
+  free(mat->data);
+  free(mat);
+}
+
+int main() {
+  MAT* A;
+  MAT* live[NUM_LIVE];
+  CMAT* B;
+  DIM* d;
+  ITER i, j;
+  long long before, after;
+  MEM_STAT stat;
+
+  init(0);
+
+  // A spectrum of one frame, 1 x 257.
+  stopwatch(0);
+  for (i = 0; i < NUM_ALLOC; i++) {
+    A = alloc_mat_malloc(1, 257);
+    sink = A->data;
+    free_mat_malloc(A);
+  }
+  before = stopwatch(1);
+
+  stopwatch(0);
+  for (i = 0; i < NUM_ALLOC; i++) {
+    A = alloc_mat(1, 257);
+    sink = A->data;
+    free_mat(A);
+  }
+  after = stopwatch(1);
+
+  printf("alloc/free 1 x 257 MAT\n");
+  printf(" header + data malloc() : %.3lf ns\n", 1000.0 * before / NUM_ALLOC);
+  printf(" one block, slab cache  : %.3lf ns\n", 1000.0 * after / NUM_ALLOC);
+
+  // Many small matrices alive at once, freed in reverse.
+  stopwatch(0);
+  for (j = 0; j < NUM_ALLOC / NUM_LIVE; j++) {
+    for (i = 0; i < NUM_LIVE; i++) live[i] = alloc_mat_malloc(8, 8);
+    for (i = NUM_LIVE - 1; i >= 0; i--) free_mat_malloc(live[i]);
+  }
+  before = stopwatch(1);
+
+  stopwatch(0);
+  for (j = 0; j < NUM_ALLOC / NUM_LIVE; j++) {
+    for (i = 0; i < NUM_LIVE; i++) live[i] = alloc_mat(8, 8);
+    for (i = NUM_LIVE - 1; i >= 0; i--) free_mat(live[i]);
+  }
+  after = stopwatch(1);
+
+  printf("alloc/free %d live 8 x 8 MAT\n", NUM_LIVE);
+  printf(" header + data malloc() : %.3lf ns\n", 1000.0 * before / NUM_ALLOC);
+  printf(" one block, slab cache  : %.3lf ns\n", 1000.0 * after / NUM_ALLOC);
+
+  // Large MAT falls back to malloc_aligned(), still one block.
+  B = czeros(1024, 1024);
+  printf("aligned : %d, data right after header : %d\n", IS_ALIGNED(B->data),
+         (char*)B->data - (char*)B == MEM_ALIGN_SIZE);
+  free_cmat(B);
+
+  // Hand-built MAT is still accepted by free_mat().
+  A = alloc_mat_malloc(4, 4);
+  free_mat(A);
+
+  d = alloc_dim(3, 4, 5);
+  free_dim(d);
+
+  mpstat(&stat);
+  printf("slab_reserved : %llu bytes\n", stat.slab_reserved);
+
+  finit();
+  return 0;
+}
@@ -0,0 +1,82 @@
+#include "mother.h"
+
+/* alloc/free churn of mpalloc()/mpfree() with 10k live blocks. */
+
+#define LIVE_BLOCK 10000
+#define BURST 64
+#define ROUND 20000
+#define RANDOM_ROUND 1000000
+
+static unsigned long long block_size(ITER i) {
+  return sizeof(DTYPE) * (1 + (i * 7919) % 257);
+}
+
+int main() {
+  void** block;
+  ITER *order;
+  ITER i, j, t, tmp;
+  long long elapsed;
+  MEM_STAT stat;
+
+  block = (void**)malloc(sizeof(void*) * LIVE_BLOCK);
+  order = (ITER*)malloc(sizeof(ITER) * LIVE_BLOCK);
+
+  init(16776960);
+
+  // fill up
+  stopwatch(0);
+  for (i = 0; i < LIVE_BLOCK; i++) block[i] = mpalloc(block_size(i));
+  elapsed = stopwatch(1);
+  printf("alloc %d blocks       : %8lld us, %6.1f ns/op\n", LIVE_BLOCK,
+         elapsed, 1000.0 * elapsed / LIVE_BLOCK);
+
+  // temporaries on top of 10k live blocks, released in LIFO order.
+  stopwatch(0);
+  for (t = 0; t < ROUND; t++) {
+    for (j = LIVE_BLOCK - 1; j >= LIVE_BLOCK - BURST; j--) mpfree(block[j]);
+    for (j = LIVE_BLOCK - BURST; j < LIVE_BLOCK; j++)
+      block[j] = mpalloc(block_size(j + t));
+  }
+  elapsed = stopwatch(1);
+  printf("churn %d x %d        : %8lld us, %6.1f ns/op\n", ROUND, BURST,
+         elapsed, 1000.0 * elapsed / ((double)ROUND * BURST * 2));
+
+  // free and re-allocate blocks picked at random. holes are reused,
+  // so the pool must not grow.
+  srand(0);
+  stopwatch(0);
+  for (t = 0; t < RANDOM_ROUND; t++) {
+    i = rand() % LIVE_BLOCK;
+    mpfree(block[i]);
+    block[i] = mpalloc(block_size(rand()));
+  }
+  elapsed = stopwatch(1);
+  printf("churn %d random     : %8lld us, %6.1f ns/op\n", RANDOM_ROUND,
+         elapsed, 1000.0 * elapsed / ((double)RANDOM_ROUND * 2));
+
+  mpstat_json(stdout);
+
+  // release every block in random order.
+  for (i = 0; i < LIVE_BLOCK; i++) order[i] = i;
+  srand(0);
+  for (i = LIVE_BLOCK - 1; i > 0; i--) {
+    j = rand() % (i + 1);
+    SWAP(order[i], order[j], tmp);
+  }
+  stopwatch(0);
+  for (i = 0; i < LIVE_BLOCK; i++) mpfree(block[order[i]]);
+  elapsed = stopwatch(1);
+  printf("free  %d blocks(rand) : %8lld us, %6.1f ns/op\n", LIVE_BLOCK,
+         elapsed, 1000.0 * elapsed / LIVE_BLOCK);
+
+  mpstat_json(stdout);
+  // everything went back to the tops, nothing left to fragment
+  mpstat(&stat);
+  if (stat.live != 0 || stat.fragmentation != 0)
+    printf("empty pool : live %llu, fragmentation %f\n", stat.live,
+           stat.fragmentation);
+  finit();
+  free(block);
+  free(order);
+  return 0;
+}
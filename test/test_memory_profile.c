@@ -0,0 +1,50 @@
+#include "mother.h"
+
+/* Cost of the first frame against a later one, for each mode of
+ * init_profile(). Every frame allocates and writes FRAME_SIZE bytes.
+ * On Linux, memory backed by transparent huge pages is also reported. */
+
+#define FRAME_SIZE (32 << 20)
+#define NUM_FRAME 100
+
+long long run_frame() {
+  DTYPE* buf;
+  long long elapsed;
+
+  stopwatch(0);
+  buf = mpalloc(FRAME_SIZE);
+  memset(buf, 1, FRAME_SIZE);
+  mpfree(buf);
+  elapsed = stopwatch(1);
+  return elapsed;
+}
+
+/* AnonHugePages of the process in kB, -1 where it can't be read. */
+long long huge_kb() {
+  char line[MAX_CHAR];
+  long long kb = -1;
+  FILE* fp = fopen("/proc/self/smaps_rollup", "r");
+
+  if (fp == NULL) return -1;
+  while (fgets(line, MAX_CHAR, fp) != NULL)
+    if (sscanf(line, "AnonHugePages: %lld", &kb) == 1) break;
+  fclose(fp);
+  return kb;
+}
+
+int main() {
+  UINT mode;
+  ITER i;
+  long long first, last;
+  char* name[3] = {"malloc", "prefault", "huge"};
+
+  for (mode = MEM_MODE_MALLOC; mode <= MEM_MODE_HUGE; mode++) {
+    init_profile(mode, 2 * FRAME_SIZE, 0, 0);
+    first = run_frame();
+    for (i = 1; i < NUM_FRAME; i++) last = run_frame();
+    printf("%-8s : first frame %8lld us, frame %d %8lld us, huge %lld kB\n",
+           name[mode], first, NUM_FRAME, last, huge_kb());
+    finit();
+  }
+  return 0;
+}
@@ -0,0 +1,45 @@
+#include "mother.h"
+#if USE_OMP
+#include <omp.h>
+#endif
+
+/* Throughput of mpalloc()/mpfree() when every thread allocates
+ * its own temporaries, as FFT and permute do inside parallel loops. */
+
+#define ITERATION 200000
+#define LIVE_BLOCK 8
+
+int main() {
+  int num_thread;
+  long long elapsed;
+  double throughput;
+
+  init(16776960);
+
+  for (num_thread = 1; num_thread <= 64; num_thread *= 2) {
+#if USE_OMP
+    omp_set_num_threads(num_thread);
+#endif
+    stopwatch(0);
+#pragma omp parallel
+    {
+      void* block[LIVE_BLOCK];
+      ITER i, j;
+      for (i = 0; i < ITERATION; i++) {
+        for (j = 0; j < LIVE_BLOCK; j++)
+          block[j] = mpalloc(sizeof(DTYPE) * (16 + ((i + j) & 63) * 8));
+        for (j = LIVE_BLOCK - 1; j >= 0; j--) mpfree(block[j]);
+      }
+    }
+    elapsed = stopwatch(1);
+    throughput = (double)num_thread * ITERATION * LIVE_BLOCK / elapsed;
+    printf("threads %2d : %8lld us, %8.2f M alloc+free/s\n", num_thread,
+           elapsed, throughput);
+#if !USE_OMP
+    break;
+#endif
+  }
+
+  finit();
+  return 0;
+}
@@ -0,0 +1,112 @@
+#include "mother.h"
+
+/* permute() on bins x frames x channels against element-wise reference,
+ * in GB/s of bytes read + written, with memcpy() as the ceiling. */
+
+#define NUM_BIN 257
+#define NUM_FRAME 500
+#define NUM_CH 8
+#define REPEAT 20
+
+UINT seqs[5] = {132, 213, 231, 312, 321};
+
+/* new[x,y,z] = old[a,b,c] where (x,y,z) is (a,b,c) in order of seq,
+ * with the per-element divisions as permute() had. */
+void perm_ref(UINT seq, UINT d0, UINT d1, UINT d2, DTYPE* src, DTYPE* des) {
+  ITER i;
+  UINT idx[3], dim[3], nd[3], ax[3];
+  dim[0] = d0;
+  dim[1] = d1;
+  dim[2] = d2;
+  ax[0] = seq / 100 - 1;
+  ax[1] = seq / 10 % 10 - 1;
+  ax[2] = seq % 10 - 1;
+  nd[0] = dim[ax[0]];
+  nd[1] = dim[ax[1]];
+  nd[2] = dim[ax[2]];
+#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(src, des) private(i, idx)
+  for (i = 0; i < d0 * d1 * d2; i++) {
+    idx[0] = i % d0;
+    idx[1] = (i % (d0 * d1)) / d0;
+    idx[2] = i / (d0 * d1);
+    des[idx[ax[0]] + idx[ax[1]] * nd[0] + idx[ax[2]] * nd[0] * nd[1]] =
+        src[i];
+  }
+}
+
+int main() {
+  MAT *A, *B, *R;
+  CMAT *CA, *CB;
+  ITER i, s;
+  UINT n = NUM_BIN * NUM_FRAME * NUM_CH;
+  long long t_copy, t_ref, t_perm;
+  int ok;
+
+  init(0);
+  A = alloc_mat(NUM_BIN, NUM_FRAME, NUM_CH);
+  B = alloc_mat(NUM_BIN, NUM_FRAME, NUM_CH);
+  R = alloc_mat(NUM_BIN, NUM_FRAME, NUM_CH);
+  CA = alloc_cmat(NUM_BIN, NUM_FRAME, NUM_CH);
+  CB = alloc_cmat(NUM_BIN, NUM_FRAME, NUM_CH);
+  randu(A, -1, 1);
+  for (i = 0; i < n; i++) {
+    CA->data[i].re = A->data[i];
+    CA->data[i].im = -A->data[i];
+  }
+
+  stopwatch(0);
+  for (i = 0; i < REPEAT; i++) memcpy(B->data, A->data, sizeof(DTYPE) * n);
+  t_copy = stopwatch(1);
+  printf("%d x %d x %d\n", NUM_BIN, NUM_FRAME, NUM_CH);
+  printf(" memcpy  : %6.2lf GB/s\n",
+         2.0 * n * sizeof(DTYPE) * REPEAT / t_copy / 1000.0);
+
+  for (s = 0; s < 5; s++) {
+    perm_ref(seqs[s], NUM_BIN, NUM_FRAME, NUM_CH, A->data, R->data);
+
+    stopwatch(0);
+    for (i = 0; i < REPEAT; i++)
+      perm_ref(seqs[s], NUM_BIN, NUM_FRAME, NUM_CH, A->data, B->data);
+    t_ref = stopwatch(1);
+
+    stopwatch(0);
+    for (i = 0; i < REPEAT; i++) {
+      B->d0 = NUM_BIN;
+      B->d1 = NUM_FRAME;
+      B->d2 = NUM_CH;
+      permute(B, seqs[s]);
+    }
+    t_perm = stopwatch(1);
+
+    B->d0 = NUM_BIN;
+    B->d1 = NUM_FRAME;
+    B->d2 = NUM_CH;
+    copy_mat(A, B);
+    permute(B, seqs[s]);
+    ok = !memcmp(B->data, R->data, sizeof(DTYPE) * n);
+
+    CB->d0 = NUM_BIN;
+    CB->d1 = NUM_FRAME;
+    CB->d2 = NUM_CH;
+    ccopy_mat(CA, CB);
+    cpermute(CB, seqs[s]);
+    for (i = 0; i < n; i++)
+      if (CB->data[i].re != R->data[i] || CB->data[i].im != -R->data[i])
+        ok = 0;
+
+    printf(" %u -> %u x %u x %u : element-wise %6.2lf GB/s, permute %6.2lf "
+           "GB/s %s\n",
+           seqs[s], B->d0, B->d1, B->d2,
+           2.0 * n * sizeof(DTYPE) * REPEAT / t_ref / 1000.0,
+           2.0 * n * sizeof(DTYPE) * REPEAT / t_perm / 1000.0,
+           ok ? "OK" : "FAIL");
+  }
+
+  free_mat(A);
+  free_mat(B);
+  free_mat(R);
+  free_cmat(CA);
+  free_cmat(CB);
+  finit();
+  return 0;
+}
@@ -0,0 +1,151 @@
+#include "mother.h"
+
+/* Planar PCMAT against interleaved CMAT on a 257-bin spectrogram :
+ * element-wise arithmetic, per-bin gain, magnitude/phase and scaling. */
+
+#define NUM_BIN 257
+#define NUM_FRAME 500
+#define REPEAT 200
+
+DTYPE max_diff(CMAT* X, PCMAT* P) {
+  ITER i;
+  DTYPE d = 0;
+  for (i = 0; i < X->d0 * X->d1 * X->d2; i++) {
+    if (fabs(X->data[i].re - P->re[i]) > d) d = fabs(X->data[i].re - P->re[i]);
+    if (fabs(X->data[i].im - P->im[i]) > d) d = fabs(X->data[i].im - P->im[i]);
+  }
+  return d;
+}
+
+void report(const char* name, long long t_i, long long t_p, DTYPE err) {
+  printf("%-10s interleaved %7.3lf ms, planar %7.3lf ms, x%.2lf, error %e\n",
+         name, (double)t_i / REPEAT / 1000, (double)t_p / REPEAT / 1000,
+         (double)t_i / t_p, err);
+}
+
+int main() {
+  CMAT *A, *B, *C, *G;
+  PCMAT *PA, *PB, *PC, *PG;
+  MAT *M, *PM;
+  CTYPE alpha;
+  ITER i, k;
+  long long t_i, t_p;
+  DTYPE err;
+
+  init(0);
+  A = alloc_cmat(NUM_BIN, NUM_FRAME);
+  B = alloc_cmat(NUM_BIN, NUM_FRAME);
+  C = alloc_cmat(NUM_BIN, NUM_FRAME);
+  G = alloc_cmat(NUM_BIN, 1);
+  PA = alloc_pcmat(NUM_BIN, NUM_FRAME);
+  PB = alloc_pcmat(NUM_BIN, NUM_FRAME);
+  PC = alloc_pcmat(NUM_BIN, NUM_FRAME);
+  PG = alloc_pcmat(NUM_BIN, 1);
+  M = alloc_mat(NUM_BIN, NUM_FRAME);
+  PM = alloc_mat(NUM_BIN, NUM_FRAME);
+  crandu(A, -1, 1, -1, 1);
+  crandu(B, 1, 2, 1, 2);
+  crandu(G, 0, 1, -1, 1);
+  alpha.re = 0.6;
+  alpha.im = 0.8;
+
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++) cmat2pcmat(A, PA);
+  t_p = stopwatch(1);
+  pcmat2cmat(PA, C);
+  printf("cmat2pcmat %7.3lf ms, round trip error %e\n",
+         (double)t_p / REPEAT / 1000, max_diff(C, PA));
+  cmat2pcmat(B, PB);
+  cmat2pcmat(G, PG);
+
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++) cmul_elements(A, B, C);
+  t_i = stopwatch(1);
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++) pmul_elements(PA, PB, PC);
+  t_p = stopwatch(1);
+  report("mul", t_i, t_p, max_diff(C, PC));
+
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++) cdiv_elements(A, B, C);
+  t_i = stopwatch(1);
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++) pdiv_elements(PA, PB, PC);
+  t_p = stopwatch(1);
+  report("div", t_i, t_p, max_diff(C, PC));
+
+  // gain per bin, (257,1) * (257,NUM_FRAME)
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++) cmul_elements(G, A, C);
+  t_i = stopwatch(1);
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++) pmul_elements(PG, PA, PC);
+  t_p = stopwatch(1);
+  report("bin gain", t_i, t_p, max_diff(C, PC));
+
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++) cadd_elements(A, B, C);
+  t_i = stopwatch(1);
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++) padd_elements(PA, PB, PC);
+  t_p = stopwatch(1);
+  report("add", t_i, t_p, max_diff(C, PC));
+
+  // magnitude, abs_cmat() is in place so it works on a copy each time
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++) {
+    ccopy_mat(A, C);
+    abs_cmat(C);
+  }
+  t_i = stopwatch(1);
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++) abs_pcmat(PA, PM);
+  t_p = stopwatch(1);
+  err = 0;
+  for (i = 0; i < NUM_BIN * NUM_FRAME; i++)
+    err = fmax(err, fabs(C->data[i].re - PM->data[i]));
+  report("abs", t_i, t_p, err);
+
+  // phase, by carg() over CMAT
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++)
+    for (i = 0; i < NUM_BIN * NUM_FRAME; i++)
+      M->data[i] = carg(CXD(A->data[i]));
+  t_i = stopwatch(1);
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++) angle_pcmat(PA, PM);
+  t_p = stopwatch(1);
+  err = 0;
+  for (i = 0; i < NUM_BIN * NUM_FRAME; i++)
+    err = fmax(err, fabs(M->data[i] - PM->data[i]));
+  report("angle", t_i, t_p, err);
+
+  // back from magnitude and phase
+  abs_pcmat(PA, M);
+  polar_pcmat(M, PM, PC);
+  pcmat2cmat(PC, C);
+  printf("polar      round trip error %e\n", max_diff(A, PC));
+
+  ccopy_mat(A, C);
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++) cscal_cmat(alpha, C);
+  t_i = stopwatch(1);
+  cmat2pcmat(A, PC);
+  stopwatch(0);
+  for (k = 0; k < REPEAT; k++) pscal_pcmat(alpha, PC);
+  t_p = stopwatch(1);
+  report("uscal", t_i, t_p, max_diff(C, PC));
+
+  free_cmat(A);
+  free_cmat(B);
+  free_cmat(C);
+  free_cmat(G);
+  free_pcmat(PA);
+  free_pcmat(PB);
+  free_pcmat(PC);
+  free_pcmat(PG);
+  free_mat(M);
+  free_mat(PM);
+  finit();
+  return 0;
+}
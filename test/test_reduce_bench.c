@@ -0,0 +1,173 @@
+#include "mother.h"
+
+/* Non-BLAS reductions(omp_dot(), omp_asum(), omp_nrm2(), omp_amax(), ...)
+ * against plain loops, in GB/s read, on 1M to 100M elements.
+ * Results are checked against long double sums on odd sizes and strides,
+ * and the error of one add chain is shown next to the pairwise one. */
+
+#define REPEAT 5
+#define MAX_N 100000000
+
+UINT sizes[3] = {1000000, 10000000, 100000000};
+UINT odd[6] = {1, 17, 1023, 1025, 100003, 1 << 20};
+
+/* Keeps compiler from removing the timed reductions. */
+volatile DTYPE sink;
+
+/* one add chain, as the loops before */
+DTYPE ref_dot(UINT N, DTYPE* x, DTYPE* y) {
+  ITER i;
+  DTYPE s = 0;
+  for (i = 0; i < N; i++) s += x[i] * y[i];
+  return s;
+}
+
+UINT ref_amax(UINT N, DTYPE* x) {
+  ITER i;
+  UINT idx = 0;
+  for (i = 1; i < N; i++)
+    if (fabs(x[i]) > fabs(x[idx])) idx = i;
+  return idx;
+}
+
+double rel(long double a, long double r) {
+  return r == 0 ? fabsl(a) : fabsl((a - r) / r);
+}
+
+int main() {
+  MAT *X, *Y;
+  DTYPE *x, *y;
+  CTYPE *cx, *cy, cd;
+  UINT N, n, inc, idx, ridx;
+  ITER i, s, r;
+  long double ld, lr, li, la;
+  double t, gb, err = 0;
+
+  init(0);
+  X = alloc_mat(MAX_N, 1);
+  Y = alloc_mat(MAX_N, 1);
+  x = X->data;
+  y = Y->data;
+  cx = (CTYPE*)x;
+  cy = (CTYPE*)y;
+  randu(X, -1, 1);
+  randu(Y, -1, 1);
+
+  // real and complex against long double, inc 1 and 3
+  for (s = 0; s < 6; s++)
+    for (inc = 1; inc <= 3; inc += 2) {
+      n = odd[s];
+      ld = la = lr = 0;
+      for (i = 0; i < n; i++) {
+        ld += (long double)x[i * inc] * y[i * inc];
+        la += fabsl(x[i * inc]);
+        lr += (long double)x[i * inc] * x[i * inc];
+      }
+      if (rel(omp_dot(n, x, inc, y, inc), ld) > err)
+        err = rel(omp_dot(n, x, inc, y, inc), ld);
+      if (rel(omp_asum(n, x, inc), la) > err) err = rel(omp_asum(n, x, inc), la);
+      if (rel(omp_nrm2(n, x, inc), sqrtl(lr)) > err)
+        err = rel(omp_nrm2(n, x, inc), sqrtl(lr));
+      idx = omp_amax(n, x, inc);
+      for (i = 0; i < n; i++)
+        if (fabs(x[i * inc]) > fabs(x[idx * inc]) ||
+            (fabs(x[i * inc]) == fabs(x[idx * inc]) && i < idx))
+          printf("amax(%u, inc %u) : %u, %ld is larger\n", n, inc, idx, i);
+      idx = omp_amin(n, x, inc);
+      for (i = 0; i < n; i++)
+        if (fabs(x[i * inc]) < fabs(x[idx * inc]))
+          printf("amin(%u, inc %u) : %u, %ld is smaller\n", n, inc, idx, i);
+
+      lr = li = la = 0;
+      for (i = 0; i < n; i++) {
+        lr += (long double)cx[i * inc].re * cy[i * inc].re -
+              (long double)cx[i * inc].im * cy[i * inc].im;
+        li += (long double)cx[i * inc].re * cy[i * inc].im +
+              (long double)cx[i * inc].im * cy[i * inc].re;
+        la += fabsl(cx[i * inc].re) + fabsl(cx[i * inc].im);
+      }
+      cd = omp_udot(n, cx, inc, cy, inc);
+      if (rel(cd.re, lr) > err) err = rel(cd.re, lr);
+      if (rel(cd.im, li) > err) err = rel(cd.im, li);
+      if (rel(omp_casum(n, cx, inc), la) > err)
+        err = rel(omp_casum(n, cx, inc), la);
+      ld = 0;
+      for (i = 0; i < n; i++)
+        ld += (long double)cx[i * inc].re * cx[i * inc].re +
+              (long double)cx[i * inc].im * cx[i * inc].im;
+      if (rel(omp_cnrm2(n, cx, inc), sqrtl(ld)) > err)
+        err = rel(omp_cnrm2(n, cx, inc), sqrtl(ld));
+      idx = omp_camax(n, cx, inc);
+      for (i = 0; i < n; i++)
+        if (cabs1(cx[i * inc]) > cabs1(cx[idx * inc]))
+          printf("camax(%u, inc %u) : %u, %ld is larger\n", n, inc, idx, i);
+    }
+  printf("max relative error, N <= %u : %.2e\n", odd[5], err);
+
+  // nrm2 away from overflow and underflow
+  for (i = 0; i < 1000; i++) x[i] = 1e300;
+  printf("nrm2 of 1000 x 1e300  : %.6e (%.6e)\n", omp_nrm2(1000, x, 1),
+         1e300 * sqrt(1000.));
+  for (i = 0; i < 1000; i++) x[i] = 1e-300;
+  printf("nrm2 of 1000 x 1e-300 : %.6e (%.6e)\n", omp_nrm2(1000, x, 1),
+         1e-300 * sqrt(1000.));
+  randu(X, -1, 1);
+
+  // one add chain against pairwise
+  for (i = 0; i < MAX_N; i++) x[i] = 0.1;
+  ld = (long double)MAX_N * 0.1L;
+  printf("sum of %u x 0.1, relative error : chain %.2e, pairwise %.2e\n",
+         MAX_N, rel(ref_dot(MAX_N, x, x) * 10, ld),
+         rel(omp_dot(MAX_N, x, 1, x, 1) * 10, ld));
+  randu(X, -1, 1);
+
+  printf("\n%10s %9s %9s %9s %9s %9s %9s %9s   (GB/s)\n", "N", "dot(ref)",
+         "dot", "asum", "nrm2", "amax(ref)", "amax", "udot");
+  for (s = 0; s < 3; s++) {
+    N = sizes[s];
+    printf("%10u", N);
+    gb = 2. * N * sizeof(DTYPE) * REPEAT / 1e3;
+
+    stopwatch(0);
+    for (r = 0; r < REPEAT; r++) sink = ref_dot(N, x, y);
+    t = stopwatch(1);
+    printf(" %9.2lf", gb / t);
+
+    stopwatch(0);
+    for (r = 0; r < REPEAT; r++) sink = omp_dot(N, x, 1, y, 1);
+    t = stopwatch(1);
+    printf(" %9.2lf", gb / t);
+
+    stopwatch(0);
+    for (r = 0; r < REPEAT; r++) sink = omp_asum(N, x, 1);
+    t = stopwatch(1);
+    printf(" %9.2lf", gb / 2 / t);
+
+    stopwatch(0);
+    for (r = 0; r < REPEAT; r++) sink = omp_nrm2(N, x, 1);
+    t = stopwatch(1);
+    printf(" %9.2lf", gb / 2 / t);
+
+    stopwatch(0);
+    for (r = 0; r < REPEAT; r++) ridx = ref_amax(N, x);
+    t = stopwatch(1);
+    printf(" %9.2lf", gb / 2 / t);
+
+    stopwatch(0);
+    for (r = 0; r < REPEAT; r++) idx = omp_amax(N, x, 1);
+    t = stopwatch(1);
+    printf(" %9.2lf", gb / 2 / t);
+    if (idx != ridx) printf(" amax %u != %u", idx, ridx);
+
+    // N / 2 complex on the same bytes
+    stopwatch(0);
+    for (r = 0; r < REPEAT; r++) cd = omp_udot(N / 2, cx, 1, cy, 1);
+    t = stopwatch(1);
+    printf(" %9.2lf\n", gb / t);
+  }
+
+  free_mat(X);
+  free_mat(Y);
+  finit();
+  return 0;
+}
@@ -0,0 +1,217 @@
+#include "header_for_test.h"
+#include "mother.h"
+
+/* Batched small matrix kernels against one call per slice, on
+ * NUM_SLICE slices of n x n for n = 2..8, as channel x channel per bin.
+ * Inverse is checked by A * inv(A) = I, det against det_?by?(). */
+
+#define NUM_SLICE (257 * 8)
+#define REPEAT 20
+
+typedef DTYPE (*DET_FUNC)(DTYPE*);
+typedef CTYPE (*CDET_FUNC)(CTYPE*);
+DET_FUNC det_f[7] = {NULL, NULL, det_2by2, det_3by3, det_4by4, det_5by5,
+                     det_6by6};
+CDET_FUNC cdet_f[7] = {NULL, NULL, cdet_2by2, cdet_3by3, cdet_4by4, cdet_5by5,
+                       cdet_6by6};
+
+/* max |A * inv - I| */
+double inv_err(MAT* A, MAT* V) {
+  MAT* P;
+  ITER i, j, s;
+  double d = 0, e;
+  P = alloc_mat(A->d0, A->d1, A->d2);
+  gemm_small(NoTran, NoTran, 1, A, V, 0, P);
+  for (s = 0; s < A->d2; s++)
+    for (j = 0; j < A->d0; j++)
+      for (i = 0; i < A->d0; i++) {
+        e = P->data[s * A->d0 * A->d0 + i + j * A->d0] - (i == j);
+        if (!(fabs(e) <= d)) d = fabs(e);
+      }
+  free_mat(P);
+  return d;
+}
+
+double cinv_err(CMAT* A, CMAT* V) {
+  CMAT* P;
+  CTYPE one, zero;
+  ITER i, j, s;
+  double d = 0, e;
+  one.re = 1;
+  one.im = zero.re = zero.im = 0;
+  P = alloc_cmat(A->d0, A->d1, A->d2);
+  cgemm_small(NoTran, NoTran, one, A, V, zero, P);
+  for (s = 0; s < A->d2; s++)
+    for (j = 0; j < A->d0; j++)
+      for (i = 0; i < A->d0; i++) {
+        e = fabs(P->data[s * A->d0 * A->d0 + i + j * A->d0].re - (i == j)) +
+            fabs(P->data[s * A->d0 * A->d0 + i + j * A->d0].im);
+        if (!(e <= d)) d = e;
+      }
+  free_cmat(P);
+  return d;
+}
+
+int main() {
+  MAT *A, *B, *C, *R, *X, *Y, *YR, *V, *D, *DV;
+  CMAT *CA, *CB, *CC, *CR, *CV, *CD, *CDV;
+  CTYPE one, zero;
+  UINT n, sz;
+  ITER r, s;
+  long long t_loop, t_small;
+  double err;
+
+  init(0);
+  one.re = 1;
+  one.im = zero.re = zero.im = 0;
+
+  printf(" %d slices, time per call in us : per-slice / batched\n", NUM_SLICE);
+  for (n = 2; n <= SMALL_MAX; n++) {
+    sz = n * n;
+    A = alloc_mat(n, n, NUM_SLICE);
+    B = alloc_mat(n, n, NUM_SLICE);
+    C = alloc_mat(n, n, NUM_SLICE);
+    R = alloc_mat(n, n, NUM_SLICE);
+    V = alloc_mat(n, n, NUM_SLICE);
+    X = alloc_mat(n, 1, NUM_SLICE);
+    Y = alloc_mat(n, 1, NUM_SLICE);
+    YR = alloc_mat(n, 1, NUM_SLICE);
+    D = alloc_mat(NUM_SLICE, 1);
+    DV = alloc_mat(NUM_SLICE, 1);
+    CA = alloc_cmat(n, n, NUM_SLICE);
+    CB = alloc_cmat(n, n, NUM_SLICE);
+    CC = alloc_cmat(n, n, NUM_SLICE);
+    CR = alloc_cmat(n, n, NUM_SLICE);
+    CV = alloc_cmat(n, n, NUM_SLICE);
+    CD = alloc_cmat(NUM_SLICE, 1);
+    CDV = alloc_cmat(NUM_SLICE, 1);
+    randu(A, -1, 1);
+    randu(B, -1, 1);
+    randu(X, -1, 1);
+    crandu(CA, -1, 1, -1, 1);
+    crandu(CB, -1, 1, -1, 1);
+    printf("%u x %u\n", n, n);
+
+    // gemm
+    stopwatch(0);
+    for (r = 0; r < REPEAT; r++)
+      for (s = 0; s < NUM_SLICE; s++)
+        omp_gemm(NoTran, Tran, n, n, n, 1, A->data + s * sz, n,
+                 B->data + s * sz, n, 0, R->data + s * sz, n);
+    t_loop = stopwatch(1);
+    stopwatch(0);
+    for (r = 0; r < REPEAT; r++) gemm_small(NoTran, Tran, 1, A, B, 0, C);
+    t_small = stopwatch(1);
+    printf("  gemm    %9.1lf / %8.1lf  err %.2e\n", (double)t_loop / REPEAT,
+           (double)t_small / REPEAT, max_diff(C->data, R->data, sz * NUM_SLICE));
+
+    stopwatch(0);
+    for (r = 0; r < REPEAT; r++)
+      for (s = 0; s < NUM_SLICE; s++)
+        omp_cgemm(CTran, NoTran, n, n, n, one, CA->data + s * sz, n,
+                  CB->data + s * sz, n, zero, CR->data + s * sz, n);
+    t_loop = stopwatch(1);
+    stopwatch(0);
+    for (r = 0; r < REPEAT; r++)
+      cgemm_small(CTran, NoTran, one, CA, CB, zero, CC);
+    t_small = stopwatch(1);
+    printf("  cgemm   %9.1lf / %8.1lf  err %.2e\n", (double)t_loop / REPEAT,
+           (double)t_small / REPEAT,
+           cmax_diff(CC->data, CR->data, sz * NUM_SLICE));
+
+    // gemv, Y = A^T X
+    stopwatch(0);
+    for (r = 0; r < REPEAT; r++)
+      for (s = 0; s < NUM_SLICE; s++)
+        omp_gemm(Tran, NoTran, n, 1, n, 1, A->data + s * sz, n,
+                 X->data + s * n, n, 0, YR->data + s * n, n);
+    t_loop = stopwatch(1);
+    stopwatch(0);
+    for (r = 0; r < REPEAT; r++) gemv_small(Tran, 1, A, X, 0, Y);
+    t_small = stopwatch(1);
+    printf("  gemv    %9.1lf / %8.1lf  err %.2e\n", (double)t_loop / REPEAT,
+           (double)t_small / REPEAT, max_diff(Y->data, YR->data, n * NUM_SLICE));
+
+    // invert, per slice only up to 6 x 6 without LAPACK
+    t_loop = 0;
+    if (n <= 6) {
+      stopwatch(0);
+      for (r = 0; r < REPEAT; r++) invert(A, R);
+      t_loop = stopwatch(1);
+    }
+    stopwatch(0);
+    for (r = 0; r < REPEAT; r++) invert_small(A, V);
+    t_small = stopwatch(1);
+    printf("  invert  %9.1lf / %8.1lf  |A*inv-V| %.2e\n",
+           (double)t_loop / REPEAT, (double)t_small / REPEAT, inv_err(A, V));
+    // in place
+    copy_mat(A, C);
+    invert_small(C, C);
+    if (max_diff(C->data, V->data, sz * NUM_SLICE) != 0)
+      printf("  invert in place differs by %.2e\n",
+             max_diff(C->data, V->data, sz * NUM_SLICE));
+
+    t_loop = 0;
+    if (n <= 6) {
+      stopwatch(0);
+      for (r = 0; r < REPEAT; r++) cinvert(CA, CR);
+      t_loop = stopwatch(1);
+    }
+    stopwatch(0);
+    for (r = 0; r < REPEAT; r++) cinvert_small(CA, CV);
+    t_small = stopwatch(1);
+    printf("  cinvert %9.1lf / %8.1lf  |A*inv-V| %.2e\n",
+           (double)t_loop / REPEAT, (double)t_small / REPEAT, cinv_err(CA, CV));
+
+    // det
+    det_small(A, D);
+    cdet_small(CA, CD);
+    if (n <= 6) {
+      err = 0;
+      for (s = 0; s < NUM_SLICE; s++) {
+        if (fabs(D->data[s] - det_f[n](A->data + s * sz)) > err)
+          err = fabs(D->data[s] - det_f[n](A->data + s * sz));
+        one = cdet_f[n](CA->data + s * sz);
+        if (fabs(CD->data[s].re - one.re) + fabs(CD->data[s].im - one.im) > err)
+          err = fabs(CD->data[s].re - one.re) + fabs(CD->data[s].im - one.im);
+      }
+      one.re = 1;
+      one.im = 0;
+      printf("  det     err %.2e\n", err);
+    }
+    // det(A) * det(inv(A)) = 1
+    det_small(V, DV);
+    cdet_small(CV, CDV);
+    err = 0;
+    for (s = 0; s < NUM_SLICE; s++) {
+      if (fabs(D->data[s] * DV->data[s] - 1) > err)
+        err = fabs(D->data[s] * DV->data[s] - 1);
+      if (fabs(CD->data[s].re * CDV->data[s].re -
+               CD->data[s].im * CDV->data[s].im - 1) > err)
+        err = fabs(CD->data[s].re * CDV->data[s].re -
+                   CD->data[s].im * CDV->data[s].im - 1);
+    }
+    printf("  |det(A)det(inv)-1| %.2e\n", err);
+
+    free_mat(A);
+    free_mat(B);
+    free_mat(C);
+    free_mat(R);
+    free_mat(V);
+    free_mat(X);
+    free_mat(Y);
+    free_mat(YR);
+    free_mat(D);
+    free_mat(DV);
+    free_cmat(CA);
+    free_cmat(CB);
+    free_cmat(CC);
+    free_cmat(CR);
+    free_cmat(CV);
+    free_cmat(CD);
+    free_cmat(CDV);
+  }
+
+  finit();
+  return 0;
+}
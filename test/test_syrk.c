@@ -0,0 +1,165 @@
+#include "mother.h"
+
+/* syrk_mat() and herk_cmat() against gemm on odd sizes, both triangles and
+ * ops, with the other triangle checked untouched, and mirror_mat().
+ * Timing of per-bin spatial covariance, herk against cgemm, in us. */
+
+#define CH 6
+#define FRAME 300
+#define BIN 257
+#define REPEAT 20
+
+UINT ns[7] = {1, 5, 63, 64, 65, 130, 200};
+UINT ks[4] = {1, 3, 7, 100};
+
+int main() {
+  MAT *A, *C, *R, *S;
+  CMAT *CA, *CC, *CR, *CS, *X, *Rf, *Rh;
+  CTYPE one = {1, 0}, zero = {0, 0}, a, b;
+  char up[2] = {Upper, Lower};
+  char tr[2] = {NoTran, Tran};
+  char ctr[2] = {NoTran, CTran};
+  UINT n, k;
+  ITER in, ik, u, t, i, j, r;
+  DTYPE err = 0, cerr = 0, d;
+  int touched = 0;
+  long long t_gemm, t_herk;
+
+  init(0);
+  a.re = 0.7;
+  a.im = 0;
+  b.re = 0.5;
+  b.im = 0;
+  for (in = 0; in < 7; in++)
+    for (ik = 0; ik < 4; ik++)
+      for (u = 0; u < 2; u++)
+        for (t = 0; t < 2; t++) {
+          n = ns[in];
+          k = ks[ik];
+          A = tr[t] == NoTran ? alloc_mat(n, k) : alloc_mat(k, n);
+          CA = ctr[t] == NoTran ? alloc_cmat(n, k) : alloc_cmat(k, n);
+          C = alloc_mat(n, n);
+          R = alloc_mat(n, n);
+          S = alloc_mat(n, n);
+          CC = alloc_cmat(n, n);
+          CR = alloc_cmat(n, n);
+          CS = alloc_cmat(n, n);
+          randu(A, -1, 1);
+          randu(C, -1, 1);
+          crandu(CA, -1, 1, -1, 1);
+          crandu(CC, -1, 1, -1, 1);
+          // symmetric and hermitian C, so that the mirror is beta * C too
+          mirror_mat(Lower, C);
+          mirror_cmat(Lower, CC);
+          copy_mat(C, R);
+          copy_mat(C, S);
+          ccopy_mat(CC, CR);
+          ccopy_mat(CC, CS);
+
+          syrk_mat(up[u], tr[t], 0.7, A, 0.5, C);
+          omp_gemm(tr[t], tr[t] == NoTran ? Tran : NoTran, n, n, k, 0.7,
+                   A->data, A->d0, A->data, A->d0, 0.5, R->data, n);
+          herk_cmat(up[u], ctr[t], 0.7, CA, 0.5, CC);
+          omp_cgemm(ctr[t], ctr[t] == NoTran ? CTran : NoTran, n, n, k, a,
+                    CA->data, CA->d0, CA->data, CA->d0, b, CR->data, n);
+          for (j = 0; j < n; j++)
+            for (i = 0; i < n; i++) {
+              if (up[u] == Upper ? i <= j : i >= j) {
+                d = fabs(C->data[i + j * n] - R->data[i + j * n]);
+                if (d > err) err = d;
+                d = fabs(CC->data[i + j * n].re - CR->data[i + j * n].re);
+                if (d > cerr) cerr = d;
+                d = fabs(CC->data[i + j * n].im - CR->data[i + j * n].im);
+                if (d > cerr) cerr = d;
+              } else if (C->data[i + j * n] != S->data[i + j * n] ||
+                         CC->data[i + j * n].re != CS->data[i + j * n].re ||
+                         CC->data[i + j * n].im != CS->data[i + j * n].im)
+                touched = 1;
+            }
+
+          // mirrored triangle against the full product
+          mirror_mat(up[u], C);
+          mirror_cmat(up[u], CC);
+          for (i = 0; i < n * n; i++) {
+            d = fabs(C->data[i] - R->data[i]);
+            if (d > err) err = d;
+            d = fabs(CC->data[i].re - CR->data[i].re);
+            if (d > cerr) cerr = d;
+            d = fabs(CC->data[i].im - CR->data[i].im);
+            if (d > cerr) cerr = d;
+          }
+          free_mat(A);
+          free_mat(C);
+          free_mat(R);
+          free_mat(S);
+          free_cmat(CA);
+          free_cmat(CC);
+          free_cmat(CR);
+          free_cmat(CS);
+        }
+  printf("max error against gemm : real %.2e, complex %.2e\n", err, cerr);
+  if (touched) printf("the other triangle is written\n");
+
+  // beta 0 doesn't read C
+  A = alloc_mat(70, 9);
+  C = alloc_mat(70, 70);
+  randu(A, -1, 1);
+  for (i = 0; i < 70 * 70; i++) C->data[i] = NAN;
+  syrk_mat(Lower, NoTran, 1, A, 0, C);
+  for (j = 0; j < 70; j++)
+    for (i = j; i < 70; i++)
+      if (isnan(C->data[i + j * 70])) touched = 2;
+  if (touched == 2) printf("beta 0 : NaN of C is read\n");
+  free_mat(A);
+  free_mat(C);
+
+  // R(bin) = X(bin) * X(bin)^H / FRAME, X : CH x FRAME x BIN
+  X = alloc_cmat(CH, FRAME, BIN);
+  Rf = alloc_cmat(CH, CH, BIN);
+  Rh = alloc_cmat(CH, CH, BIN);
+  crandu(X, -1, 1, -1, 1);
+  one.re = 1.0 / FRAME;
+  // as caABhpbC(), whose size check doesn't take transposed B
+  stopwatch(0);
+  for (r = 0; r < REPEAT; r++)
+    cgemm_batch(NoTran, CTran, CH, CH, FRAME, one, X->data, CH, CH * FRAME,
+                X->data, CH, CH * FRAME, zero, Rf->data, CH, CH * CH, BIN);
+  t_gemm = stopwatch(1);
+  stopwatch(0);
+  for (r = 0; r < REPEAT; r++) herk_cmat(Lower, NoTran, 1.0 / FRAME, X, 0, Rh);
+  t_herk = stopwatch(1);
+  mirror_cmat(Lower, Rh);
+  cerr = 0;
+  for (i = 0; i < CH * CH * BIN; i++) {
+    d = fabs(Rh->data[i].re - Rf->data[i].re);
+    if (d > cerr) cerr = d;
+    d = fabs(Rh->data[i].im - Rf->data[i].im);
+    if (d > cerr) cerr = d;
+  }
+  printf("covariance %d x %d x %d bins : cgemm %.1lf us, herk %.1lf us, "
+         "error %.2e\n",
+         CH, FRAME, BIN, (double)t_gemm / REPEAT, (double)t_herk / REPEAT,
+         cerr);
+  stopwatch(0);
+  for (r = 0; r < REPEAT; r++) mirror_cmat(Lower, Rh);
+  printf("mirror_cmat : %.1lf us\n", (double)stopwatch(1) / REPEAT);
+  free_cmat(X);
+  free_cmat(Rf);
+  free_cmat(Rh);
+
+  // one large triangle
+  A = alloc_mat(512, 512);
+  C = alloc_mat(512, 512);
+  randu(A, -1, 1);
+  stopwatch(0);
+  gemm_mat(NoTran, Tran, 1, A, A, 0, C);
+  t_gemm = stopwatch(1);
+  stopwatch(0);
+  syrk_mat(Lower, NoTran, 1, A, 0, C);
+  printf("512 x 512 : gemm %lld us, syrk %lld us\n", t_gemm, stopwatch(1));
+  free_mat(A);
+  free_mat(C);
+
+  finit();
+  return 0;
+}
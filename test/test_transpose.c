@@ -0,0 +1,146 @@
+#include "mother.h"
+
+/* Tiled transpose against the per-element loop it replaces,
+ * in GB/s of bytes read + written, with memcpy() as the ceiling. */
+
+#define REPEAT 20
+
+/* transpose loop as it was */
+void trans_naive(UINT d0, UINT d1, UINT d2, DTYPE* src, DTYPE* des) {
+  ITER i, j;
+#pragma omp parallel for schedule(dynamic,CHUNK_SIZE) shared(src, des) private(i, j)
+  for (j = 0; j < d2; j++)
+    for (i = 0; i < d0 * d1; i++)
+      des[j * d0 * d1 + i / d0 + i % d0 * d1] = src[j * d0 * d1 + i];
+}
+
+double gbps(UINT n, UINT size, long long us) {
+  return 2.0 * n * size * REPEAT / us / 1000.0;
+}
+
+int check(MAT* A, MAT* T) {
+  ITER i, j, k;
+  for (k = 0; k < A->d2; k++)
+    for (j = 0; j < A->d1; j++)
+      for (i = 0; i < A->d0; i++)
+        if (A->data[i + j * A->d0 + k * A->d0 * A->d1] !=
+            T->data[j + i * A->d1 + k * A->d0 * A->d1])
+          return 0;
+  return 1;
+}
+
+int ccheck(CMAT* A, CMAT* T) {
+  ITER i, j, k;
+  CTYPE a, t;
+  for (k = 0; k < A->d2; k++)
+    for (j = 0; j < A->d1; j++)
+      for (i = 0; i < A->d0; i++) {
+        a = A->data[i + j * A->d0 + k * A->d0 * A->d1];
+        t = T->data[j + i * A->d1 + k * A->d0 * A->d1];
+        if (a.re != t.re || a.im != t.im) return 0;
+      }
+  return 1;
+}
+
+void bench(UINT d0, UINT d1, UINT d2) {
+  MAT *A, *T, *B;
+  UINT n = d0 * d1 * d2;
+  ITER i;
+  long long t_copy, t_naive, t_tile, t_inplace;
+
+  A = alloc_mat(d0, d1, d2);
+  B = alloc_mat(d0, d1, d2);
+  randu(A, -1, 1);
+
+  stopwatch(0);
+  for (i = 0; i < REPEAT; i++) memcpy(B->data, A->data, sizeof(DTYPE) * n);
+  t_copy = stopwatch(1);
+
+  stopwatch(0);
+  for (i = 0; i < REPEAT; i++) trans_naive(d0, d1, d2, A->data, B->data);
+  t_naive = stopwatch(1);
+
+  stopwatch(0);
+  for (i = 0; i < REPEAT; i++) {
+    T = create_trans(A);
+    free_mat(T);
+  }
+  t_tile = stopwatch(1);
+
+  // even number of transpose() gives A back
+  copy_mat(A, B);
+  stopwatch(0);
+  for (i = 0; i < REPEAT; i++) transpose(B);
+  t_inplace = stopwatch(1);
+
+  printf("%u x %u x %u\n", d0, d1, d2);
+  printf(" memcpy       : %6.2lf GB/s\n", gbps(n, sizeof(DTYPE), t_copy));
+  printf(" naive        : %6.2lf GB/s\n", gbps(n, sizeof(DTYPE), t_naive));
+  printf(" create_trans : %6.2lf GB/s\n", gbps(n, sizeof(DTYPE), t_tile));
+  printf(" transpose    : %6.2lf GB/s\n", gbps(n, sizeof(DTYPE), t_inplace));
+
+  T = create_trans(A);
+  printf(" check create_trans : %s\n", check(A, T) ? "OK" : "FAIL");
+  copy_mat(A, B);
+  transpose(B);
+  printf(" check transpose    : %s\n", check(A, B) ? "OK" : "FAIL");
+  free_mat(T);
+  free_mat(A);
+  free_mat(B);
+}
+
+void cbench(UINT d0, UINT d1, UINT d2) {
+  CMAT *A, *T, *B;
+  UINT n = d0 * d1 * d2;
+  ITER i;
+  long long t_copy, t_tile, t_inplace;
+
+  A = alloc_cmat(d0, d1, d2);
+  B = alloc_cmat(d0, d1, d2);
+  crandu(A, -1, 1, -1, 1);
+
+  stopwatch(0);
+  for (i = 0; i < REPEAT; i++) memcpy(B->data, A->data, sizeof(CTYPE) * n);
+  t_copy = stopwatch(1);
+
+  stopwatch(0);
+  for (i = 0; i < REPEAT; i++) {
+    T = create_ctrans(A);
+    free_cmat(T);
+  }
+  t_tile = stopwatch(1);
+
+  ccopy_mat(A, B);
+  stopwatch(0);
+  for (i = 0; i < REPEAT; i++) ctranspose(B);
+  t_inplace = stopwatch(1);
+
+  printf("complex %u x %u x %u\n", d0, d1, d2);
+  printf(" memcpy        : %6.2lf GB/s\n", gbps(n, sizeof(CTYPE), t_copy));
+  printf(" create_ctrans : %6.2lf GB/s\n", gbps(n, sizeof(CTYPE), t_tile));
+  printf(" ctranspose    : %6.2lf GB/s\n", gbps(n, sizeof(CTYPE), t_inplace));
+
+  T = create_ctrans(A);
+  printf(" check create_ctrans : %s\n", ccheck(A, T) ? "OK" : "FAIL");
+  ccopy_mat(A, B);
+  ctranspose(B);
+  printf(" check ctranspose    : %s\n", ccheck(A, B) ? "OK" : "FAIL");
+  free_cmat(T);
+  free_cmat(A);
+  free_cmat(B);
+}
+
+int main() {
+  init(0);
+
+  bench(1024, 1024, 1);
+  bench(2048, 2048, 1);
+  bench(513, 1024, 1);
+  bench(257, 500, 8);
+  cbench(1024, 1024, 1);
+  cbench(513, 1024, 1);
+  cbench(257, 500, 8);
+
+  finit();
+  return 0;
+}
@@ -0,0 +1,102 @@
+#include "header_for_test.h"
+#include "mother.h"
+
+/* Views of a spectrogram against submat() copies :
+ * results of gemm, gemv, axpy and copy must be equal, and the view
+ * costs no copy. */
+
+#define NUM_BIN 257
+#define NUM_FRAME 500
+#define NUM_BAND 64
+#define BAND_ST 32
+#define REPEAT 100
+
+int main() {
+  MAT *S, *W, *band, *frame, *out_view, *out_copy, *y_view, *y_copy;
+  MAT_VIEW vband, vframe, vW, vout, vy, vrow;
+  MAT *row;
+  ITER i, t;
+  long long before, after;
+
+  init(0);
+  S = alloc_mat(NUM_BIN, NUM_FRAME);
+  W = alloc_mat(16, NUM_BAND);
+  band = alloc_mat(NUM_BAND, NUM_FRAME);
+  frame = alloc_mat(NUM_BIN);
+  out_view = zeros(16, NUM_FRAME);
+  out_copy = zeros(16, NUM_FRAME);
+  y_view = zeros(NUM_FRAME);
+  y_copy = zeros(NUM_FRAME);
+  row = zeros(1, NUM_FRAME);
+  randn(S, 0, 1);
+  randn(W, 0, 1);
+
+  // gemm : W * S(band)
+  submat(S, band, BAND_ST, BAND_ST + NUM_BAND, -1, -1);
+  gemm_mat(NoTran, NoTran, 1, W, band, 0, out_copy);
+
+  vband = subview(S, BAND_ST, BAND_ST + NUM_BAND, -1, -1);
+  vW = view_mat(W);
+  vout = view_mat(out_view);
+  gemm_view(NoTran, NoTran, 1, &vW, &vband, 0, &vout);
+  printf("gemm  : %e\n", max_diff(out_view->data, out_copy->data,
+                                  16 * NUM_FRAME));
+
+  // gemv : S^T * (t-th frame)
+  t = 7;
+  submat(S, frame, -1, -1, t, t + 1);
+  gemv_mat(NoTran, 1, S, frame, 0, y_copy);
+
+  vframe = subview(S, -1, -1, t, t + 1);
+  vy = view_mat(y_view);
+  {
+    MAT_VIEW vS = view_mat(S);
+    gemv_view(NoTran, 1, &vS, &vframe, 0, &vy);
+  }
+  printf("gemv  : %e\n", max_diff(y_view->data, y_copy->data, NUM_FRAME));
+
+  // axpy, copy : a row of S, stride NUM_BIN
+  vrow = subview(S, 3, 4, -1, -1);
+  {
+    MAT_VIEW vr = view_mat(row);
+    copy_view(&vrow, &vr);
+    for (i = 0; i < NUM_FRAME; i++)
+      if (row->data[i] != S->data[3 + i * NUM_BIN]) printf("copy  : FAIL\n");
+    // row - row of S = 0
+    axpy_view(-1, &vrow, &vr);
+    fill(y_view, 0);
+    printf("axpy  : %e\n", max_diff(row->data, y_view->data, NUM_FRAME));
+  }
+
+  // Slicing band of every 10 frames, copy against view.
+  stopwatch(0);
+  for (i = 0; i < REPEAT; i++)
+    for (t = 0; t + 10 <= NUM_FRAME; t += 10) {
+      MAT* b = alloc_mat(NUM_BAND, 10);
+      submat(S, b, BAND_ST, BAND_ST + NUM_BAND, t, t + 10);
+      free_mat(b);
+    }
+  before = stopwatch(1);
+
+  stopwatch(0);
+  for (i = 0; i < REPEAT; i++)
+    for (t = 0; t + 10 <= NUM_FRAME; t += 10)
+      vband = subview(S, BAND_ST, BAND_ST + NUM_BAND, t, t + 10);
+  after = stopwatch(1);
+
+  printf("slice %d x 10, per slice\n", NUM_BAND);
+  printf(" submat  : %.3lf us\n", (double)before / (REPEAT * NUM_FRAME / 10));
+  printf(" subview : %.3lf us\n", (double)after / (REPEAT * NUM_FRAME / 10));
+
+  free_mat(S);
+  free_mat(W);
+  free_mat(band);
+  free_mat(frame);
+  free_mat(out_view);
+  free_mat(out_copy);
+  free_mat(y_view);
+  free_mat(y_copy);
+  free_mat(row);
+  finit();
+  return 0;
+}